@@ -19,6 +19,12 @@
 /* If you have setmode() but not <io.h>, just delete this line: */
 #include <io.h>                 /* to declare setmode() */
 #endif
+#include "jconfigint.h"
+#ifdef HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 
 
 /*
@@ -143,3 +149,92 @@ write_stdout(void)
 #endif
   return output_file;
 }
+
+
+/*
+ * Routines to map an input file into memory, so that it can be read with the
+ * in-memory source manager rather than through a stdio buffer.  This saves a
+ * system call and a copy for every buffer load, and it allows the Huffman
+ * decoder to use its fast path across what would otherwise be buffer
+ * boundaries.
+ *
+ * map_input_file() returns FALSE if the file cannot be mapped (because it is
+ * not a regular file, because it is empty, because the stdio stream has
+ * already been read from, or because the system doesn't support memory
+ * mapping), in which case the caller should fall back to the stdio source
+ * manager.
+ */
+
+GLOBAL(boolean)
+map_input_file(FILE *infile, unsigned char **buffer, unsigned long *size)
+{
+#ifdef HAVE_MMAP
+  struct stat st;
+  void *ptr;
+
+  if (fstat(fileno(infile), &st) < 0 || !S_ISREG(st.st_mode) ||
+      st.st_size <= 0 || (off_t)(unsigned long)st.st_size != st.st_size ||
+      (off_t)(size_t)st.st_size != st.st_size || ftell(infile) != 0)
+    return FALSE;
+  ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE,
+             fileno(infile), 0);
+  if (ptr == MAP_FAILED)
+    return FALSE;
+#ifdef MADV_SEQUENTIAL
+  (void)madvise(ptr, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+  *buffer = (unsigned char *)ptr;
+  *size = (unsigned long)st.st_size;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+GLOBAL(void)
+unmap_input_file(unsigned char *buffer, unsigned long size)
+{
+#ifdef HAVE_MMAP
+  (void)munmap((void *)buffer, (size_t)size);
+#endif
+}
+
+
+/*
+ * Print the per-stage timing counters collected for a JPEG object (see
+ * jpeg_enable_profiling()), normalized to the given image dimensions.
+ * Nothing is printed if profiling was not enabled or is not supported by the
+ * library.
+ */
+
+GLOBAL(void)
+print_profile(j_common_ptr cinfo, JDIMENSION width, JDIMENSION height)
+{
+  static const char * const stage_names[JPROF_NUMSTAGES] = {
+    "markers", "entropy", "DCT", "sampling", "color", "quantize"
+  };
+  jpeg_stage_profile stages[JPROF_NUMSTAGES];
+  double total = 0.0, pixels = (double)width * (double)height;
+  int i;
+
+  jpeg_get_profile(cinfo, stages);
+  for (i = 0; i < JPROF_NUMSTAGES; i++)
+    total += (double)stages[i].ticks;
+  if (total <= 0.0 || pixels <= 0.0)
+    return;
+
+  fprintf(stderr, "%s profile (%u x %u pixels):\n",
+          cinfo->is_decompressor ? "Decompression" : "Compression", width,
+          height);
+  fprintf(stderr, "  %-9s %15s %10s %10s %7s\n", "stage", "ticks", "calls",
+          "ticks/pix", "share");
+  for (i = 0; i < JPROF_NUMSTAGES; i++) {
+    if (stages[i].calls == 0)
+      continue;
+    fprintf(stderr, "  %-9s %15.0f %10lu %10.2f %6.1f%%\n", stage_names[i],
+            (double)stages[i].ticks, stages[i].calls,
+            (double)stages[i].ticks / pixels,
+            (double)stages[i].ticks * 100.0 / total);
+  }
+}
@@ -132,6 +132,11 @@ EXTERN(void) end_progress_monitor(j_common_ptr cinfo);
 EXTERN(boolean) keymatch(char *arg, const char *keyword, int minchars);
 EXTERN(FILE *) read_stdin(void);
 EXTERN(FILE *) write_stdout(void);
+EXTERN(boolean) map_input_file(FILE *infile, unsigned char **buffer,
+                               unsigned long *size);
+EXTERN(void) unmap_input_file(unsigned char *buffer, unsigned long size);
+EXTERN(void) print_profile(j_common_ptr cinfo, JDIMENSION width,
+                           JDIMENSION height);
 
 /* miscellaneous useful macros */
 
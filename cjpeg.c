@@ -653,6 +653,13 @@ main(int argc, char **argv)
 #endif
     jpeg_stdio_dest(&cinfo, output_file);
 
+  /* With -verbose, time each stage of compression so that a breakdown can be
+   * printed at the end (this does nothing unless the library was built with
+   * profiling support.)
+   */
+  if (cinfo.err->trace_level > 0)
+    (void)jpeg_enable_profiling((j_common_ptr)&cinfo, TRUE);
+
   /* Start compressor */
   jpeg_start_compress(&cinfo, TRUE);
 
@@ -668,6 +675,8 @@ main(int argc, char **argv)
   /* Finish compression and release memory */
   (*src_mgr->finish_input) (&cinfo, src_mgr);
   jpeg_finish_compress(&cinfo);
+  if (cinfo.err->trace_level > 0)
+    print_profile((j_common_ptr)&cinfo, cinfo.image_width, cinfo.image_height);
   jpeg_destroy_compress(&cinfo);
 
   /* Close files, if we opened them */
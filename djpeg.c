@@ -518,6 +518,7 @@ main(int argc, char **argv)
   unsigned char *inbuffer = NULL;
 #if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
   unsigned long insize = 0;
+  boolean mapped = FALSE;
 #endif
   JDIMENSION num_scanlines;
 
@@ -629,10 +630,21 @@ main(int argc, char **argv)
     } while (nbytes == INPUT_BUF_SIZE);
     fprintf(stderr, "Compressed size:  %lu bytes\n", insize);
     jpeg_mem_src(&cinfo, inbuffer, insize);
+  } else if (map_input_file(input_file, &inbuffer, &insize)) {
+    /* Read directly from a memory-mapped copy of the input file */
+    mapped = TRUE;
+    jpeg_mem_src(&cinfo, inbuffer, insize);
   } else
 #endif
     jpeg_stdio_src(&cinfo, input_file);
 
+  /* With -verbose, time each stage of decompression so that a breakdown
+   * can be printed at the end (this does nothing unless the library was built
+   * with profiling support.)
+   */
+  if (cinfo.err->trace_level > 0)
+    (void)jpeg_enable_profiling((j_common_ptr)&cinfo, TRUE);
+
   /* Read file header, set default decompression parameters */
   (void)jpeg_read_header(&cinfo, TRUE);
 
@@ -801,6 +813,9 @@ main(int argc, char **argv)
    */
   (*dest_mgr->finish_output) (&cinfo, dest_mgr);
   (void)jpeg_finish_decompress(&cinfo);
+  if (cinfo.err->trace_level > 0)
+    print_profile((j_common_ptr)&cinfo, cinfo.output_width,
+                  cinfo.output_height);
   jpeg_destroy_decompress(&cinfo);
 
   /* Close files, if we opened them */
@@ -815,6 +830,10 @@ main(int argc, char **argv)
 
   if (memsrc)
     free(inbuffer);
+#if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
+  else if (mapped)
+    unmap_input_file(inbuffer, insize);
+#endif
 
   /* All done. */
   exit(jerr.num_warnings ? EXIT_WARNING : EXIT_SUCCESS);
@@ -51,7 +51,9 @@ final class TJUnitTest {
     System.out.println("-yuv = test YUV encoding/decoding support");
     System.out.println("-noyuvpad = do not pad each line of each Y, U, and V plane to the nearest");
     System.out.println("            4-byte boundary");
-    System.out.println("-bi = test BufferedImage support\n");
+    System.out.println("-bi = test BufferedImage support");
+    System.out.println("-direct = test direct ByteBuffer support (cannot be combined with -yuv or");
+    System.out.println("          -bi)\n");
     System.exit(1);
   }
 
@@ -94,6 +96,7 @@ final class TJUnitTest {
   private static boolean doYUV = false;
   private static int pad = 4;
   private static boolean bi = false;
+  private static boolean direct = false;
 
   private static int exitStatus = 0;
 
@@ -659,7 +662,13 @@ final class TJUnitTest {
     } else {
       srcBuf = new byte[w * h * ps + 1];
       initBuf(srcBuf, w, w * ps, h, pf, flags);
-      tjc.setSourceImage(srcBuf, 0, 0, w, 0, h, pf);
+      if (direct) {
+        ByteBuffer srcBufDirect = ByteBuffer.allocateDirect(srcBuf.length);
+        srcBufDirect.put(srcBuf);
+        srcBufDirect.rewind();
+        tjc.setSourceImage(srcBufDirect, 0, 0, w, 0, h, pf);
+      } else
+        tjc.setSourceImage(srcBuf, 0, 0, w, 0, h, pf);
     }
     Arrays.fill(dstBuf, (byte)0);
 
@@ -684,7 +693,12 @@ final class TJUnitTest {
       System.out.format("%s %s -> %s Q%d ... ", pfStrLong, buStrLong,
                         SUBNAME_LONG[subsamp], jpegQual);
     }
-    tjc.compress(dstBuf, flags);
+    if (direct) {
+      ByteBuffer dstBufDirect = ByteBuffer.allocateDirect(dstBuf.length);
+      tjc.compress(dstBufDirect, flags);
+      dstBufDirect.get(dstBuf);
+    } else
+      tjc.compress(dstBuf, flags);
     size = tjc.getCompressedSize();
 
     tempStr = baseName + "_enc_" + pfStr + "_" + buStr + "_" +
@@ -716,7 +730,13 @@ final class TJUnitTest {
       pfStrLong = pfStr;
     }
 
-    tjd.setSourceImage(jpegBuf, jpegSize);
+    if (direct) {
+      ByteBuffer jpegBufDirect = ByteBuffer.allocateDirect(jpegSize);
+      jpegBufDirect.put(jpegBuf, 0, jpegSize);
+      jpegBufDirect.rewind();
+      tjd.setSourceImage(jpegBufDirect, jpegSize);
+    } else
+      tjd.setSourceImage(jpegBuf, jpegSize);
     if (tjd.getWidth() != w || tjd.getHeight() != h ||
         tjd.getSubsamp() != subsamp)
       throw new Exception("Incorrect JPEG header");
@@ -753,7 +773,15 @@ final class TJUnitTest {
     }
     if (bi)
       img = tjd.decompress(scaledWidth, scaledHeight, imgType, flags);
-    else
+    else if (direct) {
+      int pitch = scaledWidth * TJ.getPixelSize(pf);
+      ByteBuffer dstBufDirect =
+        ByteBuffer.allocateDirect(pitch * scaledHeight);
+      tjd.decompress(dstBufDirect, 0, 0, scaledWidth, 0, scaledHeight, pf,
+                     flags);
+      dstBuf = new byte[pitch * scaledHeight];
+      dstBufDirect.get(dstBuf);
+    } else
       dstBuf = tjd.decompress(scaledWidth, 0, scaledHeight, pf, flags);
 
     if (bi) {
@@ -907,9 +935,14 @@ final class TJUnitTest {
         else if (argv[i].equalsIgnoreCase("-bi")) {
           bi = true;
           testName = "javabitest";
+        } else if (argv[i].equalsIgnoreCase("-direct")) {
+          direct = true;
+          testName = "javadirecttest";
         } else
           usage();
       }
+      if (direct && (doYUV || bi))
+        usage();
       if (doYUV)
         FORMATS_4BYTE[4] = -1;
       doTest(35, 39, bi ? FORMATS_3BYTEBI : FORMATS_3BYTE, TJ.SAMP_444,
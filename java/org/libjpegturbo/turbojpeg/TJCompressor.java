@@ -158,6 +158,63 @@ public class TJCompressor implements Closeable {
     srcX = x;
     srcY = y;
     srcBufInt = null;
+    srcBufDirect = null;
+    srcYUVImage = null;
+  }
+
+  /**
+   * Associate an uncompressed RGB, grayscale, or CMYK source image stored in
+   * a direct <code>ByteBuffer</code> with this compressor instance.  The
+   * image is read in place by the native code, so it need not be copied into
+   * the Java heap.
+   *
+   * @param srcImage direct <code>ByteBuffer</code> containing RGB, grayscale,
+   * or CMYK pixels to be compressed.  The image is assumed to start at the
+   * buffer's current position.  This buffer (including its position and
+   * limit) is not modified, but its contents must not change until the
+   * compress operation has completed.
+   *
+   * @param x see {@link #setSourceImage(byte[], int, int, int, int, int, int)}
+   * for description
+   *
+   * @param y see {@link #setSourceImage(byte[], int, int, int, int, int, int)}
+   * for description
+   *
+   * @param width see
+   * {@link #setSourceImage(byte[], int, int, int, int, int, int)} for
+   * description
+   *
+   * @param pitch see
+   * {@link #setSourceImage(byte[], int, int, int, int, int, int)} for
+   * description
+   *
+   * @param height see
+   * {@link #setSourceImage(byte[], int, int, int, int, int, int)} for
+   * description
+   *
+   * @param pixelFormat pixel format of the source image (one of
+   * {@link TJ#PF_RGB TJ.PF_*})
+   */
+  public void setSourceImage(ByteBuffer srcImage, int x, int y, int width,
+                             int pitch, int height, int pixelFormat)
+                             throws TJException {
+    if (handle == 0) init();
+    if (srcImage == null || !srcImage.isDirect() || x < 0 || y < 0 ||
+        width < 1 || height < 1 || pitch < 0 || pixelFormat < 0 ||
+        pixelFormat >= TJ.NUMPF)
+      throw new IllegalArgumentException("Invalid argument in setSourceImage()");
+    srcBufDirect = srcImage.slice();
+    srcWidth = width;
+    if (pitch == 0)
+      srcPitch = width * TJ.getPixelSize(pixelFormat);
+    else
+      srcPitch = pitch;
+    srcHeight = height;
+    srcPixelFormat = pixelFormat;
+    srcX = x;
+    srcY = y;
+    srcBuf = null;
+    srcBufInt = null;
     srcYUVImage = null;
   }
 
@@ -256,6 +313,7 @@ public class TJCompressor implements Closeable {
       srcBuf = db.getData();
       srcBufInt = null;
     }
+    srcBufDirect = null;
     srcYUVImage = null;
   }
 
@@ -273,6 +331,7 @@ public class TJCompressor implements Closeable {
     srcYUVImage = srcImage;
     srcBuf = null;
     srcBufInt = null;
+    srcBufDirect = null;
   }
 
   /**
@@ -329,7 +388,8 @@ public class TJCompressor implements Closeable {
   public void compress(byte[] dstBuf, int flags) throws TJException {
     if (dstBuf == null || flags < 0)
       throw new IllegalArgumentException("Invalid argument in compress()");
-    if (srcBuf == null && srcBufInt == null && srcYUVImage == null)
+    if (srcBuf == null && srcBufInt == null && srcBufDirect == null &&
+        srcYUVImage == null)
       throw new IllegalStateException(NO_ASSOC_ERROR);
     if (jpegQuality < 0)
       throw new IllegalStateException("JPEG Quality not set");
@@ -344,6 +404,10 @@ public class TJCompressor implements Closeable {
                                        srcYUVImage.getHeight(),
                                        srcYUVImage.getSubsamp(),
                                        dstBuf, jpegQuality, flags);
+    else if (srcBufDirect != null)
+      compressedSize = compress(srcBufDirect, srcX, srcY, srcWidth, srcPitch,
+                                srcHeight, srcPixelFormat, dstBuf, subsamp,
+                                jpegQuality, flags);
     else if (srcBuf != null) {
       if (srcX >= 0 && srcY >= 0)
         compressedSize = compress(srcBuf, srcX, srcY, srcWidth, srcPitch,
@@ -365,6 +429,50 @@ public class TJCompressor implements Closeable {
     }
   }
 
+  /**
+   * Compress the uncompressed source image associated with this compressor
+   * instance and output a JPEG image to the given direct
+   * <code>ByteBuffer</code>.  The JPEG image is written in place by the
+   * native code, so it need not be copied out of the Java heap.  Compressing
+   * from a YUV planar source image into a <code>ByteBuffer</code> is not
+   * supported.
+   *
+   * @param dstBuf direct <code>ByteBuffer</code> that will receive the JPEG
+   * image, starting at the buffer's current position.  At least
+   * {@link TJ#bufSize} bytes must remain in the buffer.  The buffer's position
+   * and limit are not modified.  Use {@link #getCompressedSize} to obtain the
+   * size of the JPEG image.
+   *
+   * @param flags the bitwise OR of one or more of
+   * {@link TJ#FLAG_BOTTOMUP TJ.FLAG_*}
+   */
+  public void compress(ByteBuffer dstBuf, int flags) throws TJException {
+    if (dstBuf == null || !dstBuf.isDirect() || flags < 0)
+      throw new IllegalArgumentException("Invalid argument in compress()");
+    if (srcYUVImage != null)
+      throw new IllegalStateException("Source image is not correct type");
+    if (srcBuf == null && srcBufInt == null && srcBufDirect == null)
+      throw new IllegalStateException(NO_ASSOC_ERROR);
+    if (jpegQuality < 0)
+      throw new IllegalStateException("JPEG Quality not set");
+    checkSubsampling();
+
+    ByteBuffer jpegBuf = dstBuf.slice();
+    int x = Math.max(srcX, 0), y = Math.max(srcY, 0);
+    if (srcBufDirect != null)
+      compressedSize = compress(srcBufDirect, x, y, srcWidth, srcPitch,
+                                srcHeight, srcPixelFormat, jpegBuf, subsamp,
+                                jpegQuality, flags);
+    else if (srcBuf != null)
+      compressedSize = compress(srcBuf, x, y, srcWidth, srcPitch, srcHeight,
+                                srcPixelFormat, jpegBuf, subsamp, jpegQuality,
+                                flags);
+    else
+      compressedSize = compress(srcBufInt, x, y, srcWidth, srcStride,
+                                srcHeight, srcPixelFormat, jpegBuf, subsamp,
+                                jpegQuality, flags);
+  }
+
   /**
    * Compress the uncompressed source image associated with this compressor
    * instance and return a buffer containing a JPEG image.
@@ -426,10 +534,10 @@ public class TJCompressor implements Closeable {
   public void encodeYUV(YUVImage dstImage, int flags) throws TJException {
     if (dstImage == null || flags < 0)
       throw new IllegalArgumentException("Invalid argument in encodeYUV()");
+    if (srcYUVImage != null || srcBufDirect != null)
+      throw new IllegalStateException("Source image is not correct type");
     if (srcBuf == null && srcBufInt == null)
       throw new IllegalStateException(NO_ASSOC_ERROR);
-    if (srcYUVImage != null)
-      throw new IllegalStateException("Source image is not correct type");
     checkSubsampling();
     if (srcWidth != dstImage.getWidth() || srcHeight != dstImage.getHeight())
       throw new IllegalStateException("Destination image is the wrong size");
@@ -614,6 +722,26 @@ public class TJCompressor implements Closeable {
     int stride, int height, int pixelFormat, byte[] jpegBuf, int jpegSubsamp,
     int jpegQual, int flags) throws TJException;
 
+  @SuppressWarnings("checkstyle:HiddenField")
+  private native int compress(ByteBuffer srcBuf, int x, int y, int width,
+    int pitch, int height, int pixelFormat, byte[] jpegBuf, int jpegSubsamp,
+    int jpegQual, int flags) throws TJException;
+
+  @SuppressWarnings("checkstyle:HiddenField")
+  private native int compress(byte[] srcBuf, int x, int y, int width,
+    int pitch, int height, int pixelFormat, ByteBuffer jpegBuf,
+    int jpegSubsamp, int jpegQual, int flags) throws TJException;
+
+  @SuppressWarnings("checkstyle:HiddenField")
+  private native int compress(int[] srcBuf, int x, int y, int width,
+    int stride, int height, int pixelFormat, ByteBuffer jpegBuf,
+    int jpegSubsamp, int jpegQual, int flags) throws TJException;
+
+  @SuppressWarnings("checkstyle:HiddenField")
+  private native int compress(ByteBuffer srcBuf, int x, int y, int width,
+    int pitch, int height, int pixelFormat, ByteBuffer jpegBuf,
+    int jpegSubsamp, int jpegQual, int flags) throws TJException;
+
   @SuppressWarnings("checkstyle:HiddenField")
   private native int compressFromYUV(byte[][] srcPlanes, int[] srcOffsets,
     int width, int[] srcStrides, int height, int subsamp, byte[] jpegBuf,
@@ -661,6 +789,7 @@ public class TJCompressor implements Closeable {
   private long handle = 0;
   private byte[] srcBuf = null;
   private int[] srcBufInt = null;
+  private ByteBuffer srcBufDirect = null;
   private int srcWidth = 0;
   private int srcHeight = 0;
   private int srcX = -1;
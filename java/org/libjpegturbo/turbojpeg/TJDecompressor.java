@@ -102,11 +102,37 @@ public class TJDecompressor implements Closeable {
     if (jpegImage == null || imageSize < 1)
       throw new IllegalArgumentException("Invalid argument in setSourceImage()");
     jpegBuf = jpegImage;
+    jpegBufDirect = null;
     jpegBufSize = imageSize;
     decompressHeader(jpegBuf, jpegBufSize);
     yuvImage = null;
   }
 
+  /**
+   * Associate the JPEG image of length <code>imageSize</code> bytes stored in
+   * the direct <code>ByteBuffer</code> <code>jpegImage</code> with this
+   * decompressor instance.  The image is read in place by the native code, so
+   * it need not be copied into the Java heap.  JPEG images associated with
+   * this method cannot be decompressed into YUV planar images.
+   *
+   * @param jpegImage direct <code>ByteBuffer</code> containing the JPEG image,
+   * starting at the buffer's current position.  This buffer (including its
+   * position and limit) is not modified, but its contents must not change
+   * while it is associated with this instance.
+   *
+   * @param imageSize size of the JPEG image (in bytes)
+   */
+  public void setSourceImage(ByteBuffer jpegImage, int imageSize)
+                             throws TJException {
+    if (jpegImage == null || !jpegImage.isDirect() || imageSize < 1)
+      throw new IllegalArgumentException("Invalid argument in setSourceImage()");
+    jpegBufDirect = jpegImage.slice();
+    jpegBuf = null;
+    jpegBufSize = imageSize;
+    decompressHeaderDirect(jpegBufDirect, jpegBufSize);
+    yuvImage = null;
+  }
+
   /**
    * @deprecated Use {@link #setSourceImage(byte[], int)} instead.
    */
@@ -130,6 +156,7 @@ public class TJDecompressor implements Closeable {
       throw new IllegalArgumentException("Invalid argument in setSourceImage()");
     yuvImage = srcImage;
     jpegBuf = null;
+    jpegBufDirect = null;
     jpegBufSize = 0;
   }
 
@@ -377,7 +404,7 @@ public class TJDecompressor implements Closeable {
   public void decompress(byte[] dstBuf, int x, int y, int desiredWidth,
                          int pitch, int desiredHeight, int pixelFormat,
                          int flags) throws TJException {
-    if (jpegBuf == null && yuvImage == null)
+    if (jpegBuf == null && jpegBufDirect == null && yuvImage == null)
       throw new IllegalStateException(NO_ASSOC_ERROR);
     if (dstBuf == null || x < 0 || y < 0 || pitch < 0 ||
         (yuvImage != null && (desiredWidth < 0 || desiredHeight < 0)) ||
@@ -388,6 +415,9 @@ public class TJDecompressor implements Closeable {
                 yuvImage.getStrides(), yuvImage.getSubsamp(), dstBuf, x, y,
                 yuvImage.getWidth(), pitch, yuvImage.getHeight(), pixelFormat,
                 flags);
+    else if (jpegBufDirect != null)
+      decompress(jpegBufDirect, jpegBufSize, dstBuf, x, y, desiredWidth,
+                 pitch, desiredHeight, pixelFormat, flags);
     else {
       if (x > 0 || y > 0)
         decompress(jpegBuf, jpegBufSize, dstBuf, x, y, desiredWidth, pitch,
@@ -475,6 +505,8 @@ public class TJDecompressor implements Closeable {
    */
   public void decompressToYUV(YUVImage dstImage, int flags)
                               throws TJException {
+    if (jpegBufDirect != null)
+      throw new IllegalStateException("Source image is not correct type");
     if (jpegBuf == null)
       throw new IllegalStateException(NO_ASSOC_ERROR);
     if (dstImage == null || flags < 0)
@@ -696,7 +728,7 @@ public class TJDecompressor implements Closeable {
   public void decompress(int[] dstBuf, int x, int y, int desiredWidth,
                          int stride, int desiredHeight, int pixelFormat,
                          int flags) throws TJException {
-    if (jpegBuf == null && yuvImage == null)
+    if (jpegBuf == null && jpegBufDirect == null && yuvImage == null)
       throw new IllegalStateException(NO_ASSOC_ERROR);
     if (dstBuf == null || x < 0 || y < 0 || stride < 0 ||
         (yuvImage != null && (desiredWidth < 0 || desiredHeight < 0)) ||
@@ -707,11 +739,73 @@ public class TJDecompressor implements Closeable {
                 yuvImage.getStrides(), yuvImage.getSubsamp(), dstBuf, x, y,
                 yuvImage.getWidth(), stride, yuvImage.getHeight(), pixelFormat,
                 flags);
+    else if (jpegBufDirect != null)
+      decompress(jpegBufDirect, jpegBufSize, dstBuf, x, y, desiredWidth,
+                 stride, desiredHeight, pixelFormat, flags);
     else
       decompress(jpegBuf, jpegBufSize, dstBuf, x, y, desiredWidth, stride,
                  desiredHeight, pixelFormat, flags);
   }
 
+  /**
+   * Decompress the JPEG source image associated with this decompressor
+   * instance and output a grayscale, RGB, or CMYK image to the given direct
+   * <code>ByteBuffer</code>.  The image is written in place by the native
+   * code, so it need not be copied out of the Java heap.  Decoding a YUV
+   * planar source image into a <code>ByteBuffer</code> is not supported.
+   * <p>
+   * NOTE: The output image is fully recoverable if this method throws a
+   * non-fatal {@link TJException} (unless
+   * {@link TJ#FLAG_STOPONWARNING TJ.FLAG_STOPONWARNING} is specified.)
+   *
+   * @param dstBuf direct <code>ByteBuffer</code> that will receive the
+   * decompressed image, starting at the buffer's current position.  The
+   * buffer's position and limit are not modified.  See
+   * {@link #decompress(byte[], int, int, int, int, int, int, int)} for a
+   * description of the required size.
+   *
+   * @param x see {@link #decompress(byte[], int, int, int, int, int, int, int)}
+   * for description
+   *
+   * @param y see {@link #decompress(byte[], int, int, int, int, int, int, int)}
+   * for description
+   *
+   * @param desiredWidth see
+   * {@link #decompress(byte[], int, int, int, int, int, int, int)} for
+   * description
+   *
+   * @param pitch see
+   * {@link #decompress(byte[], int, int, int, int, int, int, int)} for
+   * description
+   *
+   * @param desiredHeight see
+   * {@link #decompress(byte[], int, int, int, int, int, int, int)} for
+   * description
+   *
+   * @param pixelFormat pixel format of the decompressed image (one of
+   * {@link TJ#PF_RGB TJ.PF_*})
+   *
+   * @param flags the bitwise OR of one or more of
+   * {@link TJ#FLAG_BOTTOMUP TJ.FLAG_*}
+   */
+  public void decompress(ByteBuffer dstBuf, int x, int y, int desiredWidth,
+                         int pitch, int desiredHeight, int pixelFormat,
+                         int flags) throws TJException {
+    if (yuvImage != null)
+      throw new IllegalStateException("Source image is not correct type");
+    if (jpegBuf == null && jpegBufDirect == null)
+      throw new IllegalStateException(NO_ASSOC_ERROR);
+    if (dstBuf == null || !dstBuf.isDirect() || x < 0 || y < 0 ||
+        pitch < 0 || pixelFormat < 0 || pixelFormat >= TJ.NUMPF || flags < 0)
+      throw new IllegalArgumentException("Invalid argument in decompress()");
+    if (jpegBufDirect != null)
+      decompress(jpegBufDirect, jpegBufSize, dstBuf.slice(), x, y,
+                 desiredWidth, pitch, desiredHeight, pixelFormat, flags);
+    else
+      decompress(jpegBuf, jpegBufSize, dstBuf.slice(), x, y, desiredWidth,
+                 pitch, desiredHeight, pixelFormat, flags);
+  }
+
   /**
    * Decompress the JPEG source image or decode the YUV source image associated
    * with this decompressor instance and output a decompressed/decoded image to
@@ -797,6 +891,9 @@ public class TJDecompressor implements Closeable {
                   yuvImage.getStrides(), yuvImage.getSubsamp(), buf, 0, 0,
                   yuvImage.getWidth(), stride, yuvImage.getHeight(),
                   pixelFormat, flags);
+      else if (jpegBufDirect != null)
+        decompress(jpegBufDirect, jpegBufSize, buf, 0, 0, scaledWidth, stride,
+                   scaledHeight, pixelFormat, flags);
       else {
         if (jpegBuf == null)
           throw new IllegalStateException(NO_ASSOC_ERROR);
@@ -881,6 +978,9 @@ public class TJDecompressor implements Closeable {
   private native void decompressHeader(byte[] srcBuf, int size)
     throws TJException;
 
+  private native void decompressHeaderDirect(ByteBuffer srcBuf, int size)
+    throws TJException;
+
   @Deprecated
   private native void decompress(byte[] srcBuf, int size, byte[] dstBuf,
     int desiredWidth, int pitch, int desiredHeight, int pixelFormat, int flags)
@@ -899,6 +999,22 @@ public class TJDecompressor implements Closeable {
     int y, int desiredWidth, int stride, int desiredHeight, int pixelFormat,
     int flags) throws TJException;
 
+  private native void decompress(ByteBuffer srcBuf, int size, byte[] dstBuf,
+    int x, int y, int desiredWidth, int pitch, int desiredHeight,
+    int pixelFormat, int flags) throws TJException;
+
+  private native void decompress(ByteBuffer srcBuf, int size, int[] dstBuf,
+    int x, int y, int desiredWidth, int stride, int desiredHeight,
+    int pixelFormat, int flags) throws TJException;
+
+  private native void decompress(byte[] srcBuf, int size, ByteBuffer dstBuf,
+    int x, int y, int desiredWidth, int pitch, int desiredHeight,
+    int pixelFormat, int flags) throws TJException;
+
+  private native void decompress(ByteBuffer srcBuf, int size,
+    ByteBuffer dstBuf, int x, int y, int desiredWidth, int pitch,
+    int desiredHeight, int pixelFormat, int flags) throws TJException;
+
   @Deprecated
   private native void decompressToYUV(byte[] srcBuf, int size, byte[] dstBuf,
     int flags) throws TJException;
@@ -921,6 +1037,7 @@ public class TJDecompressor implements Closeable {
 
   protected long handle = 0;
   protected byte[] jpegBuf = null;
+  protected ByteBuffer jpegBufDirect = null;
   protected int jpegBufSize = 0;
   protected YUVImage yuvImage = null;
   protected int jpegWidth = 0;
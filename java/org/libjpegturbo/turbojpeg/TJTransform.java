@@ -140,6 +140,32 @@ public class TJTransform extends Rectangle {
    * and ICC profile data) from the source image to the output image.
    */
   public static final int OPT_COPYNONE    = 64;
+  /**
+   * This option will cause {@link TJTransformer#transform
+   * TJTransformer.transform()} to reduce the width and height of the output
+   * image by a factor of 2.  The DCT coefficients of the reduced image are
+   * derived from the low-order DCT coefficients of the source image and
+   * requantized using the source image's quantization tables, so this is not
+   * lossless, but it is much faster than decompressing, resizing, and
+   * recompressing the image.  This option can be combined with
+   * {@link #OPT_CROP} (the cropping region is specified in terms of the
+   * reduced image) and {@link #OPT_GRAY}, but the transform operation must be
+   * {@link #OP_NONE}.  Only one of <code>OPT_SCALE2</code>,
+   * <code>OPT_SCALE4</code>, and <code>OPT_SCALE8</code> may be specified.
+   */
+  public static final int OPT_SCALE2      = 128;
+  /**
+   * This option will cause {@link TJTransformer#transform
+   * TJTransformer.transform()} to reduce the width and height of the output
+   * image by a factor of 4.  See {@link #OPT_SCALE2}.
+   */
+  public static final int OPT_SCALE4      = 256;
+  /**
+   * This option will cause {@link TJTransformer#transform
+   * TJTransformer.transform()} to reduce the width and height of the output
+   * image by a factor of 8.  See {@link #OPT_SCALE2}.
+   */
+  public static final int OPT_SCALE8      = 512;
 
 
   /**
@@ -29,6 +29,8 @@
 
 package org.libjpegturbo.turbojpeg;
 
+import java.nio.*;
+
 /**
  * TurboJPEG lossless transformer
  */
@@ -96,10 +98,57 @@ public class TJTransformer extends TJDecompressor {
    */
   public void transform(byte[][] dstBufs, TJTransform[] transforms,
                         int flags) throws TJException {
-    if (jpegBuf == null)
-      throw new IllegalStateException("JPEG buffer not initialized");
-    transformedSizes = transform(jpegBuf, jpegBufSize, dstBufs, transforms,
-                                 flags);
+    if (jpegBufDirect != null)
+      transformedSizes = transformDirect(jpegBufDirect, jpegBufSize, dstBufs,
+                                         transforms, flags);
+    else {
+      if (jpegBuf == null)
+        throw new IllegalStateException("JPEG buffer not initialized");
+      transformedSizes = transform(jpegBuf, jpegBufSize, dstBufs, transforms,
+                                   flags);
+    }
+  }
+
+  /**
+   * Losslessly transform the JPEG image associated with this transformer
+   * instance into one or more JPEG images stored in the given direct
+   * <code>ByteBuffer</code>s.  The images are written in place by the native
+   * code, so they need not be copied out of the Java heap.
+   *
+   * @param dstBufs an array of direct <code>ByteBuffer</code>s.
+   * <code>dstBufs[i]</code> will receive a JPEG image, starting at the
+   * buffer's current position, that has been transformed using the
+   * parameters in <code>transforms[i]</code>.  Use {@link TJ#bufSize} to
+   * determine the number of bytes that must remain in each buffer.  The
+   * buffers' positions and limits are not modified.  Use
+   * {@link #getTransformedSizes} to obtain the sizes of the transformed JPEG
+   * images.
+   *
+   * @param transforms see {@link #transform(byte[][], TJTransform[], int)}
+   * for description
+   *
+   * @param flags the bitwise OR of one or more of
+   * {@link TJ#FLAG_BOTTOMUP TJ.FLAG_*}
+   */
+  public void transform(ByteBuffer[] dstBufs, TJTransform[] transforms,
+                        int flags) throws TJException {
+    if (dstBufs == null)
+      throw new IllegalArgumentException("Invalid argument in transform()");
+    ByteBuffer[] slices = new ByteBuffer[dstBufs.length];
+    for (int i = 0; i < dstBufs.length; i++) {
+      if (dstBufs[i] == null || !dstBufs[i].isDirect())
+        throw new IllegalArgumentException("Invalid argument in transform()");
+      slices[i] = dstBufs[i].slice();
+    }
+    if (jpegBufDirect != null)
+      transformedSizes = transformDirect(jpegBufDirect, jpegBufSize, slices,
+                                         transforms, flags);
+    else {
+      if (jpegBuf == null)
+        throw new IllegalStateException("JPEG buffer not initialized");
+      transformedSizes = transformDirect(jpegBuf, jpegBufSize, slices,
+                                         transforms, flags);
+    }
   }
 
   /**
@@ -155,6 +204,17 @@ public class TJTransformer extends TJDecompressor {
   private native int[] transform(byte[] srcBuf, int srcSize, byte[][] dstBufs,
     TJTransform[] transforms, int flags) throws TJException;
 
+  private native int[] transformDirect(ByteBuffer srcBuf, int srcSize,
+    byte[][] dstBufs, TJTransform[] transforms, int flags) throws TJException;
+
+  private native int[] transformDirect(byte[] srcBuf, int srcSize,
+    ByteBuffer[] dstBufs, TJTransform[] transforms, int flags)
+    throws TJException;
+
+  private native int[] transformDirect(ByteBuffer srcBuf, int srcSize,
+    ByteBuffer[] dstBufs, TJTransform[] transforms, int flags)
+    throws TJException;
+
   static {
     TJLoader.load();
   }
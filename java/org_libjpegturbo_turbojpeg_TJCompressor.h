@@ -55,6 +55,38 @@ JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3
 JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3IIIIIII_3BIII
   (JNIEnv *, jobject, jintArray, jint, jint, jint, jint, jint, jint, jbyteArray, jint, jint, jint);
 
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJCompressor
+ * Method:    compress
+ * Signature: (Ljava/nio/ByteBuffer;IIIIII[BIII)I
+ */
+JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress__Ljava_nio_ByteBuffer_2IIIIII_3BIII
+  (JNIEnv *, jobject, jobject, jint, jint, jint, jint, jint, jint, jbyteArray, jint, jint, jint);
+
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJCompressor
+ * Method:    compress
+ * Signature: ([BIIIIIILjava/nio/ByteBuffer;III)I
+ */
+JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3BIIIIIILjava_nio_ByteBuffer_2III
+  (JNIEnv *, jobject, jbyteArray, jint, jint, jint, jint, jint, jint, jobject, jint, jint, jint);
+
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJCompressor
+ * Method:    compress
+ * Signature: ([IIIIIIILjava/nio/ByteBuffer;III)I
+ */
+JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3IIIIIIILjava_nio_ByteBuffer_2III
+  (JNIEnv *, jobject, jintArray, jint, jint, jint, jint, jint, jint, jobject, jint, jint, jint);
+
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJCompressor
+ * Method:    compress
+ * Signature: (Ljava/nio/ByteBuffer;IIIIIILjava/nio/ByteBuffer;III)I
+ */
+JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress__Ljava_nio_ByteBuffer_2IIIIIILjava_nio_ByteBuffer_2III
+  (JNIEnv *, jobject, jobject, jint, jint, jint, jint, jint, jint, jobject, jint, jint, jint);
+
 /*
  * Class:     org_libjpegturbo_turbojpeg_TJCompressor
  * Method:    compressFromYUV
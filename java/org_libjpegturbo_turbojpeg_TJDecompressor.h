@@ -31,6 +31,14 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_destroy
 JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompressHeader
   (JNIEnv *, jobject, jbyteArray, jint);
 
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJDecompressor
+ * Method:    decompressHeaderDirect
+ * Signature: (Ljava/nio/ByteBuffer;I)V
+ */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompressHeaderDirect
+  (JNIEnv *, jobject, jobject, jint);
+
 /*
  * Class:     org_libjpegturbo_turbojpeg_TJDecompressor
  * Method:    decompress
@@ -63,6 +71,38 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress
 JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress___3BI_3IIIIIIII
   (JNIEnv *, jobject, jbyteArray, jint, jintArray, jint, jint, jint, jint, jint, jint, jint);
 
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJDecompressor
+ * Method:    decompress
+ * Signature: (Ljava/nio/ByteBuffer;I[BIIIIIII)V
+ */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress__Ljava_nio_ByteBuffer_2I_3BIIIIIII
+  (JNIEnv *, jobject, jobject, jint, jbyteArray, jint, jint, jint, jint, jint, jint, jint);
+
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJDecompressor
+ * Method:    decompress
+ * Signature: (Ljava/nio/ByteBuffer;I[IIIIIIII)V
+ */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress__Ljava_nio_ByteBuffer_2I_3IIIIIIII
+  (JNIEnv *, jobject, jobject, jint, jintArray, jint, jint, jint, jint, jint, jint, jint);
+
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJDecompressor
+ * Method:    decompress
+ * Signature: ([BILjava/nio/ByteBuffer;IIIIIII)V
+ */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress___3BILjava_nio_ByteBuffer_2IIIIIII
+  (JNIEnv *, jobject, jbyteArray, jint, jobject, jint, jint, jint, jint, jint, jint, jint);
+
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJDecompressor
+ * Method:    decompress
+ * Signature: (Ljava/nio/ByteBuffer;ILjava/nio/ByteBuffer;IIIIIII)V
+ */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress__Ljava_nio_ByteBuffer_2ILjava_nio_ByteBuffer_2IIIIIII
+  (JNIEnv *, jobject, jobject, jint, jobject, jint, jint, jint, jint, jint, jint, jint);
+
 /*
  * Class:     org_libjpegturbo_turbojpeg_TJDecompressor
  * Method:    decompressToYUV
@@ -23,6 +23,30 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_init
 JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transform
   (JNIEnv *, jobject, jbyteArray, jint, jobjectArray, jobjectArray, jint);
 
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJTransformer
+ * Method:    transformDirect
+ * Signature: (Ljava/nio/ByteBuffer;I[[B[Lorg/libjpegturbo/turbojpeg/TJTransform;I)[I
+ */
+JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transformDirect__Ljava_nio_ByteBuffer_2I_3_3B_3Lorg_libjpegturbo_turbojpeg_TJTransform_2I
+  (JNIEnv *, jobject, jobject, jint, jobjectArray, jobjectArray, jint);
+
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJTransformer
+ * Method:    transformDirect
+ * Signature: ([BI[Ljava/nio/ByteBuffer;[Lorg/libjpegturbo/turbojpeg/TJTransform;I)[I
+ */
+JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transformDirect___3BI_3Ljava_nio_ByteBuffer_2_3Lorg_libjpegturbo_turbojpeg_TJTransform_2I
+  (JNIEnv *, jobject, jbyteArray, jint, jobjectArray, jobjectArray, jint);
+
+/*
+ * Class:     org_libjpegturbo_turbojpeg_TJTransformer
+ * Method:    transformDirect
+ * Signature: (Ljava/nio/ByteBuffer;I[Ljava/nio/ByteBuffer;[Lorg/libjpegturbo/turbojpeg/TJTransform;I)[I
+ */
+JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transformDirect__Ljava_nio_ByteBuffer_2I_3Ljava_nio_ByteBuffer_2_3Lorg_libjpegturbo_turbojpeg_TJTransform_2I
+  (JNIEnv *, jobject, jobject, jint, jobjectArray, jobjectArray, jint);
+
 #ifdef __cplusplus
 }
 #endif
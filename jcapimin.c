@@ -23,6 +23,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jcmaster.h"
 
 
 /*
@@ -92,6 +93,14 @@ jpeg_CreateCompress(j_compress_ptr cinfo, int version, size_t structsize)
 
   /* OK, I'm ready */
   cinfo->global_state = CSTATE_START;
+
+  /* The master struct is used to store information that persists across
+   * images (such as cached derived tables), so we allocate it here.
+   */
+  cinfo->master = (struct jpeg_comp_master *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                sizeof(my_comp_master));
+  MEMZERO(cinfo->master, sizeof(my_comp_master));
 }
 
 
@@ -189,7 +198,9 @@ jpeg_finish_compress(j_compress_ptr cinfo)
     (*cinfo->master->finish_pass) (cinfo);
   }
   /* Write EOI, do final cleanup */
+  PROFILE_BEGIN(cinfo, JPROF_MARKERS);
   (*cinfo->marker->write_file_trailer) (cinfo);
+  PROFILE_END(cinfo);
   (*cinfo->dest->term_destination) (cinfo);
   /* We can use jpeg_abort to release memory and reset global_state */
   jpeg_abort((j_common_ptr)cinfo);
@@ -22,6 +22,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jconfigint.h"
 
 
 /* Expanded entropy encoder object for arithmetic encoding. */
@@ -118,6 +119,7 @@ typedef arith_entropy_encoder *arith_entropy_ptr;
 #endif
 
 
+INLINE
 LOCAL(void)
 emit_byte(int val, j_compress_ptr cinfo)
 /* Write next output byte; we do not support suspension in this module. */
@@ -131,6 +133,120 @@ emit_byte(int val, j_compress_ptr cinfo)
 }
 
 
+/*
+ * Write the pending 0x00 bytes (e->zc) to the destination buffer.
+ * Long runs of zero bytes are common in the flat regions of an image, so they
+ * are written in bulk rather than being passed to emit_byte() one at a time.
+ */
+
+LOCAL(void)
+emit_pending_zeroes(j_compress_ptr cinfo, arith_entropy_ptr e)
+{
+  struct jpeg_destination_mgr *dest = cinfo->dest;
+  size_t count;
+
+  while (e->zc) {
+    count = dest->free_in_buffer;
+    if ((JLONG)count > e->zc)
+      count = (size_t)e->zc;
+    MEMZERO(dest->next_output_byte, count);
+    dest->next_output_byte += count;
+    e->zc -= count;
+    if ((dest->free_in_buffer -= count) == 0)
+      if (!(*dest->empty_output_buffer) (cinfo))
+        ERREXIT(cinfo, JERR_CANT_SUSPEND);
+  }
+}
+
+
+/*
+ * Write the stacked 0xFF bytes (e->sc), each followed by a stuffed 0x00 byte,
+ * to the destination buffer.
+ */
+
+LOCAL(void)
+emit_stacked_ffs(j_compress_ptr cinfo, arith_entropy_ptr e)
+{
+  do {
+    emit_byte(0xFF, cinfo);
+    emit_byte(0x00, cinfo);
+  } while (--e->sc);
+}
+
+
+/*
+ * Data output per section D.1.6.  This is called whenever the bit shift
+ * counter indicates that another byte is ready in the C register.  Bytes that
+ * might still be affected by a carry are retained in e->buffer (the most
+ * recent byte != 0xFF), e->sc (the number of stacked 0xFF bytes that follow
+ * it), and e->zc (the number of pending 0x00 bytes that precede it), so
+ * nothing is written to the destination until the carry is resolved.
+ */
+
+LOCAL(void)
+arith_byte_out(j_compress_ptr cinfo, arith_entropy_ptr e)
+{
+  register JLONG temp;
+
+  temp = e->c >> 19;
+  if (temp > 0xFF) {
+    /* Handle overflow over all stacked 0xFF bytes */
+    if (e->buffer >= 0) {
+      emit_pending_zeroes(cinfo, e);
+      emit_byte(e->buffer + 1, cinfo);
+      if (e->buffer + 1 == 0xFF)
+        emit_byte(0x00, cinfo);
+    }
+    e->zc += e->sc;  /* carry-over converts stacked 0xFF bytes to 0x00 */
+    e->sc = 0;
+    /* Note: The 3 spacer bits in the C register guarantee
+     * that the new buffer byte can't be 0xFF here
+     * (see page 160 in the P&M JPEG book). */
+    e->buffer = temp & 0xFF;  /* new output byte, might overflow later */
+  } else if (temp == 0xFF) {
+    ++e->sc;  /* stack 0xFF byte (which might overflow later) */
+  } else {
+    /* Output all stacked 0xFF bytes, they will not overflow any more */
+    if (e->buffer == 0)
+      ++e->zc;
+    else if (e->buffer >= 0) {
+      emit_pending_zeroes(cinfo, e);
+      emit_byte(e->buffer, cinfo);
+    }
+    if (e->sc) {
+      emit_pending_zeroes(cinfo, e);
+      emit_stacked_ffs(cinfo, e);
+    }
+    e->buffer = temp & 0xFF;  /* new output byte (can still overflow) */
+  }
+  e->c &= 0x7FFFFL;
+  e->ct += 8;
+}
+
+
+/*
+ * Return the number of bit positions by which the nonzero A register must be
+ * shifted left in order to renormalize it (i.e. to make A >= 0x8000.)
+ */
+
+INLINE
+LOCAL(int)
+renorm_shift(JLONG a)
+{
+#if defined(__GNUC__)
+  return __builtin_clz((unsigned int)a) - 16;
+#else
+  int shift = 0;
+
+  while (a < 0x8000L) {
+    a <<= 1;
+    shift++;
+  }
+  return shift;
+#endif
+}
+
+
 /*
  * Finish up at the end of an arithmetic-compressed scan.
  */
@@ -154,9 +270,7 @@ finish_pass(j_compress_ptr cinfo)
   if (e->c & 0xF8000000UL) {
     /* One final overflow has to be handled */
     if (e->buffer >= 0) {
-      if (e->zc)
-        do emit_byte(0x00, cinfo);
-        while (--e->zc);
+      emit_pending_zeroes(cinfo, e);
       emit_byte(e->buffer + 1, cinfo);
       if (e->buffer + 1 == 0xFF)
         emit_byte(0x00, cinfo);
@@ -167,26 +281,17 @@ finish_pass(j_compress_ptr cinfo)
     if (e->buffer == 0)
       ++e->zc;
     else if (e->buffer >= 0) {
-      if (e->zc)
-        do emit_byte(0x00, cinfo);
-        while (--e->zc);
+      emit_pending_zeroes(cinfo, e);
       emit_byte(e->buffer, cinfo);
     }
     if (e->sc) {
-      if (e->zc)
-        do emit_byte(0x00, cinfo);
-        while (--e->zc);
-      do {
-        emit_byte(0xFF, cinfo);
-        emit_byte(0x00, cinfo);
-      } while (--e->sc);
+      emit_pending_zeroes(cinfo, e);
+      emit_stacked_ffs(cinfo, e);
     }
   }
   /* Output final bytes only if they are not 0x00 */
   if (e->c & 0x7FFF800L) {
-    if (e->zc)  /* output final pending zero bytes */
-      do emit_byte(0x00, cinfo);
-      while (--e->zc);
+    emit_pending_zeroes(cinfo, e);  /* output final pending zero bytes */
     emit_byte((e->c >> 19) & 0xFF, cinfo);
     if (((e->c >> 19) & 0xFF) == 0xFF)
       emit_byte(0x00, cinfo);
@@ -202,10 +307,12 @@ finish_pass(j_compress_ptr cinfo)
 /*
  * The core arithmetic encoding routine (common in JPEG and JBIG).
  * This needs to go as fast as possible.
- * Machine-dependent optimization facilities
- * are not utilized in this portable implementation.
- * However, this code should be fairly efficient and
- * may be a good base for further optimizations anyway.
+ * The renormalization step uses a count-leading-zeros
+ * instruction, where available, to shift the A and C
+ * registers in as few steps as possible, and the byte
+ * output procedure (which must deal with carry propagation)
+ * is kept out of line so that the remainder of the routine
+ * can be inlined into the MCU encoding loops.
  *
  * Parameter 'val' to be encoded may be 0 or 1 (binary decision).
  *
@@ -221,13 +328,14 @@ finish_pass(j_compress_ptr cinfo)
  * derived from Markus Kuhn's JBIG implementation.
  */
 
+INLINE
 LOCAL(void)
 arith_encode(j_compress_ptr cinfo, unsigned char *st, int val)
 {
   register arith_entropy_ptr e = (arith_entropy_ptr)cinfo->entropy;
   register unsigned char nl, nm;
-  register JLONG qe, temp;
-  register int sv;
+  register JLONG qe;
+  register int sv, shift;
 
   /* Fetch values from our compact representation of Table D.2:
    * Qe values and probability estimation state machine
@@ -264,55 +372,20 @@ arith_encode(j_compress_ptr cinfo, unsigned char *st, int val)
     *st = (sv & 0x80) ^ nm;     /* Estimate_after_MPS */
   }
 
-  /* Renormalization & data output per section D.1.6 */
+  /* Renormalization & data output per section D.1.6.
+   * Rather than shifting A and C one bit at a time, we shift them in one step
+   * by the full renormalization distance, or up to the point at which the
+   * next output byte is ready, whichever comes first.
+   */
   do {
-    e->a <<= 1;
-    e->c <<= 1;
-    if (--e->ct == 0) {
+    shift = renorm_shift(e->a);
+    if (shift > e->ct)
+      shift = e->ct;
+    e->a <<= shift;
+    e->c <<= shift;
+    if ((e->ct -= shift) == 0)
       /* Another byte is ready for output */
-      temp = e->c >> 19;
-      if (temp > 0xFF) {
-        /* Handle overflow over all stacked 0xFF bytes */
-        if (e->buffer >= 0) {
-          if (e->zc)
-            do emit_byte(0x00, cinfo);
-            while (--e->zc);
-          emit_byte(e->buffer + 1, cinfo);
-          if (e->buffer + 1 == 0xFF)
-            emit_byte(0x00, cinfo);
-        }
-        e->zc += e->sc;  /* carry-over converts stacked 0xFF bytes to 0x00 */
-        e->sc = 0;
-        /* Note: The 3 spacer bits in the C register guarantee
-         * that the new buffer byte can't be 0xFF here
-         * (see page 160 in the P&M JPEG book). */
-        e->buffer = temp & 0xFF;  /* new output byte, might overflow later */
-      } else if (temp == 0xFF) {
-        ++e->sc;  /* stack 0xFF byte (which might overflow later) */
-      } else {
-        /* Output all stacked 0xFF bytes, they will not overflow any more */
-        if (e->buffer == 0)
-          ++e->zc;
-        else if (e->buffer >= 0) {
-          if (e->zc)
-            do emit_byte(0x00, cinfo);
-            while (--e->zc);
-          emit_byte(e->buffer, cinfo);
-        }
-        if (e->sc) {
-          if (e->zc)
-            do emit_byte(0x00, cinfo);
-            while (--e->zc);
-          do {
-            emit_byte(0xFF, cinfo);
-            emit_byte(0x00, cinfo);
-          } while (--e->sc);
-        }
-        e->buffer = temp & 0xFF;  /* new output byte (can still overflow) */
-      }
-      e->c &= 0x7FFFFL;
-      e->ct += 8;
-    }
+      arith_byte_out(cinfo, e);
   } while (e->a < 0x8000L);
 }
 
@@ -63,6 +63,7 @@ METHODDEF(boolean) compress_data(j_compress_ptr cinfo, JSAMPIMAGE input_buf);
 METHODDEF(boolean) compress_first_pass(j_compress_ptr cinfo,
                                        JSAMPIMAGE input_buf);
 METHODDEF(boolean) compress_output(j_compress_ptr cinfo, JSAMPIMAGE input_buf);
+METHODDEF(boolean) compress_replay(j_compress_ptr cinfo, JSAMPIMAGE input_buf);
 #endif
 
 
@@ -115,9 +116,12 @@ start_pass_coef(j_compress_ptr cinfo, J_BUF_MODE pass_mode)
     coef->pub.compress_data = compress_first_pass;
     break;
   case JBUF_CRANK_DEST:
-    if (coef->whole_image[0] == NULL)
+    if (coef->whole_image[0] != NULL)
+      coef->pub.compress_data = compress_output;
+    else if (cinfo->master->single_pass_optimize)
+      coef->pub.compress_data = compress_replay;
+    else
       ERREXIT(cinfo, JERR_BAD_BUFFER_MODE);
-    coef->pub.compress_data = compress_output;
     break;
 #endif
   default:
@@ -162,6 +166,7 @@ compress_data(j_compress_ptr cinfo, JSAMPIMAGE input_buf)
        * data, viz: all zeroes in the AC entries, DC entries equal to previous
        * block's DC value.  (Thanks to Thomas Kinsman for this idea.)
        */
+      PROFILE_BEGIN(cinfo, JPROF_DCT);
       blkn = 0;
       for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
         compptr = cinfo->cur_comp_info[ci];
@@ -198,15 +203,19 @@ compress_data(j_compress_ptr cinfo, JSAMPIMAGE input_buf)
           ypos += DCTSIZE;
         }
       }
+      PROFILE_END(cinfo);
       /* Try to write the MCU.  In event of a suspension failure, we will
        * re-DCT the MCU on restart (a bit inefficient, could be fixed...)
        */
+      PROFILE_BEGIN(cinfo, JPROF_ENTROPY);
       if (!(*cinfo->entropy->encode_mcu) (cinfo, coef->MCU_buffer)) {
+        PROFILE_END(cinfo);
         /* Suspension forced; update state counters and exit */
         coef->MCU_vert_offset = yoffset;
         coef->mcu_ctr = MCU_col_num;
         return FALSE;
       }
+      PROFILE_END(cinfo);
     }
     /* Completed an MCU row, but perhaps not an iMCU row */
     coef->mcu_ctr = 0;
@@ -279,10 +288,12 @@ compress_first_pass(j_compress_ptr cinfo, JSAMPIMAGE input_buf)
      */
     for (block_row = 0; block_row < block_rows; block_row++) {
       thisblockrow = buffer[block_row];
+      PROFILE_BEGIN(cinfo, JPROF_DCT);
       (*cinfo->fdct->forward_DCT) (cinfo, compptr,
                                    input_buf[ci], thisblockrow,
                                    (JDIMENSION)(block_row * DCTSIZE),
                                    (JDIMENSION)0, blocks_across);
+      PROFILE_END(cinfo);
       if (ndummy > 0) {
         /* Create dummy blocks at the right edge of the image. */
         thisblockrow += blocks_across; /* => first dummy block */
@@ -378,12 +389,55 @@ compress_output(j_compress_ptr cinfo, JSAMPIMAGE input_buf)
         }
       }
       /* Try to write the MCU. */
+      PROFILE_BEGIN(cinfo, JPROF_ENTROPY);
       if (!(*cinfo->entropy->encode_mcu) (cinfo, coef->MCU_buffer)) {
+        PROFILE_END(cinfo);
+        /* Suspension forced; update state counters and exit */
+        coef->MCU_vert_offset = yoffset;
+        coef->mcu_ctr = MCU_col_num;
+        return FALSE;
+      }
+      PROFILE_END(cinfo);
+    }
+    /* Completed an MCU row, but perhaps not an iMCU row */
+    coef->mcu_ctr = 0;
+  }
+  /* Completed the iMCU row, advance counters for next one */
+  coef->iMCU_row_num++;
+  start_iMCU_row(cinfo);
+  return TRUE;
+}
+
+
+/*
+ * Process some data in the output pass of a single-pass Huffman optimization.
+ * The entropy encoder recorded the Huffman symbols for the whole image during
+ * the main pass, so there are no coefficients to supply; we just drive it
+ * through the MCUs of one iMCU row, passing a NULL MCU_data pointer.
+ */
+
+METHODDEF(boolean)
+compress_replay(j_compress_ptr cinfo, JSAMPIMAGE input_buf)
+{
+  my_coef_ptr coef = (my_coef_ptr)cinfo->coef;
+  JDIMENSION MCU_col_num;       /* index of current MCU within row */
+  int yoffset;
+
+  /* Loop to write as much as one whole iMCU row */
+  for (yoffset = coef->MCU_vert_offset; yoffset < coef->MCU_rows_per_iMCU_row;
+       yoffset++) {
+    for (MCU_col_num = coef->mcu_ctr; MCU_col_num < cinfo->MCUs_per_row;
+         MCU_col_num++) {
+      /* Try to write the MCU. */
+      PROFILE_BEGIN(cinfo, JPROF_ENTROPY);
+      if (!(*cinfo->entropy->encode_mcu) (cinfo, (JBLOCKROW *)NULL)) {
+        PROFILE_END(cinfo);
         /* Suspension forced; update state counters and exit */
         coef->MCU_vert_offset = yoffset;
         coef->mcu_ctr = MCU_col_num;
         return FALSE;
       }
+      PROFILE_END(cinfo);
     }
     /* Completed an MCU row, but perhaps not an iMCU row */
     coef->mcu_ctr = 0;
@@ -68,6 +68,12 @@ typedef struct {
   FAST_FLOAT *float_divisors[NUM_QUANT_TBLS];
   FAST_FLOAT *float_workspace;
 #endif
+
+  /* Unquantized DCT output that is being saved for, or reused from, another
+   * compression of the same image (see jpeg_dct_cache_tj())
+   */
+  JOCTET *dct_cache_ptr;        /* => next block of DCT output */
+  JOCTET *dct_cache_end;        /* end of DCT output buffer */
 } my_fdct_controller;
 
 typedef my_fdct_controller *my_fdct_ptr;
@@ -223,6 +229,50 @@ compute_reciprocal(UINT16 divisor, DCTELEM *dtbl)
 #endif
 
 
+/*
+ * Cache of divisor tables (see jtbl_cache_lookup() in jutils.c.)  The key is
+ * the DCT method and the quantization table contents.  The cache has enough
+ * entries to hold the luminance and chrominance tables for four different
+ * quality settings at once.
+ */
+
+#define DIVISOR_CACHE_SIZE  (2 * NUM_QUANT_TBLS)
+
+typedef struct {
+  J_DCT_METHOD dct_method;      /* DCT method the divisors were made for */
+  UINT16 quantval[DCTSIZE2];    /* quantization table contents */
+} divisor_cache_key;
+
+typedef struct {
+  jtbl_cache_entry hdr;         /* must be first */
+  divisor_cache_key key;
+  boolean simd_ok;              /* FALSE if SIMD quantization can't be used */
+  DCTELEM *divisors;            /* divisors for JDCT_ISLOW or JDCT_IFAST */
+#ifdef DCT_FLOAT_SUPPORTED
+  FAST_FLOAT *float_divisors;   /* divisors for JDCT_FLOAT */
+#endif
+} divisor_cache_entry;
+
+LOCAL(divisor_cache_entry *)
+divisor_cache_lookup(j_compress_ptr cinfo, JQUANT_TBL *qtbl)
+{
+  divisor_cache_key key;
+  divisor_cache_entry *entry;
+
+  MEMZERO(&key, sizeof(key));   /* zero any padding, since it is compared */
+  key.dct_method = cinfo->dct_method;
+  MEMCOPY(key.quantval, qtbl->quantval, sizeof(key.quantval));
+
+  entry = (divisor_cache_entry *)
+    jtbl_cache_lookup((j_common_ptr)cinfo, &cinfo->master->divisor_cache,
+                      DIVISOR_CACHE_SIZE, sizeof(divisor_cache_entry),
+                      offsetof(divisor_cache_entry, key), &key, sizeof(key));
+  if (!entry->hdr.valid)
+    entry->simd_ok = TRUE;
+  return entry;
+}
+
+
 /*
  * Initialize for a processing pass.
  * Verify that all referenced Q-tables are present, and set up
@@ -240,6 +290,7 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
   jpeg_component_info *compptr;
   JQUANT_TBL *qtbl;
   DCTELEM *dtbl;
+  divisor_cache_entry *entry;
 
   for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
        ci++, compptr++) {
@@ -249,25 +300,34 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
         cinfo->quant_tbl_ptrs[qtblno] == NULL)
       ERREXIT1(cinfo, JERR_NO_QUANT_TABLE, qtblno);
     qtbl = cinfo->quant_tbl_ptrs[qtblno];
+    /* Reuse previously computed divisors for this quant table if possible */
+    entry = divisor_cache_lookup(cinfo, qtbl);
+    if (entry->hdr.valid) {
+#ifdef DCT_FLOAT_SUPPORTED
+      fdct->float_divisors[qtblno] = entry->float_divisors;
+#endif
+      fdct->divisors[qtblno] = entry->divisors;
+      if (!entry->simd_ok && fdct->quantize == jsimd_quantize)
+        fdct->quantize = quantize;
+      continue;
+    }
     /* Compute divisors for this quant table */
-    /* We may do this more than once for same table, but it's not a big deal */
     switch (cinfo->dct_method) {
 #ifdef DCT_ISLOW_SUPPORTED
     case JDCT_ISLOW:
       /* For LL&M IDCT method, divisors are equal to raw quantization
        * coefficients multiplied by 8 (to counteract scaling).
        */
-      if (fdct->divisors[qtblno] == NULL) {
-        fdct->divisors[qtblno] = (DCTELEM *)
-          (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+      if (entry->divisors == NULL) {
+        entry->divisors = (DCTELEM *)
+          (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                       (DCTSIZE2 * 4) * sizeof(DCTELEM));
       }
-      dtbl = fdct->divisors[qtblno];
+      dtbl = fdct->divisors[qtblno] = entry->divisors;
       for (i = 0; i < DCTSIZE2; i++) {
 #if BITS_IN_JSAMPLE == 8
-        if (!compute_reciprocal(qtbl->quantval[i] << 3, &dtbl[i]) &&
-            fdct->quantize == jsimd_quantize)
-          fdct->quantize = quantize;
+        if (!compute_reciprocal(qtbl->quantval[i] << 3, &dtbl[i]))
+          entry->simd_ok = FALSE;
 #else
         dtbl[i] = ((DCTELEM)qtbl->quantval[i]) << 3;
 #endif
@@ -297,20 +357,19 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
         };
         SHIFT_TEMPS
 
-        if (fdct->divisors[qtblno] == NULL) {
-          fdct->divisors[qtblno] = (DCTELEM *)
-            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+        if (entry->divisors == NULL) {
+          entry->divisors = (DCTELEM *)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                         (DCTSIZE2 * 4) * sizeof(DCTELEM));
         }
-        dtbl = fdct->divisors[qtblno];
+        dtbl = fdct->divisors[qtblno] = entry->divisors;
         for (i = 0; i < DCTSIZE2; i++) {
 #if BITS_IN_JSAMPLE == 8
           if (!compute_reciprocal(
                 DESCALE(MULTIPLY16V16((JLONG)qtbl->quantval[i],
                                       (JLONG)aanscales[i]),
-                        CONST_BITS - 3), &dtbl[i]) &&
-              fdct->quantize == jsimd_quantize)
-            fdct->quantize = quantize;
+                        CONST_BITS - 3), &dtbl[i]))
+            entry->simd_ok = FALSE;
 #else
           dtbl[i] = (DCTELEM)
             DESCALE(MULTIPLY16V16((JLONG)qtbl->quantval[i],
@@ -339,12 +398,12 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
           1.0, 0.785694958, 0.541196100, 0.275899379
         };
 
-        if (fdct->float_divisors[qtblno] == NULL) {
-          fdct->float_divisors[qtblno] = (FAST_FLOAT *)
-            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+        if (entry->float_divisors == NULL) {
+          entry->float_divisors = (FAST_FLOAT *)
+            (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                         DCTSIZE2 * sizeof(FAST_FLOAT));
         }
-        fdtbl = fdct->float_divisors[qtblno];
+        fdtbl = fdct->float_divisors[qtblno] = entry->float_divisors;
         i = 0;
         for (row = 0; row < DCTSIZE; row++) {
           for (col = 0; col < DCTSIZE; col++) {
@@ -361,6 +420,9 @@ start_pass_fdctmgr(j_compress_ptr cinfo)
       ERREXIT(cinfo, JERR_NOT_COMPILED);
       break;
     }
+    if (!entry->simd_ok && fdct->quantize == jsimd_quantize)
+      fdct->quantize = quantize;
+    entry->hdr.valid = TRUE;
   }
 }
 
@@ -613,6 +675,193 @@ forward_DCT_float(j_compress_ptr cinfo, jpeg_component_info *compptr,
 #endif /* DCT_FLOAT_SUPPORTED */
 
 
+/*
+ * Multi-quality compression.
+ *
+ * The output of the forward DCT depends only on the image samples, not on the
+ * quantization tables.  Thus, when the same image is compressed at several
+ * quality levels, the DCT need only be performed once.  The first compression
+ * saves the unquantized DCT output, in the order in which the blocks are
+ * processed, and subsequent compressions with identical parameters (other
+ * than the quantization tables) read it back in the same order.  When the DCT
+ * output is reused, the sample data are ignored, so the caller need not
+ * perform color conversion or downsampling.  It can instead pass dummy data
+ * to jpeg_write_raw_data().
+ */
+
+#define CHECK_DCT_CACHE(blocksize) { \
+  if ((size_t)(fdct->dct_cache_end - fdct->dct_cache_ptr) < \
+      num_blocks * (blocksize)) \
+    ERREXIT(cinfo, JERR_BUFFER_SIZE); \
+}
+
+METHODDEF(void)
+forward_DCT_save(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                 JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+                 JDIMENSION start_row, JDIMENSION start_col,
+                 JDIMENSION num_blocks)
+/* This version saves the output of an integer DCT implementation. */
+{
+  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  DCTELEM *divisors = fdct->divisors[compptr->quant_tbl_no];
+  DCTELEM *workspace = fdct->workspace;
+  JDIMENSION bi;
+
+  CHECK_DCT_CACHE(DCTSIZE2 * sizeof(DCTELEM))
+
+  sample_data += start_row;     /* fold in the vertical offset once */
+
+  for (bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE) {
+    (*fdct->convsamp) (sample_data, start_col, workspace);
+    (*fdct->dct) (workspace);
+    MEMCOPY(fdct->dct_cache_ptr, workspace, DCTSIZE2 * sizeof(DCTELEM));
+    fdct->dct_cache_ptr += DCTSIZE2 * sizeof(DCTELEM);
+    (*fdct->quantize) (coef_blocks[bi], divisors, workspace);
+  }
+}
+
+
+METHODDEF(void)
+forward_DCT_reuse(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                  JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+                  JDIMENSION start_row, JDIMENSION start_col,
+                  JDIMENSION num_blocks)
+/* This version quantizes the saved output of an integer DCT implementation. */
+{
+  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  DCTELEM *divisors = fdct->divisors[compptr->quant_tbl_no];
+  DCTELEM *workspace = fdct->workspace;
+  JDIMENSION bi;
+
+  CHECK_DCT_CACHE(DCTSIZE2 * sizeof(DCTELEM))
+
+  /* The quantization routine may require an aligned workspace, so we copy
+   * each block into it rather than quantizing in place.
+   */
+  for (bi = 0; bi < num_blocks; bi++) {
+    MEMCOPY(workspace, fdct->dct_cache_ptr, DCTSIZE2 * sizeof(DCTELEM));
+    fdct->dct_cache_ptr += DCTSIZE2 * sizeof(DCTELEM);
+    (*fdct->quantize) (coef_blocks[bi], divisors, workspace);
+  }
+}
+
+
+#ifdef DCT_FLOAT_SUPPORTED
+
+METHODDEF(void)
+forward_DCT_float_save(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                       JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+                       JDIMENSION start_row, JDIMENSION start_col,
+                       JDIMENSION num_blocks)
+/* This version saves the output of a floating-point DCT implementation. */
+{
+  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  FAST_FLOAT *divisors = fdct->float_divisors[compptr->quant_tbl_no];
+  FAST_FLOAT *workspace = fdct->float_workspace;
+  JDIMENSION bi;
+
+  CHECK_DCT_CACHE(DCTSIZE2 * sizeof(FAST_FLOAT))
+
+  sample_data += start_row;     /* fold in the vertical offset once */
+
+  for (bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE) {
+    (*fdct->float_convsamp) (sample_data, start_col, workspace);
+    (*fdct->float_dct) (workspace);
+    MEMCOPY(fdct->dct_cache_ptr, workspace, DCTSIZE2 * sizeof(FAST_FLOAT));
+    fdct->dct_cache_ptr += DCTSIZE2 * sizeof(FAST_FLOAT);
+    (*fdct->float_quantize) (coef_blocks[bi], divisors, workspace);
+  }
+}
+
+
+METHODDEF(void)
+forward_DCT_float_reuse(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                        JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+                        JDIMENSION start_row, JDIMENSION start_col,
+                        JDIMENSION num_blocks)
+/* This version quantizes the saved output of a floating-point DCT
+ * implementation.
+ */
+{
+  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+  FAST_FLOAT *divisors = fdct->float_divisors[compptr->quant_tbl_no];
+  FAST_FLOAT *workspace = fdct->float_workspace;
+  JDIMENSION bi;
+
+  CHECK_DCT_CACHE(DCTSIZE2 * sizeof(FAST_FLOAT))
+
+  for (bi = 0; bi < num_blocks; bi++) {
+    MEMCOPY(workspace, fdct->dct_cache_ptr, DCTSIZE2 * sizeof(FAST_FLOAT));
+    fdct->dct_cache_ptr += DCTSIZE2 * sizeof(FAST_FLOAT);
+    (*fdct->float_quantize) (coef_blocks[bi], divisors, workspace);
+  }
+}
+
+#endif /* DCT_FLOAT_SUPPORTED */
+
+
+/*
+ * Return the size of the buffer needed to save the DCT output for the
+ * current image.  This must be called after jpeg_start_compress().
+ */
+
+GLOBAL(size_t)
+jpeg_dct_cache_size_tj(j_compress_ptr cinfo)
+{
+  size_t blocks = 0, blocksize = DCTSIZE2 * sizeof(DCTELEM);
+  int ci;
+  jpeg_component_info *compptr;
+
+  if (cinfo->global_state != CSTATE_SCANNING &&
+      cinfo->global_state != CSTATE_RAW_OK)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+
+#ifdef DCT_FLOAT_SUPPORTED
+  if (cinfo->dct_method == JDCT_FLOAT)
+    blocksize = DCTSIZE2 * sizeof(FAST_FLOAT);
+#endif
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    blocks += (size_t)compptr->width_in_blocks * compptr->height_in_blocks;
+    if (blocks > ((size_t)-1) / blocksize)
+      ERREXIT(cinfo, JERR_WIDTH_OVERFLOW);
+  }
+  return blocks * blocksize;
+}
+
+
+/*
+ * Save the DCT output for the current image in the given buffer, or reuse
+ * the DCT output that was saved there by an earlier compression.  This must
+ * be called after jpeg_start_compress() and before any image data are
+ * written.
+ */
+
+GLOBAL(void)
+jpeg_dct_cache_tj(j_compress_ptr cinfo, void *buffer, size_t size,
+                  boolean reuse)
+{
+  my_fdct_ptr fdct = (my_fdct_ptr)cinfo->fdct;
+
+  if ((cinfo->global_state != CSTATE_SCANNING &&
+       cinfo->global_state != CSTATE_RAW_OK) || cinfo->next_scanline != 0)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+  if (size < jpeg_dct_cache_size_tj(cinfo))
+    ERREXIT(cinfo, JERR_BUFFER_SIZE);
+
+  fdct->dct_cache_ptr = (JOCTET *)buffer;
+  fdct->dct_cache_end = fdct->dct_cache_ptr + size;
+#ifdef DCT_FLOAT_SUPPORTED
+  if (cinfo->dct_method == JDCT_FLOAT) {
+    fdct->pub.forward_DCT = reuse ? forward_DCT_float_reuse :
+                                    forward_DCT_float_save;
+    return;
+  }
+#endif
+  fdct->pub.forward_DCT = reuse ? forward_DCT_reuse : forward_DCT_save;
+}
+
+
 /*
  * Initialize FDCT manager.
  */
@@ -91,6 +91,38 @@ typedef struct {
 #endif
 
 
+#ifdef ENTROPY_OPT_SUPPORTED
+
+/* When a single scan is optimized without a full-image coefficient buffer
+ * (see single_pass_optimize in jpegint.h), the Huffman symbols and extra bits
+ * for the whole scan are recorded in a list of chunks, each of which is
+ * followed by its token data.  (The token format is described below, with
+ * encode_mcu_record().)
+ */
+
+typedef struct huff_token_chunk {
+  struct huff_token_chunk *next; /* next chunk in list, or NULL */
+  JOCTET *end;                  /* end of recorded tokens in this chunk */
+  JOCTET *limit;                /* end of space in this chunk */
+} huff_token_chunk;
+
+#define TOKEN_BLOCK_END  0x10
+#define TOKEN_BITS_BYTES(nbits)  (((nbits) + 7) >> 3)
+
+/* Worst-case token space for one block: a DC token and 63 AC tokens of 3
+ * bytes each, an end token, and two bytes of slack for the unused extra-bits
+ * byte that is always stored and the padding added by end_token_chunk().
+ */
+#define MAX_TOKENS_PER_BLOCK  (DCTSIZE2 * 4)
+
+#define MIN_TOKEN_CHUNK  65536
+#define MAX_TOKEN_CHUNK  (MIN_TOKEN_CHUNK * 64)
+
+#define TOKEN_DATA(chunk)  ((JOCTET *)((chunk) + 1))
+
+#endif
+
+
 typedef struct {
   struct jpeg_entropy_encoder pub; /* public fields */
 
@@ -107,6 +139,12 @@ typedef struct {
 #ifdef ENTROPY_OPT_SUPPORTED    /* Statistics tables for optimization */
   long *dc_count_ptrs[NUM_HUFF_TBLS];
   long *ac_count_ptrs[NUM_HUFF_TBLS];
+
+  /* Recorded tokens for single-pass optimization */
+  huff_token_chunk *first_chunk; /* first chunk of recorded tokens */
+  huff_token_chunk *cur_chunk;  /* chunk being recorded or replayed */
+  JOCTET *next_token;           /* => next token to record or replay */
+  size_t next_chunk_size;       /* size of next chunk to allocate */
 #endif
 
   int simd;
@@ -133,6 +171,11 @@ METHODDEF(void) finish_pass_huff(j_compress_ptr cinfo);
 METHODDEF(boolean) encode_mcu_gather(j_compress_ptr cinfo,
                                      JBLOCKROW *MCU_data);
 METHODDEF(void) finish_pass_gather(j_compress_ptr cinfo);
+METHODDEF(boolean) encode_mcu_record(j_compress_ptr cinfo,
+                                     JBLOCKROW *MCU_data);
+METHODDEF(void) finish_pass_record(j_compress_ptr cinfo);
+METHODDEF(boolean) encode_mcu_replay(j_compress_ptr cinfo,
+                                     JBLOCKROW *MCU_data);
 #endif
 
 
@@ -151,13 +194,29 @@ start_pass_huff(j_compress_ptr cinfo, boolean gather_statistics)
 
   if (gather_statistics) {
 #ifdef ENTROPY_OPT_SUPPORTED
-    entropy->pub.encode_mcu = encode_mcu_gather;
-    entropy->pub.finish_pass = finish_pass_gather;
+    if (cinfo->master->single_pass_optimize) {
+      entropy->pub.encode_mcu = encode_mcu_record;
+      entropy->pub.finish_pass = finish_pass_record;
+      entropy->first_chunk = entropy->cur_chunk = NULL;
+      entropy->next_token = NULL;
+      entropy->next_chunk_size = MIN_TOKEN_CHUNK;
+    } else {
+      entropy->pub.encode_mcu = encode_mcu_gather;
+      entropy->pub.finish_pass = finish_pass_gather;
+    }
 #else
     ERREXIT(cinfo, JERR_NOT_COMPILED);
 #endif
   } else {
-    entropy->pub.encode_mcu = encode_mcu_huff;
+#ifdef ENTROPY_OPT_SUPPORTED
+    if (cinfo->master->single_pass_optimize) {
+      /* Replay the tokens recorded during the main pass */
+      entropy->pub.encode_mcu = encode_mcu_replay;
+      entropy->cur_chunk = entropy->first_chunk;
+      entropy->next_token = TOKEN_DATA(entropy->first_chunk);
+    } else
+#endif
+      entropy->pub.encode_mcu = encode_mcu_huff;
     entropy->pub.finish_pass = finish_pass_huff;
   }
 
@@ -190,7 +249,7 @@ start_pass_huff(j_compress_ptr cinfo, boolean gather_statistics)
 #endif
     } else {
       /* Compute derived values for Huffman tables */
-      /* We may do this more than once for a table, but it's not expensive */
+      /* We may do this more than once for a table, but it's cached */
       jpeg_make_c_derived_tbl(cinfo, TRUE, dctbl,
                               &entropy->dc_derived_tbls[dctbl]);
       jpeg_make_c_derived_tbl(cinfo, FALSE, actbl,
@@ -210,6 +269,41 @@ start_pass_huff(j_compress_ptr cinfo, boolean gather_statistics)
 }
 
 
+/*
+ * Cache of derived Huffman tables (see jtbl_cache_lookup() in jutils.c.)  The
+ * key is the table definition (the contiguous bits[] and used part of
+ * huffval[] arrays of a private copy of it.)  DC and AC tables are cached
+ * separately, since they are validated differently, and each cache has room
+ * for all of the tables of its class that a single scan can use.
+ */
+
+typedef struct {
+  jtbl_cache_entry hdr;         /* must be first */
+  JHUFF_TBL htbl;               /* key: private copy of the table definition */
+  c_derived_tbl dtbl;           /* derived table */
+} huff_tbl_cache_entry;
+
+LOCAL(huff_tbl_cache_entry *)
+huff_tbl_cache_lookup(j_compress_ptr cinfo, boolean isDC, JHUFF_TBL *htbl)
+{
+  int l, numsymbols;
+
+  numsymbols = 0;
+  for (l = 1; l <= 16; l++)
+    numsymbols += htbl->bits[l];
+  if (numsymbols > 256)         /* invalid table; let the caller reject it */
+    numsymbols = 256;
+
+  return (huff_tbl_cache_entry *)
+    jtbl_cache_lookup((j_common_ptr)cinfo,
+                      isDC ? &cinfo->master->dc_huff_tbl_cache :
+                             &cinfo->master->ac_huff_tbl_cache,
+                      NUM_HUFF_TBLS, sizeof(huff_tbl_cache_entry),
+                      offsetof(huff_tbl_cache_entry, htbl), htbl,
+                      offsetof(JHUFF_TBL, huffval) + numsymbols);
+}
+
+
 /*
  * Compute the derived values for a Huffman table.
  * This routine also performs some validation checks on the table.
@@ -223,6 +317,7 @@ jpeg_make_c_derived_tbl(j_compress_ptr cinfo, boolean isDC, int tblno,
 {
   JHUFF_TBL *htbl;
   c_derived_tbl *dtbl;
+  huff_tbl_cache_entry *entry;
   int p, i, l, lastp, si, maxsymbol;
   char huffsize[257];
   unsigned int huffcode[257];
@@ -240,12 +335,14 @@ jpeg_make_c_derived_tbl(j_compress_ptr cinfo, boolean isDC, int tblno,
   if (htbl == NULL)
     ERREXIT1(cinfo, JERR_NO_HUFF_TABLE, tblno);
 
-  /* Allocate a workspace if we haven't already done so. */
-  if (*pdtbl == NULL)
-    *pdtbl = (c_derived_tbl *)
-      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-                                  sizeof(c_derived_tbl));
-  dtbl = *pdtbl;
+  /* Reuse a previously derived table if possible.  Otherwise, derive the
+   * table from the cache entry's private copy of the definition.
+   */
+  entry = huff_tbl_cache_lookup(cinfo, isDC, htbl);
+  *pdtbl = dtbl = &entry->dtbl;
+  if (entry->hdr.valid)
+    return;
+  htbl = &entry->htbl;
 
   /* Figure C.1: make table of Huffman code length for each symbol */
 
@@ -303,6 +400,8 @@ jpeg_make_c_derived_tbl(j_compress_ptr cinfo, boolean isDC, int tblno,
     dtbl->ehufco[i] = huffcode[p];
     dtbl->ehufsi[i] = huffsize[p];
   }
+
+  entry->hdr.valid = TRUE;
 }
 
 
@@ -858,6 +957,348 @@ encode_mcu_gather(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
 }
 
 
+/*
+ * Single-pass optimization.
+ *
+ * Buffering the quantized coefficients for the whole image, so that they can
+ * be scanned once to gather statistics and again to encode them, requires
+ * 128 bytes per block.  When there is only one scan, we instead record the
+ * Huffman symbols and extra bits while gathering the statistics, and then we
+ * replay them once the optimal tables are known.  That takes much less
+ * memory, and the output pass no longer needs to examine every coefficient.
+ *
+ * Each token is a symbol byte followed by (nbits + 7) / 8 bytes of extra bits,
+ * least significant byte first, where nbits is the symbol for a DC token or
+ * the low 4 bits of the symbol for an AC token.  The end of a block is marked
+ * by an EOB symbol or, if the last coefficient is nonzero, by
+ * TOKEN_BLOCK_END, which is not a valid AC symbol (its size is zero but its
+ * run length is not 0 or 15.)  Tokens are recorded an MCU at a time, so the
+ * tokens for an MCU never straddle two chunks.
+ */
+
+
+LOCAL(void)
+end_token_chunk(huff_entropy_ptr entropy)
+{
+  entropy->cur_chunk->end = entropy->next_token;
+  /* Zero-pad, so that the extra bits of the last token can always be read as
+   * two bytes.
+   */
+  entropy->next_token[0] = entropy->next_token[1] = 0;
+}
+
+
+LOCAL(void)
+start_token_chunk(j_compress_ptr cinfo, huff_entropy_ptr entropy)
+{
+  huff_token_chunk *chunk;
+  size_t size = entropy->next_chunk_size;
+
+  chunk = (huff_token_chunk *)
+    (*cinfo->mem->alloc_large) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                sizeof(huff_token_chunk) + size);
+  chunk->next = NULL;
+  chunk->end = chunk->limit = TOKEN_DATA(chunk) + size;
+
+  if (entropy->cur_chunk == NULL)
+    entropy->first_chunk = chunk;
+  else {
+    end_token_chunk(entropy);
+    entropy->cur_chunk->next = chunk;
+  }
+  entropy->cur_chunk = chunk;
+  entropy->next_token = TOKEN_DATA(chunk);
+
+  /* Use larger chunks for larger images */
+  if (size < MAX_TOKEN_CHUNK)
+    entropy->next_chunk_size = size * 2;
+}
+
+
+/* Record the tokens for a single block's worth of coefficients, and count the
+ * Huffman symbols as htest_one_block() does.  Returns the new token pointer.
+ */
+
+LOCAL(JOCTET *)
+record_one_block(j_compress_ptr cinfo, JOCTET *tok, JCOEFPTR block,
+                 int last_dc_val, long dc_counts[], long ac_counts[])
+{
+  int temp, temp2, temp3;
+  int nbits;
+  int r;
+
+  /* Encode the DC coefficient difference per section F.1.2.1 */
+
+  temp = temp2 = block[0] - last_dc_val;
+
+  /* Branch-less absolute value, bitwise complement, etc., as in
+   * encode_one_block()
+   */
+  temp3 = temp >> (CHAR_BIT * sizeof(int) - 1);
+  temp ^= temp3;
+  temp -= temp3;
+  temp2 += temp3;
+
+  /* Find the number of bits needed for the magnitude of the coefficient */
+  nbits = JPEG_NBITS(temp);
+  /* Check for out-of-range coefficient values.
+   * Since we're encoding a difference, the range limit is twice as much.
+   */
+  if (nbits > MAX_COEF_BITS + 1)
+    ERREXIT(cinfo, JERR_BAD_DCT_COEF);
+
+  /* Count and record the Huffman symbol for the number of bits, followed by
+   * the extra bits.  Both bytes of extra bits are always stored, since that
+   * is cheaper than testing how many are needed.
+   */
+  dc_counts[nbits]++;
+  tok[0] = (JOCTET)nbits;
+  tok[1] = (JOCTET)temp2;
+  tok[2] = (JOCTET)(temp2 >> 8);
+  tok += 1 + TOKEN_BITS_BYTES(nbits);
+
+  /* Encode the AC coefficients per section F.1.2.2 */
+
+  r = 0;                        /* r = run length of zeros */
+
+#define record_kloop(jpeg_natural_order_of_k) { \
+  if ((temp = block[jpeg_natural_order_of_k]) == 0) { \
+    r++; \
+  } else { \
+    temp2 = temp; \
+    temp3 = temp >> (CHAR_BIT * sizeof(int) - 1); \
+    temp ^= temp3; \
+    temp -= temp3; \
+    temp2 += temp3; \
+    nbits = JPEG_NBITS_NONZERO(temp); \
+    /* Check for out-of-range coefficient values */ \
+    if (nbits > MAX_COEF_BITS) \
+      ERREXIT(cinfo, JERR_BAD_DCT_COEF); \
+    /* if run length > 15, must emit special run-length-16 codes (0xF0) */ \
+    while (r > 15) { \
+      ac_counts[0xF0]++; \
+      *tok++ = 0xF0; \
+      r -= 16; \
+    } \
+    /* Count and record Huffman symbol for run length / number of bits */ \
+    temp3 = (r << 4) + nbits; \
+    ac_counts[temp3]++; \
+    tok[0] = (JOCTET)temp3; \
+    tok[1] = (JOCTET)temp2; \
+    tok[2] = (JOCTET)(temp2 >> 8); \
+    tok += 1 + TOKEN_BITS_BYTES(nbits); \
+    r = 0; \
+  } \
+}
+
+  /* One iteration for each value in jpeg_natural_order[], unrolled as in
+   * encode_one_block()
+   */
+  record_kloop(1);   record_kloop(8);   record_kloop(16);  record_kloop(9);
+  record_kloop(2);   record_kloop(3);   record_kloop(10);  record_kloop(17);
+  record_kloop(24);  record_kloop(32);  record_kloop(25);  record_kloop(18);
+  record_kloop(11);  record_kloop(4);   record_kloop(5);   record_kloop(12);
+  record_kloop(19);  record_kloop(26);  record_kloop(33);  record_kloop(40);
+  record_kloop(48);  record_kloop(41);  record_kloop(34);  record_kloop(27);
+  record_kloop(20);  record_kloop(13);  record_kloop(6);   record_kloop(7);
+  record_kloop(14);  record_kloop(21);  record_kloop(28);  record_kloop(35);
+  record_kloop(42);  record_kloop(49);  record_kloop(56);  record_kloop(57);
+  record_kloop(50);  record_kloop(43);  record_kloop(36);  record_kloop(29);
+  record_kloop(22);  record_kloop(15);  record_kloop(23);  record_kloop(30);
+  record_kloop(37);  record_kloop(44);  record_kloop(51);  record_kloop(58);
+  record_kloop(59);  record_kloop(52);  record_kloop(45);  record_kloop(38);
+  record_kloop(31);  record_kloop(39);  record_kloop(46);  record_kloop(53);
+  record_kloop(60);  record_kloop(61);  record_kloop(54);  record_kloop(47);
+  record_kloop(55);  record_kloop(62);  record_kloop(63);
+
+  /* If the last coef(s) were zero, emit an end-of-block code */
+  if (r > 0) {
+    ac_counts[0]++;
+    *tok++ = 0;
+  } else
+    *tok++ = TOKEN_BLOCK_END;
+
+  return tok;
+}
+
+
+/*
+ * Count the Huffman symbols in one MCU and record them for the output pass.
+ * No data is actually output, so no suspension return is possible.
+ */
+
+METHODDEF(boolean)
+encode_mcu_record(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  JOCTET *tok;
+  int blkn, ci;
+  jpeg_component_info *compptr;
+
+  /* Take care of restart intervals if needed */
+  if (cinfo->restart_interval) {
+    if (entropy->restarts_to_go == 0) {
+      /* Re-initialize DC predictions to 0 */
+      for (ci = 0; ci < cinfo->comps_in_scan; ci++)
+        entropy->saved.last_dc_val[ci] = 0;
+      /* Update restart state */
+      entropy->restarts_to_go = cinfo->restart_interval;
+    }
+    entropy->restarts_to_go--;
+  }
+
+  /* Make sure that the tokens for the whole MCU will fit in the chunk */
+  if (entropy->cur_chunk == NULL ||
+      (size_t)(entropy->cur_chunk->limit - entropy->next_token) <
+      (size_t)cinfo->blocks_in_MCU * MAX_TOKENS_PER_BLOCK)
+    start_token_chunk(cinfo, entropy);
+
+  tok = entropy->next_token;
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    ci = cinfo->MCU_membership[blkn];
+    compptr = cinfo->cur_comp_info[ci];
+    tok = record_one_block(cinfo, tok, MCU_data[blkn][0],
+                           entropy->saved.last_dc_val[ci],
+                           entropy->dc_count_ptrs[compptr->dc_tbl_no],
+                           entropy->ac_count_ptrs[compptr->ac_tbl_no]);
+    entropy->saved.last_dc_val[ci] = MCU_data[blkn][0][0];
+  }
+  entropy->next_token = tok;
+
+  return TRUE;
+}
+
+
+/* Emit the recorded tokens for a single block */
+
+LOCAL(boolean)
+replay_one_block(working_state *state, JOCTET **tokptr,
+                 c_derived_tbl *dctbl, c_derived_tbl *actbl)
+{
+  int temp2;
+  int nbits;
+  int sym, code, size;
+  JOCTET *tok = *tokptr;
+  JOCTET _buffer[BUFSIZE], *buffer;
+  size_t put_buffer;  int put_bits;
+  size_t bytes, bytestocopy;  int localbuf = 0;
+
+  put_buffer = state->cur.put_buffer;
+  put_bits = state->cur.put_bits;
+  LOAD_BUFFER()
+
+  /* Emit the DC symbol and the extra bits */
+  nbits = *tok++;
+  temp2 = tok[0] | (tok[1] << 8);
+  tok += TOKEN_BITS_BYTES(nbits);
+  code = dctbl->ehufco[nbits];
+  size = dctbl->ehufsi[nbits];
+  EMIT_CODE(code, size)
+
+  /* Emit the AC symbols and their extra bits, up to the end of the block */
+  for (;;) {
+    sym = *tok++;
+    if (sym == TOKEN_BLOCK_END)
+      break;
+    nbits = sym & 15;
+    temp2 = tok[0] | (tok[1] << 8);
+    tok += TOKEN_BITS_BYTES(nbits);
+    code = actbl->ehufco[sym];
+    size = actbl->ehufsi[sym];
+    EMIT_CODE(code, size)
+    if (sym == 0)               /* end-of-block code */
+      break;
+  }
+
+  *tokptr = tok;
+
+  state->cur.put_buffer = put_buffer;
+  state->cur.put_bits = put_bits;
+  STORE_BUFFER()
+
+  return TRUE;
+}
+
+
+/*
+ * Finish up the main pass of a single-pass optimization.
+ */
+
+METHODDEF(void)
+finish_pass_record(j_compress_ptr cinfo)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+
+  end_token_chunk(entropy);
+  finish_pass_gather(cinfo);
+}
+
+
+/*
+ * Output one MCU's worth of recorded tokens.
+ * The MCU_data pointer is not used.
+ */
+
+METHODDEF(boolean)
+encode_mcu_replay(j_compress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  working_state state;
+  huff_token_chunk *chunk = entropy->cur_chunk;
+  JOCTET *tok = entropy->next_token;
+  int blkn, ci;
+  jpeg_component_info *compptr;
+
+  /* Load up working state */
+  state.next_output_byte = cinfo->dest->next_output_byte;
+  state.free_in_buffer = cinfo->dest->free_in_buffer;
+  ASSIGN_STATE(state.cur, entropy->saved);
+  state.cinfo = cinfo;
+
+  /* Emit restart marker if needed */
+  if (cinfo->restart_interval) {
+    if (entropy->restarts_to_go == 0)
+      if (!emit_restart(&state, entropy->next_restart_num))
+        return FALSE;
+  }
+
+  /* Move to the next chunk if this one is exhausted */
+  if (tok == chunk->end) {
+    chunk = chunk->next;
+    tok = TOKEN_DATA(chunk);
+  }
+
+  /* Emit the tokens for the MCU data blocks */
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    ci = cinfo->MCU_membership[blkn];
+    compptr = cinfo->cur_comp_info[ci];
+    if (!replay_one_block(&state, &tok,
+                          entropy->dc_derived_tbls[compptr->dc_tbl_no],
+                          entropy->ac_derived_tbls[compptr->ac_tbl_no]))
+      return FALSE;
+  }
+
+  /* Completed MCU, so update state */
+  cinfo->dest->next_output_byte = state.next_output_byte;
+  cinfo->dest->free_in_buffer = state.free_in_buffer;
+  ASSIGN_STATE(entropy->saved, state.cur);
+  entropy->cur_chunk = chunk;
+  entropy->next_token = tok;
+
+  /* Update restart-interval state too */
+  if (cinfo->restart_interval) {
+    if (entropy->restarts_to_go == 0) {
+      entropy->restarts_to_go = cinfo->restart_interval;
+      entropy->next_restart_num++;
+      entropy->next_restart_num &= 7;
+    }
+    entropy->restarts_to_go--;
+  }
+
+  return TRUE;
+}
+
+
 /*
  * Generate the best Huffman code table for the given counts, fill htbl.
  * Note this is also used by jcphuff.c.
@@ -59,9 +59,13 @@ jinit_compress_master(j_compress_ptr cinfo)
       jinit_huff_encoder(cinfo);
   }
 
-  /* Need a full-image coefficient buffer in any multi-pass mode. */
-  jinit_c_coef_controller(cinfo, (boolean)(cinfo->num_scans > 1 ||
-                                           cinfo->optimize_coding));
+  /* Need a full-image coefficient buffer in any multi-pass mode, except
+   * when the entropy encoder can optimize a single scan by itself.
+   */
+  jinit_c_coef_controller(cinfo,
+                          (boolean)(cinfo->num_scans > 1 ||
+                                    (cinfo->optimize_coding &&
+                                     !cinfo->master->single_pass_optimize)));
   jinit_c_main_controller(cinfo, FALSE /* never need full buffer here */);
 
   jinit_marker_writer(cinfo);
@@ -73,5 +77,7 @@ jinit_compress_master(j_compress_ptr cinfo)
    * Frame and scan headers are postponed till later.
    * This lets application insert special markers after the SOI.
    */
+  PROFILE_BEGIN(cinfo, JPROF_MARKERS);
   (*cinfo->marker->write_file_header) (cinfo);
+  PROFILE_END(cinfo);
 }
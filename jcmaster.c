@@ -20,38 +20,7 @@
 #include "jpeglib.h"
 #include "jpegcomp.h"
 #include "jconfigint.h"
-
-
-/* Private state */
-
-typedef enum {
-  main_pass,                    /* input data, also do first output step */
-  huff_opt_pass,                /* Huffman code optimization pass */
-  output_pass                   /* data output pass */
-} c_pass_type;
-
-typedef struct {
-  struct jpeg_comp_master pub;  /* public fields */
-
-  c_pass_type pass_type;        /* the type of the current pass */
-
-  int pass_number;              /* # of passes completed */
-  int total_passes;             /* total # of passes needed */
-
-  int scan_number;              /* current index in scan_info[] */
-
-  /*
-   * This is here so we can add libjpeg-turbo version/build information to the
-   * global string table without introducing a new global symbol.  Adding this
-   * information to the global string table allows one to examine a binary
-   * object and determine which version of libjpeg-turbo it was built from or
-   * linked against.
-   */
-  const char *jpeg_version;
-
-} my_comp_master;
-
-typedef my_comp_master *my_master_ptr;
+#include "jcmaster.h"
 
 
 /*
@@ -465,7 +434,8 @@ prepare_for_pass(j_compress_ptr cinfo)
     (*cinfo->fdct->start_pass) (cinfo);
     (*cinfo->entropy->start_pass) (cinfo, cinfo->optimize_coding);
     (*cinfo->coef->start_pass) (cinfo,
-                                (master->total_passes > 1 ?
+                                (master->total_passes > 1 &&
+                                 !master->pub.single_pass_optimize ?
                                  JBUF_SAVE_AND_PASS : JBUF_PASS_THRU));
     (*cinfo->main->start_pass) (cinfo, JBUF_PASS_THRU);
     if (cinfo->optimize_coding) {
@@ -504,9 +474,11 @@ prepare_for_pass(j_compress_ptr cinfo)
     (*cinfo->entropy->start_pass) (cinfo, FALSE);
     (*cinfo->coef->start_pass) (cinfo, JBUF_CRANK_DEST);
     /* We emit frame/scan headers now */
+    PROFILE_BEGIN(cinfo, JPROF_MARKERS);
     if (master->scan_number == 0)
       (*cinfo->marker->write_frame_header) (cinfo);
     (*cinfo->marker->write_scan_header) (cinfo);
+    PROFILE_END(cinfo);
     master->pub.call_pass_startup = FALSE;
     break;
   default:
@@ -538,8 +510,10 @@ pass_startup(j_compress_ptr cinfo)
 {
   cinfo->master->call_pass_startup = FALSE; /* reset flag so call only once */
 
+  PROFILE_BEGIN(cinfo, JPROF_MARKERS);
   (*cinfo->marker->write_frame_header) (cinfo);
   (*cinfo->marker->write_scan_header) (cinfo);
+  PROFILE_END(cinfo);
 }
 
 
@@ -555,7 +529,9 @@ finish_pass_master(j_compress_ptr cinfo)
   /* The entropy coder always needs an end-of-pass call,
    * either to analyze statistics or to flush its output buffer.
    */
+  PROFILE_BEGIN(cinfo, JPROF_ENTROPY);
   (*cinfo->entropy->finish_pass) (cinfo);
+  PROFILE_END(cinfo);
 
   /* Update state for next pass */
   switch (master->pass_type) {
@@ -590,12 +566,8 @@ finish_pass_master(j_compress_ptr cinfo)
 GLOBAL(void)
 jinit_c_master_control(j_compress_ptr cinfo, boolean transcode_only)
 {
-  my_master_ptr master;
+  my_master_ptr master = (my_master_ptr)cinfo->master;
 
-  master = (my_master_ptr)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-                                sizeof(my_comp_master));
-  cinfo->master = (struct jpeg_comp_master *)master;
   master->pub.prepare_for_pass = prepare_for_pass;
   master->pub.pass_startup = pass_startup;
   master->pub.finish_pass = finish_pass_master;
@@ -636,5 +608,15 @@ jinit_c_master_control(j_compress_ptr cinfo, boolean transcode_only)
   else
     master->total_passes = cinfo->num_scans;
 
+  /* A single sequential Huffman scan can be optimized without a full-image
+   * coefficient buffer.  The entropy encoder records the Huffman symbols and
+   * extra bits during the main pass, and it replays them during the output
+   * pass, once the optimal tables are known.
+   */
+  master->pub.single_pass_optimize =
+    (boolean)(!transcode_only && cinfo->optimize_coding &&
+              !cinfo->arith_code && !cinfo->progressive_mode &&
+              cinfo->num_scans == 1);
+
   master->jpeg_version = PACKAGE_NAME " version " VERSION " (build " BUILD ")";
 }
@@ -16,6 +16,20 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 
+#ifdef PROFILE_SUPPORTED
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define USE_RDTSC
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define USE_RDTSC
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+
 
 /*
  * Abort processing of a JPEG compression or decompression operation,
@@ -54,6 +68,18 @@ jpeg_abort(j_common_ptr cinfo)
   } else {
     cinfo->global_state = CSTATE_START;
   }
+
+#ifdef PROFILE_SUPPORTED
+  /* An error exit may have left stages open. */
+  {
+    struct jpeg_profiler *profiler = cinfo->is_decompressor ?
+      ((j_decompress_ptr)cinfo)->master->profiler :
+      ((j_compress_ptr)cinfo)->master->profiler;
+
+    if (profiler != NULL)
+      profiler->depth = 0;
+  }
+#endif
 }
 
 
@@ -107,3 +133,134 @@ jpeg_alloc_huff_table(j_common_ptr cinfo)
   tbl->sent_table = FALSE;      /* make sure this is false in any new table */
   return tbl;
 }
+
+
+/*
+ * Per-stage timing instrumentation.
+ *
+ * Each module brackets the work done on behalf of one stage with
+ * PROFILE_BEGIN() and PROFILE_END().  Time is measured with the CPU's
+ * time-stamp counter on x86 platforms and with the highest-resolution
+ * monotonic clock that the OS provides elsewhere.  The instrumentation is
+ * compiled in only if PROFILE_SUPPORTED is defined, and it costs a single
+ * pointer test per stage when it has not been enabled for a JPEG object.
+ */
+
+#ifdef PROFILE_SUPPORTED
+
+LOCAL(unsigned long long)
+get_ticks(void)
+{
+#if defined(USE_RDTSC)
+  return __rdtsc();
+#elif defined(_WIN32)
+  LARGE_INTEGER counter;
+
+  QueryPerformanceCounter(&counter);
+  return (unsigned long long)counter.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+GLOBAL(void)
+jprofile_begin(struct jpeg_profiler *profiler, J_PROFILE_STAGE stage)
+{
+  unsigned long long now;
+
+  if (!profiler->enabled)
+    return;
+  /* Stages nested more deeply than JPROF_MAX_DEPTH are charged to the
+   * innermost stage that fits on the stack.
+   */
+  if (profiler->depth < JPROF_MAX_DEPTH) {
+    now = get_ticks();
+    /* Suspend the stage that is currently being timed, if any. */
+    if (profiler->depth > 0)
+      profiler->stages[profiler->stack[profiler->depth - 1]].ticks +=
+        now - profiler->mark;
+    profiler->stack[profiler->depth] = stage;
+    profiler->stages[stage].calls++;
+    profiler->mark = now;
+  }
+  profiler->depth++;
+}
+
+
+GLOBAL(void)
+jprofile_end(struct jpeg_profiler *profiler)
+{
+  unsigned long long now;
+
+  if (profiler->depth <= 0)
+    return;
+  if (--profiler->depth < JPROF_MAX_DEPTH) {
+    now = get_ticks();
+    profiler->stages[profiler->stack[profiler->depth]].ticks +=
+      now - profiler->mark;
+    profiler->mark = now;
+  }
+}
+
+#endif /* PROFILE_SUPPORTED */
+
+
+/*
+ * Enable or disable per-stage timing for a JPEG object.  Enabling profiling
+ * also clears the counters.  Returns FALSE if the library was built without
+ * the instrumentation.
+ */
+
+GLOBAL(boolean)
+jpeg_enable_profiling(j_common_ptr cinfo, boolean enable)
+{
+#ifdef PROFILE_SUPPORTED
+  struct jpeg_profiler **profiler = cinfo->is_decompressor ?
+    &((j_decompress_ptr)cinfo)->master->profiler :
+    &((j_compress_ptr)cinfo)->master->profiler;
+
+  if (*profiler == NULL) {
+    if (!enable)
+      return TRUE;
+    *profiler = (struct jpeg_profiler *)
+      (*cinfo->mem->alloc_small) (cinfo, JPOOL_PERMANENT,
+                                  sizeof(struct jpeg_profiler));
+  }
+  if (enable)
+    MEMZERO(*profiler, sizeof(struct jpeg_profiler));
+  else
+    (*profiler)->depth = 0;
+  (*profiler)->enabled = enable;
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+
+/*
+ * Retrieve the counters for all JPROF_NUMSTAGES stages.  The counters
+ * accumulate over all images processed with the object since profiling was
+ * last enabled, and they remain readable after profiling is disabled.  They
+ * are all zero if profiling was never enabled.
+ */
+
+GLOBAL(void)
+jpeg_get_profile(j_common_ptr cinfo, jpeg_stage_profile *stages)
+{
+#ifdef PROFILE_SUPPORTED
+  struct jpeg_profiler *profiler = cinfo->is_decompressor ?
+    ((j_decompress_ptr)cinfo)->master->profiler :
+    ((j_compress_ptr)cinfo)->master->profiler;
+
+  if (profiler != NULL) {
+    MEMCOPY(stages, profiler->stages, sizeof(profiler->stages));
+    return;
+  }
+#endif
+  MEMZERO(stages, sizeof(jpeg_stage_profile) * JPROF_NUMSTAGES);
+}
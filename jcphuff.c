@@ -91,7 +91,7 @@ typedef struct {
   JOCTET *next_output_byte;     /* => next byte to write in buffer */
   size_t free_in_buffer;        /* # of byte spaces remaining in buffer */
   size_t put_buffer;            /* current bit-accumulation buffer */
-  int put_bits;                 /* # of bits now in it */
+  int put_bits;                 /* # of bits now in it (right-justified) */
   j_compress_ptr cinfo;         /* link to cinfo (needed for dump_buffer) */
 
   /* Coding status for DC components */
@@ -269,7 +269,7 @@ start_pass_phuff(j_compress_ptr cinfo, boolean gather_statistics)
       MEMZERO(entropy->count_ptrs[tbl], 257 * sizeof(long));
     } else {
       /* Compute derived values for Huffman table */
-      /* We may do this more than once for a table, but it's not expensive */
+      /* We may do this more than once for a table, but it's cached */
       jpeg_make_c_derived_tbl(cinfo, is_DC_band, tbl,
                               &entropy->derived_tbls[tbl]);
     }
@@ -318,18 +318,66 @@ dump_buffer(phuff_entropy_ptr entropy)
 
 /* Outputting bits to the file */
 
-/* Only the right 24 bits of put_buffer are used; the valid bits are
- * left-justified in this part.  At most 16 bits can be passed to emit_bits
- * in one call, and we never retain more than 7 bits in put_buffer
- * between calls, so 24 bits are sufficient.
+/* The valid bits in put_buffer are right-justified, and the buffer is
+ * emptied only when it is completely full.  A full buffer is written as one
+ * big-endian word, unless it contains an 0xFF byte (which must be followed by
+ * a stuffed zero byte) or the output buffer is nearly full, in which case it
+ * is written one byte at a time.  Bits that are left over from a split code
+ * are kept in the low-order bits of put_buffer, and any stale bits above them
+ * are shifted out before the buffer is emptied again.  At most 31 bits can be
+ * passed to emit_bits() in one call.
  */
 
+#define BIT_BUF_SIZE  ((int)(sizeof(size_t) * 8))
+
+/* Nonzero if any byte of x is 0xFF */
+#define HAS_FF_BYTE(x) \
+  ((x) & ((size_t)-1 / 0xFF * 0x80) & ~((x) + (size_t)-1 / 0xFF))
+
+
+LOCAL(void)
+emit_bytes(phuff_entropy_ptr entropy, size_t put_buffer, int put_bits)
+/* Emit the put_bits / 8 most significant whole bytes of a bit buffer */
+{
+  while (put_bits >= 8) {
+    int c;
+
+    put_bits -= 8;
+    c = (int)((put_buffer >> put_bits) & 0xFF);
+    emit_byte(entropy, c);
+    if (c == 0xFF) {            /* need to stuff a zero byte? */
+      emit_byte(entropy, 0);
+    }
+  }
+}
+
+
+LOCAL(void)
+flush_buffer(phuff_entropy_ptr entropy, size_t put_buffer)
+/* Emit a full bit buffer */
+{
+  if (!HAS_FF_BYTE(put_buffer) &&
+      entropy->free_in_buffer >= sizeof(size_t)) {
+    JOCTET *buffer = entropy->next_output_byte;
+    int i;
+
+    for (i = BIT_BUF_SIZE - 8; i >= 0; i -= 8)
+      *buffer++ = (JOCTET)(put_buffer >> i);
+    entropy->next_output_byte = buffer;
+    entropy->free_in_buffer -= sizeof(size_t);
+    if (entropy->free_in_buffer == 0)
+      dump_buffer(entropy);
+  } else
+    emit_bytes(entropy, put_buffer, BIT_BUF_SIZE);
+}
+
+
 LOCAL(void)
 emit_bits(phuff_entropy_ptr entropy, unsigned int code, int size)
 /* Emit some bits, unless we are in gather mode */
 {
   /* This routine is heavily used, so it's worth coding tightly. */
-  register size_t put_buffer = (size_t)code;
+  register size_t put_buffer = entropy->put_buffer;
   register int put_bits = entropy->put_bits;
 
   /* if size is 0, caller used an invalid Huffman table entry */
@@ -339,23 +387,20 @@ emit_bits(phuff_entropy_ptr entropy, unsigned int code, int size)
   if (entropy->gather_statistics)
     return;                     /* do nothing if we're only getting stats */
 
-  put_buffer &= (((size_t)1) << size) - 1; /* mask off any extra bits in code */
+  code &= (unsigned int)((((size_t)1) << size) - 1); /* mask off extra bits */
 
   put_bits += size;             /* new number of bits in buffer */
 
-  put_buffer <<= 24 - put_bits; /* align incoming bits */
-
-  put_buffer |= entropy->put_buffer; /* and merge with old buffer contents */
-
-  while (put_bits >= 8) {
-    int c = (int)((put_buffer >> 16) & 0xFF);
-
-    emit_byte(entropy, c);
-    if (c == 0xFF) {            /* need to stuff a zero byte? */
-      emit_byte(entropy, 0);
-    }
-    put_buffer <<= 8;
-    put_bits -= 8;
+  if (put_bits < BIT_BUF_SIZE)
+    put_buffer = (put_buffer << size) | code;
+  else {
+    /* Fill the buffer with the high-order bits of the code, empty it, and
+     * keep the remaining low-order bits.
+     */
+    put_bits -= BIT_BUF_SIZE;
+    put_buffer = (put_buffer << (size - put_bits)) | (code >> put_bits);
+    flush_buffer(entropy, put_buffer);
+    put_buffer = code;
   }
 
   entropy->put_buffer = put_buffer; /* update variables */
@@ -367,6 +412,8 @@ LOCAL(void)
 flush_bits(phuff_entropy_ptr entropy)
 {
   emit_bits(entropy, 0x7F, 7); /* fill any partial byte with ones */
+  if (!entropy->gather_statistics)
+    emit_bytes(entropy, entropy->put_buffer, entropy->put_bits);
   entropy->put_buffer = 0;     /* and reset bit-buffer to empty */
   entropy->put_bits = 0;
 }
@@ -399,10 +446,19 @@ emit_buffered_bits(phuff_entropy_ptr entropy, char *bufstart,
   if (entropy->gather_statistics)
     return;                     /* no real work */
 
+  /* Pack the correction bits into groups of up to 16 so that they can be
+   * passed to emit_bits() together.
+   */
   while (nbits > 0) {
-    emit_bits(entropy, (unsigned int)(*bufstart), 1);
-    bufstart++;
-    nbits--;
+    unsigned int code = 0;
+    int size = (int)MIN(nbits, 16);
+    int i;
+
+    for (i = 0; i < size; i++)
+      code = (code << 1) | (unsigned int)(bufstart[i] & 1);
+    emit_bits(entropy, code, size);
+    bufstart += size;
+    nbits -= size;
   }
 }
 
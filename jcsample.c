@@ -54,24 +54,7 @@
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jsimd.h"
-
-
-/* Pointer to routine to downsample a single component */
-typedef void (*downsample1_ptr) (j_compress_ptr cinfo,
-                                 jpeg_component_info *compptr,
-                                 JSAMPARRAY input_data,
-                                 JSAMPARRAY output_data);
-
-/* Private subobject */
-
-typedef struct {
-  struct jpeg_downsampler pub;  /* public fields */
-
-  /* Downsampling method pointers, one per component */
-  downsample1_ptr methods[MAX_COMPONENTS];
-} my_downsampler;
-
-typedef my_downsampler *my_downsample_ptr;
+#include "jcsample.h"
 
 
 /*
@@ -203,7 +203,9 @@ transencode_master_selection(j_compress_ptr cinfo,
    * Frame and scan headers are postponed till later.
    * This lets application insert special markers after the SOI.
    */
+  PROFILE_BEGIN(cinfo, JPROF_MARKERS);
   (*cinfo->marker->write_file_header) (cinfo);
+  PROFILE_END(cinfo);
 }
 
 
@@ -346,12 +348,15 @@ compress_output(j_compress_ptr cinfo, JSAMPIMAGE input_buf)
         }
       }
       /* Try to write the MCU. */
+      PROFILE_BEGIN(cinfo, JPROF_ENTROPY);
       if (!(*cinfo->entropy->encode_mcu) (cinfo, MCU_buffer)) {
+        PROFILE_END(cinfo);
         /* Suspension forced; update state counters and exit */
         coef->MCU_vert_offset = yoffset;
         coef->mcu_ctr = MCU_col_num;
         return FALSE;
       }
+      PROFILE_END(cinfo);
     }
     /* Completed an MCU row, but perhaps not an iMCU row */
     coef->mcu_ctr = 0;
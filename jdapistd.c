@@ -387,6 +387,7 @@ jpeg_skip_scanlines(j_decompress_ptr cinfo, JDIMENSION num_lines)
   int y;
   JDIMENSION lines_per_iMCU_row, lines_left_in_iMCU_row, lines_after_iMCU_row;
   JDIMENSION lines_to_skip, lines_to_read;
+  JDIMENSION MCUs_skipped = 0;
 
   if (cinfo->global_state != DSTATE_SCANNING)
     ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
@@ -500,8 +501,31 @@ jpeg_skip_scanlines(j_decompress_ptr cinfo, JDIMENSION num_lines)
 
   /* Skip the iMCU rows that we can safely skip. */
   for (i = 0; i < lines_to_skip; i += lines_per_iMCU_row) {
+    JDIMENSION MCUs_per_iMCU_row =
+      coef->MCU_rows_per_iMCU_row * cinfo->MCUs_per_row;
+
+    /* If the image has restart markers, then the entropy decoder may be able
+     * to skip whole restart intervals without decoding them.  Let it skip as
+     * much as it can of the remaining iMCU rows, excluding the last iMCU row
+     * in the image (which may contain fewer MCU rows.)
+     */
+    if (cinfo->entropy->skip_mcus != NULL &&
+        MCUs_skipped < MCUs_per_iMCU_row &&
+        cinfo->input_iMCU_row < cinfo->total_iMCU_rows - 1) {
+      JDIMENSION rows_left =
+        MIN((lines_to_skip - i) / lines_per_iMCU_row,
+            cinfo->total_iMCU_rows - 1 - cinfo->input_iMCU_row);
+
+      MCUs_skipped += (*cinfo->entropy->skip_mcus)
+        (cinfo, rows_left * MCUs_per_iMCU_row - MCUs_skipped);
+    }
+    PROFILE_BEGIN(cinfo, JPROF_ENTROPY);
     for (y = 0; y < coef->MCU_rows_per_iMCU_row; y++) {
       for (x = 0; x < cinfo->MCUs_per_row; x++) {
+        if (MCUs_skipped > 0) {
+          MCUs_skipped--;
+          continue;
+        }
         /* Calling decode_mcu() with a NULL pointer causes it to discard the
          * decoded coefficients.  This is ~5% faster for large subsets, but
          * it's tough to tell a difference for smaller images.
@@ -509,6 +533,7 @@ jpeg_skip_scanlines(j_decompress_ptr cinfo, JDIMENSION num_lines)
         (*cinfo->entropy->decode_mcu) (cinfo, NULL);
       }
     }
+    PROFILE_END(cinfo);
     cinfo->input_iMCU_row++;
     cinfo->output_iMCU_row++;
     if (cinfo->input_iMCU_row < cinfo->total_iMCU_rows)
@@ -22,6 +22,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jconfigint.h"
 
 
 #define NEG_1  ((unsigned int)-1)
@@ -70,6 +71,7 @@ typedef arith_entropy_decoder *arith_entropy_ptr;
 #define AC_STAT_BINS  256
 
 
+INLINE
 LOCAL(int)
 get_byte(j_decompress_ptr cinfo)
 /* Read next input byte; we do not support suspension in this module. */
@@ -85,41 +87,19 @@ get_byte(j_decompress_ptr cinfo)
 
 
 /*
- * The core arithmetic decoding routine (common in JPEG and JBIG).
- * This needs to go as fast as possible.
- * Machine-dependent optimization facilities
- * are not utilized in this portable implementation.
- * However, this code should be fairly efficient and
- * may be a good base for further optimizations anyway.
- *
- * Return value is 0 or 1 (binary decision).
- *
- * Note: I've changed the handling of the code base & bit
- * buffer register C compared to other implementations
- * based on the standards layout & procedures.
- * While it also contains both the actual base of the
- * coding interval (16 bits) and the next-bits buffer,
- * the cut-point between these two parts is floating
- * (instead of fixed) with the bit shift counter CT.
- * Thus, we also need only one (variable instead of
- * fixed size) shift for the LPS/MPS decision, and
- * we can do away with any renormalization update
- * of C (except for new data insertion, of course).
- *
- * I've also introduced a new scheme for accessing
- * the probability estimation state machine table,
- * derived from Markus Kuhn's JBIG implementation.
+ * Renormalization & data input per section D.2.6.
+ * This is the general form of the renormalization procedure, which shifts A
+ * one bit at a time and inserts a new data byte into C whenever the bit
+ * buffer part of C runs dry.  It also handles the initial fill of C after
+ * the start of a scan or a restart marker.  arith_decode() calls this only
+ * when the fast path below cannot be used.
  */
 
-LOCAL(int)
-arith_decode(j_decompress_ptr cinfo, unsigned char *st)
+LOCAL(void)
+arith_renorm(j_decompress_ptr cinfo, arith_entropy_ptr e)
 {
-  register arith_entropy_ptr e = (arith_entropy_ptr)cinfo->entropy;
-  register unsigned char nl, nm;
-  register JLONG qe, temp;
-  register int sv, data;
+  register int data;
 
-  /* Renormalization & data input per section D.2.6 */
   while (e->a < 0x8000L) {
     if (--e->ct < 0) {
       /* Need to fetch next data byte */
@@ -153,6 +133,84 @@ arith_decode(j_decompress_ptr cinfo, unsigned char *st)
     }
     e->a <<= 1;
   }
+}
+
+
+/*
+ * Return the number of bit positions by which the nonzero A register must be
+ * shifted left in order to renormalize it (i.e. to make A >= 0x8000.)
+ */
+
+INLINE
+LOCAL(int)
+renorm_shift(JLONG a)
+{
+#if defined(__GNUC__)
+  return __builtin_clz((unsigned int)a) - 16;
+#else
+  int shift = 0;
+
+  while (a < 0x8000L) {
+    a <<= 1;
+    shift++;
+  }
+  return shift;
+#endif
+}
+
+
+/*
+ * The core arithmetic decoding routine (common in JPEG and JBIG).
+ * This needs to go as fast as possible.
+ * The renormalization step uses a count-leading-zeros
+ * instruction, where available, to shift the A register
+ * in one step rather than one bit at a time, and the
+ * rarely-needed data input path is kept out of line so
+ * that the remainder of the routine can be inlined into
+ * the MCU decoding loops.
+ *
+ * Return value is 0 or 1 (binary decision).
+ *
+ * Note: I've changed the handling of the code base & bit
+ * buffer register C compared to other implementations
+ * based on the standards layout & procedures.
+ * While it also contains both the actual base of the
+ * coding interval (16 bits) and the next-bits buffer,
+ * the cut-point between these two parts is floating
+ * (instead of fixed) with the bit shift counter CT.
+ * Thus, we also need only one (variable instead of
+ * fixed size) shift for the LPS/MPS decision, and
+ * we can do away with any renormalization update
+ * of C (except for new data insertion, of course).
+ *
+ * I've also introduced a new scheme for accessing
+ * the probability estimation state machine table,
+ * derived from Markus Kuhn's JBIG implementation.
+ */
+
+INLINE
+LOCAL(int)
+arith_decode(j_decompress_ptr cinfo, unsigned char *st)
+{
+  register arith_entropy_ptr e = (arith_entropy_ptr)cinfo->entropy;
+  register unsigned char nl, nm;
+  register JLONG qe, temp;
+  register int sv, shift;
+
+  /* Renormalization & data input per section D.2.6.
+   * In the common case, the bit buffer part of C still holds enough bits to
+   * cover the whole renormalization shift, so we can shift A in one step
+   * (which is equivalent to shifting it one bit at a time, since no new data
+   * needs to be inserted into C along the way.)  A is zero only before the
+   * initial fill of C, which is left to the general procedure.
+   */
+  if (e->a < 0x8000L) {
+    if (e->a != 0 && (shift = renorm_shift(e->a)) <= e->ct) {
+      e->a <<= shift;
+      e->ct -= shift;
+    } else
+      arith_renorm(cinfo, e);
+  }
 
   /* Fetch values from our compact representation of Table D.2:
    * Qe values and probability estimation state machine
@@ -203,8 +261,10 @@ process_restart(j_decompress_ptr cinfo)
   jpeg_component_info *compptr;
 
   /* Advance past the RSTn marker */
+  PROFILE_BEGIN(cinfo, JPROF_MARKERS);
   if (!(*cinfo->marker->read_restart_marker) (cinfo))
     ERREXIT(cinfo, JERR_CANT_SUSPEND);
+  PROFILE_END(cinfo);
 
   /* Re-initialize statistics areas */
   for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
@@ -748,6 +808,7 @@ jinit_arith_decoder(j_decompress_ptr cinfo)
                                 sizeof(arith_entropy_decoder));
   cinfo->entropy = (struct jpeg_entropy_decoder *)entropy;
   entropy->pub.start_pass = start_pass;
+  entropy->pub.skip_mcus = NULL;
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_ARITH_TBLS; i++) {
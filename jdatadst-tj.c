@@ -25,6 +25,7 @@
 
 #ifndef HAVE_STDLIB_H           /* <stdlib.h> should declare malloc(),free() */
 extern void *malloc(size_t size);
+extern void *realloc(void *ptr, size_t size);
 extern void free(void *ptr);
 #endif
 void jpeg_mem_dest_tj(j_compress_ptr cinfo, unsigned char **outbuffer,
@@ -41,7 +42,6 @@ typedef struct {
 
   unsigned char **outbuffer;    /* target buffer */
   unsigned long *outsize;
-  unsigned char *newbuffer;     /* newly allocated buffer */
   JOCTET *buffer;               /* start of buffer */
   size_t bufsize;
   boolean alloc;
@@ -94,18 +94,21 @@ empty_mem_output_buffer(j_compress_ptr cinfo)
 
   if (!dest->alloc) ERREXIT(cinfo, JERR_BUFFER_SIZE);
 
-  /* Try to allocate new buffer with double size */
+  /* Try to enlarge buffer to double size.  The buffer was allocated either
+   * by us or by tjAlloc(), so realloc() can usually do this in place (or, for
+   * large buffers, by remapping pages), which avoids both copying the data and
+   * having two copies of it in memory at once.
+   */
   nextsize = dest->bufsize * 2;
-  nextbuffer = (JOCTET *)malloc(nextsize);
+  nextbuffer = (JOCTET *)realloc(dest->buffer, nextsize);
 
   if (nextbuffer == NULL)
     ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
 
-  MEMCOPY(nextbuffer, dest->buffer, dest->bufsize);
-
-  free(dest->newbuffer);
-
-  dest->newbuffer = nextbuffer;
+  /* The old buffer may have been freed, so don't leave the caller holding a
+   * stale pointer to it if compression fails later.
+   */
+  *dest->outbuffer = nextbuffer;
 
   dest->pub.next_output_byte = nextbuffer + dest->bufsize;
   dest->pub.free_in_buffer = dest->bufsize;
@@ -165,7 +168,6 @@ jpeg_mem_dest_tj(j_compress_ptr cinfo, unsigned char **outbuffer,
       (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                   sizeof(my_mem_destination_mgr));
     dest = (my_mem_dest_ptr)cinfo->dest;
-    dest->newbuffer = NULL;
     dest->buffer = NULL;
   } else if (cinfo->dest->init_destination != init_mem_destination) {
     /* It is unsafe to reuse the existing destination manager unless it was
@@ -187,8 +189,8 @@ jpeg_mem_dest_tj(j_compress_ptr cinfo, unsigned char **outbuffer,
   if (*outbuffer == NULL || *outsize == 0) {
     if (alloc) {
       /* Allocate initial buffer */
-      dest->newbuffer = *outbuffer = (unsigned char *)malloc(OUTPUT_BUF_SIZE);
-      if (dest->newbuffer == NULL)
+      *outbuffer = (unsigned char *)malloc(OUTPUT_BUF_SIZE);
+      if (*outbuffer == NULL)
         ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
       *outsize = OUTPUT_BUF_SIZE;
     } else
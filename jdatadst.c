@@ -10,7 +10,8 @@
  * file.
  *
  * This file contains compression data destination routines for the case of
- * emitting JPEG data to memory or to a file (or any stdio stream).
+ * emitting JPEG data to memory, to a list of memory chunks, to an
+ * application-supplied write function, or to a file (or any stdio stream).
  * While these routines are sufficient for most applications,
  * some will want to use a different destination manager.
  * IMPORTANT: we assume that fwrite() will correctly transcribe an array of
@@ -25,6 +26,7 @@
 
 #ifndef HAVE_STDLIB_H           /* <stdlib.h> should declare malloc(),free() */
 extern void *malloc(size_t size);
+extern void *realloc(void *ptr, size_t size);
 extern void free(void *ptr);
 #endif
 
@@ -134,16 +136,28 @@ empty_mem_output_buffer(j_compress_ptr cinfo)
   JOCTET *nextbuffer;
   my_mem_dest_ptr dest = (my_mem_dest_ptr)cinfo->dest;
 
-  /* Try to allocate new buffer with double size */
+  /* Try to enlarge buffer to double size.  If the buffer was allocated by
+   * us, then realloc() can usually do this in place (or, for large buffers,
+   * by remapping pages), which avoids both copying the data and having two
+   * copies of it in memory at once.  Otherwise, we have to allocate a new
+   * buffer and copy the data into it.
+   */
   nextsize = dest->bufsize * 2;
-  nextbuffer = (JOCTET *)malloc(nextsize);
+  if (dest->newbuffer != NULL && dest->buffer == dest->newbuffer) {
+    nextbuffer = (JOCTET *)realloc(dest->newbuffer, nextsize);
 
-  if (nextbuffer == NULL)
-    ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+    if (nextbuffer == NULL)
+      ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+  } else {
+    nextbuffer = (JOCTET *)malloc(nextsize);
+
+    if (nextbuffer == NULL)
+      ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
 
-  MEMCOPY(nextbuffer, dest->buffer, dest->bufsize);
+    MEMCOPY(nextbuffer, dest->buffer, dest->bufsize);
 
-  free(dest->newbuffer);
+    free(dest->newbuffer);
+  }
 
   dest->newbuffer = nextbuffer;
 
@@ -290,3 +304,271 @@ jpeg_mem_dest(j_compress_ptr cinfo, unsigned char **outbuffer,
   dest->pub.free_in_buffer = dest->bufsize = *outsize;
 }
 #endif
+
+
+/* Expanded data destination object for chunk list output */
+
+typedef struct {
+  struct jpeg_destination_mgr pub; /* public fields */
+
+  jpeg_chunk_list *list;        /* target list */
+} my_chunk_destination_mgr;
+
+typedef my_chunk_destination_mgr *my_chunk_dest_ptr;
+
+#define DEFAULT_CHUNK_SIZE  65536
+
+
+/*
+ * Update the size of the last chunk in the list and the total size.  Every
+ * chunk except the last one is full, so this is all the bookkeeping needed.
+ */
+
+LOCAL(void)
+update_chunk_sizes(my_chunk_dest_ptr dest)
+{
+  jpeg_chunk_list *list = dest->list;
+
+  if (list->num_chunks == 0) return;
+  list->chunks[list->num_chunks - 1].size =
+    list->chunk_size - dest->pub.free_in_buffer;
+  list->total_size = (list->num_chunks - 1) * list->chunk_size +
+                     list->chunks[list->num_chunks - 1].size;
+}
+
+METHODDEF(boolean) empty_chunk_output_buffer(j_compress_ptr cinfo);
+
+METHODDEF(void)
+init_chunk_destination(j_compress_ptr cinfo)
+{
+  my_chunk_dest_ptr dest = (my_chunk_dest_ptr)cinfo->dest;
+  jpeg_chunk_list *list = dest->list;
+  jpeg_chunk *last;
+
+  /* Append to the last chunk, if there is room in it.  Otherwise, start a
+   * new chunk.  (The library expects free_in_buffer to be nonzero here.)
+   */
+  if (list->num_chunks > 0) {
+    last = &list->chunks[list->num_chunks - 1];
+    dest->pub.next_output_byte = last->data + last->size;
+    dest->pub.free_in_buffer = list->chunk_size - last->size;
+  } else {
+    dest->pub.next_output_byte = NULL;
+    dest->pub.free_in_buffer = 0;
+  }
+  if (dest->pub.free_in_buffer == 0)
+    empty_chunk_output_buffer(cinfo);
+}
+
+/*
+ * The current chunk is full, so start a new one.  Unlike
+ * empty_mem_output_buffer(), this never copies or moves the data that has
+ * already been written.  Only the (small) array of chunk descriptors is ever
+ * reallocated.
+ */
+
+METHODDEF(boolean)
+empty_chunk_output_buffer(j_compress_ptr cinfo)
+{
+  my_chunk_dest_ptr dest = (my_chunk_dest_ptr)cinfo->dest;
+  jpeg_chunk_list *list = dest->list;
+  jpeg_chunk *chunks;
+  JOCTET *data;
+  size_t max_chunks;
+
+  /* As with the other destination managers, the current state of
+   * next_output_byte and free_in_buffer must be ignored here, since the
+   * entropy encoders do not update them before calling us.
+   */
+  if (list->num_chunks > 0)
+    list->chunks[list->num_chunks - 1].size = list->chunk_size;
+
+  if (list->num_chunks >= list->max_chunks) {
+    max_chunks = list->max_chunks ? list->max_chunks * 2 : 16;
+    chunks = (jpeg_chunk *)realloc(list->chunks,
+                                   max_chunks * sizeof(jpeg_chunk));
+    if (chunks == NULL)
+      ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+    list->chunks = chunks;
+    list->max_chunks = max_chunks;
+  }
+
+  data = (JOCTET *)malloc(list->chunk_size);
+  if (data == NULL)
+    ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+  list->chunks[list->num_chunks].data = data;
+  list->chunks[list->num_chunks].size = 0;
+  list->num_chunks++;
+
+  dest->pub.next_output_byte = data;
+  dest->pub.free_in_buffer = list->chunk_size;
+
+  return TRUE;
+}
+
+METHODDEF(void)
+term_chunk_destination(j_compress_ptr cinfo)
+{
+  my_chunk_dest_ptr dest = (my_chunk_dest_ptr)cinfo->dest;
+  jpeg_chunk_list *list = dest->list;
+
+  update_chunk_sizes(dest);
+
+  /* The library empties the buffer as soon as it fills up, so the last chunk
+   * may be empty.  Discard it, so that every chunk contains some data.
+   */
+  if (list->num_chunks > 0 && list->chunks[list->num_chunks - 1].size == 0) {
+    list->num_chunks--;
+    free(list->chunks[list->num_chunks].data);
+    dest->pub.next_output_byte = NULL;
+    dest->pub.free_in_buffer = 0;
+  }
+}
+
+
+/*
+ * Prepare for output to a list of memory chunks.
+ * The chunks are allocated with malloc(), and the application is responsible
+ * for releasing them with jpeg_free_chunks(), even if compression fails.
+ */
+
+GLOBAL(void)
+jpeg_chunk_dest(j_compress_ptr cinfo, jpeg_chunk_list *list)
+{
+  my_chunk_dest_ptr dest;
+
+  if (list == NULL)             /* sanity check */
+    ERREXIT(cinfo, JERR_BUFFER_SIZE);
+
+  /* The destination object is made permanent so that multiple JPEG images
+   * can be written to the same list without re-executing jpeg_chunk_dest.
+   */
+  if (cinfo->dest == NULL) {    /* first time for this JPEG object? */
+    cinfo->dest = (struct jpeg_destination_mgr *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                  sizeof(my_chunk_destination_mgr));
+  } else if (cinfo->dest->init_destination != init_chunk_destination) {
+    /* It is unsafe to reuse the existing destination manager unless it was
+     * created by this function.
+     */
+    ERREXIT(cinfo, JERR_BUFFER_SIZE);
+  }
+
+  if (list->chunk_size == 0)
+    list->chunk_size = DEFAULT_CHUNK_SIZE;
+
+  dest = (my_chunk_dest_ptr)cinfo->dest;
+  dest->pub.init_destination = init_chunk_destination;
+  dest->pub.empty_output_buffer = empty_chunk_output_buffer;
+  dest->pub.term_destination = term_chunk_destination;
+  dest->list = list;
+}
+
+
+/*
+ * Release the chunks in a list that was filled by a chunk destination
+ * manager, and reset the list so that it can be reused.
+ */
+
+GLOBAL(void)
+jpeg_free_chunks(jpeg_chunk_list *list)
+{
+  size_t i;
+
+  if (list == NULL) return;
+  for (i = 0; i < list->num_chunks; i++)
+    free(list->chunks[i].data);
+  free(list->chunks);
+  list->chunks = NULL;
+  list->num_chunks = list->max_chunks = 0;
+  list->total_size = 0;
+}
+
+
+/* Expanded data destination object for callback output */
+
+typedef struct {
+  struct jpeg_destination_mgr pub; /* public fields */
+
+  jpeg_write_method write_data; /* application's write function */
+  JOCTET *buffer;               /* start of buffer */
+} my_callback_destination_mgr;
+
+typedef my_callback_destination_mgr *my_callback_dest_ptr;
+
+METHODDEF(void)
+init_callback_destination(j_compress_ptr cinfo)
+{
+  my_callback_dest_ptr dest = (my_callback_dest_ptr)cinfo->dest;
+
+  /* Allocate the output buffer --- it will be released when done with image */
+  dest->buffer = (JOCTET *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                OUTPUT_BUF_SIZE * sizeof(JOCTET));
+
+  dest->pub.next_output_byte = dest->buffer;
+  dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
+}
+
+METHODDEF(boolean)
+empty_callback_output_buffer(j_compress_ptr cinfo)
+{
+  my_callback_dest_ptr dest = (my_callback_dest_ptr)cinfo->dest;
+
+  if (!(*dest->write_data) (cinfo, dest->buffer, OUTPUT_BUF_SIZE))
+    ERREXIT(cinfo, JERR_FILE_WRITE);
+
+  dest->pub.next_output_byte = dest->buffer;
+  dest->pub.free_in_buffer = OUTPUT_BUF_SIZE;
+
+  return TRUE;
+}
+
+METHODDEF(void)
+term_callback_destination(j_compress_ptr cinfo)
+{
+  my_callback_dest_ptr dest = (my_callback_dest_ptr)cinfo->dest;
+  size_t datacount = OUTPUT_BUF_SIZE - dest->pub.free_in_buffer;
+
+  /* Write any data remaining in the buffer */
+  if (datacount > 0) {
+    if (!(*dest->write_data) (cinfo, dest->buffer, datacount))
+      ERREXIT(cinfo, JERR_FILE_WRITE);
+  }
+}
+
+
+/*
+ * Prepare for output to an application-supplied write function.
+ * The function receives the JPEG data in pieces as they are generated, so
+ * the compressed image never needs to be held in memory in its entirety.
+ */
+
+GLOBAL(void)
+jpeg_callback_dest(j_compress_ptr cinfo, jpeg_write_method write_data)
+{
+  my_callback_dest_ptr dest;
+
+  if (write_data == NULL)       /* sanity check */
+    ERREXIT(cinfo, JERR_BUFFER_SIZE);
+
+  /* The destination object is made permanent so that multiple JPEG images
+   * can be written without re-executing jpeg_callback_dest.
+   */
+  if (cinfo->dest == NULL) {    /* first time for this JPEG object? */
+    cinfo->dest = (struct jpeg_destination_mgr *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
+                                  sizeof(my_callback_destination_mgr));
+  } else if (cinfo->dest->init_destination != init_callback_destination) {
+    /* It is unsafe to reuse the existing destination manager unless it was
+     * created by this function.
+     */
+    ERREXIT(cinfo, JERR_BUFFER_SIZE);
+  }
+
+  dest = (my_callback_dest_ptr)cinfo->dest;
+  dest->pub.init_destination = init_callback_destination;
+  dest->pub.empty_output_buffer = empty_callback_output_buffer;
+  dest->pub.term_destination = term_callback_destination;
+  dest->write_data = write_data;
+}
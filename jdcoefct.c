@@ -102,12 +102,15 @@ decompress_onepass(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
       /* Try to fetch an MCU.  Entropy decoder expects buffer to be zeroed. */
       jzero_far((void *)coef->MCU_buffer[0],
                 (size_t)(cinfo->blocks_in_MCU * sizeof(JBLOCK)));
+      PROFILE_BEGIN(cinfo, JPROF_ENTROPY);
       if (!(*cinfo->entropy->decode_mcu) (cinfo, coef->MCU_buffer)) {
+        PROFILE_END(cinfo);
         /* Suspension forced; update state counters and exit */
         coef->MCU_vert_offset = yoffset;
         coef->MCU_ctr = MCU_col_num;
         return JPEG_SUSPENDED;
       }
+      PROFILE_END(cinfo);
 
       /* Only perform the IDCT on blocks that are contained within the desired
        * cropping region.
@@ -119,6 +122,7 @@ decompress_onepass(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
          * incremented past them!).  Note the inner loop relies on having
          * allocated the MCU_buffer[] blocks sequentially.
          */
+        PROFILE_BEGIN(cinfo, JPROF_DCT);
         blkn = 0;               /* index of current DCT block within MCU */
         for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
           compptr = cinfo->cur_comp_info[ci];
@@ -149,6 +153,7 @@ decompress_onepass(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
             output_ptr += compptr->_DCT_scaled_size;
           }
         }
+        PROFILE_END(cinfo);
       }
     }
     /* Completed an MCU row, but perhaps not an iMCU row */
@@ -228,12 +233,15 @@ consume_data(j_decompress_ptr cinfo)
         }
       }
       /* Try to fetch the MCU. */
+      PROFILE_BEGIN(cinfo, JPROF_ENTROPY);
       if (!(*cinfo->entropy->decode_mcu) (cinfo, coef->MCU_buffer)) {
+        PROFILE_END(cinfo);
         /* Suspension forced; update state counters and exit */
         coef->MCU_vert_offset = yoffset;
         coef->MCU_ctr = MCU_col_num;
         return JPEG_SUSPENDED;
       }
+      PROFILE_END(cinfo);
     }
     /* Completed an MCU row, but perhaps not an iMCU row */
     coef->MCU_ctr = 0;
@@ -300,6 +308,7 @@ decompress_data(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
     }
     inverse_DCT = cinfo->idct->inverse_DCT[ci];
     output_ptr = output_buf[ci];
+    PROFILE_BEGIN(cinfo, JPROF_DCT);
     /* Loop over all DCT blocks to be processed. */
     for (block_row = 0; block_row < block_rows; block_row++) {
       buffer_ptr = buffer[block_row] + cinfo->master->first_MCU_col[ci];
@@ -313,6 +322,7 @@ decompress_data(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
       }
       output_ptr += compptr->_DCT_scaled_size;
     }
+    PROFILE_END(cinfo);
   }
 
   if (++(cinfo->output_iMCU_row) < cinfo->total_iMCU_rows)
@@ -489,6 +499,7 @@ decompress_smooth_data(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
     Q02 = quanttbl->quantval[Q02_POS];
     inverse_DCT = cinfo->idct->inverse_DCT[ci];
     output_ptr = output_buf[ci];
+    PROFILE_BEGIN(cinfo, JPROF_DCT);
     /* Loop over all DCT blocks to be processed. */
     for (block_row = 0; block_row < block_rows; block_row++) {
       buffer_ptr = buffer[block_row] + cinfo->master->first_MCU_col[ci];
@@ -609,6 +620,7 @@ decompress_smooth_data(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
       }
       output_ptr += compptr->_DCT_scaled_size;
     }
+    PROFILE_END(cinfo);
   }
 
   if (++(cinfo->output_iMCU_row) < cinfo->total_iMCU_rows)
@@ -619,6 +631,108 @@ decompress_smooth_data(j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
 #endif /* BLOCK_SMOOTHING_SUPPORTED */
 
 
+#ifdef D_MULTISCAN_FILES_SUPPORTED
+
+/*
+ * Decompression from another decompressor's coefficients.
+ *
+ * After jpeg_read_coefficients(), the source decompressor holds the whole
+ * image in its coefficient arrays.  Any number of other decompressors that
+ * have read the header of the same JPEG image can decompress those arrays,
+ * each with its own output parameters (scaling, color space, etc.), without
+ * repeating the entropy decoding.  The input side of such a decompressor
+ * reads nothing and simply reports that the whole image is available.  The
+ * source decompressor must not be finished, aborted, or destroyed until they
+ * are done.
+ *
+ * These decompressors must not run concurrently.  Although they only read
+ * the arrays, access_virt_barray() modifies the state of an array (its
+ * in-memory window and, for packed arrays, its unpacked rows) whenever the
+ * whole array is not memory-resident, as is the case when a backing store
+ * is used or coefficient packing is enabled.
+ */
+
+METHODDEF(void)
+start_shared_input_pass(j_decompress_ptr cinfo)
+{
+  j_decompress_ptr srcinfo = cinfo->master->coef_source;
+  int ci;
+  jpeg_component_info *compptr;
+
+  /* Keep the output side from asking for more input. */
+  cinfo->input_iMCU_row = cinfo->total_iMCU_rows;
+
+  /* Latch the quantization tables that were used by all of the scans, not
+   * just the first one, along with the final progression state (which
+   * determines whether block smoothing can be used.)
+   */
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    if (srcinfo->comp_info[ci].quant_table == NULL)
+      continue;
+    if (compptr->quant_table == NULL)
+      compptr->quant_table = (JQUANT_TBL *)
+        (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+                                    sizeof(JQUANT_TBL));
+    MEMCOPY(compptr->quant_table, srcinfo->comp_info[ci].quant_table,
+            sizeof(JQUANT_TBL));
+  }
+  if (cinfo->coef_bits != NULL && srcinfo->coef_bits != NULL)
+    MEMCOPY(cinfo->coef_bits[0], srcinfo->coef_bits[0],
+            cinfo->num_components * DCTSIZE2 * sizeof(int));
+}
+
+
+METHODDEF(int)
+consume_shared_data(j_decompress_ptr cinfo)
+{
+  cinfo->inputctl->eoi_reached = TRUE;
+  (*cinfo->inputctl->finish_input_pass) (cinfo);
+  return JPEG_REACHED_EOI;
+}
+
+
+/*
+ * Make a decompressor that has read the JPEG header decompress the
+ * coefficient arrays of another decompressor, which has read the same JPEG
+ * image with jpeg_read_coefficients(), instead of reading the JPEG data
+ * stream.  This must be called before jpeg_start_decompress().  Only one
+ * decompressor at a time may use a given coefficient source (see above.)
+ */
+
+GLOBAL(void)
+jpeg_coef_source_tj(j_decompress_ptr cinfo, j_decompress_ptr srcinfo)
+{
+  int ci;
+
+  if (cinfo->global_state != DSTATE_READY)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+  if (srcinfo->global_state != DSTATE_STOPPING ||
+      srcinfo->coef->coef_arrays == NULL)
+    ERREXIT1(cinfo, JERR_BAD_STATE, srcinfo->global_state);
+
+  /* The coefficient arrays must have the same layout as our own. */
+  if (srcinfo->num_components != cinfo->num_components ||
+      srcinfo->total_iMCU_rows != cinfo->total_iMCU_rows)
+    ERREXIT(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+  for (ci = 0; ci < cinfo->num_components; ci++) {
+    if (srcinfo->comp_info[ci].h_samp_factor !=
+          cinfo->comp_info[ci].h_samp_factor ||
+        srcinfo->comp_info[ci].v_samp_factor !=
+          cinfo->comp_info[ci].v_samp_factor ||
+        srcinfo->comp_info[ci].width_in_blocks !=
+          cinfo->comp_info[ci].width_in_blocks ||
+        srcinfo->comp_info[ci].height_in_blocks !=
+          cinfo->comp_info[ci].height_in_blocks)
+      ERREXIT(cinfo, JERR_BAD_VIRTUAL_ACCESS);
+  }
+
+  cinfo->master->coef_source = srcinfo;
+}
+
+#endif /* D_MULTISCAN_FILES_SUPPORTED */
+
+
 /*
  * Initialize coefficient buffer controller.
  */
@@ -647,23 +761,34 @@ jinit_d_coef_controller(j_decompress_ptr cinfo, boolean need_full_buffer)
     int ci, access_rows;
     jpeg_component_info *compptr;
 
-    for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
-         ci++, compptr++) {
-      access_rows = compptr->v_samp_factor;
+    if (cinfo->master->coef_source != NULL) {
+      /* Use the arrays of the coefficient source instead (see below) */
+      if (cinfo->buffered_image)
+        ERREXIT(cinfo, JERR_NOTIMPL);
+      for (ci = 0; ci < cinfo->num_components; ci++)
+        coef->whole_image[ci] =
+          cinfo->master->coef_source->coef->coef_arrays[ci];
+      coef->pub.start_input_pass = start_shared_input_pass;
+      coef->pub.consume_data = consume_shared_data;
+    } else {
+      for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+           ci++, compptr++) {
+        access_rows = compptr->v_samp_factor;
 #ifdef BLOCK_SMOOTHING_SUPPORTED
-      /* If block smoothing could be used, need a bigger window */
-      if (cinfo->progressive_mode)
-        access_rows *= 3;
+        /* If block smoothing could be used, need a bigger window */
+        if (cinfo->progressive_mode)
+          access_rows *= 3;
 #endif
-      coef->whole_image[ci] = (*cinfo->mem->request_virt_barray)
-        ((j_common_ptr)cinfo, JPOOL_IMAGE, TRUE,
-         (JDIMENSION)jround_up((long)compptr->width_in_blocks,
-                               (long)compptr->h_samp_factor),
-         (JDIMENSION)jround_up((long)compptr->height_in_blocks,
-                               (long)compptr->v_samp_factor),
-         (JDIMENSION)access_rows);
+        coef->whole_image[ci] = (*cinfo->mem->request_virt_barray)
+          ((j_common_ptr)cinfo, JPOOL_IMAGE, TRUE,
+           (JDIMENSION)jround_up((long)compptr->width_in_blocks,
+                                 (long)compptr->h_samp_factor),
+           (JDIMENSION)jround_up((long)compptr->height_in_blocks,
+                                 (long)compptr->v_samp_factor),
+           (JDIMENSION)access_rows);
+      }
+      coef->pub.consume_data = consume_data;
     }
-    coef->pub.consume_data = consume_data;
     coef->pub.decompress_data = decompress_data;
     coef->pub.coef_arrays = coef->whole_image; /* link to virtual arrays */
 #else
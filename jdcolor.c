@@ -211,21 +211,33 @@ LOCAL(void)
 build_ycc_rgb_table(j_decompress_ptr cinfo)
 {
   my_cconvert_ptr cconvert = (my_cconvert_ptr)cinfo->cconvert;
+  struct jpeg_decomp_master *master = cinfo->master;
   int i;
   JLONG x;
   SHIFT_TEMPS
 
-  cconvert->Cr_r_tab = (int *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+  /* The tables never change, so they are built only once for each
+   * decompression object and shared by all images.
+   */
+  if (master->Cr_r_tab != NULL) {
+    cconvert->Cr_r_tab = master->Cr_r_tab;
+    cconvert->Cb_b_tab = master->Cb_b_tab;
+    cconvert->Cr_g_tab = master->Cr_g_tab;
+    cconvert->Cb_g_tab = master->Cb_g_tab;
+    return;
+  }
+
+  cconvert->Cr_r_tab = master->Cr_r_tab = (int *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                 (MAXJSAMPLE + 1) * sizeof(int));
-  cconvert->Cb_b_tab = (int *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+  cconvert->Cb_b_tab = master->Cb_b_tab = (int *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                 (MAXJSAMPLE + 1) * sizeof(int));
-  cconvert->Cr_g_tab = (JLONG *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+  cconvert->Cr_g_tab = master->Cr_g_tab = (JLONG *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                 (MAXJSAMPLE + 1) * sizeof(JLONG));
-  cconvert->Cb_g_tab = (JLONG *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+  cconvert->Cb_g_tab = master->Cb_g_tab = (JLONG *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                 (MAXJSAMPLE + 1) * sizeof(JLONG));
 
   for (i = 0, x = -CENTERJSAMPLE; i <= MAXJSAMPLE; i++, x++) {
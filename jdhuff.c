@@ -111,7 +111,7 @@ start_pass_huff_decoder(j_decompress_ptr cinfo)
     dctbl = compptr->dc_tbl_no;
     actbl = compptr->ac_tbl_no;
     /* Compute derived values for Huffman tables */
-    /* We may do this more than once for a table, but it's not expensive */
+    /* We may do this more than once for a table, but it's cached */
     pdtbl = (d_derived_tbl **)(entropy->dc_derived_tbls) + dctbl;
     jpeg_make_d_derived_tbl(cinfo, TRUE, dctbl, pdtbl);
     pdtbl = (d_derived_tbl **)(entropy->ac_derived_tbls) + actbl;
@@ -147,6 +147,41 @@ start_pass_huff_decoder(j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Cache of derived Huffman tables (see jtbl_cache_lookup() in jutils.c.)  The
+ * key is the table definition (the contiguous bits[] and used part of
+ * huffval[] arrays of a private copy of it.)  DC and AC tables are cached
+ * separately, since they are validated differently, and each cache has room
+ * for all of the tables of its class that a single scan can use.
+ */
+
+typedef struct {
+  jtbl_cache_entry hdr;         /* must be first */
+  JHUFF_TBL htbl;               /* key: private copy of the table definition */
+  d_derived_tbl dtbl;           /* derived table */
+} huff_tbl_cache_entry;
+
+LOCAL(huff_tbl_cache_entry *)
+huff_tbl_cache_lookup(j_decompress_ptr cinfo, boolean isDC, JHUFF_TBL *htbl)
+{
+  int l, numsymbols;
+
+  numsymbols = 0;
+  for (l = 1; l <= 16; l++)
+    numsymbols += htbl->bits[l];
+  if (numsymbols > 256)         /* invalid table; let the caller reject it */
+    numsymbols = 256;
+
+  return (huff_tbl_cache_entry *)
+    jtbl_cache_lookup((j_common_ptr)cinfo,
+                      isDC ? &cinfo->master->dc_huff_tbl_cache :
+                             &cinfo->master->ac_huff_tbl_cache,
+                      NUM_HUFF_TBLS, sizeof(huff_tbl_cache_entry),
+                      offsetof(huff_tbl_cache_entry, htbl), htbl,
+                      offsetof(JHUFF_TBL, huffval) + numsymbols);
+}
+
+
 /*
  * Compute the derived values for a Huffman table.
  * This routine also performs some validation checks on the table.
@@ -160,6 +195,7 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, boolean isDC, int tblno,
 {
   JHUFF_TBL *htbl;
   d_derived_tbl *dtbl;
+  huff_tbl_cache_entry *entry;
   int p, i, l, si, numsymbols;
   int lookbits, ctr;
   char huffsize[257];
@@ -178,12 +214,14 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, boolean isDC, int tblno,
   if (htbl == NULL)
     ERREXIT1(cinfo, JERR_NO_HUFF_TABLE, tblno);
 
-  /* Allocate a workspace if we haven't already done so. */
-  if (*pdtbl == NULL)
-    *pdtbl = (d_derived_tbl *)
-      (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
-                                  sizeof(d_derived_tbl));
-  dtbl = *pdtbl;
+  /* Reuse a previously derived table if possible.  Otherwise, derive the
+   * table from the cache entry's private copy of the definition.
+   */
+  entry = huff_tbl_cache_lookup(cinfo, isDC, htbl);
+  *pdtbl = dtbl = &entry->dtbl;
+  if (entry->hdr.valid)
+    return;
+  htbl = &entry->htbl;
   dtbl->pub = htbl;             /* fill in back link */
 
   /* Figure C.1: make table of Huffman code length for each symbol */
@@ -273,6 +311,8 @@ jpeg_make_d_derived_tbl(j_decompress_ptr cinfo, boolean isDC, int tblno,
         ERREXIT(cinfo, JERR_BAD_HUFF_TABLE);
     }
   }
+
+  entry->hdr.valid = TRUE;
 }
 
 
@@ -535,8 +575,12 @@ process_restart(j_decompress_ptr cinfo)
   entropy->bitstate.bits_left = 0;
 
   /* Advance past the RSTn marker */
-  if (!(*cinfo->marker->read_restart_marker) (cinfo))
+  PROFILE_BEGIN(cinfo, JPROF_MARKERS);
+  if (!(*cinfo->marker->read_restart_marker) (cinfo)) {
+    PROFILE_END(cinfo);
     return FALSE;
+  }
+  PROFILE_END(cinfo);
 
   /* Re-initialize DC predictions to 0 */
   for (ci = 0; ci < cinfo->comps_in_scan; ci++)
@@ -801,6 +845,93 @@ use_slow:
 }
 
 
+/*
+ * Scan forward through the entropy-coded data to the next marker without
+ * decoding it, and leave the marker code in cinfo->unread_marker (just as
+ * jpeg_fill_bit_buffer() does when it runs into a marker.)
+ * Returns FALSE if data source requested suspension.
+ */
+
+LOCAL(boolean)
+skip_to_marker(j_decompress_ptr cinfo)
+{
+  struct jpeg_source_mgr *src = cinfo->src;
+  const JOCTET *ptr;
+  int c;
+
+  while (cinfo->unread_marker == 0) {
+    if (src->bytes_in_buffer == 0) {
+      if (!(*src->fill_input_buffer) (cinfo))
+        return FALSE;
+    }
+    ptr = (const JOCTET *)memchr(src->next_input_byte, 0xFF,
+                                 src->bytes_in_buffer);
+    if (ptr == NULL) {
+      src->next_input_byte += src->bytes_in_buffer;
+      src->bytes_in_buffer = 0;
+      continue;
+    }
+    src->bytes_in_buffer -= (size_t)(ptr - src->next_input_byte) + 1;
+    src->next_input_byte = ptr + 1;
+    /* Found FF.  Skip any pad FFs, then check for a stuffed zero byte. */
+    do {
+      if (src->bytes_in_buffer == 0) {
+        if (!(*src->fill_input_buffer) (cinfo))
+          return FALSE;
+      }
+      src->bytes_in_buffer--;
+      c = GETJOCTET(*src->next_input_byte++);
+    } while (c == 0xFF);
+    if (c != 0)
+      cinfo->unread_marker = c;
+  }
+
+  return TRUE;
+}
+
+
+/*
+ * Skip up to num_MCUs MCUs without decoding them.  Since the DC predictions
+ * are reset at each restart marker, we can skip the remainder of a restart
+ * interval by simply searching for the marker that ends it.  Returns the
+ * number of MCUs skipped, which is 0 if the image has no restart markers.
+ * As with jpeg_skip_scanlines(), suspending data sources are not supported.
+ */
+
+METHODDEF(JDIMENSION)
+skip_mcus(j_decompress_ptr cinfo, JDIMENSION num_MCUs)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr)cinfo->entropy;
+  JDIMENSION skipped = 0;
+
+  if (!cinfo->restart_interval)
+    return 0;
+
+  while (!entropy->pub.insufficient_data) {
+    if (entropy->restarts_to_go == 0) {
+      if (!process_restart(cinfo))
+        break;
+      if (entropy->pub.insufficient_data)
+        break;
+    }
+    if (entropy->restarts_to_go > num_MCUs - skipped)
+      break;
+
+    /* Throw away the rest of this restart interval, including any unused
+     * bits in the bit buffer.  The next call to process_restart() will read
+     * the RSTn marker.
+     */
+    skipped += entropy->restarts_to_go;
+    entropy->restarts_to_go = 0;
+    entropy->bitstate.bits_left = 0;
+    if (!skip_to_marker(cinfo))
+      break;
+  }
+
+  return skipped;
+}
+
+
 /*
  * Module initialization routine for Huffman entropy decoding.
  */
@@ -823,6 +954,7 @@ jinit_huff_decoder(j_decompress_ptr cinfo)
   cinfo->entropy = (struct jpeg_entropy_decoder *)entropy;
   entropy->pub.start_pass = start_pass_huff_decoder;
   entropy->pub.decode_mcu = decode_mcu;
+  entropy->pub.skip_mcus = skip_mcus;
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
@@ -320,7 +320,9 @@ consume_markers(j_decompress_ptr cinfo)
   if (inputctl->pub.eoi_reached) /* After hitting EOI, read no further */
     return JPEG_REACHED_EOI;
 
+  PROFILE_BEGIN(cinfo, JPROF_MARKERS);
   val = (*cinfo->marker->read_markers) (cinfo);
+  PROFILE_END(cinfo);
 
   switch (val) {
   case JPEG_REACHED_SOS:        /* Found SOS */
@@ -376,6 +378,8 @@ reset_input_controller(j_decompress_ptr cinfo)
   (*cinfo->marker->reset_marker_reader) (cinfo);
   /* Reset progression state -- would be cleaner if entropy decoder did this */
   cinfo->coef_bits = NULL;
+  /* Forget any coefficient source that was used for the previous image */
+  cinfo->master->coef_source = NULL;
 }
 
 
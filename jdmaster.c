@@ -420,14 +420,21 @@ LOCAL(void)
 prepare_range_limit_table(j_decompress_ptr cinfo)
 /* Allocate and fill in the sample_range_limit table */
 {
+  my_master_ptr master = (my_master_ptr)cinfo->master;
   JSAMPLE *table;
   int i;
 
+  /* The table is the same for every image, so build it only once. */
+  if (master->sample_range_limit != NULL) {
+    cinfo->sample_range_limit = master->sample_range_limit;
+    return;
+  }
+
   table = (JSAMPLE *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                 (5 * (MAXJSAMPLE + 1) + CENTERJSAMPLE) * sizeof(JSAMPLE));
   table += (MAXJSAMPLE + 1);    /* allow negative subscripts of simple table */
-  cinfo->sample_range_limit = table;
+  cinfo->sample_range_limit = master->sample_range_limit = table;
   /* First segment of "simple" table: limit[x] = 0 for x < 0 */
   MEMZERO(table - (MAXJSAMPLE + 1), (MAXJSAMPLE + 1) * sizeof(JSAMPLE));
   /* Main part of "simple" table: limit[x] = x */
@@ -563,7 +570,8 @@ master_selection(j_decompress_ptr cinfo)
   }
 
   /* Initialize principal buffer controllers. */
-  use_c_buffer = cinfo->inputctl->has_multiple_scans || cinfo->buffered_image;
+  use_c_buffer = cinfo->inputctl->has_multiple_scans || cinfo->buffered_image ||
+                 cinfo->master->coef_source != NULL;
   jinit_d_coef_controller(cinfo, use_c_buffer);
 
   if (!cinfo->raw_data_out)
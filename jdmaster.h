@@ -23,6 +23,11 @@ typedef struct {
    */
   struct jpeg_color_quantizer *quantizer_1pass;
   struct jpeg_color_quantizer *quantizer_2pass;
+
+  /* Sample range limiting table (permanent lifespan, since it never
+   * changes)
+   */
+  JSAMPLE *sample_range_limit;
 } my_decomp_master;
 
 typedef my_decomp_master *my_master_ptr;
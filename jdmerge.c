@@ -190,21 +190,33 @@ LOCAL(void)
 build_ycc_rgb_table(j_decompress_ptr cinfo)
 {
   my_upsample_ptr upsample = (my_upsample_ptr)cinfo->upsample;
+  struct jpeg_decomp_master *master = cinfo->master;
   int i;
   JLONG x;
   SHIFT_TEMPS
 
-  upsample->Cr_r_tab = (int *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+  /* The tables never change, so they are built only once for each
+   * decompression object and shared by all images.
+   */
+  if (master->Cr_r_tab != NULL) {
+    upsample->Cr_r_tab = master->Cr_r_tab;
+    upsample->Cb_b_tab = master->Cb_b_tab;
+    upsample->Cr_g_tab = master->Cr_g_tab;
+    upsample->Cb_g_tab = master->Cb_g_tab;
+    return;
+  }
+
+  upsample->Cr_r_tab = master->Cr_r_tab = (int *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                 (MAXJSAMPLE + 1) * sizeof(int));
-  upsample->Cb_b_tab = (int *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+  upsample->Cb_b_tab = master->Cb_b_tab = (int *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                 (MAXJSAMPLE + 1) * sizeof(int));
-  upsample->Cr_g_tab = (JLONG *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+  upsample->Cr_g_tab = master->Cr_g_tab = (JLONG *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                 (MAXJSAMPLE + 1) * sizeof(JLONG));
-  upsample->Cb_g_tab = (JLONG *)
-    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_IMAGE,
+  upsample->Cb_g_tab = master->Cb_g_tab = (JLONG *)
+    (*cinfo->mem->alloc_small) ((j_common_ptr)cinfo, JPOOL_PERMANENT,
                                 (MAXJSAMPLE + 1) * sizeof(JLONG));
 
   for (i = 0, x = -CENTERJSAMPLE; i <= MAXJSAMPLE; i++, x++) {
@@ -285,8 +297,12 @@ merged_2v_upsample(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
       work_ptrs[1] = upsample->spare_row;
       upsample->spare_full = TRUE;
     }
-    /* Now do the upsampling. */
+    /* Now do the upsampling.  Merged upsampling is mostly color conversion
+     * work, so it is profiled as such.
+     */
+    PROFILE_BEGIN(cinfo, JPROF_COLOR);
     (*upsample->upmethod) (cinfo, input_buf, *in_row_group_ctr, work_ptrs);
+    PROFILE_END(cinfo);
   }
 
   /* Adjust counts */
@@ -308,8 +324,10 @@ merged_1v_upsample(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
   my_upsample_ptr upsample = (my_upsample_ptr)cinfo->upsample;
 
   /* Just do the upsampling. */
+  PROFILE_BEGIN(cinfo, JPROF_COLOR);
   (*upsample->upmethod) (cinfo, input_buf, *in_row_group_ctr,
                          output_buf + *out_row_ctr);
+  PROFILE_END(cinfo);
   /* Adjust counts */
   (*out_row_ctr)++;
   (*in_row_group_ctr)++;
@@ -250,8 +250,12 @@ process_restart(j_decompress_ptr cinfo)
   entropy->bitstate.bits_left = 0;
 
   /* Advance past the RSTn marker */
-  if (!(*cinfo->marker->read_restart_marker) (cinfo))
+  PROFILE_BEGIN(cinfo, JPROF_MARKERS);
+  if (!(*cinfo->marker->read_restart_marker) (cinfo)) {
+    PROFILE_END(cinfo);
     return FALSE;
+  }
+  PROFILE_END(cinfo);
 
   /* Re-initialize DC predictions to 0 */
   for (ci = 0; ci < cinfo->comps_in_scan; ci++)
@@ -667,6 +671,7 @@ jinit_phuff_decoder(j_decompress_ptr cinfo)
                                 sizeof(phuff_entropy_decoder));
   cinfo->entropy = (struct jpeg_entropy_decoder *)entropy;
   entropy->pub.start_pass = start_pass_phuff_decoder;
+  entropy->pub.skip_mcus = NULL;
 
   /* Mark derived tables unallocated */
   for (i = 0; i < NUM_HUFF_TBLS; i++) {
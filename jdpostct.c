@@ -147,9 +147,11 @@ post_process_1pass(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
                                 in_row_groups_avail, post->buffer, &num_rows,
                                 max_rows);
   /* Quantize and emit data. */
+  PROFILE_BEGIN(cinfo, JPROF_QUANTIZE);
   (*cinfo->cquantize->color_quantize) (cinfo, post->buffer,
                                        output_buf + *out_row_ctr,
                                        (int)num_rows);
+  PROFILE_END(cinfo);
   *out_row_ctr += num_rows;
 }
 
@@ -186,8 +188,10 @@ post_process_prepass(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
   /* but we advance out_row_ctr so outer loop can tell when we're done. */
   if (post->next_row > old_next_row) {
     num_rows = post->next_row - old_next_row;
+    PROFILE_BEGIN(cinfo, JPROF_QUANTIZE);
     (*cinfo->cquantize->color_quantize) (cinfo, post->buffer + old_next_row,
                                          (JSAMPARRAY)NULL, (int)num_rows);
+    PROFILE_END(cinfo);
     *out_row_ctr += num_rows;
   }
 
@@ -230,9 +234,11 @@ post_process_2pass(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
     num_rows = max_rows;
 
   /* Quantize and emit data. */
+  PROFILE_BEGIN(cinfo, JPROF_QUANTIZE);
   (*cinfo->cquantize->color_quantize) (cinfo, post->buffer + post->next_row,
                                        output_buf + *out_row_ctr,
                                        (int)num_rows);
+  PROFILE_END(cinfo);
   *out_row_ctr += num_rows;
 
   /* Advance if we filled the strip. */
@@ -69,6 +69,7 @@ sep_upsample(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
 
   /* Fill the conversion buffer, if it's empty */
   if (upsample->next_row_out >= cinfo->max_v_samp_factor) {
+    PROFILE_BEGIN(cinfo, JPROF_SAMPLING);
     for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
          ci++, compptr++) {
       /* Invoke per-component upsample method.  Notice we pass a POINTER
@@ -78,6 +79,7 @@ sep_upsample(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
         input_buf[ci] + (*in_row_group_ctr * upsample->rowgroup_height[ci]),
         upsample->color_buf + ci);
     }
+    PROFILE_END(cinfo);
     upsample->next_row_out = 0;
   }
 
@@ -95,9 +97,11 @@ sep_upsample(j_decompress_ptr cinfo, JSAMPIMAGE input_buf,
   if (num_rows > out_rows_avail)
     num_rows = out_rows_avail;
 
+  PROFILE_BEGIN(cinfo, JPROF_COLOR);
   (*cinfo->cconvert->color_convert) (cinfo, upsample->color_buf,
                                      (JDIMENSION)upsample->next_row_out,
                                      output_buf + *out_row_ctr, (int)num_rows);
+  PROFILE_END(cinfo);
 
   /* Adjust counts */
   *out_row_ctr += num_rows;
@@ -145,6 +145,11 @@ typedef struct {
    * array routines.
    */
   JDIMENSION last_rowsperchunk; /* from most recent alloc_sarray/barray */
+
+  /* Keep whole-image coefficient arrays packed in memory when decompressing
+   * (set from the JPEGPACKCOEF environment variable.)
+   */
+  boolean pack_coef_arrays;
 } my_memory_mgr;
 
 typedef my_memory_mgr *my_mem_ptr;
@@ -173,6 +178,21 @@ struct jvirt_sarray_control {
   backing_store_info b_s_info;  /* System-dependent control info */
 };
 
+/*
+ * A packed coefficient row holds, for each block in the row, DCTSIZE mask
+ * bytes (bit j of byte i is set if coefficient i*DCTSIZE+j is nonzero)
+ * followed by the nonzero coefficients in natural order.
+ */
+
+typedef struct {
+  JOCTET *data;                 /* packed row, or NULL if row is all zero */
+  size_t size;                  /* bytes of packed data in use */
+  size_t capacity;              /* bytes allocated at data */
+  boolean dirty;                /* must the unpacked row be repacked? */
+} packed_row_info;
+
+typedef packed_row_info *packed_row_ptr;
+
 struct jvirt_barray_control {
   JBLOCKARRAY mem_buffer;       /* => the in-memory buffer */
   JDIMENSION rows_in_array;     /* total virtual array height */
@@ -187,6 +207,9 @@ struct jvirt_barray_control {
   boolean b_s_open;             /* is backing-store data valid? */
   jvirt_barray_ptr next;        /* link to next virtual barray control block */
   backing_store_info b_s_info;  /* System-dependent control info */
+  packed_row_ptr packed_rows;   /* packed copy of each row, if not NULL */
+  JOCTET *pack_buffer;          /* workspace for packing one row */
+  JBLOCKARRAY spare_rows;       /* workspace for sliding the window */
 };
 
 
@@ -627,6 +650,7 @@ request_virt_barray(j_common_ptr cinfo, int pool_id, boolean pre_zero,
   result->maxaccess = maxaccess;
   result->pre_zero = pre_zero;
   result->b_s_open = FALSE;     /* no associated backing-store object */
+  result->packed_rows = NULL;   /* rows are not packed */
   result->next = mem->virt_barray_list; /* add to list of virtual arrays */
   mem->virt_barray_list = result;
 
@@ -644,6 +668,40 @@ realize_virt_arrays(j_common_ptr cinfo)
   jvirt_sarray_ptr sptr;
   jvirt_barray_ptr bptr;
 
+  /* When packing is enabled, the whole-image coefficient arrays of a
+   * multi-scan decompressor need only a window of maxaccess unpacked rows.
+   * The packed copies are allocated as they are written, so these arrays
+   * do not take part in the space computation below.  In buffered-image
+   * mode (which includes transcoding), the application may access the
+   * arrays in arbitrary order, so we leave them alone.
+   */
+  if (mem->pack_coef_arrays && cinfo->is_decompressor &&
+      !((j_decompress_ptr)cinfo)->buffered_image) {
+    for (bptr = mem->virt_barray_list; bptr != NULL; bptr = bptr->next) {
+      if (bptr->mem_buffer == NULL && /* if not realized yet */
+          bptr->rows_in_array > bptr->maxaccess) {
+        bptr->rows_in_mem = bptr->maxaccess;
+        bptr->mem_buffer = alloc_barray(cinfo, JPOOL_IMAGE,
+                                        bptr->blocksperrow, bptr->rows_in_mem);
+        bptr->rowsperchunk = mem->last_rowsperchunk;
+        bptr->packed_rows = (packed_row_ptr)
+          alloc_large(cinfo, JPOOL_IMAGE,
+                      (size_t)bptr->rows_in_array * sizeof(packed_row_info));
+        jzero_far((void *)bptr->packed_rows,
+                  (size_t)bptr->rows_in_array * sizeof(packed_row_info));
+        bptr->pack_buffer = (JOCTET *)
+          alloc_large(cinfo, JPOOL_IMAGE, (size_t)bptr->blocksperrow *
+                                          (DCTSIZE + sizeof(JBLOCK)));
+        bptr->spare_rows = (JBLOCKARRAY)
+          alloc_small(cinfo, JPOOL_IMAGE,
+                      2 * (size_t)bptr->rows_in_mem * sizeof(JBLOCKROW));
+        bptr->cur_start_row = 0;
+        bptr->first_undef_row = 0;
+        bptr->dirty = FALSE;
+      }
+    }
+  }
+
   /* Compute the minimum space needed (maxaccess rows in each buffer)
    * and the maximum space needed (full image height in each buffer).
    * These may be of use to the system-dependent jpeg_mem_available routine.
@@ -737,6 +795,30 @@ realize_virt_arrays(j_common_ptr cinfo)
                                 (long)bptr->blocksperrow *
                                 (long)sizeof(JBLOCK));
         bptr->b_s_open = TRUE;
+        if (bptr->b_s_info.mapping != NULL) {
+          /* The backing store is memory-mapped, so rather than swapping
+           * strips of the array in and out of an in-memory buffer, point the
+           * rows directly into the mapping and let the operating system page
+           * them in and out on demand.  Coefficient rows are always a
+           * multiple of ALIGN_SIZE bytes, so each row remains aligned.
+           */
+          JBLOCKROW workspace = (JBLOCKROW)bptr->b_s_info.mapping;
+          JDIMENSION row;
+
+          bptr->rows_in_mem = bptr->rows_in_array;
+          bptr->mem_buffer = (JBLOCKARRAY)
+            alloc_small(cinfo, JPOOL_IMAGE,
+                        (size_t)bptr->rows_in_array * sizeof(JBLOCKROW));
+          for (row = 0; row < bptr->rows_in_array; row++) {
+            bptr->mem_buffer[row] = workspace;
+            workspace += bptr->blocksperrow;
+          }
+          bptr->rowsperchunk = bptr->rows_in_array;
+          bptr->cur_start_row = 0;
+          bptr->first_undef_row = 0;
+          bptr->dirty = FALSE;
+          continue;
+        }
       }
       bptr->mem_buffer = alloc_barray(cinfo, JPOOL_IMAGE,
                                       bptr->blocksperrow, bptr->rows_in_mem);
@@ -815,6 +897,149 @@ do_barray_io(j_common_ptr cinfo, jvirt_barray_ptr ptr, boolean writing)
 }
 
 
+LOCAL(void)
+pack_barray_row(j_common_ptr cinfo, jvirt_barray_ptr ptr, JBLOCKROW blockrow,
+                packed_row_ptr prow)
+/* Pack one row of a virtual coefficient-block array */
+{
+  my_mem_ptr mem = (my_mem_ptr)cinfo->mem;
+  JOCTET *outptr = ptr->pack_buffer;
+  JDIMENSION blockn;
+  size_t size;
+  int i, j;
+
+  for (blockn = 0; blockn < ptr->blocksperrow; blockn++) {
+    JCOEFPTR inptr = blockrow[blockn];
+    JOCTET *maskptr = outptr;
+    JCOEF *coefptr = (JCOEF *)(outptr + DCTSIZE);
+
+    for (i = 0; i < DCTSIZE; i++, inptr += DCTSIZE) {
+      int mask = 0;
+
+      /* Most rows of high-frequency coefficients are entirely zero. */
+      if ((inptr[0] | inptr[1] | inptr[2] | inptr[3] | inptr[4] | inptr[5] |
+           inptr[6] | inptr[7]) != 0) {
+        /* Store each coefficient unconditionally, but advance the output
+         * pointer only past nonzero ones.  This avoids a data-dependent
+         * branch per coefficient.
+         */
+        for (j = 0; j < DCTSIZE; j++) {
+          JCOEF coef = inptr[j];
+
+          *coefptr = coef;
+          coefptr += (coef != 0);
+          mask |= (coef != 0) << j;
+        }
+      }
+      maskptr[i] = (JOCTET)mask;
+    }
+    outptr = (JOCTET *)coefptr;
+  }
+  size = (size_t)(outptr - ptr->pack_buffer);
+
+  /* unpack_barray_row() may read one JCOEF past the end of the packed data */
+  if (size + sizeof(JCOEF) > prow->capacity) {
+    /* Leave some headroom, since later scans will add more coefficients */
+    size_t capacity = size + size / 8 + sizeof(JCOEF);
+
+    if (prow->data != NULL) {
+      jpeg_free_large(cinfo, (void *)prow->data, prow->capacity);
+      mem->total_space_allocated -= prow->capacity;
+      prow->data = NULL;
+      prow->capacity = 0;
+    }
+    prow->data = (JOCTET *)jpeg_get_large(cinfo, capacity);
+    if (prow->data == NULL)
+      out_of_memory(cinfo, 12); /* jpeg_get_large failed */
+    mem->total_space_allocated += capacity;
+    prow->capacity = capacity;
+  }
+  MEMCOPY(prow->data, ptr->pack_buffer, size);
+  prow->size = size;
+  prow->dirty = FALSE;
+}
+
+
+LOCAL(void)
+unpack_barray_row(jvirt_barray_ptr ptr, JBLOCKROW blockrow,
+                  packed_row_ptr prow)
+/* Unpack one row of a virtual coefficient-block array */
+{
+  const JOCTET *inptr = prow->data;
+  JDIMENSION blockn;
+  int i, j;
+
+  if (inptr == NULL) {          /* row was never packed, so it is all zero */
+    jzero_far((void *)blockrow[0],
+              (size_t)ptr->blocksperrow * sizeof(JBLOCK));
+    return;
+  }
+
+  for (blockn = 0; blockn < ptr->blocksperrow; blockn++) {
+    JCOEFPTR outptr = blockrow[blockn];
+    const JCOEF *coefptr = (const JCOEF *)(inptr + DCTSIZE);
+
+    for (i = 0; i < DCTSIZE; i++, outptr += DCTSIZE) {
+      int mask = inptr[i];
+
+      if (mask == 0) {
+        for (j = 0; j < DCTSIZE; j++)
+          outptr[j] = 0;
+        continue;
+      }
+      /* As in pack_barray_row(), avoid a data-dependent branch per
+       * coefficient.  This may read one JCOEF past the end of the packed
+       * data, so pack_barray_row() always allocates that much extra.
+       */
+      for (j = 0; j < DCTSIZE; j++, mask >>= 1) {
+        outptr[j] = (JCOEF)(*coefptr & -(mask & 1));
+        coefptr += (mask & 1);
+      }
+    }
+    inptr = (const JOCTET *)coefptr;
+  }
+}
+
+
+LOCAL(void)
+slide_packed_barray(j_common_ptr cinfo, jvirt_barray_ptr ptr,
+                    JDIMENSION old_start_row)
+/* Move the in-memory window of a packed virtual coefficient-block array from
+ * old_start_row to cur_start_row.  Rows that remain in the window are kept as
+ * they are, rows that leave it are packed (if they were modified), and rows
+ * that enter it are unpacked.
+ */
+{
+  JDIMENSION new_start_row = ptr->cur_start_row;
+  JDIMENSION rows_in_mem = ptr->rows_in_mem;
+  JBLOCKARRAY new_buffer = ptr->spare_rows;
+  JBLOCKARRAY free_rows = ptr->spare_rows + rows_in_mem;
+  JDIMENSION i, row, num_free = 0;
+
+  for (i = 0; i < rows_in_mem; i++)
+    new_buffer[i] = NULL;
+  for (i = 0, row = old_start_row; i < rows_in_mem; i++, row++) {
+    if (row >= new_start_row && row - new_start_row < rows_in_mem) {
+      new_buffer[row - new_start_row] = ptr->mem_buffer[i];
+    } else {
+      if (row < ptr->rows_in_array && ptr->packed_rows[row].dirty)
+        pack_barray_row(cinfo, ptr, ptr->mem_buffer[i],
+                        &ptr->packed_rows[row]);
+      free_rows[num_free++] = ptr->mem_buffer[i];
+    }
+  }
+  for (i = 0, row = new_start_row; i < rows_in_mem; i++, row++) {
+    if (new_buffer[i] == NULL) {
+      new_buffer[i] = free_rows[--num_free];
+      /* Rows past first_undef_row are undefined, so don't bother */
+      if (row < ptr->first_undef_row && row < ptr->rows_in_array)
+        unpack_barray_row(ptr, new_buffer[i], &ptr->packed_rows[row]);
+    }
+    ptr->mem_buffer[i] = new_buffer[i];
+  }
+}
+
+
 METHODDEF(JSAMPARRAY)
 access_virt_sarray(j_common_ptr cinfo, jvirt_sarray_ptr ptr,
                    JDIMENSION start_row, JDIMENSION num_rows, boolean writable)
@@ -917,12 +1142,16 @@ access_virt_barray(j_common_ptr cinfo, jvirt_barray_ptr ptr,
   /* Make the desired part of the virtual array accessible */
   if (start_row < ptr->cur_start_row ||
       end_row > ptr->cur_start_row + ptr->rows_in_mem) {
-    if (!ptr->b_s_open)
-      ERREXIT(cinfo, JERR_VIRTUAL_BUG);
-    /* Flush old buffer contents if necessary */
-    if (ptr->dirty) {
-      do_barray_io(cinfo, ptr, TRUE);
-      ptr->dirty = FALSE;
+    JDIMENSION old_start_row = ptr->cur_start_row;
+
+    if (ptr->packed_rows == NULL) {
+      if (!ptr->b_s_open)
+        ERREXIT(cinfo, JERR_VIRTUAL_BUG);
+      /* Flush old buffer contents if necessary */
+      if (ptr->dirty) {
+        do_barray_io(cinfo, ptr, TRUE);
+        ptr->dirty = FALSE;
+      }
     }
     /* Decide what part of virtual array to access.
      * Algorithm: if target address > current window, assume forward scan,
@@ -946,7 +1175,10 @@ access_virt_barray(j_common_ptr cinfo, jvirt_barray_ptr ptr,
      * During the initial write pass, we will do no actual read
      * because the selected part is all undefined.
      */
-    do_barray_io(cinfo, ptr, FALSE);
+    if (ptr->packed_rows != NULL)
+      slide_packed_barray(cinfo, ptr, old_start_row);
+    else
+      do_barray_io(cinfo, ptr, FALSE);
   }
   /* Ensure the accessed part of the array is defined; prezero if needed.
    * To improve locality of access, we only prezero the part of the array
@@ -976,8 +1208,15 @@ access_virt_barray(j_common_ptr cinfo, jvirt_barray_ptr ptr,
     }
   }
   /* Flag the buffer dirty if caller will write in it */
-  if (writable)
+  if (writable) {
     ptr->dirty = TRUE;
+    if (ptr->packed_rows != NULL) {
+      JDIMENSION row;
+
+      for (row = start_row; row < start_row + num_rows; row++)
+        ptr->packed_rows[row].dirty = TRUE;
+    }
+  }
   /* Return address of proper part of the buffer */
   return ptr->mem_buffer + (start_row - ptr->cur_start_row);
 }
@@ -1020,6 +1259,19 @@ free_pool(j_common_ptr cinfo, int pool_id)
         bptr->b_s_open = FALSE; /* prevent recursive close if error */
         (*bptr->b_s_info.close_backing_store) (cinfo, &bptr->b_s_info);
       }
+      if (bptr->packed_rows != NULL) {
+        JDIMENSION row;
+
+        for (row = 0; row < bptr->rows_in_array; row++) {
+          packed_row_ptr prow = &bptr->packed_rows[row];
+
+          if (prow->data != NULL) {
+            jpeg_free_large(cinfo, (void *)prow->data, prow->capacity);
+            mem->total_space_allocated -= prow->capacity;
+          }
+        }
+        bptr->packed_rows = NULL;
+      }
     }
     mem->virt_barray_list = NULL;
   }
@@ -1176,4 +1428,17 @@ jinit_memory_mgr(j_common_ptr cinfo)
   }
 #endif
 
+  /* Check for an environment variable JPEGPACKCOEF; if set to 1, keep the
+   * whole-image coefficient arrays of multi-scan decompressors packed in
+   * memory, which trades some CPU time for a large reduction in memory use.
+   */
+  mem->pack_coef_arrays = FALSE;
+#ifndef NO_GETENV
+  {
+    char *env;
+
+    if ((env = getenv("JPEGPACKCOEF")) != NULL && !strcmp(env, "1"))
+      mem->pack_coef_arrays = TRUE;
+  }
+#endif
 }
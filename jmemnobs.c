@@ -9,18 +9,32 @@
  * file.
  *
  * This file provides a really simple implementation of the system-
- * dependent portion of the JPEG memory manager.  This implementation
- * assumes that no backing-store files are needed: all required space
- * can be obtained from malloc().
+ * dependent portion of the JPEG memory manager.  All required space is
+ * obtained from malloc(), and unless the application limits the amount of
+ * memory that the library may use (by setting max_memory_to_use or the
+ * JPEGMEM environment variable), no backing-store files are needed.
  * This is very portable in the sense that it'll compile on almost anything,
  * but you'd better have lots of main memory (or virtual memory) if you want
- * to process big images.
+ * to process big images without a memory limit.
+ *
+ * If a memory limit is set, virtual arrays that don't fit within it are
+ * stored in an anonymous temporary file.  Where mmap() is available, the
+ * file is mapped into memory, so swapping part of an array in or out is
+ * just a memcpy() and the operating system is free to write the pages back
+ * to disk and reclaim them whenever it needs to.  Otherwise, the file is
+ * accessed through stdio, as in the IJG's jmemansi.c.
  */
 
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jmemsys.h"            /* import the system-dependent declarations */
+#include "jconfigint.h"
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #ifndef HAVE_STDLIB_H           /* <stdlib.h> should declare malloc(),free() */
 extern void *malloc(size_t size);
@@ -85,15 +99,141 @@ jpeg_mem_available(j_common_ptr cinfo, size_t min_bytes_needed,
 
 /*
  * Backing store (temporary file) management.
- * Since jpeg_mem_available always promised the moon,
- * this should never be called and we can just error out.
+ * This is only called if jpeg_mem_available() had to turn down a request
+ * because of max_memory_to_use.
+ */
+
+METHODDEF(void)
+read_backing_store(j_common_ptr cinfo, backing_store_ptr info,
+                   void *buffer_address, long file_offset, long byte_count)
+{
+  if (fseek(info->temp_file, file_offset, SEEK_SET))
+    ERREXIT(cinfo, JERR_TFILE_SEEK);
+  if (JFREAD(info->temp_file, buffer_address, byte_count) !=
+      (size_t)byte_count)
+    ERREXIT(cinfo, JERR_TFILE_READ);
+}
+
+
+METHODDEF(void)
+write_backing_store(j_common_ptr cinfo, backing_store_ptr info,
+                    void *buffer_address, long file_offset, long byte_count)
+{
+  if (fseek(info->temp_file, file_offset, SEEK_SET))
+    ERREXIT(cinfo, JERR_TFILE_SEEK);
+  if (JFWRITE(info->temp_file, buffer_address, byte_count) !=
+      (size_t)byte_count)
+    ERREXIT(cinfo, JERR_TFILE_WRITE);
+}
+
+
+METHODDEF(void)
+close_backing_store(j_common_ptr cinfo, backing_store_ptr info)
+{
+  fclose(info->temp_file);
+}
+
+
+#ifdef HAVE_MMAP
+
+/*
+ * Memory-mapped backing store.  The read/write routines never see an offset
+ * beyond the size passed to jpeg_open_backing_store(), but we check anyway so
+ * that a bug in jmemmgr.c can't scribble outside of the mapping.
+ */
+
+METHODDEF(void)
+read_mapped_store(j_common_ptr cinfo, backing_store_ptr info,
+                  void *buffer_address, long file_offset, long byte_count)
+{
+  if (file_offset < 0 || byte_count < 0 ||
+      (size_t)file_offset + (size_t)byte_count > info->mapping_size)
+    ERREXIT(cinfo, JERR_TFILE_READ);
+  MEMCOPY(buffer_address, info->mapping + file_offset, byte_count);
+}
+
+
+METHODDEF(void)
+write_mapped_store(j_common_ptr cinfo, backing_store_ptr info,
+                   void *buffer_address, long file_offset, long byte_count)
+{
+  if (file_offset < 0 || byte_count < 0 ||
+      (size_t)file_offset + (size_t)byte_count > info->mapping_size)
+    ERREXIT(cinfo, JERR_TFILE_WRITE);
+  MEMCOPY(info->mapping + file_offset, buffer_address, byte_count);
+}
+
+
+METHODDEF(void)
+close_mapped_store(j_common_ptr cinfo, backing_store_ptr info)
+{
+  munmap(info->mapping, info->mapping_size);
+  info->mapping = NULL;
+}
+
+
+/*
+ * Create an unlinked temporary file in $TMPDIR (or /tmp), size it, and map it.
+ * Returns FALSE, leaving nothing open, if any step fails, so that the caller
+ * can fall back to stdio.
  */
 
+LOCAL(boolean)
+open_mapped_store(j_common_ptr cinfo, backing_store_ptr info,
+                  long total_bytes_needed)
+{
+  const char *tmpdir = getenv("TMPDIR");
+  void *mapping;
+  int fd;
+
+  if (total_bytes_needed <= 0)
+    return FALSE;
+  if (tmpdir == NULL || *tmpdir == '\0')
+    tmpdir = "/tmp";
+  if (strlen(tmpdir) + 16 > TEMP_NAME_LENGTH)
+    return FALSE;
+  snprintf(info->temp_name, TEMP_NAME_LENGTH, "%s/jpegXXXXXX", tmpdir);
+
+  if ((fd = mkstemp(info->temp_name)) < 0)
+    return FALSE;
+  unlink(info->temp_name);    /* file goes away when the mapping does */
+  if (ftruncate(fd, (off_t)total_bytes_needed) < 0) {
+    close(fd);
+    return FALSE;
+  }
+  mapping = mmap(NULL, (size_t)total_bytes_needed, PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED)
+    return FALSE;
+
+  info->mapping = (char *)mapping;
+  info->mapping_size = (size_t)total_bytes_needed;
+  info->read_backing_store = read_mapped_store;
+  info->write_backing_store = write_mapped_store;
+  info->close_backing_store = close_mapped_store;
+  TRACEMSS(cinfo, 1, JTRC_TFILE_OPEN, info->temp_name);
+  return TRUE;
+}
+
+#endif /* HAVE_MMAP */
+
+
 GLOBAL(void)
 jpeg_open_backing_store(j_common_ptr cinfo, backing_store_ptr info,
                         long total_bytes_needed)
 {
-  ERREXIT(cinfo, JERR_NO_BACKING_STORE);
+#ifdef HAVE_MMAP
+  if (open_mapped_store(cinfo, info, total_bytes_needed))
+    return;
+#endif
+
+  info->mapping = NULL;
+  if ((info->temp_file = tmpfile()) == NULL)
+    ERREXITS(cinfo, JERR_TFILE_CREATE, "");
+  info->read_backing_store = read_backing_store;
+  info->write_backing_store = write_backing_store;
+  info->close_backing_store = close_backing_store;
 }
 
 
@@ -144,6 +144,12 @@ typedef struct backing_store_struct {
   /* For a typical implementation with temp files, we need: */
   FILE *temp_file;              /* stdio reference to temp file */
   char temp_name[TEMP_NAME_LENGTH]; /* name of temp file */
+  /* If the temp file is memory-mapped, jmemmgr.c may access coefficient
+   * arrays directly through the mapping rather than swapping them in and
+   * out.  Implementations that don't map the file must set mapping to NULL.
+   */
+  char *mapping;                /* address of mapped temp file, or NULL */
+  size_t mapping_size;          /* size of mapping in bytes */
 #endif
 #endif
 } backing_store_info;
@@ -58,6 +58,19 @@ typedef long JLONG;
 
 /* Declarations for compression modules */
 
+/* Least-recently-used cache of tables derived from JPEG tables (see
+ * jtbl_cache_lookup() in jutils.c)
+ */
+typedef struct {
+  boolean valid;                /* TRUE if the derived table is valid */
+  unsigned int last_used;       /* value of use_counter at last lookup */
+} jtbl_cache_entry;
+
+typedef struct {
+  unsigned int use_counter;     /* incremented with each lookup */
+  JOCTET *entries;              /* array of module-specific entries */
+} jtbl_cache;
+
 /* Master control module */
 struct jpeg_comp_master {
   void (*prepare_for_pass) (j_compress_ptr cinfo);
@@ -67,6 +80,14 @@ struct jpeg_comp_master {
   /* State variables made visible to other modules */
   boolean call_pass_startup;    /* True if pass_startup must be called */
   boolean is_last_pass;         /* True during last pass */
+  boolean single_pass_optimize; /* True if Huffman optimization is done by
+                                   recording symbols, not coefficients */
+
+  /* Per-instance caches (these have permanent lifespan) */
+  jtbl_cache *dc_huff_tbl_cache; /* derived DC Huffman tables */
+  jtbl_cache *ac_huff_tbl_cache; /* derived AC Huffman tables */
+  jtbl_cache *divisor_cache;    /* quantization divisors */
+  struct jpeg_profiler *profiler; /* per-stage timing counters, if enabled */
 };
 
 /* Main buffer control (downsampled-data buffer) */
@@ -158,6 +179,20 @@ struct jpeg_decomp_master {
   JDIMENSION first_MCU_col[MAX_COMPONENTS];
   JDIMENSION last_MCU_col[MAX_COMPONENTS];
   boolean jinit_upsampler_no_alloc;
+
+  /* Decompressor whose coefficient arrays are to be decompressed instead of
+   * the JPEG data stream (see jpeg_coef_source_tj())
+   */
+  j_decompress_ptr coef_source;
+
+  /* Per-instance caches (these have permanent lifespan) */
+  jtbl_cache *dc_huff_tbl_cache; /* derived DC Huffman tables */
+  jtbl_cache *ac_huff_tbl_cache; /* derived AC Huffman tables */
+  int *Cr_r_tab;                /* YCC->RGB conversion tables (shared by */
+  int *Cb_b_tab;                /* color deconverter & merged upsampler) */
+  JLONG *Cr_g_tab;
+  JLONG *Cb_g_tab;
+  struct jpeg_profiler *profiler; /* per-stage timing counters, if enabled */
 };
 
 /* Input control module */
@@ -223,6 +258,9 @@ struct jpeg_marker_reader {
 struct jpeg_entropy_decoder {
   void (*start_pass) (j_decompress_ptr cinfo);
   boolean (*decode_mcu) (j_decompress_ptr cinfo, JBLOCKROW *MCU_data);
+  /* Skip up to num_MCUs MCUs without decoding them, if restart markers make
+   * that possible, and return the number skipped.  May be NULL. */
+  JDIMENSION (*skip_mcus) (j_decompress_ptr cinfo, JDIMENSION num_MCUs);
 
   /* This is here to share code between baseline and progressive decoders; */
   /* other modules probably should not use it */
@@ -349,6 +387,42 @@ EXTERN(void) jcopy_sample_rows(JSAMPARRAY input_array, int source_row,
 EXTERN(void) jcopy_block_row(JBLOCKROW input_row, JBLOCKROW output_row,
                              JDIMENSION num_blocks);
 EXTERN(void) jzero_far(void *target, size_t bytestozero);
+EXTERN(void *) jtbl_cache_lookup(j_common_ptr cinfo, jtbl_cache **cachep,
+                                 int num_entries, size_t entry_size,
+                                 size_t key_offset, const void *key,
+                                 size_t key_size);
+
+/* Per-stage timing instrumentation in jcomapi.c.  Stages can nest (for
+ * instance, restart markers are read from within the entropy decoder), in
+ * which case the time spent in the inner stage is not charged to the outer
+ * stage.
+ */
+#define JPROF_MAX_DEPTH  4
+
+struct jpeg_profiler {
+  jpeg_stage_profile stages[JPROF_NUMSTAGES];
+  int stack[JPROF_MAX_DEPTH];   /* stages being timed, innermost last */
+  int depth;                    /* number of entries in stack[] */
+  unsigned long long mark;      /* tick count at the last stage transition */
+  boolean enabled;              /* FALSE if profiling has been disabled */
+};
+
+#ifdef PROFILE_SUPPORTED
+EXTERN(void) jprofile_begin(struct jpeg_profiler *profiler,
+                            J_PROFILE_STAGE stage);
+EXTERN(void) jprofile_end(struct jpeg_profiler *profiler);
+
+#define PROFILE_BEGIN(cinfo, stage) \
+  ((cinfo)->master->profiler ? \
+   jprofile_begin((cinfo)->master->profiler, stage) : (void)0)
+#define PROFILE_END(cinfo) \
+  ((cinfo)->master->profiler ? jprofile_end((cinfo)->master->profiler) : \
+   (void)0)
+#else
+#define PROFILE_BEGIN(cinfo, stage)  ((void)0)
+#define PROFILE_END(cinfo)  ((void)0)
+#endif
+
 /* Constant tables in jutils.c */
 #if 0                           /* This table is not actually needed in v6a */
 extern const int jpeg_zigzag_order[]; /* natural coef order to zigzag order */
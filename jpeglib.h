@@ -924,6 +924,30 @@ EXTERN(void) jpeg_mem_src(j_decompress_ptr cinfo,
                           const unsigned char *inbuffer, unsigned long insize);
 #endif
 
+/* Data destination managers (libjpeg-turbo extensions): a list of fixed-size
+ * memory chunks, or an application-supplied write function.  See libjpeg.txt.
+ */
+typedef struct {
+  JOCTET *data;                 /* start of chunk (allocated with malloc()) */
+  size_t size;                  /* # of bytes of JPEG data in chunk */
+} jpeg_chunk;
+
+typedef struct {
+  jpeg_chunk *chunks;           /* array of chunks (allocated with malloc()) */
+  size_t num_chunks;            /* # of chunks in array */
+  size_t total_size;            /* total # of bytes of JPEG data */
+  size_t chunk_size;            /* capacity of each chunk (0 = default) */
+  size_t max_chunks;            /* allocated length of array (private) */
+} jpeg_chunk_list;
+
+typedef boolean (*jpeg_write_method) (j_compress_ptr cinfo,
+                                      const JOCTET *data, size_t size);
+
+EXTERN(void) jpeg_chunk_dest(j_compress_ptr cinfo, jpeg_chunk_list *list);
+EXTERN(void) jpeg_free_chunks(jpeg_chunk_list *list);
+EXTERN(void) jpeg_callback_dest(j_compress_ptr cinfo,
+                                jpeg_write_method write_data);
+
 /* Default parameter setup for compression */
 EXTERN(void) jpeg_set_defaults(j_compress_ptr cinfo);
 /* Compression parameter setup aids */
@@ -1067,6 +1091,29 @@ EXTERN(boolean) jpeg_read_icc_profile(j_decompress_ptr cinfo,
                                       JOCTET **icc_data_ptr,
                                       unsigned int *icc_data_len);
 
+/* Per-stage timing instrumentation (libjpeg-turbo extension.)  This is
+ * available only if the library was built with PROFILE_SUPPORTED.  See
+ * libjpeg.txt for usage information.
+ */
+#define JPROF_NUMSTAGES  6
+
+typedef enum {
+  JPROF_MARKERS,                /* Marker reading or writing */
+  JPROF_ENTROPY,                /* Entropy decoding or encoding */
+  JPROF_DCT,                    /* Inverse DCT, or forward DCT + quantization */
+  JPROF_SAMPLING,               /* Upsampling or downsampling */
+  JPROF_COLOR,                  /* Color conversion */
+  JPROF_QUANTIZE                /* Color quantization */
+} J_PROFILE_STAGE;
+
+typedef struct {
+  unsigned long long ticks;     /* Time spent in the stage, in timer ticks */
+  unsigned long calls;          /* Number of times the stage was entered */
+} jpeg_stage_profile;
+
+EXTERN(boolean) jpeg_enable_profiling(j_common_ptr cinfo, boolean enable);
+EXTERN(void) jpeg_get_profile(j_common_ptr cinfo, jpeg_stage_profile *stages);
+
 
 /* These marker codes are exported since applications and data source modules
  * are likely to want to use them.
@@ -74,6 +74,7 @@ usage(void)
   fprintf(stderr, "  -flip [horizontal|vertical]  Mirror image (left-right or top-bottom)\n");
   fprintf(stderr, "  -perfect       Fail if there is non-transformable edge blocks\n");
   fprintf(stderr, "  -rotate [90|180|270]         Rotate image (degrees clockwise)\n");
+  fprintf(stderr, "  -scale 1/N     Downscale image by 1/N (N = 2, 4, or 8) in the DCT domain\n");
 #endif
 #if TRANSFORMS_SUPPORTED
   fprintf(stderr, "  -transpose     Transpose image\n");
@@ -149,6 +150,7 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
   transformoption.force_grayscale = FALSE;
   transformoption.crop = FALSE;
   transformoption.slow_hflip = FALSE;
+  transformoption.scale_denom = 1;
   cinfo->err->trace_level = 0;
 
   /* Scan command line options, adjust parameters */
@@ -325,6 +327,25 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
       else
         usage();
 
+    } else if (keymatch(arg, "scale", 4)) {
+      /* Reduce image dimensions in the DCT domain. */
+#if TRANSFORMS_SUPPORTED
+      unsigned int scale_num, scale_denom;
+
+      if (++argn >= argc)       /* advance to next argument */
+        usage();
+      if (sscanf(argv[argn], "%u/%u", &scale_num, &scale_denom) != 2 ||
+          scale_num != 1 || (scale_denom != 1 && scale_denom != 2 &&
+                             scale_denom != 4 && scale_denom != 8)) {
+        fprintf(stderr, "%s: bogus -scale argument '%s'\n",
+                progname, argv[argn]);
+        exit(EXIT_FAILURE);
+      }
+      transformoption.scale_denom = (int)scale_denom;
+#else
+      select_transform(JXFORM_NONE);    /* force an error */
+#endif
+
     } else if (keymatch(arg, "scans", 1)) {
       /* Set scan script. */
 #ifdef C_MULTISCAN_FILES_SUPPORTED
@@ -357,6 +378,15 @@ parse_switches(j_compress_ptr cinfo, int argc, char **argv,
 
   /* Post-switch-scanning cleanup */
 
+#if TRANSFORMS_SUPPORTED
+  if (transformoption.scale_denom > 1 &&
+      transformoption.transform != JXFORM_NONE) {
+    fprintf(stderr, "%s: -scale can only be combined with -crop and -grayscale\n",
+            progname);
+    usage();
+  }
+#endif
+
   if (for_real) {
 
 #ifdef C_PROGRESSIVE_SUPPORTED
@@ -398,6 +428,10 @@ main(int argc, char **argv)
   FILE *icc_file;
   JOCTET *icc_profile = NULL;
   long icc_len = 0;
+#if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
+  unsigned char *inbuffer = NULL;
+  unsigned long insize = 0;
+#endif
 
   /* On Mac, fetch a command line. */
 #ifdef USE_CCOMMAND
@@ -496,12 +530,28 @@ main(int argc, char **argv)
   start_progress_monitor((j_common_ptr)&dstinfo, &progress);
 #endif
 
-  /* Specify data source for decompression */
-  jpeg_stdio_src(&srcinfo, fp);
+  /* Specify data source for decompression.  If possible, read directly from
+   * a memory-mapped copy of the input file.
+   */
+#if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
+  if (map_input_file(fp, &inbuffer, &insize))
+    jpeg_mem_src(&srcinfo, inbuffer, insize);
+  else
+#endif
+    jpeg_stdio_src(&srcinfo, fp);
 
   /* Enable saving of extra markers that we want to copy */
   jcopy_markers_setup(&srcinfo, copyoption);
 
+  /* With -verbose, time each stage of decompression and compression so that
+   * a breakdown can be printed at the end (this does nothing unless the
+   * library was built with profiling support.)
+   */
+  if (jdsterr.trace_level > 0) {
+    (void)jpeg_enable_profiling((j_common_ptr)&srcinfo, TRUE);
+    (void)jpeg_enable_profiling((j_common_ptr)&dstinfo, TRUE);
+  }
+
   /* Read file header */
   (void)jpeg_read_header(&srcinfo, TRUE);
 
@@ -543,6 +593,14 @@ main(int argc, char **argv)
    */
   if (fp != stdin)
     fclose(fp);
+#if JPEG_LIB_VERSION >= 80 || defined(MEM_SRCDST_SUPPORTED)
+  /* The same reasoning applies to the memory-mapped copy of the input file,
+   * which must be unmapped before the output file is opened, since the output
+   * file may be the same as the input file.
+   */
+  if (inbuffer != NULL)
+    unmap_input_file(inbuffer, insize);
+#endif
 
   /* Open the output file. */
   if (outfilename != NULL) {
@@ -579,8 +637,14 @@ main(int argc, char **argv)
 
   /* Finish compression and release memory */
   jpeg_finish_compress(&dstinfo);
+  if (jdsterr.trace_level > 0)
+    print_profile((j_common_ptr)&dstinfo, dstinfo.image_width,
+                  dstinfo.image_height);
   jpeg_destroy_compress(&dstinfo);
   (void)jpeg_finish_decompress(&srcinfo);
+  if (jdsterr.trace_level > 0)
+    print_profile((j_common_ptr)&srcinfo, srcinfo.image_width,
+                  srcinfo.image_height);
   jpeg_destroy_decompress(&srcinfo);
 
   /* Close output file, if we opened it */
@@ -13,6 +13,9 @@
 
 #include "jchuff.h"             /* Declarations shared with jcphuff.c */
 
+EXTERN(const char *) jsimd_get_name(void);
+EXTERN(void) jsimd_set_enabled(boolean enable);
+
 EXTERN(int) jsimd_can_rgb_ycc(void);
 EXTERN(int) jsimd_can_rgb_gray(void);
 EXTERN(int) jsimd_can_ycc_rgb(void);
@@ -19,6 +19,17 @@
 #include "jdct.h"
 #include "jsimddct.h"
 
+GLOBAL(const char *)
+jsimd_get_name(void)
+{
+  return "none";
+}
+
+GLOBAL(void)
+jsimd_set_enabled(boolean enable)
+{
+}
+
 GLOBAL(int)
 jsimd_can_rgb_ycc(void)
 {
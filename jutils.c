@@ -131,3 +131,73 @@ jzero_far(void *target, size_t bytestozero)
 {
   MEMZERO(target, bytestozero);
 }
+
+
+/*
+ * Table caches.
+ *
+ * Deriving tables from the JPEG tables (for instance, the Huffman lookup
+ * tables in jchuff.c and jdhuff.c, or the quantization divisors in
+ * jcdctmgr.c) is a measurable fraction of the per-image setup cost for small
+ * images, and an application that processes many images usually uses only a
+ * handful of distinct JPEG tables (often the standard tables from Annex K.)
+ * Thus, each of these modules retains its most recently derived tables in a
+ * cache that is allocated in permanent storage and attached to the master
+ * object.  A table whose key (the JPEG table from which it was derived, along
+ * with any parameters that affect the derivation) matches that of a cached
+ * table need not be re-derived, whether in a later scan or a later image.
+ *
+ * Each cache entry is a structure whose first member is a jtbl_cache_entry
+ * and which holds the key at key_offset bytes from its start.  The first
+ * key_size bytes of the key are compared.  If a matching entry is found, then
+ * it is returned with valid == TRUE.  Otherwise, the least recently used
+ * entry is returned with valid == FALSE and a copy of the key, and the caller
+ * must derive the table into it and then set valid = TRUE.  Since a cache
+ * holds num_entries entries, a module that looks up no more than num_entries
+ * tables in a pass can rely on none of them being evicted before the end of
+ * the pass.
+ */
+
+GLOBAL(void *)
+jtbl_cache_lookup(j_common_ptr cinfo, jtbl_cache **cachep, int num_entries,
+                  size_t entry_size, size_t key_offset, const void *key,
+                  size_t key_size)
+{
+  jtbl_cache *cache = *cachep;
+  jtbl_cache_entry *entry, *victim;
+  int i;
+
+  if (cache == NULL) {
+    cache = (jtbl_cache *)
+      (*cinfo->mem->alloc_small) (cinfo, JPOOL_PERMANENT, sizeof(jtbl_cache));
+    cache->use_counter = 0;
+    cache->entries = (JOCTET *)
+      (*cinfo->mem->alloc_small) (cinfo, JPOOL_PERMANENT,
+                                  num_entries * entry_size);
+    MEMZERO(cache->entries, num_entries * entry_size);
+    *cachep = cache;
+  }
+  cache->use_counter++;
+
+  victim = (jtbl_cache_entry *)cache->entries;
+  for (i = 0; i < num_entries; i++) {
+    entry = (jtbl_cache_entry *)(cache->entries + i * entry_size);
+    if (!entry->valid) {
+      victim = entry;
+      continue;
+    }
+    if (!MEMCMP((JOCTET *)entry + key_offset, key, key_size)) {
+      entry->last_used = cache->use_counter;
+      return entry;
+    }
+    if (victim->valid &&
+        cache->use_counter - entry->last_used >
+        cache->use_counter - victim->last_used)
+      victim = entry;
+  }
+
+  victim->valid = FALSE;
+  victim->last_used = cache->use_counter;
+  MEMCOPY((JOCTET *)victim + key_offset, key, key_size);
+  return victim;
+}
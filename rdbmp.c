@@ -237,6 +237,21 @@ get_24bit_row(j_compress_ptr cinfo, cjpeg_source_ptr sinfo)
   register JSAMPROW inptr, outptr;
   register JDIMENSION col;
 
+  outptr = source->pub.buffer[0];
+  if (!source->use_inversion_array && cinfo->in_color_space == JCS_EXT_BGR) {
+    /* The pixels are already in the requested order, so read them right into
+     * the output buffer and discard the padding at the end of the row.
+     */
+    size_t data_width = (size_t)cinfo->image_width * 3;
+
+    if (!ReadOK(source->pub.input_file, outptr, data_width) ||
+        (source->row_width > data_width &&
+         !ReadOK(source->pub.input_file, source->iobuffer,
+                 source->row_width - data_width)))
+      ERREXIT(cinfo, JERR_INPUT_EOF);
+    return 1;
+  }
+
   if (source->use_inversion_array) {
     /* Fetch next row from virtual array */
     source->source_row--;
@@ -253,9 +268,8 @@ get_24bit_row(j_compress_ptr cinfo, cjpeg_source_ptr sinfo)
   /* Transfer data.  Note source values are in BGR order
    * (even though Microsoft's own documents say the opposite).
    */
-  outptr = source->pub.buffer[0];
   if (cinfo->in_color_space == JCS_EXT_BGR) {
-    MEMCOPY(outptr, inptr, source->row_width);
+    MEMCOPY(outptr, inptr, (size_t)cinfo->image_width * 3);
   } else if (cinfo->in_color_space == JCS_CMYK) {
     for (col = cinfo->image_width; col > 0; col--) {
       /* can omit GETJSAMPLE() safely */
@@ -301,6 +315,18 @@ get_32bit_row(j_compress_ptr cinfo, cjpeg_source_ptr sinfo)
   register JSAMPROW inptr, outptr;
   register JDIMENSION col;
 
+  outptr = source->pub.buffer[0];
+  if (!source->use_inversion_array &&
+      (cinfo->in_color_space == JCS_EXT_BGRX ||
+       cinfo->in_color_space == JCS_EXT_BGRA)) {
+    /* The pixels are already in the requested order, and 32-bit rows are
+     * never padded, so read them right into the output buffer.
+     */
+    if (!ReadOK(source->pub.input_file, outptr, source->row_width))
+      ERREXIT(cinfo, JERR_INPUT_EOF);
+    return 1;
+  }
+
   if (source->use_inversion_array) {
     /* Fetch next row from virtual array */
     source->source_row--;
@@ -317,7 +343,6 @@ get_32bit_row(j_compress_ptr cinfo, cjpeg_source_ptr sinfo)
   /* Transfer data.  Note source values are in BGR order
    * (even though Microsoft's own documents say the opposite).
    */
-  outptr = source->pub.buffer[0];
   if (cinfo->in_color_space == JCS_EXT_BGRX ||
       cinfo->in_color_space == JCS_EXT_BGRA) {
     MEMCOPY(outptr, inptr, source->row_width);
@@ -167,6 +167,40 @@ init_simd(void)
 #endif
 }
 
+GLOBAL(const char *)
+jsimd_get_name(void)
+{
+  init_simd();
+
+  if (simd_support & JSIMD_NEON)
+    return "NEON";
+  return "none";
+}
+
+/*
+ * Disable all SIMD extensions (enable == FALSE), or restore the extensions
+ * that were detected at startup (enable == TRUE).  This allows the SIMD and C
+ * implementations of an algorithm to be compared within the same process.  It
+ * must not be called while a compressor or decompressor is active.
+ */
+GLOBAL(void)
+jsimd_set_enabled(boolean enable)
+{
+  static unsigned int saved_support = 0;
+  static boolean disabled = FALSE;
+
+  init_simd();
+
+  if (!enable && !disabled) {
+    saved_support = simd_support;
+    simd_support = 0;
+    disabled = TRUE;
+  } else if (enable && disabled) {
+    simd_support = saved_support;
+    disabled = FALSE;
+  }
+}
+
 GLOBAL(int)
 jsimd_can_rgb_ycc(void)
 {
@@ -879,6 +879,9 @@ EXTERN(void) jsimd_convsamp_float_sse
 EXTERN(void) jsimd_convsamp_float_sse2
   (JSAMPARRAY sample_data, JDIMENSION start_col, FAST_FLOAT *workspace);
 
+EXTERN(void) jsimd_convsamp_float_avx2
+  (JSAMPARRAY sample_data, JDIMENSION start_col, FAST_FLOAT *workspace);
+
 EXTERN(void) jsimd_convsamp_float_dspr2
   (JSAMPARRAY sample_data, JDIMENSION start_col, FAST_FLOAT *workspace);
 
@@ -905,6 +908,9 @@ EXTERN(void) jsimd_fdct_ifast_mmx(DCTELEM *data);
 extern const int jconst_fdct_ifast_sse2[];
 EXTERN(void) jsimd_fdct_ifast_sse2(DCTELEM *data);
 
+extern const int jconst_fdct_ifast_avx2[];
+EXTERN(void) jsimd_fdct_ifast_avx2(DCTELEM *data);
+
 EXTERN(void) jsimd_fdct_ifast_neon(DCTELEM *data);
 
 EXTERN(void) jsimd_fdct_ifast_dspr2(DCTELEM *data);
@@ -917,6 +923,9 @@ EXTERN(void) jsimd_fdct_float_3dnow(FAST_FLOAT *data);
 extern const int jconst_fdct_float_sse[];
 EXTERN(void) jsimd_fdct_float_sse(FAST_FLOAT *data);
 
+extern const int jconst_fdct_float_avx2[];
+EXTERN(void) jsimd_fdct_float_avx2(FAST_FLOAT *data);
+
 /* Quantization */
 EXTERN(void) jsimd_quantize_mmx
   (JCOEFPTR coef_block, DCTELEM *divisors, DCTELEM *workspace);
@@ -949,6 +958,9 @@ EXTERN(void) jsimd_quantize_float_sse
 EXTERN(void) jsimd_quantize_float_sse2
   (JCOEFPTR coef_block, FAST_FLOAT *divisors, FAST_FLOAT *workspace);
 
+EXTERN(void) jsimd_quantize_float_avx2
+  (JCOEFPTR coef_block, FAST_FLOAT *divisors, FAST_FLOAT *workspace);
+
 EXTERN(void) jsimd_quantize_float_dspr2
   (JCOEFPTR coef_block, FAST_FLOAT *divisors, FAST_FLOAT *workspace);
 
@@ -1029,6 +1041,11 @@ EXTERN(void) jsimd_idct_ifast_sse2
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
    JDIMENSION output_col);
 
+extern const int jconst_idct_ifast_avx2[];
+EXTERN(void) jsimd_idct_ifast_avx2
+  (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
+   JDIMENSION output_col);
+
 EXTERN(void) jsimd_idct_ifast_neon
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
    JDIMENSION output_col);
@@ -1059,6 +1076,11 @@ EXTERN(void) jsimd_idct_float_sse2
   (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
    JDIMENSION output_col);
 
+extern const int jconst_idct_float_avx2[];
+EXTERN(void) jsimd_idct_float_avx2
+  (void *dct_table, JCOEFPTR coef_block, JSAMPARRAY output_buf,
+   JDIMENSION output_col);
+
 /* Huffman coding */
 extern const int jconst_huff_encode_one_block[];
 EXTERN(JOCTET *) jsimd_huff_encode_one_block_sse2
@@ -1081,3 +1103,12 @@ EXTERN(void) jsimd_encode_mcu_AC_first_prepare_sse2
 EXTERN(int) jsimd_encode_mcu_AC_refine_prepare_sse2
   (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
    JCOEF *absvalues, size_t *bits);
+
+extern const int jconst_encode_mcu_AC_prepare_avx2[];
+EXTERN(void) jsimd_encode_mcu_AC_first_prepare_avx2
+  (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
+   JCOEF *values, size_t *zerobits);
+
+EXTERN(int) jsimd_encode_mcu_AC_refine_prepare_avx2
+  (const JCOEF *block, const int *jpeg_natural_order_start, int Sl, int Al,
+   JCOEF *absvalues, size_t *bits);
@@ -92,6 +92,40 @@ init_simd(void)
 #endif
 }
 
+GLOBAL(const char *)
+jsimd_get_name(void)
+{
+  init_simd();
+
+  if (simd_support & JSIMD_DSPR2)
+    return "DSPr2";
+  return "none";
+}
+
+/*
+ * Disable all SIMD extensions (enable == FALSE), or restore the extensions
+ * that were detected at startup (enable == TRUE).  This allows the SIMD and C
+ * implementations of an algorithm to be compared within the same process.  It
+ * must not be called while a compressor or decompressor is active.
+ */
+GLOBAL(void)
+jsimd_set_enabled(boolean enable)
+{
+  static unsigned int saved_support = 0;
+  static boolean disabled = FALSE;
+
+  init_simd();
+
+  if (!enable && !disabled) {
+    saved_support = simd_support;
+    simd_support = 0;
+    disabled = TRUE;
+  } else if (enable && disabled) {
+    simd_support = saved_support;
+    disabled = FALSE;
+  }
+}
+
 static const int mips_idct_ifast_coefs[4] = {
   0x45404540,           /* FIX( 1.082392200 / 2) =  17734 = 0x4546 */
   0x5A805A80,           /* FIX( 1.414213562 / 2) =  23170 = 0x5A82 */
@@ -0,0 +1,290 @@
+;
+; jcphuff-avx2.asm - prepare data for progressive Huffman encoding
+; (64-bit AVX2)
+;
+; Copyright (C) 2016, 2018, Matthieu Darbois
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler),
+; can *not* be assembled with Microsoft's MASM or any compatible
+; assembler (including Borland's Turbo Assembler).
+; NASM is available from http://nasm.sourceforge.net/ or
+; http://sourceforge.net/project/showfiles.php?group_id=6208
+;
+; This file contains an AVX2 implementation of data preparation for
+; progressive Huffman encoding.  See jcphuff.c for more details.
+;
+; Sixteen coefficients are processed at a time.  They are fetched in zigzag
+; order using masked dword gathers, so the last (partial) group of
+; coefficients in the spectral band needs no special handling.  Each gathered
+; dword is read from 2 bytes below the coefficient, so that the coefficient
+; ends up in the high word.  This never reads outside of the block, since
+; AC coefficients have a natural-order index of at least 1.
+
+%include "jsimdext.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    alignz      32
+    GLOBAL_DATA(jconst_encode_mcu_AC_prepare_avx2)
+
+EXTN(jconst_encode_mcu_AC_prepare_avx2):
+
+PD_0_7   dd 0, 1, 2, 3, 4, 5, 6, 7
+PD_8_15  dd 8, 9, 10, 11, 12, 13, 14, 15
+PW_1     times 16 dw 1
+
+    alignz      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+
+; --------------------------------------------------------------------------
+; Macro to load data for jsimd_encode_mcu_AC_first_prepare_avx2() and
+; jsimd_encode_mcu_AC_refine_prepare_avx2()
+;
+; Load the next 16 coefficients into X0, using jpeg_natural_order_start[k] as
+; the index of the k'th coefficient.  Coefficients past the end of the
+; spectral band are set to 0.
+
+%macro LOAD16 0
+    mov         eax, LEN
+    sub         eax, KK                 ; eax = # of coefficients remaining
+    vmovd       xmm4, eax
+    vpbroadcastd ymm4, xmm4
+    vpcmpgtd    ymm2, ymm4, [rel PD_0_7]
+    vpcmpgtd    ymm3, ymm4, [rel PD_8_15]
+
+    vmovdqu     ymm4, YMMWORD [LUT + 0*SIZEOF_INT]
+    vpxor       ymm0, ymm0, ymm0
+    vpgatherdd  ymm0, [BLOCK + ymm4 * 2 - 2], ymm2
+    vmovdqu     ymm4, YMMWORD [LUT + 8*SIZEOF_INT]
+    vpxor       ymm1, ymm1, ymm1
+    vpgatherdd  ymm1, [BLOCK + ymm4 * 2 - 2], ymm3
+
+    vpsrad      ymm0, ymm0, 16
+    vpsrad      ymm1, ymm1, 16
+    vpackssdw   X0, ymm0, ymm1          ; X0=(0 1 2 3 8 9 10 11  4 5 6 7 12 13 14 15)
+    vpermq      X0, X0, 0xD8            ; X0=(0 1 2 3 4 5 6 7  8 9 10 11 12 13 14 15)
+%endmacro
+
+; Compute the 64-bit mask of nonzero values in VALUES[0..63] and store it in
+; [r15].
+
+%macro REDUCE0 0
+    vpxor       ymm4, ymm4, ymm4
+    vpcmpeqw    ymm0, ymm4, YMMWORD [VALUES + ( 0*2)]
+    vpcmpeqw    ymm1, ymm4, YMMWORD [VALUES + (16*2)]
+    vpcmpeqw    ymm2, ymm4, YMMWORD [VALUES + (32*2)]
+    vpcmpeqw    ymm3, ymm4, YMMWORD [VALUES + (48*2)]
+
+    vpacksswb   ymm0, ymm0, ymm1
+    vpacksswb   ymm2, ymm2, ymm3
+    vpermq      ymm0, ymm0, 0xD8
+    vpermq      ymm2, ymm2, 0xD8
+
+    vpmovmskb   eax, ymm0
+    vpmovmskb   ecx, ymm2
+
+    shl         rcx, 32
+    or          rax, rcx
+
+    not         rax
+
+    mov         MMWORD [r15], rax
+%endmacro
+
+;
+; Prepare data for jsimd_encode_mcu_AC_first().
+;
+; GLOBAL(void)
+; jsimd_encode_mcu_AC_first_prepare_avx2(const JCOEF *block,
+;                                        const int *jpeg_natural_order_start,
+;                                        int Sl, int Al, JCOEF *values,
+;                                        size_t *zerobits)
+;
+; r10 = const JCOEF *block
+; r11 = const int *jpeg_natural_order_start
+; r12 = int Sl
+; r13 = int Al
+; r14 = JCOEF *values
+; r15 = size_t *zerobits
+
+%define X0      ymm0
+%define N0      ymm1
+%define AL      xmm7
+%define KK      r9d
+%define LUT     r11
+%define BLOCK   r10
+%define VALUES  r14
+%define LEN     r12d
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_encode_mcu_AC_first_prepare_avx2)
+
+EXTN(jsimd_encode_mcu_AC_first_prepare_avx2):
+    push        rbp
+    mov         rax, rsp                ; rax = original rbp
+    mov         rbp, rsp
+    collect_args 6
+
+    vmovd       AL, r13d
+    xor         KK, KK
+.BLOOP16:
+    LOAD16
+    vpsraw      N0, X0, 15              ; N0 = (coef < 0) ? -1 : 0
+    vpabsw      X0, X0
+    vpsrlw      X0, X0, AL              ; X0 = abs(coef) >> Al
+    vpxor       N0, N0, X0              ; N0 = (coef < 0) ? ~X0 : X0
+    vmovdqu     YMMWORD [VALUES + (0) * 2], X0
+    vmovdqu     YMMWORD [VALUES + (0 + DCTSIZE2) * 2], N0
+    add         VALUES, 16*2
+    add         LUT, 16*SIZEOF_INT
+    add         KK, 16
+    cmp         KK, LEN
+    jl          .BLOOP16
+
+    vpxor       ymm0, ymm0, ymm0
+    cmp         KK, DCTSIZE2
+    jge         .EPADDING
+.ZEROLOOP:
+    vmovdqu     YMMWORD [VALUES + 0], ymm0
+    add         VALUES, 16*2
+    add         KK, 16
+    cmp         KK, DCTSIZE2
+    jl          .ZEROLOOP
+.EPADDING:
+    sub         VALUES, DCTSIZE2*2
+
+    REDUCE0
+
+    vzeroupper
+    uncollect_args 6
+    pop         rbp
+    ret
+
+%undef X0
+%undef N0
+%undef AL
+%undef KK
+%undef LUT
+%undef BLOCK
+%undef VALUES
+%undef LEN
+
+;
+; Prepare data for jsimd_encode_mcu_AC_refine().
+;
+; GLOBAL(int)
+; jsimd_encode_mcu_AC_refine_prepare_avx2(const JCOEF *block,
+;                                         const int *jpeg_natural_order_start,
+;                                         int Sl, int Al, JCOEF *absvalues,
+;                                         size_t *bits)
+;
+; r10 = const JCOEF *block
+; r11 = const int *jpeg_natural_order_start
+; r12 = int Sl
+; r13 = int Al
+; r14 = JCOEF *values
+; r15 = size_t *bits
+
+%define X0      ymm0
+%define N0      ymm1
+%define AL      xmm7
+%define KK      r9d
+%define EOB     r8d
+%define SIGN    rdi
+%define LUT     r11
+%define T0      rcx
+%define T0d     ecx
+%define T1      rdx
+%define T1d     edx
+%define BLOCK   r10
+%define VALUES  r14
+%define LEN     r12d
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_encode_mcu_AC_refine_prepare_avx2)
+
+EXTN(jsimd_encode_mcu_AC_refine_prepare_avx2):
+    push        rbp
+    mov         rax, rsp                ; rax = original rbp
+    mov         rbp, rsp
+    collect_args 6
+
+    xor         SIGN, SIGN
+    xor         EOB, EOB
+    xor         KK, KK
+    vmovd       AL, r13d
+.BLOOPR16:
+    LOAD16
+    vpsraw      N0, X0, 15              ; N0 = (coef < 0) ? -1 : 0
+    vpabsw      X0, X0
+    vpsrlw      X0, X0, AL              ; X0 = abs(coef) >> Al
+    vmovdqu     YMMWORD [VALUES + (0) * 2], X0
+    vpcmpeqw    X0, X0, [rel PW_1]
+    vpacksswb   N0, N0, X0              ; N0=(N 0-7 X 0-7  N 8-15 X 8-15)
+    vpermq      N0, N0, 0xD8            ; N0=(N 0-15  X 0-15)
+    vpmovmskb   T0d, N0                 ; T0d = (idx << 16) | lsignbits
+    mov         T1d, T0d
+    shr         T1d, 16                 ; idx = _mm_movemask_epi8(x1);
+    shr         SIGN, 16                ; make room for sizebits
+    shl         T0, 48
+    or          SIGN, T0
+    bsr         T1d, T1d                ; idx = 16 - (__builtin_clz(idx)>>1);
+    jz          .CONTINUER16            ; if (idx) {
+    mov         EOB, KK
+    add         EOB, T1d                ; EOB = k + idx;
+.CONTINUER16:
+    add         VALUES, 16*2
+    add         LUT, 16*SIZEOF_INT
+    add         KK, 16
+    cmp         KK, LEN
+    jl          .BLOOPR16
+
+    vpxor       ymm0, ymm0, ymm0
+    cmp         KK, DCTSIZE2
+    jge         .EPADDINGR
+.ZEROLOOPR:
+    vmovdqu     YMMWORD [VALUES + 0], ymm0
+    shr         SIGN, 16
+    add         VALUES, 16*2
+    add         KK, 16
+    cmp         KK, DCTSIZE2
+    jl          .ZEROLOOPR
+.EPADDINGR:
+    not         SIGN
+    sub         VALUES, DCTSIZE2*2
+    mov         MMWORD [r15+SIZEOF_MMWORD], SIGN
+
+    REDUCE0
+
+    mov         eax, EOB
+    vzeroupper
+    uncollect_args 6
+    pop         rbp
+    ret
+
+%undef X0
+%undef N0
+%undef AL
+%undef KK
+%undef EOB
+%undef SIGN
+%undef LUT
+%undef T0
+%undef T0d
+%undef T1
+%undef T1d
+%undef BLOCK
+%undef VALUES
+%undef LEN
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
@@ -0,0 +1,221 @@
+;
+; jfdctflt.asm - floating-point FDCT (64-bit AVX2)
+;
+; Copyright 2009 Pierre Ossman <ossman@cendio.se> for Cendio AB
+; Copyright (C) 2009, 2016, D. R. Commander.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler),
+; can *not* be assembled with Microsoft's MASM or any compatible
+; assembler (including Borland's Turbo Assembler).
+; NASM is available from http://nasm.sourceforge.net/ or
+; http://sourceforge.net/project/showfiles.php?group_id=6208
+;
+; This file contains a floating-point implementation of the forward DCT
+; (Discrete Cosine Transform). The following code is based directly on
+; the IJG's original jfdctflt.c; see the jfdctflt.c for more details.
+;
+; The arithmetic is performed in the same order as in jfdctflt-sse.asm, so
+; the two implementations produce bit-identical results.
+
+%include "jsimdext.inc"
+%include "jdct.inc"
+
+; --------------------------------------------------------------------------
+; In-place 8x8x32-bit matrix transpose using AVX instructions
+; %1-%8: Input/output registers
+; %9:    Temp register
+
+%macro dotranspose 9
+    ; %1=(00 01 02 03 04 05 06 07), %2=(10 11 12 13 14 15 16 17)
+    ; %3=(20 21 22 23 24 25 26 27), %4=(30 31 32 33 34 35 36 37)
+    ; %5=(40 41 42 43 44 45 46 47), %6=(50 51 52 53 54 55 56 57)
+    ; %7=(60 61 62 63 64 65 66 67), %8=(70 71 72 73 74 75 76 77)
+
+    vunpcklps   %9, %1, %2
+    vunpckhps   %1, %1, %2
+    vunpcklps   %2, %3, %4
+    vunpckhps   %3, %3, %4
+    vunpcklps   %4, %5, %6
+    vunpckhps   %5, %5, %6
+    vunpcklps   %6, %7, %8
+    vunpckhps   %7, %7, %8
+    ; transpose coefficients(phase 1)
+    ; %9=(00 10 01 11 04 14 05 15), %1=(02 12 03 13 06 16 07 17)
+    ; %2=(20 30 21 31 24 34 25 35), %3=(22 32 23 33 26 36 27 37)
+    ; %4=(40 50 41 51 44 54 45 55), %5=(42 52 43 53 46 56 47 57)
+    ; %6=(60 70 61 71 64 74 65 75), %7=(62 72 63 73 66 76 67 77)
+
+    vshufps     %8, %9, %2, 0x44
+    vshufps     %9, %9, %2, 0xEE
+    vshufps     %2, %1, %3, 0x44
+    vshufps     %3, %1, %3, 0xEE
+    vshufps     %1, %4, %6, 0x44
+    vshufps     %6, %4, %6, 0xEE
+    vshufps     %4, %5, %7, 0xEE
+    vshufps     %7, %5, %7, 0x44
+    ; transpose coefficients(phase 2)
+    ; %8=(00 10 20 30 04 14 24 34), %9=(01 11 21 31 05 15 25 35)
+    ; %2=(02 12 22 32 06 16 26 36), %3=(03 13 23 33 07 17 27 37)
+    ; %1=(40 50 60 70 44 54 64 74), %6=(41 51 61 71 45 55 65 75)
+    ; %7=(42 52 62 72 46 56 66 76), %4=(43 53 63 73 47 57 67 77)
+
+    vperm2f128  %5, %8, %1, 0x31
+    vperm2f128  %1, %8, %1, 0x20
+    vperm2f128  %8, %3, %4, 0x31
+    vperm2f128  %4, %3, %4, 0x20
+    vperm2f128  %3, %2, %7, 0x20
+    vperm2f128  %7, %2, %7, 0x31
+    vperm2f128  %2, %9, %6, 0x20
+    vperm2f128  %6, %9, %6, 0x31
+    ; transpose coefficients(phase 3)
+    ; %1=(00 10 20 30 40 50 60 70), %2=(01 11 21 31 41 51 61 71)
+    ; %3=(02 12 22 32 42 52 62 72), %4=(03 13 23 33 43 53 63 73)
+    ; %5=(04 14 24 34 44 54 64 74), %6=(05 15 25 35 45 55 65 75)
+    ; %7=(06 16 26 36 46 56 66 76), %8=(07 17 27 37 47 57 67 77)
+%endmacro
+
+; --------------------------------------------------------------------------
+; 8-point floating-point forward DCT using AVX instructions
+; %1-%8:  Input registers (data0-data7)
+; %9-%12: Temp registers
+;
+; Output: data0=%5, data1=%1, data2=%6, data3=%10,
+;         data4=%7, data5=%8, data6=%9, data7=%11
+
+%macro dodct 12
+    vaddps      %9, %1, %8              ; %9=data0+data7=tmp0
+    vsubps      %1, %1, %8              ; %1=data0-data7=tmp7
+    vaddps      %10, %2, %7             ; %10=data1+data6=tmp1
+    vsubps      %2, %2, %7              ; %2=data1-data6=tmp6
+    vaddps      %11, %3, %6             ; %11=data2+data5=tmp2
+    vsubps      %3, %3, %6              ; %3=data2-data5=tmp5
+    vaddps      %12, %4, %5             ; %12=data3+data4=tmp3
+    vsubps      %4, %4, %5              ; %4=data3-data4=tmp4
+
+    ; -- Even part
+
+    vaddps      %5, %9, %12             ; %5=tmp10
+    vsubps      %9, %9, %12             ; %9=tmp13
+    vaddps      %6, %10, %11            ; %6=tmp11
+    vsubps      %10, %10, %11           ; %10=tmp12
+
+    vaddps      %10, %10, %9
+    vmulps      %10, %10, [rel PD_0_707]  ; %10=z1
+
+    vsubps      %7, %5, %6              ; %7=data4
+    vaddps      %5, %5, %6              ; %5=data0
+    vaddps      %6, %9, %10             ; %6=data2
+    vsubps      %9, %9, %10             ; %9=data6
+
+    ; -- Odd part
+
+    vaddps      %4, %4, %3              ; %4=tmp10
+    vaddps      %3, %3, %2              ; %3=tmp11
+    vaddps      %2, %2, %1              ; %2=tmp12, %1=tmp7
+
+    vmulps      %3, %3, [rel PD_0_707]  ; %3=z3
+
+    vsubps      %8, %4, %2
+    vmulps      %8, %8, [rel PD_0_382]  ; %8=z5
+    vmulps      %4, %4, [rel PD_0_541]  ; %4=MULTIPLY(tmp10,FIX_0_541196)
+    vmulps      %2, %2, [rel PD_1_306]  ; %2=MULTIPLY(tmp12,FIX_1_306562)
+    vaddps      %4, %4, %8              ; %4=z2
+    vaddps      %2, %2, %8              ; %2=z4
+
+    vsubps      %8, %1, %3              ; %8=z13
+    vaddps      %1, %1, %3              ; %1=z11
+
+    vsubps      %10, %8, %4             ; %10=data3
+    vaddps      %8, %8, %4              ; %8=data5
+    vsubps      %11, %1, %2             ; %11=data7
+    vaddps      %1, %1, %2              ; %1=data1
+%endmacro
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    alignz      32
+    GLOBAL_DATA(jconst_fdct_float_avx2)
+
+EXTN(jconst_fdct_float_avx2):
+
+PD_0_382 times 8 dd 0.382683432365089771728460
+PD_0_707 times 8 dd 0.707106781186547524400844
+PD_0_541 times 8 dd 0.541196100146196984399723
+PD_1_306 times 8 dd 1.306562964876376527856643
+
+    alignz      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Perform the forward DCT on one block of samples.
+;
+; GLOBAL(void)
+; jsimd_fdct_float_avx2(FAST_FLOAT *data)
+;
+
+; r10 = FAST_FLOAT *data
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_fdct_float_avx2)
+
+EXTN(jsimd_fdct_float_avx2):
+    push        rbp
+    mov         rax, rsp
+    mov         rbp, rsp
+    push_xmm    4
+    collect_args 1
+
+    ; ---- Pass 1: process rows.
+
+    vmovups     ymm0, YMMWORD [YMMBLOCK(0,0,r10,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm1, YMMWORD [YMMBLOCK(1,0,r10,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm2, YMMWORD [YMMBLOCK(2,0,r10,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm3, YMMWORD [YMMBLOCK(3,0,r10,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm4, YMMWORD [YMMBLOCK(4,0,r10,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm5, YMMWORD [YMMBLOCK(5,0,r10,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm6, YMMWORD [YMMBLOCK(6,0,r10,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm7, YMMWORD [YMMBLOCK(7,0,r10,SIZEOF_FAST_FLOAT)]
+
+    dotranspose ymm0, ymm1, ymm2, ymm3, ymm4, ymm5, ymm6, ymm7, ymm8
+    ; ymm0=col0, ymm1=col1, ymm2=col2, ymm3=col3,
+    ; ymm4=col4, ymm5=col5, ymm6=col6, ymm7=col7
+
+    dodct       ymm0, ymm1, ymm2, ymm3, ymm4, ymm5, ymm6, ymm7, \
+                ymm8, ymm9, ymm10, ymm11
+    ; ymm4=data0, ymm0=data1, ymm5=data2, ymm9=data3,
+    ; ymm6=data4, ymm7=data5, ymm8=data6, ymm10=data7
+
+    ; ---- Pass 2: process columns.
+
+    dotranspose ymm4, ymm0, ymm5, ymm9, ymm6, ymm7, ymm8, ymm10, ymm11
+
+    dodct       ymm4, ymm0, ymm5, ymm9, ymm6, ymm7, ymm8, ymm10, \
+                ymm1, ymm2, ymm3, ymm11
+    ; ymm6=data0, ymm4=data1, ymm7=data2, ymm2=data3,
+    ; ymm8=data4, ymm10=data5, ymm1=data6, ymm3=data7
+
+    vmovups     YMMWORD [YMMBLOCK(0,0,r10,SIZEOF_FAST_FLOAT)], ymm6
+    vmovups     YMMWORD [YMMBLOCK(1,0,r10,SIZEOF_FAST_FLOAT)], ymm4
+    vmovups     YMMWORD [YMMBLOCK(2,0,r10,SIZEOF_FAST_FLOAT)], ymm7
+    vmovups     YMMWORD [YMMBLOCK(3,0,r10,SIZEOF_FAST_FLOAT)], ymm2
+    vmovups     YMMWORD [YMMBLOCK(4,0,r10,SIZEOF_FAST_FLOAT)], ymm8
+    vmovups     YMMWORD [YMMBLOCK(5,0,r10,SIZEOF_FAST_FLOAT)], ymm10
+    vmovups     YMMWORD [YMMBLOCK(6,0,r10,SIZEOF_FAST_FLOAT)], ymm1
+    vmovups     YMMWORD [YMMBLOCK(7,0,r10,SIZEOF_FAST_FLOAT)], ymm3
+
+    vzeroupper
+    uncollect_args 1
+    pop_xmm     4
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
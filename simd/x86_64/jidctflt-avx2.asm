@@ -0,0 +1,356 @@
+;
+; jidctflt.asm - floating-point IDCT (64-bit AVX2)
+;
+; Copyright 2009 Pierre Ossman <ossman@cendio.se> for Cendio AB
+; Copyright (C) 2009, 2016, D. R. Commander.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler),
+; can *not* be assembled with Microsoft's MASM or any compatible
+; assembler (including Borland's Turbo Assembler).
+; NASM is available from http://nasm.sourceforge.net/ or
+; http://sourceforge.net/project/showfiles.php?group_id=6208
+;
+; This file contains a floating-point implementation of the inverse DCT
+; (Discrete Cosine Transform). The following code is based directly on
+; the IJG's original jidctflt.c; see the jidctflt.c for more details.
+;
+; The arithmetic is performed in the same order as in jidctflt-sse2.asm, so
+; the two implementations produce bit-identical results.
+
+%include "jsimdext.inc"
+%include "jdct.inc"
+
+; --------------------------------------------------------------------------
+; In-place 8x8x32-bit matrix transpose using AVX instructions
+; %1-%8: Input/output registers
+; %9:    Temp register
+
+%macro dotranspose 9
+    ; %1=(00 01 02 03 04 05 06 07), %2=(10 11 12 13 14 15 16 17)
+    ; %3=(20 21 22 23 24 25 26 27), %4=(30 31 32 33 34 35 36 37)
+    ; %5=(40 41 42 43 44 45 46 47), %6=(50 51 52 53 54 55 56 57)
+    ; %7=(60 61 62 63 64 65 66 67), %8=(70 71 72 73 74 75 76 77)
+
+    vunpcklps   %9, %1, %2
+    vunpckhps   %1, %1, %2
+    vunpcklps   %2, %3, %4
+    vunpckhps   %3, %3, %4
+    vunpcklps   %4, %5, %6
+    vunpckhps   %5, %5, %6
+    vunpcklps   %6, %7, %8
+    vunpckhps   %7, %7, %8
+    ; transpose coefficients(phase 1)
+    ; %9=(00 10 01 11 04 14 05 15), %1=(02 12 03 13 06 16 07 17)
+    ; %2=(20 30 21 31 24 34 25 35), %3=(22 32 23 33 26 36 27 37)
+    ; %4=(40 50 41 51 44 54 45 55), %5=(42 52 43 53 46 56 47 57)
+    ; %6=(60 70 61 71 64 74 65 75), %7=(62 72 63 73 66 76 67 77)
+
+    vshufps     %8, %9, %2, 0x44
+    vshufps     %9, %9, %2, 0xEE
+    vshufps     %2, %1, %3, 0x44
+    vshufps     %3, %1, %3, 0xEE
+    vshufps     %1, %4, %6, 0x44
+    vshufps     %6, %4, %6, 0xEE
+    vshufps     %4, %5, %7, 0xEE
+    vshufps     %7, %5, %7, 0x44
+    ; transpose coefficients(phase 2)
+    ; %8=(00 10 20 30 04 14 24 34), %9=(01 11 21 31 05 15 25 35)
+    ; %2=(02 12 22 32 06 16 26 36), %3=(03 13 23 33 07 17 27 37)
+    ; %1=(40 50 60 70 44 54 64 74), %6=(41 51 61 71 45 55 65 75)
+    ; %7=(42 52 62 72 46 56 66 76), %4=(43 53 63 73 47 57 67 77)
+
+    vperm2f128  %5, %8, %1, 0x31
+    vperm2f128  %1, %8, %1, 0x20
+    vperm2f128  %8, %3, %4, 0x31
+    vperm2f128  %4, %3, %4, 0x20
+    vperm2f128  %3, %2, %7, 0x20
+    vperm2f128  %7, %2, %7, 0x31
+    vperm2f128  %2, %9, %6, 0x20
+    vperm2f128  %6, %9, %6, 0x31
+    ; transpose coefficients(phase 3)
+    ; %1=(00 10 20 30 40 50 60 70), %2=(01 11 21 31 41 51 61 71)
+    ; %3=(02 12 22 32 42 52 62 72), %4=(03 13 23 33 43 53 63 73)
+    ; %5=(04 14 24 34 44 54 64 74), %6=(05 15 25 35 45 55 65 75)
+    ; %7=(06 16 26 36 46 56 66 76), %8=(07 17 27 37 47 57 67 77)
+%endmacro
+
+; --------------------------------------------------------------------------
+; 8-point floating-point inverse DCT using AVX instructions
+; %1-%8:  Input registers (in0-in7)
+; %9-%10: Temp registers
+;
+; Output: data0=%9, data1=%1, data2=%7, data3=%3,
+;         data4=%5, data5=%6, data6=%4, data7=%8
+
+%macro dodct 10
+    ; -- Even part
+
+    vaddps      %9, %1, %5              ; %9=tmp10
+    vsubps      %1, %1, %5              ; %1=tmp11
+    vaddps      %10, %3, %7             ; %10=tmp13
+    vsubps      %3, %3, %7
+
+    vmulps      %3, %3, [rel PD_1_414]
+    vsubps      %3, %3, %10             ; %3=tmp12
+
+    vsubps      %5, %9, %10             ; %5=tmp3
+    vaddps      %9, %9, %10             ; %9=tmp0
+    vsubps      %7, %1, %3              ; %7=tmp2
+    vaddps      %1, %1, %3              ; %1=tmp1
+
+    ; -- Odd part
+
+    vaddps      %3, %2, %8              ; %3=z11
+    vsubps      %2, %2, %8              ; %2=z12
+    vaddps      %10, %6, %4             ; %10=z13
+    vsubps      %6, %6, %4              ; %6=z10
+
+    vaddps      %4, %3, %10             ; %4=tmp7
+    vsubps      %3, %3, %10
+    vmulps      %3, %3, [rel PD_1_414]  ; %3=tmp11
+
+    vaddps      %8, %6, %2
+    vmulps      %8, %8, [rel PD_1_847]  ; %8=z5
+    vmulps      %6, %6, [rel PD_M2_613]  ; %6=(z10 * -2.613125930)
+    vmulps      %2, %2, [rel PD_1_082]  ; %2=(z12 * 1.082392200)
+    vaddps      %6, %6, %8              ; %6=tmp12
+    vsubps      %2, %2, %8              ; %2=tmp10
+
+    ; -- Final output stage
+
+    vsubps      %6, %6, %4              ; %6=tmp6
+    vsubps      %3, %3, %6              ; %3=tmp5
+    vaddps      %2, %2, %3              ; %2=tmp4
+
+    vsubps      %8, %9, %4              ; %8=data7
+    vaddps      %9, %9, %4              ; %9=data0
+    vsubps      %4, %1, %6              ; %4=data6
+    vaddps      %1, %1, %6              ; %1=data1
+    vsubps      %6, %7, %3              ; %6=data5
+    vaddps      %7, %7, %3              ; %7=data2
+    vsubps      %3, %5, %2              ; %3=data3
+    vaddps      %5, %5, %2              ; %5=data4
+%endmacro
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_CONST
+
+    alignz      32
+    GLOBAL_DATA(jconst_idct_float_avx2)
+
+EXTN(jconst_idct_float_avx2):
+
+PD_1_414        times 8  dd  1.414213562373095048801689
+PD_1_847        times 8  dd  1.847759065022573512256366
+PD_1_082        times 8  dd  1.082392200292393968799446
+PD_M2_613       times 8  dd -2.613125929752753055713286
+PD_RNDINT_MAGIC times 8  dd  100663296.0  ; (float)(0x00C00000 << 3)
+PB_CENTERJSAMP  times 32 db  CENTERJSAMPLE
+
+    alignz      32
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Perform dequantization and inverse DCT on one block of coefficients.
+;
+; GLOBAL(void)
+; jsimd_idct_float_avx2(void *dct_table, JCOEFPTR coef_block,
+;                       JSAMPARRAY output_buf, JDIMENSION output_col)
+;
+
+; r10 = void *dct_table
+; r11 = JCOEFPTR coef_block
+; r12 = JSAMPARRAY output_buf
+; r13d = JDIMENSION output_col
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_idct_float_avx2)
+
+EXTN(jsimd_idct_float_avx2):
+    push        rbp
+    mov         rax, rsp                     ; rax = original rbp
+    mov         rbp, rsp                     ; rbp = aligned rbp
+    push_xmm    4
+    collect_args 4
+
+    ; ---- Pass 1: process columns.
+
+%ifndef NO_ZERO_COLUMN_TEST_FLOAT_AVX2
+    mov         eax, dword [DWBLOCK(1,0,r11,SIZEOF_JCOEF)]
+    or          eax, dword [DWBLOCK(2,0,r11,SIZEOF_JCOEF)]
+    jnz         near .columnDCT
+
+    movdqa      xmm0, XMMWORD [XMMBLOCK(1,0,r11,SIZEOF_JCOEF)]
+    movdqa      xmm1, XMMWORD [XMMBLOCK(2,0,r11,SIZEOF_JCOEF)]
+    vpor        xmm0, xmm0, XMMWORD [XMMBLOCK(3,0,r11,SIZEOF_JCOEF)]
+    vpor        xmm1, xmm1, XMMWORD [XMMBLOCK(4,0,r11,SIZEOF_JCOEF)]
+    vpor        xmm0, xmm0, XMMWORD [XMMBLOCK(5,0,r11,SIZEOF_JCOEF)]
+    vpor        xmm1, xmm1, XMMWORD [XMMBLOCK(6,0,r11,SIZEOF_JCOEF)]
+    vpor        xmm0, xmm0, XMMWORD [XMMBLOCK(7,0,r11,SIZEOF_JCOEF)]
+    vpor        xmm1, xmm1, xmm0
+    vpacksswb   xmm1, xmm1, xmm1
+    vpacksswb   xmm1, xmm1, xmm1
+    movd        eax, xmm1
+    test        rax, rax
+    jnz         short .columnDCT
+
+    ; -- AC terms all zero
+
+    vpmovsxwd   ymm0, XMMWORD [XMMBLOCK(0,0,r11,SIZEOF_JCOEF)]
+    vcvtdq2ps   ymm0, ymm0              ; ymm0=in0=(00 01 02 03 04 05 06 07)
+    vmulps      ymm0, ymm0, YMMWORD [YMMBLOCK(0,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+
+    vperm2f128  ymm1, ymm0, ymm0, 0x00  ; ymm1=(00 01 02 03 00 01 02 03)
+    vperm2f128  ymm9, ymm0, ymm0, 0x11  ; ymm9=(04 05 06 07 04 05 06 07)
+
+    vshufps     ymm8, ymm1, ymm1, 0x00  ; ymm8=col0=(00 00 00 00 00 00 00 00)
+    vshufps     ymm0, ymm1, ymm1, 0x55  ; ymm0=col1=(01 01 01 01 01 01 01 01)
+    vshufps     ymm6, ymm1, ymm1, 0xAA  ; ymm6=col2=(02 02 02 02 02 02 02 02)
+    vshufps     ymm2, ymm1, ymm1, 0xFF  ; ymm2=col3=(03 03 03 03 03 03 03 03)
+    vshufps     ymm4, ymm9, ymm9, 0x00  ; ymm4=col4=(04 04 04 04 04 04 04 04)
+    vshufps     ymm5, ymm9, ymm9, 0x55  ; ymm5=col5=(05 05 05 05 05 05 05 05)
+    vshufps     ymm3, ymm9, ymm9, 0xAA  ; ymm3=col6=(06 06 06 06 06 06 06 06)
+    vshufps     ymm7, ymm9, ymm9, 0xFF  ; ymm7=col7=(07 07 07 07 07 07 07 07)
+
+    jmp         near .column_end
+%endif
+.columnDCT:
+
+    vpmovsxwd   ymm0, XMMWORD [XMMBLOCK(0,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm1, XMMWORD [XMMBLOCK(1,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm2, XMMWORD [XMMBLOCK(2,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm3, XMMWORD [XMMBLOCK(3,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm4, XMMWORD [XMMBLOCK(4,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm5, XMMWORD [XMMBLOCK(5,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm6, XMMWORD [XMMBLOCK(6,0,r11,SIZEOF_JCOEF)]
+    vpmovsxwd   ymm7, XMMWORD [XMMBLOCK(7,0,r11,SIZEOF_JCOEF)]
+
+    vcvtdq2ps   ymm0, ymm0              ; ymm0=in0=(00 01 02 03 04 05 06 07)
+    vcvtdq2ps   ymm1, ymm1              ; ymm1=in1=(10 11 12 13 14 15 16 17)
+    vcvtdq2ps   ymm2, ymm2              ; ymm2=in2=(20 21 22 23 24 25 26 27)
+    vcvtdq2ps   ymm3, ymm3              ; ymm3=in3=(30 31 32 33 34 35 36 37)
+    vcvtdq2ps   ymm4, ymm4              ; ymm4=in4=(40 41 42 43 44 45 46 47)
+    vcvtdq2ps   ymm5, ymm5              ; ymm5=in5=(50 51 52 53 54 55 56 57)
+    vcvtdq2ps   ymm6, ymm6              ; ymm6=in6=(60 61 62 63 64 65 66 67)
+    vcvtdq2ps   ymm7, ymm7              ; ymm7=in7=(70 71 72 73 74 75 76 77)
+
+    vmulps      ymm0, ymm0, YMMWORD [YMMBLOCK(0,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+    vmulps      ymm1, ymm1, YMMWORD [YMMBLOCK(1,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+    vmulps      ymm2, ymm2, YMMWORD [YMMBLOCK(2,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+    vmulps      ymm3, ymm3, YMMWORD [YMMBLOCK(3,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+    vmulps      ymm4, ymm4, YMMWORD [YMMBLOCK(4,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+    vmulps      ymm5, ymm5, YMMWORD [YMMBLOCK(5,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+    vmulps      ymm6, ymm6, YMMWORD [YMMBLOCK(6,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+    vmulps      ymm7, ymm7, YMMWORD [YMMBLOCK(7,0,r10,SIZEOF_FLOAT_MULT_TYPE)]
+
+    dodct       ymm0, ymm1, ymm2, ymm3, ymm4, ymm5, ymm6, ymm7, ymm8, ymm9
+    ; ymm8=data0, ymm0=data1, ymm6=data2, ymm2=data3,
+    ; ymm4=data4, ymm5=data5, ymm3=data6, ymm7=data7
+
+    dotranspose ymm8, ymm0, ymm6, ymm2, ymm4, ymm5, ymm3, ymm7, ymm9
+    ; ymm8=col0, ymm0=col1, ymm6=col2, ymm2=col3,
+    ; ymm4=col4, ymm5=col5, ymm3=col6, ymm7=col7
+
+.column_end:
+
+    ; -- Prefetch the next coefficient block
+
+    prefetchnta [r11 + DCTSIZE2*SIZEOF_JCOEF + 0*32]
+    prefetchnta [r11 + DCTSIZE2*SIZEOF_JCOEF + 1*32]
+    prefetchnta [r11 + DCTSIZE2*SIZEOF_JCOEF + 2*32]
+    prefetchnta [r11 + DCTSIZE2*SIZEOF_JCOEF + 3*32]
+
+    ; ---- Pass 2: process rows.
+
+    dodct       ymm8, ymm0, ymm6, ymm2, ymm4, ymm5, ymm3, ymm7, ymm1, ymm9
+    ; ymm1=data0=(00 10 20 30 40 50 60 70), ymm8=data1=(01 11 21 31 41 51 61 71)
+    ; ymm3=data2=(02 12 22 32 42 52 62 72), ymm6=data3=(03 13 23 33 43 53 63 73)
+    ; ymm4=data4=(04 14 24 34 44 54 64 74), ymm5=data5=(05 15 25 35 45 55 65 75)
+    ; ymm2=data6=(06 16 26 36 46 56 66 76), ymm7=data7=(07 17 27 37 47 57 67 77)
+
+    vmovaps     ymm9, [rel PD_RNDINT_MAGIC]  ; ymm9=[rel PD_RNDINT_MAGIC]
+    vpcmpeqd    ymm10, ymm10, ymm10
+    vpsrld      ymm10, ymm10, WORD_BIT  ; ymm10={0xFFFF 0x0000 0xFFFF 0x0000 ..}
+
+    vaddps      ymm1, ymm1, ymm9        ; ymm1=roundint(data0/8)=(00 ** 10 ** 20 ** 30 ** 40 ** 50 ** 60 ** 70 **)
+    vaddps      ymm8, ymm8, ymm9        ; ymm8=roundint(data1/8)=(01 ** 11 ** 21 ** 31 ** 41 ** 51 ** 61 ** 71 **)
+    vaddps      ymm3, ymm3, ymm9        ; ymm3=roundint(data2/8)=(02 ** 12 ** 22 ** 32 ** 42 ** 52 ** 62 ** 72 **)
+    vaddps      ymm6, ymm6, ymm9        ; ymm6=roundint(data3/8)=(03 ** 13 ** 23 ** 33 ** 43 ** 53 ** 63 ** 73 **)
+    vaddps      ymm4, ymm4, ymm9        ; ymm4=roundint(data4/8)=(04 ** 14 ** 24 ** 34 ** 44 ** 54 ** 64 ** 74 **)
+    vaddps      ymm5, ymm5, ymm9        ; ymm5=roundint(data5/8)=(05 ** 15 ** 25 ** 35 ** 45 ** 55 ** 65 ** 75 **)
+    vaddps      ymm2, ymm2, ymm9        ; ymm2=roundint(data6/8)=(06 ** 16 ** 26 ** 36 ** 46 ** 56 ** 66 ** 76 **)
+    vaddps      ymm7, ymm7, ymm9        ; ymm7=roundint(data7/8)=(07 ** 17 ** 27 ** 37 ** 47 ** 57 ** 67 ** 77 **)
+
+    vpand       ymm1, ymm1, ymm10       ; ymm1=(00 -- 10 -- 20 -- 30 -- 40 -- 50 -- 60 -- 70 --)
+    vpslld      ymm8, ymm8, WORD_BIT    ; ymm8=(-- 01 -- 11 -- 21 -- 31 -- 41 -- 51 -- 61 -- 71)
+    vpand       ymm3, ymm3, ymm10       ; ymm3=(02 -- 12 -- 22 -- 32 -- 42 -- 52 -- 62 -- 72 --)
+    vpslld      ymm6, ymm6, WORD_BIT    ; ymm6=(-- 03 -- 13 -- 23 -- 33 -- 43 -- 53 -- 63 -- 73)
+    vpand       ymm4, ymm4, ymm10       ; ymm4=(04 -- 14 -- 24 -- 34 -- 44 -- 54 -- 64 -- 74 --)
+    vpslld      ymm5, ymm5, WORD_BIT    ; ymm5=(-- 05 -- 15 -- 25 -- 35 -- 45 -- 55 -- 65 -- 75)
+    vpand       ymm2, ymm2, ymm10       ; ymm2=(06 -- 16 -- 26 -- 36 -- 46 -- 56 -- 66 -- 76 --)
+    vpslld      ymm7, ymm7, WORD_BIT    ; ymm7=(-- 07 -- 17 -- 27 -- 37 -- 47 -- 57 -- 67 -- 77)
+
+    vpor        ymm1, ymm1, ymm8        ; ymm1=(00 01 10 11 20 21 30 31  40 41 50 51 60 61 70 71)
+    vpor        ymm3, ymm3, ymm6        ; ymm3=(02 03 12 13 22 23 32 33  42 43 52 53 62 63 72 73)
+    vpor        ymm4, ymm4, ymm5        ; ymm4=(04 05 14 15 24 25 34 35  44 45 54 55 64 65 74 75)
+    vpor        ymm2, ymm2, ymm7        ; ymm2=(06 07 16 17 26 27 36 37  46 47 56 57 66 67 76 77)
+
+    vpacksswb   ymm1, ymm1, ymm4        ; ymm1=(00 01 10 11 20 21 30 31 04 05 14 15 24 25 34 35  40 41 ..)
+    vpacksswb   ymm3, ymm3, ymm2        ; ymm3=(02 03 12 13 22 23 32 33 06 07 16 17 26 27 36 37  42 43 ..)
+    vpaddb      ymm1, ymm1, [rel PB_CENTERJSAMP]
+    vpaddb      ymm3, ymm3, [rel PB_CENTERJSAMP]
+
+    vpunpcklwd  ymm0, ymm1, ymm3        ; ymm0=(00 01 02 03 10 11 12 13 20 21 22 23 30 31 32 33  40 41 ..)
+    vpunpckhwd  ymm1, ymm1, ymm3        ; ymm1=(04 05 06 07 14 15 16 17 24 25 26 27 34 35 36 37  44 45 ..)
+
+    vpunpckldq  ymm2, ymm0, ymm1        ; ymm2=data01_45
+    vpunpckhdq  ymm3, ymm0, ymm1        ; ymm3=data23_67
+
+    vextracti128 xmm6, ymm3, 1          ; xmm6=data67
+    vextracti128 xmm4, ymm2, 1          ; xmm4=data45
+    vextracti128 xmm0, ymm2, 0          ; xmm0=data01
+    vextracti128 xmm2, ymm3, 0          ; xmm2=data23
+
+    vpshufd     xmm1, xmm0, 0x4E  ; xmm1=(10 11 12 13 14 15 16 17 00 01 02 03 04 05 06 07)
+    vpshufd     xmm3, xmm2, 0x4E  ; xmm3=(30 31 32 33 34 35 36 37 20 21 22 23 24 25 26 27)
+    vpshufd     xmm5, xmm4, 0x4E  ; xmm5=(50 51 52 53 54 55 56 57 40 41 42 43 44 45 46 47)
+    vpshufd     xmm7, xmm6, 0x4E  ; xmm7=(70 71 72 73 74 75 76 77 60 61 62 63 64 65 66 67)
+
+    vzeroupper
+
+    mov         eax, r13d
+
+    mov         rdx, JSAMPROW [r12+0*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsi, JSAMPROW [r12+1*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    movq        XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE], xmm0
+    movq        XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE], xmm1
+
+    mov         rdx, JSAMPROW [r12+2*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsi, JSAMPROW [r12+3*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    movq        XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE], xmm2
+    movq        XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE], xmm3
+
+    mov         rdx, JSAMPROW [r12+4*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsi, JSAMPROW [r12+5*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    movq        XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE], xmm4
+    movq        XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE], xmm5
+
+    mov         rdx, JSAMPROW [r12+6*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rsi, JSAMPROW [r12+7*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    movq        XMM_MMWORD [rdx+rax*SIZEOF_JSAMPLE], xmm6
+    movq        XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE], xmm7
+
+    uncollect_args 4
+    pop_xmm     4
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
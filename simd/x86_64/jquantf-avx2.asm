@@ -0,0 +1,166 @@
+;
+; jquantf.asm - sample data conversion and quantization (64-bit AVX2)
+;
+; Copyright 2009 Pierre Ossman <ossman@cendio.se> for Cendio AB
+; Copyright (C) 2009, 2016, D. R. Commander.
+;
+; Based on the x86 SIMD extension for IJG JPEG library
+; Copyright (C) 1999-2006, MIYASAKA Masaru.
+; For conditions of distribution and use, see copyright notice in jsimdext.inc
+;
+; This file should be assembled with NASM (Netwide Assembler),
+; can *not* be assembled with Microsoft's MASM or any compatible
+; assembler (including Borland's Turbo Assembler).
+; NASM is available from http://nasm.sourceforge.net/ or
+; http://sourceforge.net/project/showfiles.php?group_id=6208
+
+%include "jsimdext.inc"
+%include "jdct.inc"
+
+; --------------------------------------------------------------------------
+    SECTION     SEG_TEXT
+    BITS        64
+;
+; Load data into workspace, applying unsigned->signed conversion
+;
+; GLOBAL(void)
+; jsimd_convsamp_float_avx2(JSAMPARRAY sample_data, JDIMENSION start_col,
+;                           FAST_FLOAT *workspace);
+;
+
+; r10 = JSAMPARRAY sample_data
+; r11d = JDIMENSION start_col
+; r12 = FAST_FLOAT *workspace
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_convsamp_float_avx2)
+
+EXTN(jsimd_convsamp_float_avx2):
+    push        rbp
+    mov         rax, rsp
+    mov         rbp, rsp
+    collect_args 3
+
+    vpcmpeqd    ymm7, ymm7, ymm7
+    vpslld      ymm7, ymm7, 7           ; ymm7={0xFFFFFF80 0xFFFFFF80 ..}
+
+    mov         eax, r11d
+
+    mov         rsi, JSAMPROW [r10+0*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rdi, JSAMPROW [r10+1*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    vpmovzxbd   ymm0, XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE]
+    vpmovzxbd   ymm1, XMM_MMWORD [rdi+rax*SIZEOF_JSAMPLE]
+
+    mov         rsi, JSAMPROW [r10+2*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rdi, JSAMPROW [r10+3*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    vpmovzxbd   ymm2, XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE]
+    vpmovzxbd   ymm3, XMM_MMWORD [rdi+rax*SIZEOF_JSAMPLE]
+
+    vpaddd      ymm0, ymm0, ymm7
+    vpaddd      ymm1, ymm1, ymm7
+    vpaddd      ymm2, ymm2, ymm7
+    vpaddd      ymm3, ymm3, ymm7
+
+    vcvtdq2ps   ymm0, ymm0              ; ymm0=(00 01 02 03 04 05 06 07)
+    vcvtdq2ps   ymm1, ymm1              ; ymm1=(10 11 12 13 14 15 16 17)
+    vcvtdq2ps   ymm2, ymm2              ; ymm2=(20 21 22 23 24 25 26 27)
+    vcvtdq2ps   ymm3, ymm3              ; ymm3=(30 31 32 33 34 35 36 37)
+
+    vmovups     YMMWORD [YMMBLOCK(0,0,r12,SIZEOF_FAST_FLOAT)], ymm0
+    vmovups     YMMWORD [YMMBLOCK(1,0,r12,SIZEOF_FAST_FLOAT)], ymm1
+    vmovups     YMMWORD [YMMBLOCK(2,0,r12,SIZEOF_FAST_FLOAT)], ymm2
+    vmovups     YMMWORD [YMMBLOCK(3,0,r12,SIZEOF_FAST_FLOAT)], ymm3
+
+    mov         rsi, JSAMPROW [r10+4*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rdi, JSAMPROW [r10+5*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    vpmovzxbd   ymm0, XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE]
+    vpmovzxbd   ymm1, XMM_MMWORD [rdi+rax*SIZEOF_JSAMPLE]
+
+    mov         rsi, JSAMPROW [r10+6*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    mov         rdi, JSAMPROW [r10+7*SIZEOF_JSAMPROW]  ; (JSAMPLE *)
+    vpmovzxbd   ymm2, XMM_MMWORD [rsi+rax*SIZEOF_JSAMPLE]
+    vpmovzxbd   ymm3, XMM_MMWORD [rdi+rax*SIZEOF_JSAMPLE]
+
+    vpaddd      ymm0, ymm0, ymm7
+    vpaddd      ymm1, ymm1, ymm7
+    vpaddd      ymm2, ymm2, ymm7
+    vpaddd      ymm3, ymm3, ymm7
+
+    vcvtdq2ps   ymm0, ymm0              ; ymm0=(40 41 42 43 44 45 46 47)
+    vcvtdq2ps   ymm1, ymm1              ; ymm1=(50 51 52 53 54 55 56 57)
+    vcvtdq2ps   ymm2, ymm2              ; ymm2=(60 61 62 63 64 65 66 67)
+    vcvtdq2ps   ymm3, ymm3              ; ymm3=(70 71 72 73 74 75 76 77)
+
+    vmovups     YMMWORD [YMMBLOCK(4,0,r12,SIZEOF_FAST_FLOAT)], ymm0
+    vmovups     YMMWORD [YMMBLOCK(5,0,r12,SIZEOF_FAST_FLOAT)], ymm1
+    vmovups     YMMWORD [YMMBLOCK(6,0,r12,SIZEOF_FAST_FLOAT)], ymm2
+    vmovups     YMMWORD [YMMBLOCK(7,0,r12,SIZEOF_FAST_FLOAT)], ymm3
+
+    vzeroupper
+    uncollect_args 3
+    pop         rbp
+    ret
+
+; --------------------------------------------------------------------------
+;
+; Quantize/descale the coefficients, and store into coef_block
+;
+; GLOBAL(void)
+; jsimd_quantize_float_avx2(JCOEFPTR coef_block, FAST_FLOAT *divisors,
+;                           FAST_FLOAT *workspace);
+;
+
+; r10 = JCOEFPTR coef_block
+; r11 = FAST_FLOAT *divisors
+; r12 = FAST_FLOAT *workspace
+
+    align       32
+    GLOBAL_FUNCTION(jsimd_quantize_float_avx2)
+
+EXTN(jsimd_quantize_float_avx2):
+    push        rbp
+    mov         rax, rsp
+    mov         rbp, rsp
+    collect_args 3
+
+    mov         rsi, r12
+    mov         rdx, r11
+    mov         rdi, r10
+    mov         rax, DCTSIZE/4
+.quantloop:
+    vmovups     ymm0, YMMWORD [YMMBLOCK(0,0,rsi,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm1, YMMWORD [YMMBLOCK(1,0,rsi,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm2, YMMWORD [YMMBLOCK(2,0,rsi,SIZEOF_FAST_FLOAT)]
+    vmovups     ymm3, YMMWORD [YMMBLOCK(3,0,rsi,SIZEOF_FAST_FLOAT)]
+    vmulps      ymm0, ymm0, YMMWORD [YMMBLOCK(0,0,rdx,SIZEOF_FAST_FLOAT)]
+    vmulps      ymm1, ymm1, YMMWORD [YMMBLOCK(1,0,rdx,SIZEOF_FAST_FLOAT)]
+    vmulps      ymm2, ymm2, YMMWORD [YMMBLOCK(2,0,rdx,SIZEOF_FAST_FLOAT)]
+    vmulps      ymm3, ymm3, YMMWORD [YMMBLOCK(3,0,rdx,SIZEOF_FAST_FLOAT)]
+
+    vcvtps2dq   ymm0, ymm0
+    vcvtps2dq   ymm1, ymm1
+    vcvtps2dq   ymm2, ymm2
+    vcvtps2dq   ymm3, ymm3
+
+    vpackssdw   ymm0, ymm0, ymm1        ; ymm0=(00 01 02 03 10 11 12 13  04 05 06 07 14 15 16 17)
+    vpackssdw   ymm2, ymm2, ymm3        ; ymm2=(20 21 22 23 30 31 32 33  24 25 26 27 34 35 36 37)
+    vpermq      ymm0, ymm0, 0xD8        ; ymm0=(00 01 02 03 04 05 06 07  10 11 12 13 14 15 16 17)
+    vpermq      ymm2, ymm2, 0xD8        ; ymm2=(20 21 22 23 24 25 26 27  30 31 32 33 34 35 36 37)
+
+    vmovdqu     YMMWORD [YMMBLOCK(0,0,rdi,SIZEOF_JCOEF)], ymm0
+    vmovdqu     YMMWORD [YMMBLOCK(2,0,rdi,SIZEOF_JCOEF)], ymm2
+
+    add         rsi, byte 4*DCTSIZE*SIZEOF_FAST_FLOAT
+    add         rdx, byte 4*DCTSIZE*SIZEOF_FAST_FLOAT
+    add         rdi, byte 4*DCTSIZE*SIZEOF_JCOEF
+    dec         rax
+    jnz         short .quantloop
+
+    vzeroupper
+    uncollect_args 3
+    pop         rbp
+    ret
+
+; For some reason, the OS X linker does not honor the request to align the
+; segment unless we do this.
+    align       32
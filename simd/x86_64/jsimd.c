@@ -69,6 +69,42 @@ init_simd(void)
 #endif
 }
 
+GLOBAL(const char *)
+jsimd_get_name(void)
+{
+  init_simd();
+
+  if (simd_support & JSIMD_AVX2)
+    return "AVX2";
+  if (simd_support & JSIMD_SSE2)
+    return "SSE2";
+  return "none";
+}
+
+/*
+ * Disable all SIMD extensions (enable == FALSE), or restore the extensions
+ * that were detected at startup (enable == TRUE).  This allows the SIMD and C
+ * implementations of an algorithm to be compared within the same process.  It
+ * must not be called while a compressor or decompressor is active.
+ */
+GLOBAL(void)
+jsimd_set_enabled(boolean enable)
+{
+  static unsigned int saved_support = 0;
+  static boolean disabled = FALSE;
+
+  init_simd();
+
+  if (!enable && !disabled) {
+    saved_support = simd_support;
+    simd_support = 0;
+    disabled = TRUE;
+  } else if (enable && disabled) {
+    simd_support = saved_support;
+    disabled = FALSE;
+  }
+}
+
 GLOBAL(int)
 jsimd_can_rgb_ycc(void)
 {
@@ -676,6 +712,8 @@ jsimd_can_convsamp_float(void)
   if (sizeof(FAST_FLOAT) != 4)
     return 0;
 
+  if (simd_support & JSIMD_AVX2)
+    return 1;
   if (simd_support & JSIMD_SSE2)
     return 1;
 
@@ -696,7 +734,10 @@ GLOBAL(void)
 jsimd_convsamp_float(JSAMPARRAY sample_data, JDIMENSION start_col,
                      FAST_FLOAT *workspace)
 {
-  jsimd_convsamp_float_sse2(sample_data, start_col, workspace);
+  if (simd_support & JSIMD_AVX2)
+    jsimd_convsamp_float_avx2(sample_data, start_col, workspace);
+  else
+    jsimd_convsamp_float_sse2(sample_data, start_col, workspace);
 }
 
 GLOBAL(int)
@@ -729,6 +770,8 @@ jsimd_can_fdct_ifast(void)
   if (sizeof(DCTELEM) != 2)
     return 0;
 
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_fdct_ifast_avx2))
+    return 1;
   if ((simd_support & JSIMD_SSE2) && IS_ALIGNED_SSE(jconst_fdct_ifast_sse2))
     return 1;
 
@@ -746,6 +789,8 @@ jsimd_can_fdct_float(void)
   if (sizeof(FAST_FLOAT) != 4)
     return 0;
 
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_fdct_float_avx2))
+    return 1;
   if ((simd_support & JSIMD_SSE) && IS_ALIGNED_SSE(jconst_fdct_float_sse))
     return 1;
 
@@ -764,13 +809,19 @@ jsimd_fdct_islow(DCTELEM *data)
 GLOBAL(void)
 jsimd_fdct_ifast(DCTELEM *data)
 {
-  jsimd_fdct_ifast_sse2(data);
+  if (simd_support & JSIMD_AVX2)
+    jsimd_fdct_ifast_avx2(data);
+  else
+    jsimd_fdct_ifast_sse2(data);
 }
 
 GLOBAL(void)
 jsimd_fdct_float(FAST_FLOAT *data)
 {
-  jsimd_fdct_float_sse(data);
+  if (simd_support & JSIMD_AVX2)
+    jsimd_fdct_float_avx2(data);
+  else
+    jsimd_fdct_float_sse(data);
 }
 
 GLOBAL(int)
@@ -807,6 +858,8 @@ jsimd_can_quantize_float(void)
   if (sizeof(FAST_FLOAT) != 4)
     return 0;
 
+  if (simd_support & JSIMD_AVX2)
+    return 1;
   if (simd_support & JSIMD_SSE2)
     return 1;
 
@@ -826,7 +879,10 @@ GLOBAL(void)
 jsimd_quantize_float(JCOEFPTR coef_block, FAST_FLOAT *divisors,
                      FAST_FLOAT *workspace)
 {
-  jsimd_quantize_float_sse2(coef_block, divisors, workspace);
+  if (simd_support & JSIMD_AVX2)
+    jsimd_quantize_float_avx2(coef_block, divisors, workspace);
+  else
+    jsimd_quantize_float_sse2(coef_block, divisors, workspace);
 }
 
 GLOBAL(int)
@@ -935,6 +991,8 @@ jsimd_can_idct_ifast(void)
   if (IFAST_SCALE_BITS != 2)
     return 0;
 
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_idct_ifast_avx2))
+    return 1;
   if ((simd_support & JSIMD_SSE2) && IS_ALIGNED_SSE(jconst_idct_ifast_sse2))
     return 1;
 
@@ -959,6 +1017,8 @@ jsimd_can_idct_float(void)
   if (sizeof(FLOAT_MULT_TYPE) != 4)
     return 0;
 
+  if ((simd_support & JSIMD_AVX2) && IS_ALIGNED_AVX(jconst_idct_float_avx2))
+    return 1;
   if ((simd_support & JSIMD_SSE2) && IS_ALIGNED_SSE(jconst_idct_float_sse2))
     return 1;
 
@@ -983,8 +1043,12 @@ jsimd_idct_ifast(j_decompress_ptr cinfo, jpeg_component_info *compptr,
                  JCOEFPTR coef_block, JSAMPARRAY output_buf,
                  JDIMENSION output_col)
 {
-  jsimd_idct_ifast_sse2(compptr->dct_table, coef_block, output_buf,
-                        output_col);
+  if (simd_support & JSIMD_AVX2)
+    jsimd_idct_ifast_avx2(compptr->dct_table, coef_block, output_buf,
+                          output_col);
+  else
+    jsimd_idct_ifast_sse2(compptr->dct_table, coef_block, output_buf,
+                          output_col);
 }
 
 GLOBAL(void)
@@ -992,8 +1056,12 @@ jsimd_idct_float(j_decompress_ptr cinfo, jpeg_component_info *compptr,
                  JCOEFPTR coef_block, JSAMPARRAY output_buf,
                  JDIMENSION output_col)
 {
-  jsimd_idct_float_sse2(compptr->dct_table, coef_block, output_buf,
-                        output_col);
+  if (simd_support & JSIMD_AVX2)
+    jsimd_idct_float_avx2(compptr->dct_table, coef_block, output_buf,
+                          output_col);
+  else
+    jsimd_idct_float_sse2(compptr->dct_table, coef_block, output_buf,
+                          output_col);
 }
 
 GLOBAL(int)
@@ -1033,6 +1101,9 @@ jsimd_can_encode_mcu_AC_first_prepare(void)
     return 0;
   if (SIZEOF_SIZE_T != 8)
     return 0;
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(jconst_encode_mcu_AC_prepare_avx2))
+    return 1;
   if (simd_support & JSIMD_SSE2)
     return 1;
 
@@ -1044,8 +1115,12 @@ jsimd_encode_mcu_AC_first_prepare(const JCOEF *block,
                                   const int *jpeg_natural_order_start, int Sl,
                                   int Al, JCOEF *values, size_t *zerobits)
 {
-  jsimd_encode_mcu_AC_first_prepare_sse2(block, jpeg_natural_order_start,
-                                         Sl, Al, values, zerobits);
+  if (simd_support & JSIMD_AVX2)
+    jsimd_encode_mcu_AC_first_prepare_avx2(block, jpeg_natural_order_start,
+                                           Sl, Al, values, zerobits);
+  else
+    jsimd_encode_mcu_AC_first_prepare_sse2(block, jpeg_natural_order_start,
+                                           Sl, Al, values, zerobits);
 }
 
 GLOBAL(int)
@@ -1059,6 +1134,9 @@ jsimd_can_encode_mcu_AC_refine_prepare(void)
     return 0;
   if (SIZEOF_SIZE_T != 8)
     return 0;
+  if ((simd_support & JSIMD_AVX2) &&
+      IS_ALIGNED_AVX(jconst_encode_mcu_AC_prepare_avx2))
+    return 1;
   if (simd_support & JSIMD_SSE2)
     return 1;
 
@@ -1070,7 +1148,12 @@ jsimd_encode_mcu_AC_refine_prepare(const JCOEF *block,
                                    const int *jpeg_natural_order_start, int Sl,
                                    int Al, JCOEF *absvalues, size_t *bits)
 {
-  return jsimd_encode_mcu_AC_refine_prepare_sse2(block,
-                                                 jpeg_natural_order_start,
-                                                 Sl, Al, absvalues, bits);
+  if (simd_support & JSIMD_AVX2)
+    return jsimd_encode_mcu_AC_refine_prepare_avx2(block,
+                                                   jpeg_natural_order_start,
+                                                   Sl, Al, absvalues, bits);
+  else
+    return jsimd_encode_mcu_AC_refine_prepare_sse2(block,
+                                                   jpeg_natural_order_start,
+                                                   Sl, Al, absvalues, bits);
 }
@@ -0,0 +1,1163 @@
+/*
+ * simdbench.c
+ *
+ * This file is part of the libjpeg-turbo Project.
+ * For conditions of distribution and use, see the accompanying README.ijg
+ * file.
+ *
+ * This program benchmarks the individual SIMD kernels against their C
+ * counterparts and verifies that both produce the same results.  Each kernel
+ * is exercised through the module method that the library selected for it,
+ * so the program measures exactly the code that a compressor or decompressor
+ * would run.  The C implementation is selected by temporarily disabling the
+ * SIMD extensions with jsimd_set_enabled(), and the JSIMD_FORCE* environment
+ * variables can be used to restrict the SIMD implementation to a particular
+ * instruction set.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jerror.h"
+#include "jpegcomp.h"
+#include "jsimd.h"
+#include "jdct.h"
+#include "jsimddct.h"
+#include "jcsample.h"
+#include "jdsample.h"
+#include <setjmp.h>
+#include <time.h>
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define USE_RDTSC
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <x86intrin.h>
+#define USE_RDTSC
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#define strcasecmp  stricmp
+#endif
+
+
+#define IMAGE_HEIGHT  16        /* height of the synthetic images */
+#define NUM_ROWS  8             /* rows processed per call to a row kernel */
+#define ROW_SLACK  128          /* padding for SIMD over-reads/over-writes */
+#define MAX_WIDTHS  16
+#define MAX_OFFSETS  16
+#define MAX_ALLOCS  32
+
+#define UNIT_PIXEL  0
+#define UNIT_BLOCK  1
+
+/* Kernel flags */
+#define KF_USERBUF  1           /* kernel accesses a user-supplied buffer */
+#define KF_INEXACT  2           /* SIMD results may differ from C results */
+
+typedef struct _bench bench;
+
+typedef struct {
+  const char *name;
+  int (*simd_available) (void);
+  int unit;
+  int flags;
+  int param;
+  void (*setup) (bench *b);     /* create the JPEG object and buffers */
+  void (*run) (bench *b);       /* run the kernel once (timed) */
+  void (*result) (bench *b);    /* store the output of the kernel */
+} kernel;
+
+typedef struct {
+  struct jpeg_error_mgr pub;
+  jmp_buf setjmp_buffer;
+} my_error_mgr;
+
+struct _bench {
+  const kernel *k;
+  JDIMENSION width;
+  int offset;
+
+  my_error_mgr jerr;
+  struct jpeg_compress_struct cinfo;
+  struct jpeg_decompress_struct dinfo;
+  boolean have_cinfo, have_dinfo;
+  struct jpeg_destination_mgr dest;
+  struct jpeg_source_mgr src;
+  JOCTET destbuf[4096];
+  boolean capture;              /* append compressed data to result? */
+  unsigned char *jpeg_buf;      /* synthetic JPEG image */
+  size_t jpeg_size;
+
+  void *allocs[MAX_ALLOCS];
+  int nallocs;
+
+  /* Kernel buffers */
+  JSAMPARRAY in_rows, out_rows;
+  JSAMPARRAY in_img[MAX_COMPONENTS], out_img[MAX_COMPONENTS];
+  JDIMENSION in_width, out_width, out_height;
+  int out_rowlen;               /* bytes of each output row to compare */
+  JBLOCKROW blocks;
+  JBLOCKROW *mcu_ptrs;
+  JDIMENSION nblocks;
+  double units;                 /* pixels or blocks per run */
+
+  /* Output of the kernel */
+  unsigned char *result;
+  size_t result_size, result_alloc;
+  int result_elem;              /* 1 = JSAMPLE, 2 = JCOEF */
+};
+
+static double benchTime = 0.1;
+static boolean checkOnly = FALSE;
+static unsigned int seed = 1;
+
+
+/*
+ * Utility routines
+ */
+
+static unsigned int nextRandom(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7FFF;
+}
+
+
+static unsigned long long getTicks(void)
+{
+#if defined(USE_RDTSC)
+  return __rdtsc();
+#elif defined(_WIN32)
+  LARGE_INTEGER counter, freq;
+
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&freq);
+  return (unsigned long long)((double)counter.QuadPart * 1.0e9 /
+                              (double)freq.QuadPart);
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+
+static double getTime(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER counter, freq;
+
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&freq);
+  return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1.0e-9;
+#endif
+}
+
+
+METHODDEF(void)
+my_error_exit(j_common_ptr cinfo)
+{
+  my_error_mgr *myerr = (my_error_mgr *)cinfo->err;
+
+  (*cinfo->err->output_message) (cinfo);
+  longjmp(myerr->setjmp_buffer, 1);
+}
+
+
+static void *benchAlloc(bench *b, size_t size)
+{
+  void *ptr;
+
+  if (b->nallocs >= MAX_ALLOCS || (ptr = calloc(1, size)) == NULL) {
+    fprintf(stderr, "ERROR: memory allocation failure\n");
+    exit(1);
+  }
+  b->allocs[b->nallocs++] = ptr;
+  return ptr;
+}
+
+
+/* Allocate nrows sample rows of rowlen bytes each.  The rows are 64-byte
+ * aligned, plus the given offset, and they are padded so that SIMD kernels
+ * can safely read and write past the end of the row.
+ */
+
+static JSAMPARRAY allocRows(bench *b, int nrows, size_t rowlen, int offset)
+{
+  size_t stride = (rowlen + offset + ROW_SLACK + 63) & ~(size_t)63;
+  JSAMPARRAY rows = (JSAMPARRAY)benchAlloc(b, nrows * sizeof(JSAMPROW));
+  JSAMPLE *buf = (JSAMPLE *)benchAlloc(b, stride * nrows + 64);
+  int i;
+
+  buf = (JSAMPLE *)(((size_t)buf + 63) & ~(size_t)63);
+  for (i = 0; i < nrows; i++)
+    rows[i] = buf + stride * i + offset;
+  return rows;
+}
+
+
+static void fillRows(JSAMPARRAY rows, int nrows, size_t rowlen)
+{
+  int i;
+  size_t j;
+
+  for (i = 0; i < nrows; i++)
+    for (j = 0; j < rowlen; j++)
+      rows[i][j] = (JSAMPLE)(nextRandom() & 0xFF);
+}
+
+
+/* Generate nblocks blocks of quantized DCT coefficients with a roughly
+ * natural distribution (large low-frequency coefficients and mostly-zero
+ * high-frequency coefficients.)
+ */
+
+static JBLOCKROW allocBlocks(bench *b, JDIMENSION nblocks)
+{
+  JBLOCKROW blocks = (JBLOCKROW)benchAlloc(b, nblocks * sizeof(JBLOCK) + 32);
+  JDIMENSION i;
+  int k, amplitude;
+
+  blocks = (JBLOCKROW)(((size_t)blocks + 31) & ~(size_t)31);
+  for (i = 0; i < nblocks; i++) {
+    blocks[i][0] = (JCOEF)((int)(nextRandom() & 127) - 64);
+    for (k = 1; k < DCTSIZE2; k++) {
+      amplitude = 32 >> (k / 16);
+      if ((int)(nextRandom() % (DCTSIZE2 * 2)) < k + DCTSIZE2)
+        blocks[i][jpeg_natural_order[k]] = 0;
+      else
+        blocks[i][jpeg_natural_order[k]] =
+          (JCOEF)((int)(nextRandom() % (2 * amplitude + 1)) - amplitude);
+    }
+  }
+  return blocks;
+}
+
+
+/* Generate nblocks blocks of quantized DCT coefficients by transforming and
+ * quantizing blocks of noisy image samples.  Unlike the blocks generated by
+ * allocBlocks(), these correspond to an image whose samples are in range.
+ * The SIMD inverse DCTs use 16-bit intermediate values and are only
+ * guaranteed to match the C implementations for such images.
+ */
+
+static JBLOCKROW allocImageBlocks(bench *b, JDIMENSION nblocks,
+                                  const JQUANT_TBL *qtbl)
+{
+  JBLOCKROW blocks = (JBLOCKROW)benchAlloc(b, nblocks * sizeof(JBLOCK) + 32);
+  DCTELEM workspace[DCTSIZE2];
+  JDIMENSION i;
+  int k, base, sample, coef, qval;
+
+  blocks = (JBLOCKROW)(((size_t)blocks + 31) & ~(size_t)31);
+  for (i = 0; i < nblocks; i++) {
+    base = (int)(nextRandom() & 0xFF);
+    for (k = 0; k < DCTSIZE2; k++) {
+      sample = base + (int)(nextRandom() % 65) - 32;
+      if (sample < 0) sample = 0;
+      if (sample > MAXJSAMPLE) sample = MAXJSAMPLE;
+      workspace[k] = (DCTELEM)(sample - CENTERJSAMPLE);
+    }
+    /* The outputs of jpeg_fdct_islow() are scaled up by a factor of 8. */
+    jpeg_fdct_islow(workspace);
+    for (k = 0; k < DCTSIZE2; k++) {
+      qval = (int)qtbl->quantval[k] << 3;
+      coef = (int)workspace[k];
+      if (coef < 0)
+        coef = -((-coef + (qval >> 1)) / qval);
+      else
+        coef = (coef + (qval >> 1)) / qval;
+      blocks[i][k] = (JCOEF)coef;
+    }
+  }
+  return blocks;
+}
+
+
+static void appendResult(bench *b, const void *data, size_t size)
+{
+  if (b->result_size + size > b->result_alloc) {
+    size_t new_alloc = (b->result_size + size) * 2;
+    unsigned char *new_result = (unsigned char *)realloc(b->result, new_alloc);
+
+    if (!new_result) {
+      fprintf(stderr, "ERROR: memory allocation failure\n");
+      exit(1);
+    }
+    b->result = new_result;
+    b->result_alloc = new_alloc;
+  }
+  MEMCOPY(b->result + b->result_size, data, size);
+  b->result_size += size;
+}
+
+
+static void appendRows(bench *b, JSAMPARRAY rows, int nrows, size_t rowlen)
+{
+  int i;
+
+  for (i = 0; i < nrows; i++)
+    appendResult(b, rows[i], rowlen * sizeof(JSAMPLE));
+}
+
+
+/*
+ * Destination manager that discards the compressed data unless the harness
+ * is capturing it
+ */
+
+METHODDEF(void)
+init_destination(j_compress_ptr cinfo)
+{
+  bench *b = (bench *)cinfo->client_data;
+
+  cinfo->dest->next_output_byte = b->destbuf;
+  cinfo->dest->free_in_buffer = sizeof(b->destbuf);
+}
+
+
+METHODDEF(boolean)
+empty_output_buffer(j_compress_ptr cinfo)
+{
+  bench *b = (bench *)cinfo->client_data;
+
+  if (b->capture)
+    appendResult(b, b->destbuf, sizeof(b->destbuf));
+  cinfo->dest->next_output_byte = b->destbuf;
+  cinfo->dest->free_in_buffer = sizeof(b->destbuf);
+  return TRUE;
+}
+
+
+METHODDEF(void)
+term_destination(j_compress_ptr cinfo)
+{
+}
+
+
+/* Start capturing compressed data */
+
+static void beginCapture(bench *b)
+{
+  b->cinfo.dest->next_output_byte = b->destbuf;
+  b->cinfo.dest->free_in_buffer = sizeof(b->destbuf);
+  b->capture = TRUE;
+}
+
+
+/* Flush the destination buffer and stop capturing compressed data */
+
+static void endCapture(bench *b)
+{
+  appendResult(b, b->destbuf,
+               sizeof(b->destbuf) - b->cinfo.dest->free_in_buffer);
+  b->capture = FALSE;
+}
+
+
+/*
+ * Source manager that reads the synthetic JPEG image
+ */
+
+METHODDEF(void)
+init_source(j_decompress_ptr cinfo)
+{
+}
+
+
+METHODDEF(boolean)
+fill_input_buffer(j_decompress_ptr cinfo)
+{
+  static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+
+  WARNMS(cinfo, JWRN_JPEG_EOF);
+  cinfo->src->next_input_byte = eoi;
+  cinfo->src->bytes_in_buffer = 2;
+  return TRUE;
+}
+
+
+METHODDEF(void)
+skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+  while (num_bytes > (long)cinfo->src->bytes_in_buffer) {
+    num_bytes -= (long)cinfo->src->bytes_in_buffer;
+    (void)(*cinfo->src->fill_input_buffer) (cinfo);
+  }
+  cinfo->src->next_input_byte += (size_t)num_bytes;
+  cinfo->src->bytes_in_buffer -= (size_t)num_bytes;
+}
+
+
+METHODDEF(void)
+term_source(j_decompress_ptr cinfo)
+{
+}
+
+
+/*
+ * Compressor setup
+ */
+
+static void initCompress(bench *b, J_COLOR_SPACE in_color_space,
+                         int h_samp, int v_samp)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+
+  cinfo->err = jpeg_std_error(&b->jerr.pub);
+  b->jerr.pub.error_exit = my_error_exit;
+  jpeg_create_compress(cinfo);
+  b->have_cinfo = TRUE;
+  cinfo->client_data = (void *)b;
+
+  b->dest.init_destination = init_destination;
+  b->dest.empty_output_buffer = empty_output_buffer;
+  b->dest.term_destination = term_destination;
+  cinfo->dest = &b->dest;
+
+  cinfo->image_width = b->width;
+  cinfo->image_height = IMAGE_HEIGHT;
+  cinfo->in_color_space = in_color_space;
+  switch (in_color_space) {
+  case JCS_GRAYSCALE:
+    cinfo->input_components = 1;  break;
+  case JCS_EXT_RGBX:
+    cinfo->input_components = 4;  break;
+  default:
+    cinfo->input_components = 3;
+  }
+  jpeg_set_defaults(cinfo);
+  cinfo->comp_info[0].h_samp_factor = h_samp;
+  cinfo->comp_info[0].v_samp_factor = v_samp;
+}
+
+
+/* Color conversion (param = input color space) */
+
+static void setupRGBYCC(bench *b)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+  int ci;
+
+  initCompress(b, (J_COLOR_SPACE)b->k->param, 2, 2);
+  if (b->k->simd_available == jsimd_can_rgb_gray)
+    jpeg_set_colorspace(cinfo, JCS_GRAYSCALE);
+  jpeg_start_compress(cinfo, FALSE);
+
+  b->in_rows = allocRows(b, NUM_ROWS, b->width * cinfo->input_components,
+                         b->offset);
+  fillRows(b->in_rows, NUM_ROWS, b->width * cinfo->input_components);
+  for (ci = 0; ci < cinfo->num_components; ci++)
+    b->out_img[ci] = allocRows(b, NUM_ROWS, b->width, 0);
+  b->units = (double)b->width * NUM_ROWS;
+}
+
+static void runRGBYCC(bench *b)
+{
+  (*b->cinfo.cconvert->color_convert) (&b->cinfo, b->in_rows, b->out_img, 0,
+                                       NUM_ROWS);
+}
+
+static void resultRGBYCC(bench *b)
+{
+  int ci;
+
+  runRGBYCC(b);
+  for (ci = 0; ci < b->cinfo.num_components; ci++)
+    appendRows(b, b->out_img[ci], NUM_ROWS, b->width);
+}
+
+
+/* Downsampling (param = v_samp_factor of the luminance component) */
+
+static void setupDownsample(bench *b)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+  jpeg_component_info *compptr;
+  int in_rows;
+
+  initCompress(b, JCS_YCbCr, 2, b->k->param);
+#if defined(__mips__)
+  if (b->k->simd_available == jsimd_can_h2v2_smooth_downsample)
+    cinfo->smoothing_factor = 25;
+#endif
+  jpeg_start_compress(cinfo, FALSE);
+
+  /* Process NUM_ROWS output rows of the first chrominance component, plus
+   * one row of context above and below for the smoothing downsampler.
+   */
+  compptr = &cinfo->comp_info[1];
+  b->out_width = compptr->width_in_blocks * DCTSIZE;
+  b->in_width = b->out_width * 2;
+  in_rows = NUM_ROWS * cinfo->max_v_samp_factor;
+  b->in_rows = allocRows(b, in_rows + 2, b->in_width, 0);
+  fillRows(b->in_rows, in_rows + 2, b->width);
+  b->in_rows++;
+  b->out_rows = allocRows(b, NUM_ROWS, b->out_width, 0);
+  b->units = (double)b->width * in_rows;
+}
+
+static void runDownsample(bench *b)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+  my_downsample_ptr downsample = (my_downsample_ptr)cinfo->downsample;
+  int row;
+
+  for (row = 0; row < NUM_ROWS; row++)
+    (*downsample->methods[1]) (cinfo, &cinfo->comp_info[1],
+                               b->in_rows + row * cinfo->max_v_samp_factor,
+                               b->out_rows + row);
+}
+
+static void resultDownsample(bench *b)
+{
+  runDownsample(b);
+  appendRows(b, b->out_rows, NUM_ROWS, b->out_width);
+}
+
+
+/* Forward DCT and quantization (param = DCT method) */
+
+static void setupFDCT(bench *b)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+
+  initCompress(b, JCS_YCbCr, 2, 2);
+  cinfo->dct_method = (J_DCT_METHOD)b->k->param;
+  jpeg_start_compress(cinfo, FALSE);
+
+  b->nblocks = cinfo->comp_info[0].width_in_blocks;
+  b->in_rows = allocRows(b, DCTSIZE, b->nblocks * DCTSIZE, 0);
+  fillRows(b->in_rows, DCTSIZE, b->nblocks * DCTSIZE);
+  b->blocks = allocBlocks(b, b->nblocks);
+  b->result_elem = sizeof(JCOEF);
+  b->units = (double)b->nblocks;
+}
+
+static void runFDCT(bench *b)
+{
+  (*b->cinfo.fdct->forward_DCT) (&b->cinfo, &b->cinfo.comp_info[0],
+                                 b->in_rows, b->blocks, 0, 0, b->nblocks);
+}
+
+static void resultFDCT(bench *b)
+{
+  runFDCT(b);
+  appendResult(b, b->blocks, b->nblocks * sizeof(JBLOCK));
+}
+
+
+/* Sequential Huffman encoding of four rows of 4:2:0 MCUs */
+
+static void setupHuff(bench *b)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+  JDIMENSION i;
+
+  initCompress(b, JCS_YCbCr, 2, 2);
+  jpeg_start_compress(cinfo, FALSE);
+
+  b->nblocks = cinfo->MCUs_per_row * 4 * cinfo->blocks_in_MCU;
+  b->blocks = allocBlocks(b, b->nblocks);
+  b->mcu_ptrs = (JBLOCKROW *)benchAlloc(b, b->nblocks * sizeof(JBLOCKROW));
+  for (i = 0; i < b->nblocks; i++)
+    b->mcu_ptrs[i] = b->blocks + i;
+  b->units = (double)b->nblocks;
+}
+
+static void runHuff(bench *b)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+  JDIMENSION i;
+
+  (*cinfo->entropy->start_pass) (cinfo, FALSE);
+  for (i = 0; i < b->nblocks; i += cinfo->blocks_in_MCU)
+    (*cinfo->entropy->encode_mcu) (cinfo, b->mcu_ptrs + i);
+}
+
+static void resultHuff(bench *b)
+{
+  beginCapture(b);
+  runHuff(b);
+  (*b->cinfo.entropy->finish_pass) (&b->cinfo);
+  endCapture(b);
+}
+
+
+/* Progressive Huffman encoding of an AC scan of the luminance component
+ * (param = Ah)
+ */
+
+static void setupPhuff(bench *b)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+  JDIMENSION i;
+
+  initCompress(b, JCS_YCbCr, 2, 2);
+  jpeg_simple_progression(cinfo);
+  jpeg_start_compress(cinfo, FALSE);
+
+  /* Set up the scan by hand, then gather statistics so that the output pass
+   * has Huffman tables that contain all of the necessary symbols.
+   */
+  cinfo->comps_in_scan = 1;
+  cinfo->cur_comp_info[0] = &cinfo->comp_info[0];
+  cinfo->blocks_in_MCU = 1;
+  cinfo->MCU_membership[0] = 0;
+  cinfo->Ss = 1;
+  cinfo->Se = DCTSIZE2 - 1;
+  cinfo->Ah = b->k->param;
+  cinfo->Al = 0;
+
+  b->nblocks = cinfo->comp_info[0].width_in_blocks * 4;
+  b->blocks = allocBlocks(b, b->nblocks);
+  b->mcu_ptrs = (JBLOCKROW *)benchAlloc(b, b->nblocks * sizeof(JBLOCKROW));
+  for (i = 0; i < b->nblocks; i++)
+    b->mcu_ptrs[i] = b->blocks + i;
+  b->units = (double)b->nblocks;
+
+  (*cinfo->entropy->start_pass) (cinfo, TRUE);
+  for (i = 0; i < b->nblocks; i++)
+    (*cinfo->entropy->encode_mcu) (cinfo, b->mcu_ptrs + i);
+  (*cinfo->entropy->finish_pass) (cinfo);
+}
+
+/* runHuff() and resultHuff() also handle progressive Huffman encoding. */
+
+
+/*
+ * Decompressor setup
+ */
+
+static void initDecompress(bench *b, int h_samp, int v_samp)
+{
+  j_compress_ptr cinfo = &b->cinfo;
+  j_decompress_ptr dinfo = &b->dinfo;
+  JSAMPARRAY rows;
+  JDIMENSION row;
+
+  /* Generate a synthetic JPEG image with the desired sampling factors */
+  initCompress(b, JCS_RGB, h_samp, v_samp);
+  rows = allocRows(b, IMAGE_HEIGHT, b->width * 3, 0);
+  fillRows(rows, IMAGE_HEIGHT, b->width * 3);
+  beginCapture(b);
+  jpeg_start_compress(cinfo, TRUE);
+  for (row = 0; row < IMAGE_HEIGHT; row++)
+    jpeg_write_scanlines(cinfo, rows + row, 1);
+  jpeg_finish_compress(cinfo);
+  endCapture(b);
+  b->jpeg_buf = b->result;
+  b->jpeg_size = b->result_size;
+  b->result = NULL;
+  b->result_size = b->result_alloc = 0;
+
+  dinfo->err = jpeg_std_error(&b->jerr.pub);
+  b->jerr.pub.error_exit = my_error_exit;
+  jpeg_create_decompress(dinfo);
+  b->have_dinfo = TRUE;
+  dinfo->client_data = (void *)b;
+
+  b->src.init_source = init_source;
+  b->src.fill_input_buffer = fill_input_buffer;
+  b->src.skip_input_data = skip_input_data;
+  b->src.resync_to_restart = jpeg_resync_to_restart;
+  b->src.term_source = term_source;
+  b->src.next_input_byte = b->jpeg_buf;
+  b->src.bytes_in_buffer = b->jpeg_size;
+  dinfo->src = &b->src;
+
+  jpeg_read_header(dinfo, TRUE);
+}
+
+
+/* Color conversion (param = output color space) */
+
+static void setupYCCRGB(bench *b)
+{
+  j_decompress_ptr dinfo = &b->dinfo;
+  int ci;
+
+  initDecompress(b, 1, 1);
+  dinfo->out_color_space = (J_COLOR_SPACE)b->k->param;
+  jpeg_start_decompress(dinfo);
+
+  for (ci = 0; ci < dinfo->num_components; ci++) {
+    b->in_img[ci] = allocRows(b, NUM_ROWS, dinfo->output_width, 0);
+    fillRows(b->in_img[ci], NUM_ROWS, dinfo->output_width);
+  }
+  b->out_rowlen = dinfo->output_width * dinfo->out_color_components;
+  b->out_rows = allocRows(b, NUM_ROWS, b->out_rowlen, b->offset);
+  b->units = (double)dinfo->output_width * NUM_ROWS;
+}
+
+static void runYCCRGB(bench *b)
+{
+  (*b->dinfo.cconvert->color_convert) (&b->dinfo, b->in_img, 0, b->out_rows,
+                                       NUM_ROWS);
+}
+
+static void resultYCCRGB(bench *b)
+{
+  runYCCRGB(b);
+  appendRows(b, b->out_rows, NUM_ROWS, b->out_rowlen);
+}
+
+
+/* Upsampling (param = v_samp_factor of the luminance component.  The kernel
+ * flags select fancy or plain upsampling.)
+ */
+
+static boolean isFancy(const kernel *k)
+{
+  return k->simd_available == jsimd_can_h2v1_fancy_upsample ||
+         k->simd_available == jsimd_can_h2v2_fancy_upsample;
+}
+
+static void setupUpsample(bench *b)
+{
+  j_decompress_ptr dinfo = &b->dinfo;
+  jpeg_component_info *compptr;
+
+  initDecompress(b, 2, b->k->param);
+  dinfo->out_color_space = JCS_YCbCr;
+  dinfo->do_fancy_upsampling = isFancy(b->k);
+  jpeg_start_decompress(dinfo);
+
+  /* Process NUM_ROWS input rows of the first chrominance component, plus one
+   * row of context above and below for the fancy upsamplers.
+   */
+  compptr = &dinfo->comp_info[1];
+  b->in_width = compptr->downsampled_width;
+  b->in_rows = allocRows(b, NUM_ROWS + 2, b->in_width, 0);
+  fillRows(b->in_rows, NUM_ROWS + 2, b->in_width);
+  b->in_rows++;
+  b->out_width = dinfo->output_width;
+  b->out_height = NUM_ROWS * dinfo->max_v_samp_factor;
+  b->out_rows = allocRows(b, b->out_height, b->out_width + 1, 0);
+  b->units = (double)b->out_width * b->out_height;
+}
+
+static void runUpsample(bench *b)
+{
+  j_decompress_ptr dinfo = &b->dinfo;
+  my_upsample_ptr upsample = (my_upsample_ptr)dinfo->upsample;
+  JSAMPARRAY output_data;
+  int row;
+
+  for (row = 0; row < NUM_ROWS; row++) {
+    output_data = b->out_rows + row * dinfo->max_v_samp_factor;
+    (*upsample->methods[1]) (dinfo, &dinfo->comp_info[1], b->in_rows + row,
+                             &output_data);
+  }
+}
+
+static void resultUpsample(bench *b)
+{
+  runUpsample(b);
+  appendRows(b, b->out_rows, b->out_height, b->out_width);
+}
+
+
+/* Merged upsampling and color conversion (param = v_samp_factor of the
+ * luminance component)
+ */
+
+static void setupMerged(bench *b)
+{
+  j_decompress_ptr dinfo = &b->dinfo;
+  int ci;
+
+  initDecompress(b, 2, b->k->param);
+  dinfo->out_color_space = JCS_EXT_RGB;
+  dinfo->do_fancy_upsampling = FALSE;
+  jpeg_start_decompress(dinfo);
+
+  b->in_width = dinfo->output_width + 1;
+  b->in_img[0] = allocRows(b, NUM_ROWS * dinfo->max_v_samp_factor,
+                           b->in_width, 0);
+  fillRows(b->in_img[0], NUM_ROWS * dinfo->max_v_samp_factor, b->in_width);
+  for (ci = 1; ci < dinfo->num_components; ci++) {
+    b->in_img[ci] = allocRows(b, NUM_ROWS, dinfo->comp_info[ci].downsampled_width,
+                              0);
+    fillRows(b->in_img[ci], NUM_ROWS, dinfo->comp_info[ci].downsampled_width);
+  }
+  b->out_height = NUM_ROWS * dinfo->max_v_samp_factor;
+  b->out_rowlen = dinfo->output_width * dinfo->out_color_components;
+  b->out_rows = allocRows(b, b->out_height, b->out_rowlen, b->offset);
+  b->units = (double)dinfo->output_width * b->out_height;
+}
+
+static void runMerged(bench *b)
+{
+  j_decompress_ptr dinfo = &b->dinfo;
+  JDIMENSION in_row_group_ctr = 0, out_row_ctr;
+  int rows_per_group = dinfo->max_v_samp_factor;
+
+  (*dinfo->upsample->start_pass) (dinfo);
+  while (in_row_group_ctr < NUM_ROWS) {
+    out_row_ctr = 0;
+    (*dinfo->upsample->upsample) (dinfo, b->in_img, &in_row_group_ctr,
+                                  NUM_ROWS, b->out_rows +
+                                  in_row_group_ctr * rows_per_group,
+                                  &out_row_ctr, rows_per_group);
+  }
+}
+
+static void resultMerged(bench *b)
+{
+  runMerged(b);
+  appendRows(b, b->out_rows, b->out_height, b->out_rowlen);
+}
+
+
+/* Inverse DCT (param = DCT method.  The kernel flags select the scaling
+ * factor.)
+ */
+
+static void setupIDCT(bench *b)
+{
+  j_decompress_ptr dinfo = &b->dinfo;
+  jpeg_component_info *compptr;
+
+  initDecompress(b, 2, 2);
+  dinfo->dct_method = (J_DCT_METHOD)b->k->param;
+  if (b->k->simd_available == jsimd_can_idct_4x4)
+    dinfo->scale_denom = 2;
+  else if (b->k->simd_available == jsimd_can_idct_2x2)
+    dinfo->scale_denom = 4;
+  jpeg_start_decompress(dinfo);
+
+  compptr = &dinfo->comp_info[0];
+  b->nblocks = compptr->width_in_blocks;
+  b->blocks = allocImageBlocks(b, b->nblocks, compptr->quant_table);
+  b->out_width = b->nblocks * compptr->_DCT_scaled_size;
+  b->out_height = compptr->_DCT_scaled_size;
+  b->out_rows = allocRows(b, b->out_height, b->out_width, 0);
+  b->units = (double)b->nblocks;
+}
+
+static void runIDCT(bench *b)
+{
+  j_decompress_ptr dinfo = &b->dinfo;
+  jpeg_component_info *compptr = &dinfo->comp_info[0];
+  inverse_DCT_method_ptr inverse_DCT = dinfo->idct->inverse_DCT[0];
+  JDIMENSION i;
+
+  for (i = 0; i < b->nblocks; i++)
+    (*inverse_DCT) (dinfo, compptr, (JCOEFPTR)b->blocks[i], b->out_rows,
+                    i * compptr->_DCT_scaled_size);
+}
+
+static void resultIDCT(bench *b)
+{
+  runIDCT(b);
+  appendRows(b, b->out_rows, b->out_height, b->out_width);
+}
+
+
+static const kernel kernels[] = {
+  { "rgb_ycc_convert/rgb", jsimd_can_rgb_ycc, UNIT_PIXEL, KF_USERBUF,
+    JCS_EXT_RGB, setupRGBYCC, runRGBYCC, resultRGBYCC },
+  { "rgb_ycc_convert/rgbx", jsimd_can_rgb_ycc, UNIT_PIXEL, KF_USERBUF,
+    JCS_EXT_RGBX, setupRGBYCC, runRGBYCC, resultRGBYCC },
+  { "rgb_gray_convert/rgb", jsimd_can_rgb_gray, UNIT_PIXEL, KF_USERBUF,
+    JCS_EXT_RGB, setupRGBYCC, runRGBYCC, resultRGBYCC },
+  { "rgb_gray_convert/rgbx", jsimd_can_rgb_gray, UNIT_PIXEL, KF_USERBUF,
+    JCS_EXT_RGBX, setupRGBYCC, runRGBYCC, resultRGBYCC },
+  { "h2v1_downsample", jsimd_can_h2v1_downsample, UNIT_PIXEL, 0, 1,
+    setupDownsample, runDownsample, resultDownsample },
+  { "h2v2_downsample", jsimd_can_h2v2_downsample, UNIT_PIXEL, 0, 2,
+    setupDownsample, runDownsample, resultDownsample },
+#if defined(__mips__)
+  /* Only the MIPS SIMD extensions provide a smoothing downsampler.  See
+   * jcsample.c.
+   */
+  { "h2v2_smooth_downsample", jsimd_can_h2v2_smooth_downsample, UNIT_PIXEL,
+    0, 2, setupDownsample, runDownsample, resultDownsample },
+#endif
+  { "fdct_islow", jsimd_can_fdct_islow, UNIT_BLOCK, 0, JDCT_ISLOW,
+    setupFDCT, runFDCT, resultFDCT },
+  { "fdct_ifast", jsimd_can_fdct_ifast, UNIT_BLOCK, 0, JDCT_IFAST,
+    setupFDCT, runFDCT, resultFDCT },
+  { "fdct_float", jsimd_can_fdct_float, UNIT_BLOCK, KF_INEXACT, JDCT_FLOAT,
+    setupFDCT, runFDCT, resultFDCT },
+  { "huff_encode_one_block", jsimd_can_huff_encode_one_block, UNIT_BLOCK, 0,
+    0, setupHuff, runHuff, resultHuff },
+  { "encode_mcu_AC_first_prepare", jsimd_can_encode_mcu_AC_first_prepare,
+    UNIT_BLOCK, 0, 0, setupPhuff, runHuff, resultHuff },
+  { "encode_mcu_AC_refine_prepare", jsimd_can_encode_mcu_AC_refine_prepare,
+    UNIT_BLOCK, 0, 1, setupPhuff, runHuff, resultHuff },
+  { "ycc_rgb_convert/rgb", jsimd_can_ycc_rgb, UNIT_PIXEL, KF_USERBUF,
+    JCS_EXT_RGB, setupYCCRGB, runYCCRGB, resultYCCRGB },
+  { "ycc_rgb_convert/rgbx", jsimd_can_ycc_rgb, UNIT_PIXEL, KF_USERBUF,
+    JCS_EXT_RGBX, setupYCCRGB, runYCCRGB, resultYCCRGB },
+  { "h2v1_upsample", jsimd_can_h2v1_upsample, UNIT_PIXEL, 0, 1,
+    setupUpsample, runUpsample, resultUpsample },
+  { "h2v2_upsample", jsimd_can_h2v2_upsample, UNIT_PIXEL, 0, 2,
+    setupUpsample, runUpsample, resultUpsample },
+  { "h2v1_fancy_upsample", jsimd_can_h2v1_fancy_upsample, UNIT_PIXEL, 0, 1,
+    setupUpsample, runUpsample, resultUpsample },
+  { "h2v2_fancy_upsample", jsimd_can_h2v2_fancy_upsample, UNIT_PIXEL, 0, 2,
+    setupUpsample, runUpsample, resultUpsample },
+  { "h2v1_merged_upsample", jsimd_can_h2v1_merged_upsample, UNIT_PIXEL,
+    KF_USERBUF, 1, setupMerged, runMerged, resultMerged },
+  { "h2v2_merged_upsample", jsimd_can_h2v2_merged_upsample, UNIT_PIXEL,
+    KF_USERBUF, 2, setupMerged, runMerged, resultMerged },
+  { "idct_islow", jsimd_can_idct_islow, UNIT_BLOCK, 0, JDCT_ISLOW,
+    setupIDCT, runIDCT, resultIDCT },
+  { "idct_ifast", jsimd_can_idct_ifast, UNIT_BLOCK, 0, JDCT_IFAST,
+    setupIDCT, runIDCT, resultIDCT },
+  { "idct_float", jsimd_can_idct_float, UNIT_BLOCK, KF_INEXACT, JDCT_FLOAT,
+    setupIDCT, runIDCT, resultIDCT },
+  { "idct_4x4", jsimd_can_idct_4x4, UNIT_BLOCK, 0, JDCT_ISLOW,
+    setupIDCT, runIDCT, resultIDCT },
+  { "idct_2x2", jsimd_can_idct_2x2, UNIT_BLOCK, 0, JDCT_ISLOW,
+    setupIDCT, runIDCT, resultIDCT }
+};
+
+#define NUM_KERNELS  (int)(sizeof(kernels) / sizeof(kernel))
+
+
+/*
+ * Benchmark driver
+ */
+
+static void cleanup(bench *b)
+{
+  int i;
+
+  if (b->have_cinfo) jpeg_destroy_compress(&b->cinfo);
+  if (b->have_dinfo) jpeg_destroy_decompress(&b->dinfo);
+  b->have_cinfo = b->have_dinfo = FALSE;
+  for (i = 0; i < b->nallocs; i++)
+    free(b->allocs[i]);
+  b->nallocs = 0;
+  free(b->jpeg_buf);
+  b->jpeg_buf = NULL;
+}
+
+
+/* Run the kernel once to obtain its output, then (unless only checking)
+ * time it.  Returns the number of ticks per unit, 0 if only checking, or -1
+ * if an error occurred.
+ */
+
+static double runKernel(bench *b, const kernel *k, JDIMENSION width,
+                        int offset)
+{
+  double start, ticksPerUnit = 0.;
+  unsigned long long ticks;
+  unsigned long iter;
+
+  MEMZERO(b, sizeof(bench));
+  b->k = k;
+  b->width = width;
+  b->offset = offset;
+  b->result_elem = sizeof(JSAMPLE);
+  seed = 1;
+
+  if (setjmp(b->jerr.setjmp_buffer)) {
+    cleanup(b);
+    return -1.;
+  }
+
+  (*k->setup) (b);
+  (*k->result) (b);
+
+  if (!checkOnly) {
+    iter = 0;
+    start = getTime();
+    ticks = getTicks();
+    do {
+      (*k->run) (b);
+      iter++;
+    } while (getTime() - start < benchTime);
+    ticks = getTicks() - ticks;
+    ticksPerUnit = (double)ticks / (double)iter / b->units;
+  }
+
+  cleanup(b);
+  return ticksPerUnit;
+}
+
+
+/* Compare the results of the C and SIMD implementations.  Returns the maximum
+ * absolute difference between corresponding samples or coefficients, or -1
+ * if the results have different lengths.
+ */
+
+static int compareResults(bench *cb, bench *sb)
+{
+  size_t i;
+  int diff, maxDiff = 0;
+
+  if (cb->result_size != sb->result_size)
+    return -1;
+  if (cb->result_elem == sizeof(JCOEF)) {
+    JCOEF *c = (JCOEF *)cb->result, *s = (JCOEF *)sb->result;
+
+    for (i = 0; i < cb->result_size / sizeof(JCOEF); i++) {
+      diff = abs((int)c[i] - (int)s[i]);
+      if (diff > maxDiff) maxDiff = diff;
+    }
+  } else {
+    for (i = 0; i < cb->result_size; i++) {
+      diff = abs((int)cb->result[i] - (int)sb->result[i]);
+      if (diff > maxDiff) maxDiff = diff;
+    }
+  }
+  return maxDiff;
+}
+
+
+static void usage(char *progName)
+{
+  printf("USAGE: %s [options]\n\n", progName);
+  printf("Benchmarks each SIMD kernel against its C counterpart and verifies that\n");
+  printf("both produce the same output.\n\n");
+  printf("Options:\n");
+  printf("-kernel <name> = Test only kernels whose names contain <name>\n");
+  printf("-width <w1,w2,...> = Test the given image widths (default: 64,227,1920)\n");
+  printf("-offset <o1,o2,...> = Test the given offsets (in bytes) of user-supplied\n");
+  printf("     buffers relative to a 64-byte boundary (default: 0,1,3)\n");
+  printf("-benchtime <t> = Run each benchmark for at least <t> seconds (default: 0.1)\n");
+  printf("-check = Verify the SIMD kernels without benchmarking them\n\n");
+  printf("The JSIMD_FORCE* environment variables can be used to select the SIMD\n");
+  printf("instruction set that is tested.  Times are reported in %s per pixel\n",
+#ifdef USE_RDTSC
+         "TSC cycles");
+#else
+         "nanoseconds");
+#endif
+  printf("or per 8x8 block.  The program returns a non-zero exit status if a SIMD\n");
+  printf("kernel produces different output than its C counterpart or if -check is\n");
+  printf("specified and no SIMD kernels are available.\n\n");
+  exit(1);
+}
+
+
+static int parseList(char *arg, int *list, int max, int min)
+{
+  int n = 0;
+  char *ptr = arg, *end;
+  long value;
+
+  while (*ptr) {
+    value = strtol(ptr, &end, 10);
+    if (end == ptr || value < min || value > 65500 || n >= max)
+      return 0;
+    list[n++] = (int)value;
+    if (*end == ',') end++;
+    else if (*end) return 0;
+    ptr = end;
+  }
+  return n;
+}
+
+
+int main(int argc, char *argv[])
+{
+  static bench cb, sb;
+  int widths[MAX_WIDTHS] = { 64, 227, 1920 }, nWidths = 3;
+  int offsets[MAX_OFFSETS] = { 0, 1, 3 }, nOffsets = 3;
+  char *kernelName = NULL;
+  int i, w, o, maxDiff, retval = 0, nChecked = 0;
+  double cTicks, sTicks;
+  const kernel *k;
+
+  for (i = 1; i < argc; i++) {
+    if (!strcasecmp(argv[i], "-kernel") && i < argc - 1)
+      kernelName = argv[++i];
+    else if (!strcasecmp(argv[i], "-width") && i < argc - 1) {
+      if ((nWidths = parseList(argv[++i], widths, MAX_WIDTHS, 16)) < 1)
+        usage(argv[0]);
+    } else if (!strcasecmp(argv[i], "-offset") && i < argc - 1) {
+      if ((nOffsets = parseList(argv[++i], offsets, MAX_OFFSETS, 0)) < 1)
+        usage(argv[0]);
+    } else if (!strcasecmp(argv[i], "-benchtime") && i < argc - 1) {
+      double temp = atof(argv[++i]);
+
+      if (temp <= 0.0) usage(argv[0]);
+      benchTime = temp;
+    } else if (!strcasecmp(argv[i], "-check"))
+      checkOnly = TRUE;
+    else
+      usage(argv[0]);
+  }
+
+  printf("SIMD extensions: %s\n", jsimd_get_name());
+  if (!checkOnly)
+#ifdef USE_RDTSC
+    printf("Times are in TSC cycles per pixel or per 8x8 block\n");
+#else
+    printf("Times are in nanoseconds per pixel or per 8x8 block\n");
+#endif
+  printf("\n%-30s %5s %6s %5s", "Kernel", "Width", "Offset", "Unit");
+  if (!checkOnly)
+    printf(" %9s %9s %8s", "C", "SIMD", "Speedup");
+  printf("  Result\n");
+
+  for (i = 0; i < NUM_KERNELS; i++) {
+    k = &kernels[i];
+    if (kernelName && !strstr(k->name, kernelName))
+      continue;
+
+    for (w = 0; w < nWidths; w++) {
+      for (o = 0; o < ((k->flags & KF_USERBUF) ? nOffsets : 1); o++) {
+        int offset = (k->flags & KF_USERBUF) ? offsets[o] : 0;
+        boolean haveSIMD;
+
+        jsimd_set_enabled(FALSE);
+        cTicks = runKernel(&cb, k, widths[w], offset);
+        jsimd_set_enabled(TRUE);
+        haveSIMD = (*k->simd_available) ();
+        sTicks = haveSIMD ? runKernel(&sb, k, widths[w], offset) : 0.;
+
+        printf("%-30s %5d %6d %5s", k->name, widths[w], offset,
+               k->unit == UNIT_BLOCK ? "block" : "pixel");
+        if (cTicks < 0. || sTicks < 0.) {
+          printf("  ERROR\n");
+          retval = 1;
+        } else {
+          if (!checkOnly) {
+            printf(" %9.2f", cTicks);
+            if (haveSIMD)
+              printf(" %9.2f %7.2fx", sTicks, cTicks / sTicks);
+            else
+              printf(" %9s %8s", "-", "-");
+          }
+          if (haveSIMD)
+            nChecked++;
+          if (!haveSIMD)
+            printf("  C only\n");
+          else if ((maxDiff = compareResults(&cb, &sb)) == 0)
+            printf("  exact\n");
+          else if (maxDiff > 0 && (k->flags & KF_INEXACT))
+            printf("  max diff %d\n", maxDiff);
+          else {
+            printf("  MISMATCH\n");
+            retval = 1;
+          }
+        }
+        free(cb.result);
+        free(sb.result);
+        cb.result = sb.result = NULL;
+      }
+    }
+  }
+
+  /* A check that verified nothing should not be mistaken for success. */
+  if (checkOnly && !nChecked) {
+    fprintf(stderr, "ERROR: no SIMD kernels are available to check\n");
+    retval = 1;
+  }
+
+  return retval;
+}
@@ -26,6 +26,9 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE  /* for sched_getaffinity() and pthread_setaffinity_np() */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,6 +39,18 @@
 #include <cdjpeg.h>
 #include "./tjutil.h"
 #include "./turbojpeg.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
 
 
 #define THROW(op, err) { \
@@ -44,8 +59,16 @@
 }
 #define THROW_UNIX(m)  THROW(m, strerror(errno))
 
-char tjErrorStr[JMSG_LENGTH_MAX] = "\0", tjErrorMsg[JMSG_LENGTH_MAX] = "\0";
-int tjErrorLine = -1, tjErrorCode = -1;
+/* The last warning is tracked separately for each benchmark thread. */
+#ifdef _MSC_VER
+#define THREAD_LOCAL  __declspec(thread)
+#else
+#define THREAD_LOCAL  __thread
+#endif
+
+THREAD_LOCAL char tjErrorStr[JMSG_LENGTH_MAX] = "\0",
+  tjErrorMsg[JMSG_LENGTH_MAX] = "\0";
+THREAD_LOCAL int tjErrorLine = -1, tjErrorCode = -1;
 
 #define THROW_TJG(m) { \
   printf("ERROR in line %d while %s:\n%s\n", __LINE__, m, \
@@ -76,7 +99,8 @@ int tjErrorLine = -1, tjErrorCode = -1;
 }
 
 int flags = TJFLAG_NOREALLOC, compOnly = 0, decompOnly = 0, doYUV = 0,
-  quiet = 0, doTile = 0, pf = TJPF_BGR, yuvPad = 1, doWrite = 1;
+  quiet = 0, doTile = 0, pf = TJPF_BGR, yuvPad = 1, doWrite = 1,
+  doProfile = 0, nThreads = 0, doPin = 0;
 char *ext = "ppm";
 const char *pixFormatStr[TJ_NUMPF] = {
   "RGB", "BGR", "RGBX", "BGRX", "XBGR", "XRGB", "GRAY", "", "", "", "", "CMYK"
@@ -95,6 +119,11 @@ int nsf = 0, xformOp = TJXOP_NONE, xformOpt = 0;
 int (*customFilter) (short *, tjregion, tjregion, int, int, tjtransform *);
 double benchTime = 5.0, warmup = 1.0;
 
+#define REPORT_JSON  1
+#define REPORT_CSV  2
+FILE *reportFile = NULL;
+int reportFormat = 0, nRecords = 0;
+
 
 static char *formatName(int subsamp, int cs, char *buf)
 {
@@ -122,6 +151,37 @@ static char *sigfig(double val, int figs, char *buf, int len)
 }
 
 
+/* Print the per-stage timing counters that the given instance accumulated over
+   the timed iterations */
+static int printProfile(tjhandle handle, int iter, double pixels)
+{
+  static const char *stageName[TJ_NUMPROF] = {
+    "markers", "entropy", "DCT", "sampling", "color", "quantize"
+  };
+  tjprofile profile[TJ_NUMPROF];
+  double total = 0.;
+  int i, first = 1, retval = 0;
+
+  if (tjGetProfile(handle, profile) == -1)
+    THROW_TJ("executing tjGetProfile()");
+  for (i = 0; i < TJ_NUMPROF; i++) total += (double)profile[i].ticks;
+  if (total <= 0. || iter <= 0) goto bailout;
+
+  for (i = 0; i < TJ_NUMPROF; i++) {
+    if (profile[i].calls == 0) continue;
+    printf("%s%-9s %9.3f ticks/pixel  (%4.1f%%)\n",
+           first ? "                  Stage profile:      " :
+                   "                                      ",
+           stageName[i], (double)profile[i].ticks / (double)iter / pixels,
+           (double)profile[i].ticks * 100. / total);
+    first = 0;
+  }
+
+bailout:
+  return retval;
+}
+
+
 /* Custom DCT filter which produces a negative of the image */
 static int dummyDCTFilter(short *coeffs, tjregion arrayRegion,
                           tjregion planeRegion, int componentIndex,
@@ -135,6 +195,627 @@ static int dummyDCTFilter(short *coeffs, tjregion arrayRegion,
 }
 
 
+/* Compress one image, tile by tile, into jpegBuf[] */
+static int compImage(tjhandle handle, unsigned char *srcBuf, int w, int h,
+                     int subsamp, int jpegQual, int tilew, int tileh,
+                     unsigned char **jpegBuf, unsigned long *jpegSize,
+                     unsigned char *yuvBuf, int *totalJpegSize,
+                     double *elapsedEncode)
+{
+  int ps = tjPixelSize[pf];
+  int ntilesw = (w + tilew - 1) / tilew, ntilesh = (h + tileh - 1) / tileh;
+  int pitch = w * ps, row, col, tile = 0, retval = 0;
+  unsigned char *srcPtr, *srcPtr2;
+
+  *totalJpegSize = 0;
+  for (row = 0, srcPtr = srcBuf; row < ntilesh;
+       row++, srcPtr += pitch * tileh) {
+    for (col = 0, srcPtr2 = srcPtr; col < ntilesw;
+         col++, tile++, srcPtr2 += ps * tilew) {
+      int width = min(tilew, w - col * tilew);
+      int height = min(tileh, h - row * tileh);
+
+      if (doYUV) {
+        double startEncode = getTime();
+
+        if (tjEncodeYUV3(handle, srcPtr2, width, pitch, height, pf, yuvBuf,
+                         yuvPad, subsamp, flags) == -1)
+          THROW_TJ("executing tjEncodeYUV3()");
+        *elapsedEncode += getTime() - startEncode;
+        if (tjCompressFromYUV(handle, yuvBuf, width, yuvPad, height, subsamp,
+                              &jpegBuf[tile], &jpegSize[tile], jpegQual,
+                              flags) == -1)
+          THROW_TJ("executing tjCompressFromYUV()");
+      } else {
+        if (tjCompress2(handle, srcPtr2, width, pitch, height, pf,
+                        &jpegBuf[tile], &jpegSize[tile], subsamp, jpegQual,
+                        flags) == -1)
+          THROW_TJ("executing tjCompress2()");
+      }
+      *totalJpegSize += jpegSize[tile];
+    }
+  }
+
+bailout:
+  return retval;
+}
+
+
+/* Decompress one image, tile by tile, into dstBuf */
+static int decompImage(tjhandle handle, unsigned char **jpegBuf,
+                       unsigned long *jpegSize, unsigned char *dstBuf, int w,
+                       int h, int subsamp, int tilew, int tileh,
+                       unsigned char *yuvBuf, double *elapsedDecode)
+{
+  int ps = tjPixelSize[pf];
+  int scaledw = TJSCALED(w, sf);
+  int scaledh = TJSCALED(h, sf);
+  int pitch = scaledw * ps;
+  int ntilesw = (w + tilew - 1) / tilew, ntilesh = (h + tileh - 1) / tileh;
+  int row, col, tile = 0, retval = 0;
+  unsigned char *dstPtr, *dstPtr2;
+
+  for (row = 0, dstPtr = dstBuf; row < ntilesh;
+       row++, dstPtr += (size_t)pitch * tileh) {
+    for (col = 0, dstPtr2 = dstPtr; col < ntilesw;
+         col++, tile++, dstPtr2 += ps * tilew) {
+      int width = doTile ? min(tilew, w - col * tilew) : scaledw;
+      int height = doTile ? min(tileh, h - row * tileh) : scaledh;
+
+      if (doYUV) {
+        double startDecode;
+
+        if (tjDecompressToYUV2(handle, jpegBuf[tile], jpegSize[tile], yuvBuf,
+                               width, yuvPad, height, flags) == -1)
+          THROW_TJ("executing tjDecompressToYUV2()");
+        startDecode = getTime();
+        if (tjDecodeYUV(handle, yuvBuf, yuvPad, subsamp, dstPtr2, width,
+                        pitch, height, pf, flags) == -1)
+          THROW_TJ("executing tjDecodeYUV()");
+        *elapsedDecode += getTime() - startDecode;
+      } else if (tjDecompress2(handle, jpegBuf[tile], jpegSize[tile],
+                               dstPtr2, width, pitch, height, pf,
+                               flags) == -1)
+        THROW_TJ("executing tjDecompress2()");
+    }
+  }
+
+bailout:
+  return retval;
+}
+
+
+/* Benchmark loop (optionally multi-threaded) */
+
+#ifdef _WIN32
+typedef HANDLE THREAD_T;
+typedef CRITICAL_SECTION MUTEX_T;
+typedef CONDITION_VARIABLE COND_T;
+#define THREAD_FUNC  DWORD WINAPI
+#define THREAD_RETURN  return 0
+#define MUTEX_INIT(m)  InitializeCriticalSection(m)
+#define MUTEX_DESTROY(m)  DeleteCriticalSection(m)
+#define MUTEX_LOCK(m)  EnterCriticalSection(m)
+#define MUTEX_UNLOCK(m)  LeaveCriticalSection(m)
+#define COND_INIT(c)  InitializeConditionVariable(c)
+#define COND_DESTROY(c)
+#define COND_WAIT(c, m)  SleepConditionVariableCS(c, m, INFINITE)
+#define COND_BROADCAST(c)  WakeAllConditionVariable(c)
+#else
+typedef pthread_t THREAD_T;
+typedef pthread_mutex_t MUTEX_T;
+typedef pthread_cond_t COND_T;
+#define THREAD_FUNC  void *
+#define THREAD_RETURN  return NULL
+#define MUTEX_INIT(m)  pthread_mutex_init(m, NULL)
+#define MUTEX_DESTROY(m)  pthread_mutex_destroy(m)
+#define MUTEX_LOCK(m)  pthread_mutex_lock(m)
+#define MUTEX_UNLOCK(m)  pthread_mutex_unlock(m)
+#define COND_INIT(c)  pthread_cond_init(c, NULL)
+#define COND_DESTROY(c)  pthread_cond_destroy(c)
+#define COND_WAIT(c, m)  pthread_cond_wait(c, m)
+#define COND_BROADCAST(c)  pthread_cond_broadcast(c)
+#endif
+
+/* A growable list of per-iteration times */
+typedef struct {
+  double *times;
+  int n, alloc;
+} timeList;
+
+static int addTime(timeList *list, double t)
+{
+  if (list->n >= list->alloc) {
+    int alloc = list->alloc ? list->alloc * 2 : 1024;
+    double *tmp = (double *)realloc(list->times, sizeof(double) * alloc);
+
+    if (tmp == NULL) return -1;
+    list->times = tmp;  list->alloc = alloc;
+  }
+  list->times[list->n++] = t;
+  return 0;
+}
+
+
+static int compareDoubles(const void *arg1, const void *arg2)
+{
+  double d1 = *(const double *)arg1, d2 = *(const double *)arg2;
+
+  return d1 < d2 ? -1 : (d1 > d2 ? 1 : 0);
+}
+
+
+/* Compute the minimum, median, and 99th-percentile (nearest-rank) time.  The
+   list is sorted in place. */
+static void getTimeStats(timeList *list, double *min, double *p50,
+                         double *p99)
+{
+  *min = *p50 = *p99 = 0.;
+  if (list->n < 1) return;
+  qsort(list->times, list->n, sizeof(double), compareDoubles);
+  *min = list->times[0];
+  *p50 = list->times[(int)ceil(0.50 * list->n) - 1];
+  *p99 = list->times[(int)ceil(0.99 * list->n) - 1];
+}
+
+
+typedef struct {
+  int index, doComp;
+  tjhandle handle;
+  unsigned char *srcBuf, **jpegBuf, *dstBuf, *yuvBuf;
+  unsigned long *jpegSize;
+  int w, h, subsamp, jpegQual, tilew, tileh;
+  /* Results */
+  int iter, totalJpegSize, ready, retval;
+  double elapsed, elapsedYUV;
+  timeList times, timesYUV;
+} threadParam;
+
+typedef struct {
+  int iter;                     /* Timed iterations (first thread) */
+  int totalIter;                /* Timed iterations (all threads) */
+  double fps, fpsYUV;           /* Frame rates (sum over all threads) */
+  double mean, stddev;          /* Per-thread throughput (Megapixels/sec) */
+  double min, p50, p99;         /* Per-iteration time (seconds) */
+  double minYUV, p50YUV, p99YUV;
+  int totalJpegSize;            /* (first thread) */
+} benchStats;
+
+static MUTEX_T startMutex;
+static COND_T startCond;
+static int nWaiting = 0, nBenchThreads = 1;
+
+
+/* Block until all benchmark threads have finished warming up, so that their
+   timed iterations overlap */
+static void waitForThreads(threadParam *param)
+{
+  if (nBenchThreads < 2) {
+    param->ready = 1;
+    return;
+  }
+  MUTEX_LOCK(&startMutex);
+  param->ready = 1;
+  if (++nWaiting >= nBenchThreads)
+    COND_BROADCAST(&startCond);
+  else {
+    while (nWaiting < nBenchThreads)
+      COND_WAIT(&startCond, &startMutex);
+  }
+  MUTEX_UNLOCK(&startMutex);
+}
+
+
+/* Pin the calling thread to the index-th CPU that the process is allowed to
+   run on (wrapping around if there are more threads than CPUs) */
+static int pinThread(int index)
+{
+#if defined(__linux__)
+  cpu_set_t allowed, cpuset;
+  int cpu, count;
+
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 ||
+      (count = CPU_COUNT(&allowed)) < 1)
+    return -1;
+  index %= count;
+  for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    if (CPU_ISSET(cpu, &allowed) && index-- == 0) break;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) ?
+         -1 : 0;
+#elif defined(_WIN32)
+  DWORD_PTR processMask, systemMask, mask;
+  int count = 0;
+
+  if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+    return -1;
+  for (mask = 1; mask; mask <<= 1)
+    if (processMask & mask) count++;
+  if (count < 1) return -1;
+  index %= count;
+  for (mask = 1; mask; mask <<= 1)
+    if ((processMask & mask) && index-- == 0) break;
+  return SetThreadAffinityMask(GetCurrentThread(), mask) ? 0 : -1;
+#else
+  return -1;
+#endif
+}
+
+
+/* Run the benchmark loop for one thread:  warm up, then time iterations until
+   the benchmark time has elapsed */
+static THREAD_FUNC benchThread(void *arg)
+{
+  threadParam *param = (threadParam *)arg;
+  tjhandle handle = param->handle;
+  int iter = -1, retval = 0;
+  double elapsed = 0., elapsedYUV = 0.;
+
+  if (doPin && nThreads > 0 && pinThread(param->index) == -1)
+    printf("WARNING: Could not pin thread %d to a CPU\n", param->index);
+
+  if (handle == NULL &&
+      (handle = param->doComp ? tjInitCompress() : tjInitDecompress()) ==
+      NULL)
+    THROW_TJ("creating TurboJPEG instance");
+
+  while (1) {
+    double start = getTime(), startYUV = elapsedYUV, time;
+
+    if (param->doComp) {
+      if (compImage(handle, param->srcBuf, param->w, param->h,
+                    param->subsamp, param->jpegQual, param->tilew,
+                    param->tileh, param->jpegBuf, param->jpegSize,
+                    param->yuvBuf, &param->totalJpegSize, &elapsedYUV) == -1)
+        goto bailout;
+    } else if (decompImage(handle, param->jpegBuf, param->jpegSize,
+                           param->dstBuf, param->w, param->h, param->subsamp,
+                           param->tilew, param->tileh, param->yuvBuf,
+                           &elapsedYUV) == -1)
+      goto bailout;
+    time = getTime() - start;
+    elapsed += time;
+    if (iter >= 0) {
+      iter++;
+      if (addTime(&param->times, time - (elapsedYUV - startYUV)) == -1 ||
+          (doYUV && addTime(&param->timesYUV, elapsedYUV - startYUV) == -1))
+        THROW_UNIX("allocating time list");
+      if (elapsed >= benchTime) break;
+    } else if (elapsed >= warmup) {
+      waitForThreads(param);
+      iter = 0;
+      elapsed = elapsedYUV = 0.;
+      if (doProfile && tjEnableProfiling(handle, 1) == -1)
+        THROW_TJ("executing tjEnableProfiling()");
+    }
+  }
+
+  param->iter = iter;
+  param->elapsed = elapsed - elapsedYUV;
+  param->elapsedYUV = elapsedYUV;
+
+bailout:
+  if (retval < 0) param->retval = -1;
+  /* Don't leave the other threads waiting for this one */
+  if (!param->ready) waitForThreads(param);
+  if (handle && handle != param->handle) tjDestroy(handle);
+  THREAD_RETURN;
+}
+
+
+/* Run a compression or decompression benchmark.  If -threads was specified,
+   then the benchmark runs in that many concurrent threads, each with its own
+   TurboJPEG instance and output buffers.  The first thread uses the caller's
+   instance and output buffers, so the caller can print its profile and save
+   or compare the output image as usual. */
+static int runBench(int doComp, tjhandle handle, unsigned char *srcBuf,
+                    unsigned char **jpegBuf, unsigned long *jpegSize,
+                    unsigned char *dstBuf, unsigned char *yuvBuf, int w, int h,
+                    int subsamp, int jpegQual, int tilew, int tileh,
+                    benchStats *stats)
+{
+  threadParam *params = NULL;
+  THREAD_T *threads = NULL;
+  timeList times = { NULL, 0, 0 }, timesYUV = { NULL, 0, 0 };
+  double pixels = (double)(w * h), sum = 0., sum2 = 0.;
+  int ntiles = ((w + tilew - 1) / tilew) * ((h + tileh - 1) / tileh);
+  int ps = tjPixelSize[pf], i, j, started = 0, retval = 0;
+  size_t dstSize = (size_t)TJSCALED(w, sf) * ps * TJSCALED(h, sf);
+  unsigned long yuvSize = 0;
+
+  nBenchThreads = max(nThreads, 1);
+
+  if (doYUV) {
+    int width = doTile || doComp ? tilew : TJSCALED(w, sf);
+    int height = doTile || doComp ? tileh : TJSCALED(h, sf);
+
+    if ((yuvSize = tjBufSizeYUV2(width, yuvPad, height, subsamp)) ==
+        (unsigned long)-1)
+      THROW_TJG("allocating YUV buffer");
+  }
+
+  if ((params = (threadParam *)calloc(nBenchThreads,
+                                      sizeof(threadParam))) == NULL ||
+      (threads = (THREAD_T *)calloc(nBenchThreads, sizeof(THREAD_T))) == NULL)
+    THROW_UNIX("allocating thread structures");
+
+  for (i = 0; i < nBenchThreads; i++) {
+    threadParam *param = &params[i];
+
+    param->index = i;  param->doComp = doComp;
+    param->srcBuf = srcBuf;  param->w = w;  param->h = h;
+    param->subsamp = subsamp;  param->jpegQual = jpegQual;
+    param->tilew = tilew;  param->tileh = tileh;
+    if (i == 0) {
+      param->handle = handle;
+      param->jpegBuf = jpegBuf;  param->jpegSize = jpegSize;
+      param->dstBuf = dstBuf;  param->yuvBuf = yuvBuf;
+      continue;
+    }
+
+    if (doYUV && (param->yuvBuf = (unsigned char *)malloc(yuvSize)) == NULL)
+      THROW_UNIX("allocating YUV buffer");
+    if (doComp) {
+      if ((param->jpegBuf = (unsigned char **)calloc(ntiles,
+                              sizeof(unsigned char *))) == NULL ||
+          (param->jpegSize = (unsigned long *)calloc(ntiles,
+                               sizeof(unsigned long))) == NULL)
+        THROW_UNIX("allocating JPEG tile array");
+      if ((flags & TJFLAG_NOREALLOC) != 0)
+        for (j = 0; j < ntiles; j++) {
+          if ((param->jpegBuf[j] = (unsigned char *)
+                tjAlloc(tjBufSize(tilew, tileh, subsamp))) == NULL)
+            THROW_UNIX("allocating JPEG tiles");
+        }
+    } else {
+      param->jpegBuf = jpegBuf;  param->jpegSize = jpegSize;
+      if ((param->dstBuf = (unsigned char *)malloc(dstSize)) == NULL)
+        THROW_UNIX("allocating destination buffer");
+    }
+  }
+
+  if (nBenchThreads == 1)
+    benchThread(&params[0]);
+  else {
+    nWaiting = 0;
+    MUTEX_INIT(&startMutex);
+    COND_INIT(&startCond);
+    for (started = 0; started < nBenchThreads; started++) {
+#ifdef _WIN32
+      if ((threads[started] = CreateThread(NULL, 0, benchThread,
+                                           &params[started], 0, NULL)) == NULL)
+        break;
+#else
+      if (pthread_create(&threads[started], NULL, benchThread,
+                         &params[started]) != 0)
+        break;
+#endif
+    }
+    if (started < nBenchThreads) {
+      printf("ERROR in line %d while creating benchmark threads\n", __LINE__);
+      retval = -1;
+      /* Release the threads that were started */
+      MUTEX_LOCK(&startMutex);
+      nWaiting += nBenchThreads - started;
+      COND_BROADCAST(&startCond);
+      MUTEX_UNLOCK(&startMutex);
+    }
+    for (i = 0; i < started; i++) {
+#ifdef _WIN32
+      WaitForSingleObject(threads[i], INFINITE);
+      CloseHandle(threads[i]);
+#else
+      pthread_join(threads[i], NULL);
+#endif
+    }
+    COND_DESTROY(&startCond);
+    MUTEX_DESTROY(&startMutex);
+    if (retval == -1) goto bailout;
+  }
+
+  memset(stats, 0, sizeof(benchStats));
+  for (i = 0; i < nBenchThreads; i++) {
+    double fps;
+
+    if (params[i].retval == -1) { retval = -1;  goto bailout; }
+    fps = (double)params[i].iter / params[i].elapsed;
+    stats->fps += fps;
+    if (doYUV)
+      stats->fpsYUV += (double)params[i].iter / params[i].elapsedYUV;
+    sum += fps * pixels / 1000000.;
+    sum2 += (fps * pixels / 1000000.) * (fps * pixels / 1000000.);
+    for (j = 0; j < params[i].times.n; j++) {
+      if (addTime(&times, params[i].times.times[j]) == -1)
+        THROW_UNIX("allocating time list");
+    }
+    for (j = 0; j < params[i].timesYUV.n; j++) {
+      if (addTime(&timesYUV, params[i].timesYUV.times[j]) == -1)
+        THROW_UNIX("allocating time list");
+    }
+  }
+  stats->iter = params[0].iter;
+  stats->totalIter = times.n;
+  stats->mean = sum / (double)nBenchThreads;
+  stats->stddev = sqrt(max(sum2 / (double)nBenchThreads -
+                           stats->mean * stats->mean, 0.));
+  stats->totalJpegSize = params[0].totalJpegSize;
+  getTimeStats(&times, &stats->min, &stats->p50, &stats->p99);
+  getTimeStats(&timesYUV, &stats->minYUV, &stats->p50YUV, &stats->p99YUV);
+
+bailout:
+  if (params) {
+    for (i = 0; i < nBenchThreads; i++) {
+      free(params[i].times.times);
+      free(params[i].timesYUV.times);
+      if (i == 0) continue;
+      free(params[i].yuvBuf);
+      if (doComp) {
+        if (params[i].jpegBuf) {
+          for (j = 0; j < ntiles; j++) tjFree(params[i].jpegBuf[j]);
+        }
+        free(params[i].jpegBuf);
+        free(params[i].jpegSize);
+      } else
+        free(params[i].dstBuf);
+    }
+  }
+  free(params);
+  free(threads);
+  free(times.times);
+  free(timesYUV.times);
+  return retval;
+}
+
+
+static void printThreadStats(benchStats *stats)
+{
+  printf("                  Threads:            %d%s\n", nThreads,
+         doPin ? " (pinned)" : "");
+  printf("                  Per-thread:         %f +/- %f Megapixels/sec\n",
+         stats->mean, stats->stddev);
+  printf("                  Latency:            p50 = %f ms, p99 = %f ms\n",
+         stats->p50 * 1000., stats->p99 * 1000.);
+}
+
+
+/* Machine-readable (JSON or CSV) output */
+
+static const char *recordFields[] = {
+  "image", "operation", "pixelformat", "subsamp", "quality", "scale",
+  "tilewidth", "tileheight", "flags", "threads", "simd", "iterations", "fps",
+  "mpixels_per_sec", "size_bytes", "time_min_ms", "time_median_ms",
+  "time_p99_ms", NULL
+};
+
+
+/* Write a string field, quoting and escaping it as necessary */
+static void writeString(const char *str)
+{
+  const char *ptr;
+
+  if (reportFormat == REPORT_CSV && strpbrk(str, ",\"\r\n") == NULL) {
+    fputs(str, reportFile);
+    return;
+  }
+  fputc('"', reportFile);
+  for (ptr = str; *ptr; ptr++) {
+    if (reportFormat == REPORT_CSV) {
+      if (*ptr == '"') fputc('"', reportFile);
+      fputc(*ptr, reportFile);
+    } else if (*ptr == '"' || *ptr == '\\')
+      fprintf(reportFile, "\\%c", *ptr);
+    else if ((unsigned char)*ptr < 0x20)
+      fprintf(reportFile, "\\u%04x", (unsigned char)*ptr);
+    else
+      fputc(*ptr, reportFile);
+  }
+  fputc('"', reportFile);
+}
+
+
+static int openReport(const char *fileName, int format)
+{
+  int i;
+
+  if ((reportFile = fopen(fileName, "w")) == NULL) return -1;
+  reportFormat = format;
+  if (format == REPORT_CSV) {
+    for (i = 0; recordFields[i]; i++)
+      fprintf(reportFile, "%s%s", i ? "," : "", recordFields[i]);
+    fprintf(reportFile, "\n");
+  } else
+    fprintf(reportFile, "[");
+  return 0;
+}
+
+
+static void closeReport(void)
+{
+  if (!reportFile) return;
+  if (reportFormat == REPORT_JSON)
+    fprintf(reportFile, "%s]\n", nRecords ? "\n" : "");
+  fclose(reportFile);
+  reportFile = NULL;
+}
+
+
+/* Write one record describing a benchmark.  jpegQual is 0 if the JPEG quality
+   is unknown (i.e. if the source image is a JPEG image.) */
+static void writeRecord(const char *fileName, const char *op, int subsamp,
+                        int jpegQual, tjscalingfactor scale, int tilew,
+                        int tileh, int xform, int iter, double fps,
+                        double pixels, unsigned long size, double tmin,
+                        double tp50, double tp99)
+{
+  char flagStr[256] = "\0", tempStr[80];
+  const char *xformName[TJ_NUMXOP] = {
+    "", "hflip", "vflip", "transpose", "transverse", "rot90", "rot180",
+    "rot270"
+  };
+  int i = 0;
+
+  if (!reportFile) return;
+
+#define ADD_FLAG(cond, name) { \
+  if (cond) \
+    snprintf(&flagStr[strlen(flagStr)], 256 - strlen(flagStr), "%s%s", \
+             flagStr[0] ? " " : "", name); \
+}
+  ADD_FLAG(flags & TJFLAG_BOTTOMUP, "bottomup");
+  ADD_FLAG(flags & TJFLAG_FASTUPSAMPLE, "fastupsample");
+  ADD_FLAG(flags & TJFLAG_FASTDCT, "fastdct");
+  ADD_FLAG(flags & TJFLAG_ACCURATEDCT, "accuratedct");
+  ADD_FLAG(flags & TJFLAG_PROGRESSIVE, "progressive");
+  ADD_FLAG(!(flags & TJFLAG_NOREALLOC), "alloc");
+  ADD_FLAG(flags & TJFLAG_STOPONWARNING, "stoponwarning");
+  if (xform) {
+    ADD_FLAG(xformOp != TJXOP_NONE, xformName[xformOp]);
+    ADD_FLAG(xformOpt & TJXOPT_GRAY, "grayscale");
+    ADD_FLAG(xformOpt & TJXOPT_SCALE2, "dctscale=1/2");
+    ADD_FLAG(xformOpt & TJXOPT_SCALE4, "dctscale=1/4");
+    ADD_FLAG(xformOpt & TJXOPT_SCALE8, "dctscale=1/8");
+    ADD_FLAG(xformOpt & TJXOPT_COPYNONE, "copynone");
+    ADD_FLAG(customFilter, "custom");
+  }
+
+  if (reportFormat == REPORT_JSON)
+    fprintf(reportFile, "%s\n  {", nRecords ? "," : "");
+#define BEGIN_FIELD() { \
+  if (reportFormat == REPORT_JSON) \
+    fprintf(reportFile, "%s\"%s\": ", i ? ", " : "", recordFields[i]); \
+  else if (i) fputc(',', reportFile); \
+  i++; \
+}
+  BEGIN_FIELD();  writeString(fileName);
+  BEGIN_FIELD();  writeString(op);
+  BEGIN_FIELD();  writeString(pixFormatStr[pf]);
+  BEGIN_FIELD();  writeString(subName[subsamp]);
+  BEGIN_FIELD();
+  if (jpegQual > 0) fprintf(reportFile, "%d", jpegQual);
+  else if (reportFormat == REPORT_JSON) fprintf(reportFile, "null");
+  snprintf(tempStr, 80, "%d/%d", scale.num, scale.denom);
+  BEGIN_FIELD();  writeString(tempStr);
+  BEGIN_FIELD();  fprintf(reportFile, "%d", tilew);
+  BEGIN_FIELD();  fprintf(reportFile, "%d", tileh);
+  BEGIN_FIELD();  writeString(flagStr);
+  BEGIN_FIELD();  fprintf(reportFile, "%d", max(nThreads, 1));
+  BEGIN_FIELD();  writeString(tjGetSIMDName());
+  BEGIN_FIELD();  fprintf(reportFile, "%d", iter);
+  BEGIN_FIELD();  fprintf(reportFile, "%f", fps);
+  BEGIN_FIELD();  fprintf(reportFile, "%f", pixels / 1000000. * fps);
+  BEGIN_FIELD();  fprintf(reportFile, "%lu", size);
+  BEGIN_FIELD();  fprintf(reportFile, "%f", tmin * 1000.);
+  BEGIN_FIELD();  fprintf(reportFile, "%f", tp50 * 1000.);
+  BEGIN_FIELD();  fprintf(reportFile, "%f", tp99 * 1000.);
+  if (reportFormat == REPORT_JSON) fputc('}', reportFile);
+  else fputc('\n', reportFile);
+  nRecords++;
+#undef ADD_FLAG
+#undef BEGIN_FIELD
+}
+
+
 /* Decompression test */
 static int decomp(unsigned char *srcBuf, unsigned char **jpegBuf,
                   unsigned long *jpegSize, unsigned char *dstBuf, int w, int h,
@@ -144,14 +825,16 @@ static int decomp(unsigned char *srcBuf, unsigned char **jpegBuf,
   char tempStr[1024], sizeStr[24] = "\0", qualStr[13] = "\0", *ptr;
   FILE *file = NULL;
   tjhandle handle = NULL;
-  int row, col, iter = 0, dstBufAlloc = 0, retval = 0;
-  double elapsed, elapsedDecode;
+  int row, col, dstBufAlloc = 0, retval = 0;
+  double fps, fpsDecode;
   int ps = tjPixelSize[pf];
   int scaledw = TJSCALED(w, sf);
   int scaledh = TJSCALED(h, sf);
   int pitch = scaledw * ps;
-  int ntilesw = (w + tilew - 1) / tilew, ntilesh = (h + tileh - 1) / tileh;
-  unsigned char *dstPtr, *dstPtr2, *yuvBuf = NULL;
+  int i, ntiles = ((w + tilew - 1) / tilew) * ((h + tileh - 1) / tileh);
+  unsigned char *yuvBuf = NULL;
+  unsigned long yuvSize = 0, totalJpegSize = 0;
+  benchStats stats;
 
   if (jpegQual > 0) {
     snprintf(qualStr, 13, "_Q%d", jpegQual);
@@ -176,8 +859,8 @@ static int decomp(unsigned char *srcBuf, unsigned char **jpegBuf,
   if (doYUV) {
     int width = doTile ? tilew : scaledw;
     int height = doTile ? tileh : scaledh;
-    unsigned long yuvSize = tjBufSizeYUV2(width, yuvPad, height, subsamp);
 
+    yuvSize = tjBufSizeYUV2(width, yuvPad, height, subsamp);
     if (yuvSize == (unsigned long)-1)
       THROW_TJ("allocating YUV buffer");
     if ((yuvBuf = (unsigned char *)malloc(yuvSize)) == NULL)
@@ -186,73 +869,47 @@ static int decomp(unsigned char *srcBuf, unsigned char **jpegBuf,
   }
 
   /* Benchmark */
-  iter = -1;
-  elapsed = elapsedDecode = 0.;
-  while (1) {
-    int tile = 0;
-    double start = getTime();
-
-    for (row = 0, dstPtr = dstBuf; row < ntilesh;
-         row++, dstPtr += (size_t)pitch * tileh) {
-      for (col = 0, dstPtr2 = dstPtr; col < ntilesw;
-           col++, tile++, dstPtr2 += ps * tilew) {
-        int width = doTile ? min(tilew, w - col * tilew) : scaledw;
-        int height = doTile ? min(tileh, h - row * tileh) : scaledh;
-
-        if (doYUV) {
-          double startDecode;
-
-          if (tjDecompressToYUV2(handle, jpegBuf[tile], jpegSize[tile], yuvBuf,
-                                 width, yuvPad, height, flags) == -1)
-            THROW_TJ("executing tjDecompressToYUV2()");
-          startDecode = getTime();
-          if (tjDecodeYUV(handle, yuvBuf, yuvPad, subsamp, dstPtr2, width,
-                          pitch, height, pf, flags) == -1)
-            THROW_TJ("executing tjDecodeYUV()");
-          if (iter >= 0) elapsedDecode += getTime() - startDecode;
-        } else if (tjDecompress2(handle, jpegBuf[tile], jpegSize[tile],
-                                 dstPtr2, width, pitch, height, pf,
-                                 flags) == -1)
-          THROW_TJ("executing tjDecompress2()");
-      }
-    }
-    elapsed += getTime() - start;
-    if (iter >= 0) {
-      iter++;
-      if (elapsed >= benchTime) break;
-    } else if (elapsed >= warmup) {
-      iter = 0;
-      elapsed = elapsedDecode = 0.;
-    }
+  if (runBench(0, handle, NULL, jpegBuf, jpegSize, dstBuf, yuvBuf, w, h,
+               subsamp, 0, tilew, tileh, &stats) == -1) {
+    retval = -1;  goto bailout;
   }
-  if (doYUV) elapsed -= elapsedDecode;
+  fps = stats.fps;  fpsDecode = stats.fpsYUV;
 
-  if (tjDestroy(handle) == -1) THROW_TJ("executing tjDestroy()");
-  handle = NULL;
+  for (i = 0; i < ntiles; i++) totalJpegSize += jpegSize[i];
+  writeRecord(fileName, doYUV ? "decompress_to_yuv" : "decompress", subsamp,
+              jpegQual, sf, tilew, tileh, 0, stats.totalIter, fps,
+              (double)(w * h), totalJpegSize, stats.min, stats.p50, stats.p99);
+  if (doYUV)
+    writeRecord(fileName, "decode_yuv", subsamp, jpegQual, sf, tilew, tileh,
+                0, stats.totalIter, fpsDecode, (double)(w * h), yuvSize,
+                stats.minYUV, stats.p50YUV, stats.p99YUV);
 
   if (quiet) {
     printf("%-6s%s",
-           sigfig((double)(w * h) / 1000000. * (double)iter / elapsed, 4,
-                  tempStr, 1024),
+           sigfig((double)(w * h) / 1000000. * fps, 4, tempStr, 1024),
            quiet == 2 ? "\n" : "  ");
     if (doYUV)
       printf("%s\n",
-             sigfig((double)(w * h) / 1000000. * (double)iter / elapsedDecode,
-                    4, tempStr, 1024));
+             sigfig((double)(w * h) / 1000000. * fpsDecode, 4, tempStr, 1024));
     else if (quiet != 2) printf("\n");
   } else {
     printf("%s --> Frame rate:         %f fps\n",
-           doYUV ? "Decomp to YUV" : "Decompress   ", (double)iter / elapsed);
+           doYUV ? "Decomp to YUV" : "Decompress   ", fps);
     printf("                  Throughput:         %f Megapixels/sec\n",
-           (double)(w * h) / 1000000. * (double)iter / elapsed);
+           (double)(w * h) / 1000000. * fps);
     if (doYUV) {
-      printf("YUV Decode    --> Frame rate:         %f fps\n",
-             (double)iter / elapsedDecode);
+      printf("YUV Decode    --> Frame rate:         %f fps\n", fpsDecode);
       printf("                  Throughput:         %f Megapixels/sec\n",
-             (double)(w * h) / 1000000. * (double)iter / elapsedDecode);
+             (double)(w * h) / 1000000. * fpsDecode);
     }
+    if (nThreads > 0) printThreadStats(&stats);
+    if (doProfile && printProfile(handle, stats.iter, (double)(w * h)) == -1)
+      goto bailout;
   }
 
+  if (tjDestroy(handle) == -1) THROW_TJ("executing tjDestroy()");
+  handle = NULL;
+
   if (!doWrite) goto bailout;
 
   if (sf.num != 1 || sf.denom != 1)
@@ -316,15 +973,15 @@ static int fullTest(unsigned char *srcBuf, int w, int h, int subsamp,
   char tempStr[1024], tempStr2[80];
   FILE *file = NULL;
   tjhandle handle = NULL;
-  unsigned char **jpegBuf = NULL, *yuvBuf = NULL, *tmpBuf = NULL, *srcPtr,
-    *srcPtr2;
-  double start, elapsed, elapsedEncode;
-  int totalJpegSize = 0, row, col, i, tilew = w, tileh = h, retval = 0;
-  int iter;
+  unsigned char **jpegBuf = NULL, *yuvBuf = NULL, *tmpBuf = NULL;
+  double fps, fpsEncode;
+  int totalJpegSize = 0, i, tilew = w, tileh = h, retval = 0;
+  tjscalingfactor noScale = { 1, 1 };
   unsigned long *jpegSize = NULL, yuvSize = 0;
   int ps = tjPixelSize[pf];
   int ntilesw = 1, ntilesh = 1, pitch = w * ps;
   const char *pfStr = pixFormatStr[pf];
+  benchStats stats;
 
   if ((unsigned long long)pitch * (unsigned long long)h >
       (unsigned long long)((size_t)-1))
@@ -382,64 +1039,31 @@ static int fullTest(unsigned char *srcBuf, int w, int h, int subsamp,
     }
 
     /* Benchmark */
-    iter = -1;
-    elapsed = elapsedEncode = 0.;
-    while (1) {
-      int tile = 0;
-
-      totalJpegSize = 0;
-      start = getTime();
-      for (row = 0, srcPtr = srcBuf; row < ntilesh;
-           row++, srcPtr += pitch * tileh) {
-        for (col = 0, srcPtr2 = srcPtr; col < ntilesw;
-             col++, tile++, srcPtr2 += ps * tilew) {
-          int width = min(tilew, w - col * tilew);
-          int height = min(tileh, h - row * tileh);
-
-          if (doYUV) {
-            double startEncode = getTime();
-
-            if (tjEncodeYUV3(handle, srcPtr2, width, pitch, height, pf, yuvBuf,
-                             yuvPad, subsamp, flags) == -1)
-              THROW_TJ("executing tjEncodeYUV3()");
-            if (iter >= 0) elapsedEncode += getTime() - startEncode;
-            if (tjCompressFromYUV(handle, yuvBuf, width, yuvPad, height,
-                                  subsamp, &jpegBuf[tile], &jpegSize[tile],
-                                  jpegQual, flags) == -1)
-              THROW_TJ("executing tjCompressFromYUV()");
-          } else {
-            if (tjCompress2(handle, srcPtr2, width, pitch, height, pf,
-                            &jpegBuf[tile], &jpegSize[tile], subsamp, jpegQual,
-                            flags) == -1)
-              THROW_TJ("executing tjCompress2()");
-          }
-          totalJpegSize += jpegSize[tile];
-        }
-      }
-      elapsed += getTime() - start;
-      if (iter >= 0) {
-        iter++;
-        if (elapsed >= benchTime) break;
-      } else if (elapsed >= warmup) {
-        iter = 0;
-        elapsed = elapsedEncode = 0.;
-      }
+    if (runBench(1, handle, srcBuf, jpegBuf, jpegSize, NULL, yuvBuf, w, h,
+                 subsamp, jpegQual, tilew, tileh, &stats) == -1) {
+      retval = -1;  goto bailout;
     }
-    if (doYUV) elapsed -= elapsedEncode;
+    fps = stats.fps;  fpsEncode = stats.fpsYUV;
+    totalJpegSize = stats.totalJpegSize;
 
-    if (tjDestroy(handle) == -1) THROW_TJ("executing tjDestroy()");
-    handle = NULL;
+    if (doYUV)
+      writeRecord(fileName, "encode_yuv", subsamp, jpegQual, noScale, tilew,
+                  tileh, 0, stats.totalIter, fpsEncode, (double)(w * h),
+                  yuvSize, stats.minYUV, stats.p50YUV, stats.p99YUV);
+    writeRecord(fileName, doYUV ? "compress_from_yuv" : "compress", subsamp,
+                jpegQual, noScale, tilew, tileh, 0, stats.totalIter, fps,
+                (double)(w * h), totalJpegSize, stats.min, stats.p50,
+                stats.p99);
 
     if (quiet == 1) printf("%-5d  %-5d   ", tilew, tileh);
     if (quiet) {
       if (doYUV)
         printf("%-6s%s",
-               sigfig((double)(w * h) / 1000000. *
-                      (double)iter / elapsedEncode, 4, tempStr, 1024),
+               sigfig((double)(w * h) / 1000000. * fpsEncode, 4, tempStr,
+                      1024),
                quiet == 2 ? "\n" : "  ");
       printf("%-6s%s",
-             sigfig((double)(w * h) / 1000000. * (double)iter / elapsed, 4,
-                    tempStr, 1024),
+             sigfig((double)(w * h) / 1000000. * fps, 4, tempStr, 1024),
              quiet == 2 ? "\n" : "  ");
       printf("%-6s%s",
              sigfig((double)(w * h * ps) / (double)totalJpegSize, 4, tempStr2,
@@ -448,28 +1072,34 @@ static int fullTest(unsigned char *srcBuf, int w, int h, int subsamp,
     } else {
       printf("\n%s size: %d x %d\n", doTile ? "Tile" : "Image", tilew, tileh);
       if (doYUV) {
-        printf("Encode YUV    --> Frame rate:         %f fps\n",
-               (double)iter / elapsedEncode);
+        printf("Encode YUV    --> Frame rate:         %f fps\n", fpsEncode);
         printf("                  Output image size:  %lu bytes\n", yuvSize);
         printf("                  Compression ratio:  %f:1\n",
                (double)(w * h * ps) / (double)yuvSize);
         printf("                  Throughput:         %f Megapixels/sec\n",
-               (double)(w * h) / 1000000. * (double)iter / elapsedEncode);
+               (double)(w * h) / 1000000. * fpsEncode);
         printf("                  Output bit stream:  %f Megabits/sec\n",
-               (double)yuvSize * 8. / 1000000. * (double)iter / elapsedEncode);
+               (double)yuvSize * 8. / 1000000. * fpsEncode);
       }
       printf("%s --> Frame rate:         %f fps\n",
-             doYUV ? "Comp from YUV" : "Compress     ",
-             (double)iter / elapsed);
+             doYUV ? "Comp from YUV" : "Compress     ", fps);
       printf("                  Output image size:  %d bytes\n",
              totalJpegSize);
       printf("                  Compression ratio:  %f:1\n",
              (double)(w * h * ps) / (double)totalJpegSize);
       printf("                  Throughput:         %f Megapixels/sec\n",
-             (double)(w * h) / 1000000. * (double)iter / elapsed);
+             (double)(w * h) / 1000000. * fps);
       printf("                  Output bit stream:  %f Megabits/sec\n",
-             (double)totalJpegSize * 8. / 1000000. * (double)iter / elapsed);
+             (double)totalJpegSize * 8. / 1000000. * fps);
+      if (nThreads > 0) printThreadStats(&stats);
+      if (doProfile &&
+          printProfile(handle, stats.iter, (double)(w * h)) == -1)
+        goto bailout;
     }
+
+    if (tjDestroy(handle) == -1) THROW_TJ("executing tjDestroy()");
+    handle = NULL;
+
     if (tilew == w && tileh == h && doWrite) {
       snprintf(tempStr, 1024, "%s_%s_Q%d.jpg", fileName, subName[subsamp],
                jpegQual);
@@ -523,7 +1153,9 @@ static int decompTest(char *fileName)
   unsigned char **jpegBuf = NULL, *srcBuf = NULL;
   unsigned long *jpegSize = NULL, srcSize, totalJpegSize;
   tjtransform *t = NULL;
-  double start, elapsed;
+  tjscalingfactor noScale = { 1, 1 };
+  timeList times = { NULL, 0, 0 };
+  double start, elapsed, tmin, tp50, tp99;
   int ps = tjPixelSize[pf], tile, row, col, i, iter, retval = 0, decompsrc = 0;
   char *temp = NULL, tempStr[80], tempStr2[80];
   /* Original image */
@@ -624,6 +1256,12 @@ static int decompTest(char *fileName)
       }
 
       if (xformOpt & TJXOPT_GRAY) tsubsamp = TJ_GRAYSCALE;
+      if (xformOpt & (TJXOPT_SCALE2 | TJXOPT_SCALE4 | TJXOPT_SCALE8)) {
+        int xscale = (xformOpt & TJXOPT_SCALE2) ? 2 :
+                     ((xformOpt & TJXOPT_SCALE4) ? 4 : 8);
+
+        tw = (tw + xscale - 1) / xscale;  th = (th + xscale - 1) / xscale;
+      }
       if (xformOp == TJXOP_HFLIP || xformOp == TJXOP_ROT180)
         tw = tw - (tw % tjMCUWidth[tsubsamp]);
       if (xformOp == TJXOP_VFLIP || xformOp == TJXOP_ROT180)
@@ -658,18 +1296,26 @@ static int decompTest(char *fileName)
 
       iter = -1;
       elapsed = 0.;
+      times.n = 0;
       while (1) {
+        double time;
+
         start = getTime();
         if (tjTransform(handle, srcBuf, srcSize, tntilesw * tntilesh, jpegBuf,
                         jpegSize, t, flags) == -1)
           THROW_TJ("executing tjTransform()");
-        elapsed += getTime() - start;
+        time = getTime() - start;
+        elapsed += time;
         if (iter >= 0) {
           iter++;
+          if (addTime(&times, time) == -1)
+            THROW_UNIX("allocating time list");
           if (elapsed >= benchTime) break;
         } else if (elapsed >= warmup) {
           iter = 0;
           elapsed = 0.;
+          if (doProfile && tjEnableProfiling(handle, 1) == -1)
+            THROW_TJ("executing tjEnableProfiling()");
         }
       }
 
@@ -678,24 +1324,33 @@ static int decompTest(char *fileName)
       for (tile = 0, totalJpegSize = 0; tile < tntilesw * tntilesh; tile++)
         totalJpegSize += jpegSize[tile];
 
+      getTimeStats(&times, &tmin, &tp50, &tp99);
+      writeRecord(fileName, "transform", subsamp, 0, noScale, tilew, tileh, 1,
+                  iter, (double)iter / elapsed, (double)(w * h), totalJpegSize,
+                  tmin, tp50, tp99);
+
       if (quiet) {
         printf("%-6s%s%-6s%s",
-               sigfig((double)(w * h) / 1000000. / elapsed, 4, tempStr, 80),
+               sigfig((double)(w * h) / 1000000. * (double)iter / elapsed, 4,
+                      tempStr, 80),
                quiet == 2 ? "\n" : "  ",
                sigfig((double)(w * h * ps) / (double)totalJpegSize, 4,
                       tempStr2, 80),
                quiet == 2 ? "\n" : "  ");
       } else if (!quiet) {
         printf("Transform     --> Frame rate:         %f fps\n",
-               1.0 / elapsed);
+               (double)iter / elapsed);
         printf("                  Output image size:  %lu bytes\n",
                totalJpegSize);
         printf("                  Compression ratio:  %f:1\n",
                (double)(w * h * ps) / (double)totalJpegSize);
         printf("                  Throughput:         %f Megapixels/sec\n",
-               (double)(w * h) / 1000000. / elapsed);
+               (double)(w * h) / 1000000. * (double)iter / elapsed);
         printf("                  Output bit stream:  %f Megabits/sec\n",
-               (double)totalJpegSize * 8. / 1000000. / elapsed);
+               (double)totalJpegSize * 8. / 1000000. * (double)iter /
+               elapsed);
+        if (doProfile && printProfile(handle, iter, (double)(w * h)) == -1)
+          goto bailout;
       }
     } else {
       if (quiet == 1) printf("N/A     N/A     ");
@@ -733,11 +1388,92 @@ bailout:
   free(jpegSize);
   free(srcBuf);
   free(t);
+  free(times.times);
   if (handle) { tjDestroy(handle);  handle = NULL; }
   return retval;
 }
 
 
+static int compareStrings(const void *arg1, const void *arg2)
+{
+  return strcmp(*(char * const *)arg1, *(char * const *)arg2);
+}
+
+
+/* Add a file name to a list if it has a JPEG extension */
+static int addJPEGName(char ***names, int *nnames, const char *name)
+{
+  const char *temp = strrchr(name, '.');
+  char **tmp;
+
+  if (temp == NULL ||
+      (strcasecmp(temp, ".jpg") && strcasecmp(temp, ".jpeg")))
+    return 0;
+  if ((tmp = (char **)realloc(*names, sizeof(char *) * (*nnames + 1))) ==
+      NULL)
+    return -1;
+  *names = tmp;
+  if (((*names)[*nnames] = (char *)malloc(strlen(name) + 1)) == NULL)
+    return -1;
+  strcpy((*names)[(*nnames)++], name);
+  return 0;
+}
+
+
+/* Corpus mode:  run the decompression/transform test on each JPEG file in a
+   directory, in alphabetical order */
+static int corpusTest(char *dirName)
+{
+  char **names = NULL, path[1024];
+  int nnames = 0, i, savePF = pf, retval = 0;
+#ifdef _WIN32
+  WIN32_FIND_DATAA findData;
+  HANDLE find;
+
+  snprintf(path, 1024, "%s\\*", dirName);
+  if ((find = FindFirstFileA(path, &findData)) == INVALID_HANDLE_VALUE)
+    THROW("opening directory", "Could not list directory");
+  do {
+    if (addJPEGName(&names, &nnames, findData.cFileName) == -1) {
+      FindClose(find);
+      THROW_UNIX("allocating file list");
+    }
+  } while (FindNextFileA(find, &findData));
+  FindClose(find);
+#else
+  DIR *dir;
+  struct dirent *entry;
+
+  if ((dir = opendir(dirName)) == NULL)
+    THROW_UNIX("opening directory");
+  while ((entry = readdir(dir)) != NULL) {
+    if (addJPEGName(&names, &nnames, entry->d_name) == -1) {
+      closedir(dir);
+      THROW_UNIX("allocating file list");
+    }
+  }
+  closedir(dir);
+#endif
+  if (nnames == 0)
+    THROW("reading directory", "No JPEG files found");
+  qsort(names, nnames, sizeof(char *), compareStrings);
+
+  for (i = 0; i < nnames; i++) {
+    snprintf(path, 1024, "%s/%s", dirName, names[i]);
+    if (quiet != 2) printf("%s:\n\n", path);
+    pf = savePF;
+    if (decompTest(path) == -1) retval = -1;
+    printf("\n");
+  }
+
+bailout:
+  for (i = 0; i < nnames; i++) free(names[i]);
+  free(names);
+  pf = savePF;
+  return retval;
+}
+
+
 static void usage(char *progName)
 {
   int i;
@@ -746,6 +1482,8 @@ static void usage(char *progName)
   printf("       <Inputfile (BMP|PPM)> <Quality> [options]\n\n");
   printf("       %s\n", progName);
   printf("       <Inputfile (JPG)> [options]\n\n");
+  printf("       %s\n", progName);
+  printf("       <Directory containing JPG files> [options]\n\n");
   printf("Options:\n\n");
   printf("-alloc = Dynamically allocate JPEG image buffers\n");
   printf("-bmp = Generate output images in Windows Bitmap format (default = PPM)\n");
@@ -791,6 +1529,9 @@ static void usage(char *progName)
   printf("     decompression (these options are mutually exclusive)\n");
   printf("-grayscale = Perform lossless grayscale conversion prior to decompression\n");
   printf("     test (can be combined with the other transforms above)\n");
+  printf("-dctscale 1/N = Reduce the width/height of the image by a factor of N\n");
+  printf("     (N = 2, 4, or 8) in the DCT domain prior to decompression (cannot be\n");
+  printf("     combined with -hflip, -vflip, etc.)\n");
   printf("-copynone = Do not copy any extra markers (including EXIF and ICC profile data)\n");
   printf("     when transforming the image.\n");
   printf("-benchtime <t> = Run each benchmark for at least <t> seconds (default = 5.0)\n");
@@ -800,11 +1541,27 @@ static void usage(char *progName)
   printf("-componly = Stop after running compression tests.  Do not test decompression.\n");
   printf("-nowrite = Do not write reference or output images (improves consistency of\n");
   printf("     performance measurements.)\n");
+  printf("-profile = Report the time spent in each stage of the underlying codec\n");
+  printf("     during each benchmark (requires a codec built with WITH_PROFILE=1).\n");
+  printf("     This option is ignored if -threads is specified.\n");
+  printf("-threads <n> = Run each compression/decompression benchmark in <n>\n");
+  printf("     concurrent threads, each with its own TurboJPEG instance, and report the\n");
+  printf("     aggregate throughput along with the mean and standard deviation of the\n");
+  printf("     per-thread throughput and the median (p50) and 99th-percentile (p99)\n");
+  printf("     time required to compress/decompress one image\n");
+  printf("-pin = When used with -threads, pin each thread to a separate CPU (cycling\n");
+  printf("     through the CPUs that the process is allowed to use)\n");
+  printf("-json <file>, -csv <file> = Also write the results to <file> in JSON or CSV\n");
+  printf("     format, with one record per benchmark (including the throughput,\n");
+  printf("     compressed size, minimum/median/99th-percentile time per iteration, and\n");
+  printf("     the SIMD instruction set extension in use)\n");
   printf("-stoponwarning = Immediately discontinue the current\n");
   printf("     compression/decompression/transform operation if the underlying codec\n");
   printf("     throws a warning (non-fatal error)\n\n");
   printf("NOTE:  If the quality is specified as a range (e.g. 90-100), a separate\n");
   printf("test will be performed for all quality values in the range.\n\n");
+  printf("NOTE:  If a directory is specified, then each JPEG file in the directory\n");
+  printf("is tested in turn, and output images are not written.\n\n");
   exit(1);
 }
 
@@ -813,8 +1570,9 @@ int main(int argc, char *argv[])
 {
   unsigned char *srcBuf = NULL;
   int w = 0, h = 0, i, j, minQual = -1, maxQual = -1;
-  char *temp;
-  int minArg = 2, retval = 0, subsamp = -1;
+  char *temp, *reportName = NULL;
+  int minArg = 2, retval = 0, subsamp = -1, corpus = 0, format = 0;
+  struct stat st;
 
   if ((scalingFactors = tjGetScalingFactors(&nsf)) == NULL || nsf == 0)
     THROW("executing tjGetScalingFactors()", tjGetErrorStr());
@@ -827,6 +1585,9 @@ int main(int argc, char *argv[])
     if (!strcasecmp(temp, ".jpg") || !strcasecmp(temp, ".jpeg"))
       decompOnly = 1;
   }
+  if (stat(argv[1], &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR) {
+    decompOnly = corpus = 1;  doWrite = 0;
+  }
 
   printf("\n");
 
@@ -909,7 +1670,16 @@ int main(int argc, char *argv[])
         xformOp = TJXOP_ROT270;
       else if (!strcasecmp(argv[i], "-grayscale"))
         xformOpt |= TJXOPT_GRAY;
-      else if (!strcasecmp(argv[i], "-custom"))
+      else if (!strcasecmp(argv[i], "-dctscale") && i < argc - 1) {
+        int temp1 = 0, temp2 = 0;
+
+        if (sscanf(argv[++i], "%d/%d", &temp1, &temp2) != 2 || temp1 != 1)
+          usage(argv[0]);
+        if (temp2 == 2) xformOpt |= TJXOPT_SCALE2;
+        else if (temp2 == 4) xformOpt |= TJXOPT_SCALE4;
+        else if (temp2 == 8) xformOpt |= TJXOPT_SCALE8;
+        else usage(argv[0]);
+      } else if (!strcasecmp(argv[i], "-custom"))
         customFilter = dummyDCTFilter;
       else if (!strcasecmp(argv[i], "-nooutput"))
         xformOpt |= TJXOPT_NOOUTPUT;
@@ -955,6 +1725,24 @@ int main(int argc, char *argv[])
         compOnly = 1;
       else if (!strcasecmp(argv[i], "-nowrite"))
         doWrite = 0;
+      else if (!strcasecmp(argv[i], "-profile"))
+        doProfile = 1;
+      else if (!strcasecmp(argv[i], "-threads") && i < argc - 1) {
+        int tempi = atoi(argv[++i]);
+
+        if (tempi >= 1) nThreads = tempi;
+        else usage(argv[0]);
+      } else if (!strcasecmp(argv[i], "-json") && i < argc - 1) {
+        reportName = argv[++i];  format = REPORT_JSON;
+      } else if (!strcasecmp(argv[i], "-csv") && i < argc - 1) {
+        reportName = argv[++i];  format = REPORT_CSV;
+      } else if (!strcasecmp(argv[i], "-pin")) {
+#if defined(__linux__) || defined(_WIN32)
+        doPin = 1;
+#else
+        printf("CPU pinning is not supported on this platform.\n\n");
+#endif
+      }
       else if (!strcasecmp(argv[i], "-stoponwarning"))
         flags |= TJFLAG_STOPONWARNING;
       else usage(argv[0]);
@@ -973,6 +1761,9 @@ int main(int argc, char *argv[])
     doTile = 0;
   }
 
+  if (reportName && openReport(reportName, format) == -1)
+    THROW_UNIX("opening report file");
+
   if (!decompOnly) {
     if ((srcBuf = tjLoadImage(argv[1], &w, 1, &h, &pf, flags)) == NULL)
       THROW_TJG("loading bitmap");
@@ -995,6 +1786,10 @@ int main(int argc, char *argv[])
     printf("\n\n");
   }
 
+  if (corpus) {
+    corpusTest(argv[1]);
+    goto bailout;
+  }
   if (decompOnly) {
     decompTest(argv[1]);
     printf("\n");
@@ -1022,6 +1817,7 @@ int main(int argc, char *argv[])
   }
 
 bailout:
+  closeReport();
   tjFree(srcBuf);
   return retval;
 }
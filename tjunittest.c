@@ -54,6 +54,11 @@ static void usage(char *progName)
   printf("-noyuvpad = do not pad each line of each Y, U, and V plane to the nearest\n");
   printf("            4-byte boundary\n");
   printf("-alloc = test automatic buffer allocation\n");
+  printf("-stream = test incremental decompression\n");
+  printf("-batch = test batch decompression\n");
+  printf("-multi = test multi-quality compression\n");
+  printf("-multires = test multi-resolution decompression\n");
+  printf("-chunks = test compression to a list of chunks and to a callback\n");
   printf("-bmp = tjLoadImage()/tjSaveImage() unit test\n\n");
   exit(1);
 }
@@ -90,7 +95,8 @@ const int _4byteFormats[] = {
 const int _onlyGray[] = { TJPF_GRAY };
 const int _onlyRGB[] = { TJPF_RGB };
 
-int doYUV = 0, alloc = 0, pad = 4;
+int doYUV = 0, alloc = 0, doStream = 0, doBatch = 0, doMulti = 0,
+  doMultiRes = 0, doChunks = 0, pad = 4;
 
 int exitStatus = 0;
 #define BAILOUT() { exitStatus = -1;  goto bailout; }
@@ -357,6 +363,200 @@ bailout:
 }
 
 
+/* Compress the source image at three quality levels in one call, and ensure
+   that the JPEG images with the requested quality level and with a quality
+   level that uses the other DCT method are identical to the ones produced by
+   tjCompress2().  Then ensure that searching for the highest quality level
+   that fits in the size of the first JPEG image finds an image that fits and
+   is identical to the one produced by tjCompress2(). */
+
+static int multiCompress(tjhandle handle, unsigned char *srcBuf, int w, int h,
+                         int pf, unsigned char **dstBuf,
+                         unsigned long *dstSize, int subsamp, int jpegQual,
+                         int flags)
+{
+  unsigned char *jpegBufs[3] = { NULL, NULL, NULL }, *refBuf = NULL;
+  unsigned long jpegSizes[3] = { 0, 0, 0 }, refSize = 0;
+  int jpegQuals[3], i, quality = jpegQual, retval = 0;
+
+  if ((retval = tjCompress2(handle, srcBuf, w, 0, h, pf, dstBuf, dstSize,
+                            subsamp, jpegQual, flags)) == -1)
+    goto bailout;
+
+  /* TurboJPEG uses the accurate integer DCT for quality levels >= 96 and the
+     fast integer DCT otherwise.  Save the DCT output at a lower quality level
+     that uses the same DCT method as the requested quality level, so that the
+     requested quality level is compressed from the saved DCT output, and
+     compress another quality level on the other side of the switch in
+     between, so that the DCT output for both methods is saved. */
+  jpegQuals[0] = jpegQual >= 96 ? 96 : jpegQual / 2 + 1;
+  jpegQuals[1] = jpegQual >= 96 ? 95 : 96;
+  jpegQuals[2] = jpegQual;
+  for (i = 0; i < 3; i++) {
+    if (flags & TJFLAG_NOREALLOC) {
+      jpegSizes[i] = tjBufSize(w, h, subsamp);
+      if ((jpegBufs[i] = tjAlloc(jpegSizes[i])) == NULL)
+        THROW("Memory allocation failure");
+    }
+  }
+  if ((retval = tjCompressMulti(handle, srcBuf, w, 0, h, pf, jpegBufs,
+                                jpegSizes, subsamp, jpegQuals, 3,
+                                flags)) == -1)
+    goto bailout;
+  if (jpegSizes[2] != *dstSize || memcmp(jpegBufs[2], *dstBuf, *dstSize))
+    THROW("Multi-quality JPEG image differs");
+  if (jpegSizes[0] > jpegSizes[2])
+    THROW("Lower-quality JPEG image is larger");
+
+  if (flags & TJFLAG_NOREALLOC) {
+    refSize = tjBufSize(w, h, subsamp);
+    if ((refBuf = tjAlloc(refSize)) == NULL)
+      THROW("Memory allocation failure");
+  }
+  if ((retval = tjCompress2(handle, srcBuf, w, 0, h, pf, &refBuf, &refSize,
+                            subsamp, jpegQuals[1], flags)) == -1)
+    goto bailout;
+  if (jpegSizes[1] != refSize || memcmp(jpegBufs[1], refBuf, refSize))
+    THROW("Multi-quality JPEG image with other DCT method differs");
+
+  if (!(flags & TJFLAG_NOREALLOC)) {
+    tjFree(jpegBufs[0]);
+    jpegBufs[0] = NULL;
+  }
+  if ((retval = tjCompressToSize(handle, srcBuf, w, 0, h, pf, &jpegBufs[0],
+                                 &jpegSizes[0], subsamp, &quality, *dstSize,
+                                 flags)) == -1)
+    goto bailout;
+  if (quality < 1 || quality > jpegQual || jpegSizes[0] > *dstSize)
+    THROW("Size-targeted JPEG image is too large");
+
+  /* JPEG image size does not always increase with quality level, so the
+     search may settle on a lower quality level than requested.  In any case,
+     the JPEG image should be the same as one produced by tjCompress2(). */
+  if (flags & TJFLAG_NOREALLOC)
+    jpegSizes[1] = tjBufSize(w, h, subsamp);
+  else {
+    tjFree(jpegBufs[1]);
+    jpegBufs[1] = NULL;
+  }
+  if ((retval = tjCompress2(handle, srcBuf, w, 0, h, pf, &jpegBufs[1],
+                            &jpegSizes[1], subsamp, quality, flags)) == -1)
+    goto bailout;
+  if (jpegSizes[0] != jpegSizes[1] ||
+      memcmp(jpegBufs[0], jpegBufs[1], jpegSizes[0]))
+    THROW("Size-targeted JPEG image differs");
+
+bailout:
+  for (i = 0; i < 3; i++) tjFree(jpegBufs[i]);
+  tjFree(refBuf);
+  return retval;
+}
+
+
+typedef struct {
+  unsigned char *buf;
+  unsigned long size, maxSize;
+  int calls, failAfter;
+} writeState;
+
+static int writeFunc(const unsigned char *data, unsigned long size,
+                     void *userData)
+{
+  writeState *state = (writeState *)userData;
+
+  if (state->failAfter >= 0 && state->calls >= state->failAfter) return -1;
+  state->calls++;
+  if (size > 4096 || state->size + size > state->maxSize) return -1;
+  memcpy(&state->buf[state->size], data, size);
+  state->size += size;
+  return 0;
+}
+
+/* Compress the image with tjCompress2(), then ensure that the concatenated
+   output of tjCompressToChunks() and tjCompressToCallback() is identical to
+   it, that every chunk except the last is full, and that a failing callback
+   makes the compression fail. */
+
+static int chunkCompress(tjhandle handle, unsigned char *srcBuf, int w, int h,
+                         int pf, unsigned char **dstBuf,
+                         unsigned long *dstSize, int subsamp, int jpegQual,
+                         int flags)
+{
+  tjchunk *chunks = NULL;
+  int numChunks = 0, i, retval = 0;
+  unsigned long offset = 0;
+  writeState state = { NULL, 0, 0, 0, -1 };
+
+  if ((retval = tjCompress2(handle, srcBuf, w, 0, h, pf, dstBuf, dstSize,
+                            subsamp, jpegQual, flags)) == -1)
+    goto bailout;
+
+  if ((retval = tjCompressToChunks(handle, srcBuf, w, 0, h, pf, &chunks,
+                                   &numChunks, subsamp, jpegQual,
+                                   flags)) == -1)
+    goto bailout;
+  if (numChunks < 1) THROW("No JPEG chunks were generated");
+  for (i = 0; i < numChunks; i++) {
+    if (i < numChunks - 1 && chunks[i].size != chunks[0].size)
+      THROW("JPEG chunk is not full");
+    if (chunks[i].size < 1 || offset + chunks[i].size > *dstSize ||
+        memcmp(&(*dstBuf)[offset], chunks[i].data, chunks[i].size))
+      THROW("Chunked JPEG image differs");
+    offset += chunks[i].size;
+  }
+  if (offset != *dstSize) THROW("Chunked JPEG image differs");
+
+  state.maxSize = *dstSize;
+  if ((state.buf = (unsigned char *)malloc(state.maxSize)) == NULL)
+    THROW("Memory allocation failure");
+  if ((retval = tjCompressToCallback(handle, srcBuf, w, 0, h, pf, writeFunc,
+                                     &state, subsamp, jpegQual, flags)) == -1)
+    goto bailout;
+  if (state.size != *dstSize || memcmp(state.buf, *dstBuf, *dstSize))
+    THROW("JPEG image written to callback differs");
+
+  state.size = 0;
+  state.failAfter = state.calls / 2;
+  state.calls = 0;
+  if (tjCompressToCallback(handle, srcBuf, w, 0, h, pf, writeFunc, &state,
+                           subsamp, jpegQual, flags) != -1)
+    THROW("Failing callback did not cause an error");
+
+bailout:
+  tjFreeChunks(chunks, numChunks);
+  free(state.buf);
+  return retval;
+}
+
+
+/* The images generated by the other tests fit in one chunk, so compress an
+   image of random noise that spans many chunks. */
+
+static void largeChunkTest(void)
+{
+  int w = 512, h = 512, i;
+  unsigned char *srcBuf = NULL, *dstBuf = NULL;
+  unsigned long dstSize = 0;
+  tjhandle handle = NULL;
+
+  if ((handle = tjInitCompress()) == NULL) THROW_TJ();
+
+  printf("Large chunked JPEG image test ... ");
+  if ((srcBuf = (unsigned char *)malloc(w * h * 3)) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < w * h * 3; i++)
+    srcBuf[i] = (unsigned char)(random() % 256);
+  TRY_TJ(chunkCompress(handle, srcBuf, w, h, TJPF_RGB, &dstBuf, &dstSize,
+                       TJSAMP_444, 100, TJFLAG_PROGRESSIVE));
+  printf("Passed.\n");
+
+bailout:
+  free(srcBuf);
+  tjFree(dstBuf);
+  if (handle) tjDestroy(handle);
+}
+
+
 static void compTest(tjhandle handle, unsigned char **dstBuf,
                      unsigned long *dstSize, int w, int h, int pf,
                      char *basename, int subsamp, int jpegQual, int flags)
@@ -400,8 +600,15 @@ static void compTest(tjhandle handle, unsigned char **dstBuf,
   } else {
     printf("%s %s -> %s Q%d ... ", pfStr, buStrLong, subNameLong[subsamp],
            jpegQual);
-    TRY_TJ(tjCompress2(handle, srcBuf, w, 0, h, pf, dstBuf, dstSize, subsamp,
-                       jpegQual, flags));
+    if (doMulti)
+      TRY_TJ(multiCompress(handle, srcBuf, w, h, pf, dstBuf, dstSize, subsamp,
+                           jpegQual, flags))
+    else if (doChunks)
+      TRY_TJ(chunkCompress(handle, srcBuf, w, h, pf, dstBuf, dstSize, subsamp,
+                           jpegQual, flags))
+    else
+      TRY_TJ(tjCompress2(handle, srcBuf, w, 0, h, pf, dstBuf, dstSize,
+                         subsamp, jpegQual, flags));
   }
 
   snprintf(tempStr, 1024, "%s_enc_%s_%s_%s_Q%d.jpg", basename, pfStr, buStr,
@@ -415,6 +622,255 @@ bailout:
 }
 
 
+/* Push the JPEG image to the decompressor with the second half of its
+   entropy-coded data missing, and ensure that the rows decompressed so far
+   match those of the complete image (refBuf.)  Truncating the image by ending
+   the stream should cause tjDecompressStreamFinish() to report a warning, and
+   truncating it by appending an EOI marker should cause
+   tjDecompressStreamRows() to report a warning without abandoning the
+   stream. */
+
+static int streamTruncDecompress(tjhandle handle, unsigned char *jpegBuf,
+                                 unsigned long jpegSize, unsigned char *refBuf,
+                                 int w, int h, int pf, int flags)
+{
+  static const unsigned char eoi[2] = { 0xFF, 0xD9 };
+  unsigned char *dstBuf = NULL;
+  unsigned long i, truncSize = 0;
+  int width, height, subsamp, colorspace, rows, row, pass, retval = 0;
+  size_t pitch = (size_t)w * tjPixelSize[pf];
+
+  for (i = 0; i + 3 < jpegSize; i++) {
+    if (jpegBuf[i] == 0xFF && jpegBuf[i + 1] == 0xDA) {
+      truncSize = i + 2 + ((jpegBuf[i + 2] << 8) | jpegBuf[i + 3]);
+      break;
+    }
+  }
+  if (truncSize == 0 || truncSize >= jpegSize)
+    THROW("Could not find SOS marker");
+  truncSize += (jpegSize - truncSize) / 2;
+
+  if ((dstBuf = (unsigned char *)malloc(pitch * h)) == NULL)
+    THROW("Memory allocation failure");
+
+  for (pass = 0; pass < 2; pass++) {
+    if (tjDecompressStreamHeader(handle, jpegBuf, truncSize, &width, &height,
+                                 &subsamp, &colorspace) != 0)
+      THROW("Could not read JPEG header from truncated stream");
+    rows = tjDecompressStreamRows(handle, NULL, 0, dstBuf, w, 0, h, pf,
+                                  flags);
+    if (rows < 0 || rows >= h)
+      THROW("Truncated JPEG image produced wrong number of rows");
+    for (row = 0; row < rows; row++) {
+      size_t offset =
+        (size_t)((flags & TJFLAG_BOTTOMUP) ? h - row - 1 : row) * pitch;
+
+      if (memcmp(&dstBuf[offset], &refBuf[offset], pitch))
+        THROW("Rows from truncated JPEG image differ");
+    }
+
+    if (pass == 0) {
+      if (tjDecompressStreamFinish(handle) != -1 ||
+          tjGetErrorCode(handle) != TJERR_WARNING)
+        THROW("Truncated JPEG image did not generate a warning");
+    } else {
+      if (tjDecompressStreamRows(handle, eoi, 2, dstBuf, w, 0, h, pf,
+                                 flags) != -1 ||
+          tjGetErrorCode(handle) != TJERR_WARNING)
+        THROW("Premature EOI marker did not generate a warning");
+      if (tjDecompressStreamRows(handle, NULL, 0, dstBuf, w, 0, h, pf,
+                                 flags) != h)
+        THROW("Stream was abandoned after a warning");
+      if ((retval = tjDecompressStreamFinish(handle)) == -1) goto bailout;
+    }
+  }
+
+bailout:
+  free(dstBuf);
+  return retval;
+}
+
+
+/* Decompress the JPEG image by pushing it to the decompressor in small chunks
+   of varying sizes, as if it were arriving from a network connection. */
+
+static int streamDecompress(tjhandle handle, unsigned char *jpegBuf,
+                            unsigned long jpegSize, unsigned char *dstBuf,
+                            int w, int h, int pf, int flags)
+{
+  unsigned long pos = 0, chunkSize;
+  int i, retval = 0, width, height, subsamp, colorspace, rows = 0;
+
+  for (i = 0; ; i++) {
+    chunkSize = min((unsigned long)(1 + i % 37), jpegSize - pos);
+    retval = tjDecompressStreamHeader(handle, &jpegBuf[pos], chunkSize, &width,
+                                      &height, &subsamp, &colorspace);
+    pos += chunkSize;
+    if (retval == -1) return -1;
+    if (retval == 0) break;
+    if (pos >= jpegSize) THROW("Incomplete JPEG header");
+  }
+  while (rows < h) {
+    i++;
+    chunkSize = min((unsigned long)(1 + i % 37), jpegSize - pos);
+    rows = tjDecompressStreamRows(handle, &jpegBuf[pos], chunkSize, dstBuf, w,
+                                  0, h, pf, flags);
+    pos += chunkSize;
+    if (rows == -1) return -1;
+    if (rows < h && pos >= jpegSize) THROW("Incomplete JPEG image");
+  }
+  if (tjDecompressStreamFinish(handle) == -1) return -1;
+  return streamTruncDecompress(handle, jpegBuf, jpegSize, dstBuf, w, h, pf,
+                               flags);
+
+bailout:
+  tjDecompressStreamFinish(handle);
+  return 0;
+}
+
+
+/* Decompress several copies of the JPEG image in one batch using multiple
+   threads, and ensure that all copies are identical.  Then ensure that an
+   invalid image in the batch generates a fatal error with the correct
+   message. */
+
+#define BATCH_SIZE  5
+#define BATCH_THREADS  3
+
+static int batchDecompress(tjhandle handle, unsigned char *jpegBuf,
+                           unsigned long jpegSize, unsigned char *dstBuf,
+                           int w, int h, int pf, int flags)
+{
+  tjbatchimage images[BATCH_SIZE];
+  unsigned char *tmpBuf = NULL, badBuf[2] = { 0, 0 };
+  unsigned long size = w * h * tjPixelSize[pf];
+  int i, retval = 0;
+
+  if ((tmpBuf = (unsigned char *)malloc(size * (BATCH_SIZE - 1))) == NULL)
+    THROW("Memory allocation failure");
+  for (i = 0; i < BATCH_SIZE; i++) {
+    images[i].jpegBuf = jpegBuf;
+    images[i].jpegSize = jpegSize;
+    images[i].dstBuf = i == BATCH_SIZE - 1 ? dstBuf : &tmpBuf[size * i];
+    images[i].width = w;
+    images[i].pitch = 0;
+    images[i].height = h;
+  }
+  if ((retval = tjDecompressBatch(handle, images, BATCH_SIZE, pf, flags,
+                                  BATCH_THREADS)) == -1)
+    goto bailout;
+  for (i = 0; i < BATCH_SIZE; i++) {
+    if (images[i].scaledWidth != w || images[i].scaledHeight != h)
+      THROW("Incorrect scaled dimensions");
+    if (i < BATCH_SIZE - 1 && memcmp(&tmpBuf[size * i], dstBuf, size))
+      THROW("Batch-decompressed images differ");
+  }
+
+  images[1].jpegBuf = badBuf;
+  images[1].jpegSize = sizeof(badBuf);
+  if (tjDecompressBatch(handle, images, BATCH_SIZE, pf, flags,
+                        BATCH_THREADS) != -1 ||
+      tjGetErrorCode(handle) != TJERR_FATAL)
+    THROW("Invalid image in batch did not generate an error");
+  /* The worker threads report errors through their own instances, so make
+     sure that the library's message reached both error strings. */
+  if (strncmp(tjGetErrorStr2(handle), "Not a JPEG file", 15) ||
+      strncmp(tjGetErrorStr2(NULL), "Not a JPEG file", 15))
+    THROW("Invalid image in batch generated the wrong error message");
+  if (images[1].scaledWidth != 0 || images[1].scaledHeight != 0)
+    THROW("Invalid image in batch was reported as decompressed");
+
+bailout:
+  free(tmpBuf);
+  return retval;
+}
+
+
+/* Decompress the JPEG image at full size and at the requested size in one
+   call, and ensure that both images are identical to the ones produced by
+   tjDecompress2().  The requested size is also checked by the caller. */
+
+static int multiResDecompress(tjhandle handle, unsigned char *jpegBuf,
+                              unsigned long jpegSize, unsigned char *dstBuf,
+                              int w, int h, int pf, int flags)
+{
+  tjscaledimage images[2];
+  unsigned char *fullBuf = NULL, *refBuf = NULL;
+  int fullw, fullh, subsamp, retval = 0;
+  unsigned long fullSize, scaledSize;
+
+  if ((retval = tjDecompressHeader2(handle, jpegBuf, jpegSize, &fullw, &fullh,
+                                    &subsamp)) == -1)
+    goto bailout;
+  fullSize = fullw * fullh * tjPixelSize[pf];
+  scaledSize = w * h * tjPixelSize[pf];
+  if ((fullBuf = (unsigned char *)malloc(fullSize)) == NULL ||
+      (refBuf = (unsigned char *)malloc(max(fullSize, scaledSize))) == NULL)
+    THROW("Memory allocation failure");
+  images[0].dstBuf = fullBuf;
+  images[0].width = images[0].height = 0;
+  images[1].dstBuf = dstBuf;
+  images[1].width = w;
+  images[1].height = h;
+  images[0].pitch = images[1].pitch = 0;
+  if ((retval = tjDecompressMulti(handle, jpegBuf, jpegSize, images, 2, pf,
+                                  flags)) == -1)
+    goto bailout;
+  if (images[0].scaledWidth != fullw || images[0].scaledHeight != fullh ||
+      images[1].scaledWidth != w || images[1].scaledHeight != h)
+    THROW("Incorrect scaled dimensions");
+
+  if ((retval = tjDecompress2(handle, jpegBuf, jpegSize, refBuf, 0, 0, 0, pf,
+                              flags)) == -1)
+    goto bailout;
+  if (memcmp(fullBuf, refBuf, fullSize))
+    THROW("Multi-resolution full-size image differs");
+
+  if ((retval = tjDecompress2(handle, jpegBuf, jpegSize, refBuf, w, 0, h, pf,
+                              flags)) == -1)
+    goto bailout;
+  if (memcmp(dstBuf, refBuf, scaledSize))
+    THROW("Multi-resolution scaled image differs");
+
+bailout:
+  free(fullBuf);
+  free(refBuf);
+  return retval;
+}
+
+
+/* Verify that tjScanHeader() agrees with tjDecompressHeader3() on the complete
+   JPEG image and on every truncated copy of its header */
+static void scanHeaderTest(tjhandle handle, unsigned char *jpegBuf,
+                           unsigned long jpegSize)
+{
+  int w1, h1, subsamp1, cs1, w2, h2, subsamp2, cs2, ret1, ret2;
+  unsigned long size;
+
+  TRY_TJ(tjScanHeader(jpegBuf, jpegSize, &w1, &h1, &subsamp1, &cs1));
+  TRY_TJ(tjDecompressHeader3(handle, jpegBuf, jpegSize, &w2, &h2, &subsamp2,
+                             &cs2));
+  if (w1 != w2 || h1 != h2 || subsamp1 != subsamp2 || cs1 != cs2)
+    THROW("tjScanHeader() and tjDecompressHeader3() disagree");
+
+  for (size = 1; size < jpegSize; size++) {
+    ret1 = tjScanHeader(jpegBuf, size, &w1, &h1, &subsamp1, &cs1);
+    ret2 = tjDecompressHeader3(handle, jpegBuf, size, &w2, &h2, &subsamp2,
+                               &cs2);
+    if (ret1 != ret2)
+      THROW("tjScanHeader() and tjDecompressHeader3() disagree on truncated image");
+    if (ret1 == 0) {
+      if (w1 != w2 || h1 != h2 || subsamp1 != subsamp2 || cs1 != cs2)
+        THROW("tjScanHeader() and tjDecompressHeader3() disagree on truncated image");
+      break;
+    }
+  }
+
+bailout:
+  return;
+}
+
+
 static void _decompTest(tjhandle handle, unsigned char *jpegBuf,
                         unsigned long jpegSize, int w, int h, int pf,
                         char *basename, int subsamp, int flags,
@@ -468,8 +924,18 @@ static void _decompTest(tjhandle handle, unsigned char *jpegBuf,
     if (sf.num != 1 || sf.denom != 1)
       printf("%d/%d ... ", sf.num, sf.denom);
     else printf("... ");
-    TRY_TJ(tjDecompress2(handle, jpegBuf, jpegSize, dstBuf, scaledWidth, 0,
-                         scaledHeight, pf, flags));
+    if (doStream)
+      TRY_TJ(streamDecompress(handle, jpegBuf, jpegSize, dstBuf, scaledWidth,
+                              scaledHeight, pf, flags))
+    else if (doBatch)
+      TRY_TJ(batchDecompress(handle, jpegBuf, jpegSize, dstBuf, scaledWidth,
+                             scaledHeight, pf, flags))
+    else if (doMultiRes)
+      TRY_TJ(multiResDecompress(handle, jpegBuf, jpegSize, dstBuf,
+                                scaledWidth, scaledHeight, pf, flags))
+    else
+      TRY_TJ(tjDecompress2(handle, jpegBuf, jpegSize, dstBuf, scaledWidth, 0,
+                           scaledHeight, pf, flags));
   }
 
   if (checkBuf(dstBuf, scaledWidth, scaledHeight, pf, subsamp, sf, flags))
@@ -492,6 +958,8 @@ static void decompTest(tjhandle handle, unsigned char *jpegBuf,
 
   if (!sf || !n) THROW_TJ();
 
+  scanHeaderTest(handle, jpegBuf, jpegSize);
+
   for (i = 0; i < n; i++) {
     if (subsamp == TJSAMP_444 || subsamp == TJSAMP_GRAY ||
         (subsamp == TJSAMP_411 && sf[i].num == 1 &&
@@ -895,11 +1363,21 @@ int main(int argc, char *argv[])
       if (!strcasecmp(argv[i], "-yuv")) doYUV = 1;
       else if (!strcasecmp(argv[i], "-noyuvpad")) pad = 1;
       else if (!strcasecmp(argv[i], "-alloc")) alloc = 1;
+      else if (!strcasecmp(argv[i], "-stream")) doStream = 1;
+      else if (!strcasecmp(argv[i], "-batch")) doBatch = 1;
+      else if (!strcasecmp(argv[i], "-multi")) doMulti = 1;
+      else if (!strcasecmp(argv[i], "-multires")) doMultiRes = 1;
+      else if (!strcasecmp(argv[i], "-chunks")) doChunks = 1;
       else if (!strcasecmp(argv[i], "-bmp")) return bmpTest();
       else usage(argv[0]);
     }
   }
   if (alloc) printf("Testing automatic buffer allocation\n");
+  if (doStream) printf("Testing incremental decompression\n");
+  if (doBatch) printf("Testing batch decompression\n");
+  if (doMulti) printf("Testing multi-quality compression\n");
+  if (doMultiRes) printf("Testing multi-resolution decompression\n");
+  if (doChunks) printf("Testing chunked and callback compression\n");
   if (doYUV) num4bf = 4;
   overflowTest();
   doTest(35, 39, _3byteFormats, 2, TJSAMP_444, "test");
@@ -916,6 +1394,7 @@ int main(int argc, char *argv[])
   doTest(41, 35, _3byteFormats, 2, TJSAMP_GRAY, "test");
   doTest(35, 39, _4byteFormats, 4, TJSAMP_GRAY, "test");
   bufSizeTest();
+  if (doChunks) largeChunkTest();
   if (doYUV) {
     printf("\n--------------------\n\n");
     doTest(48, 48, _onlyRGB, 1, TJSAMP_444, "test_yuv0");
@@ -24,6 +24,7 @@
 #include "jpeglib.h"
 #include "transupp.h"           /* My own external interface */
 #include "jpegcomp.h"
+#include "jdct.h"               /* for DESCALE() */
 #include <ctype.h>              /* to declare isdigit() */
 
 
@@ -126,6 +127,237 @@ do_crop(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
 }
 
 
+/* DCT-domain downscaling.
+ *
+ * If a source block's coefficients are F(u,v), then its low-order N x N
+ * coefficients F(u,v)/S, 0 <= u,v < N, where N = DCTSIZE/S, are the N x N
+ * DCT of the block reduced by a factor of S (this is what the reduced-size
+ * IDCTs in jidctred.c rely upon.)  A destination block is the DCTSIZE x
+ * DCTSIZE DCT of the S x S such N x N blocks that it covers, so it can be
+ * computed directly from the source coefficients as M * B * M', where B is
+ * the DCTSIZE x DCTSIZE matrix formed by the S x S arrays of low-order
+ * source coefficients (divided by S) and M is the DCTSIZE-point DCT matrix
+ * multiplied by S copies of the N-point IDCT matrix along its diagonal.
+ *
+ * Each row of the tables below holds one column of M, scaled by
+ * 2^SCALE_CONST_BITS.  As in jidctint.c, we keep SCALE_PASS1_BITS of extra
+ * precision between the horizontal and vertical passes, and fewer bits are
+ * used with 12-bit samples in order to avoid overflow.
+ *
+ * The dequantized source coefficients are clamped to the range that the
+ * Huffman encoder accepts: magnitudes of at most 2^SCALE_MAX_COEF_BITS - 1
+ * for AC coefficients and 2^(SCALE_MAX_COEF_BITS+1) - 1 for DC coefficients
+ * (SCALE_MAX_COEF_BITS is the same as MAX_COEF_BITS in jchuff.h.)  Summing
+ * the absolute values of the table entries shows that, with these inputs,
+ * the magnitudes of the accumulated sums are less than 2^26 (8-bit) or 2^30
+ * (12-bit) in pass 1 and less than 2^27 (8-bit) or 2^30 (12-bit) in pass 2
+ * for all scaling factors, so 32-bit accumulators cannot overflow.
+ */
+
+#define SCALE_CONST_BITS  13
+#if BITS_IN_JSAMPLE == 8
+#define SCALE_PASS1_BITS  2
+#define SCALE_MAX_COEF_BITS  10
+#else
+#define SCALE_PASS1_BITS  1
+#define SCALE_MAX_COEF_BITS  14
+#endif
+
+#define SCALE_MAX_AC  ((1 << SCALE_MAX_COEF_BITS) - 1)
+#define SCALE_MAX_DC  ((1 << (SCALE_MAX_COEF_BITS + 1)) - 1)
+
+static const INT16 scale_matrix_2[DCTSIZE2] = {
+   5793,  5249,     0, -1843,     0,  1232,     0, -1044,
+      0,  2408,  5793,  4582,     0, -2042,     0,  1609,
+      0,  -432,     0,  2973,  5793,  4450,     0, -2174,
+      0,   133,     0,  -565,     0,  2841,  5793,  5015,
+   5793, -5249,     0,  1843,     0, -1232,     0,  1044,
+      0,  2408, -5793,  4582,     0, -2042,     0,  1609,
+      0,   432,     0, -2973,  5793, -4450,     0,  2174,
+      0,   133,     0,  -565,     0,  2841, -5793,  5015
+};
+
+static const INT16 scale_matrix_4[DCTSIZE2] = {
+   4096,  5249,  3784,  1843,     0, -1232, -1567, -1044,
+      0,   432,  1567,  2973,  4096,  4450,  3784,  2174,
+   4096,  2174, -3784, -4450,     0,  2973,  1567,  -432,
+      0,  1044,  1567, -1232, -4096, -1843,  3784,  5249,
+   4096, -2174, -3784,  4450,     0, -2973,  1567,   432,
+      0,  1044, -1567, -1232,  4096, -1843, -3784,  5249,
+   4096, -5249,  3784, -1843,     0,  1232, -1567,  1044,
+      0,   432, -1567,  2973, -4096,  4450, -3784,  2174
+};
+
+static const INT16 scale_matrix_8[DCTSIZE2] = {
+   2896,  4017,  3784,  3406,  2896,  2276,  1567,   799,
+   2896,  3406,  1567,  -799, -2896, -4017, -3784, -2276,
+   2896,  2276, -1567, -4017, -2896,   799,  3784,  3406,
+   2896,   799, -3784, -2276,  2896,  3406, -1567, -4017,
+   2896,  -799, -3784,  2276,  2896, -3406, -1567,  4017,
+   2896, -2276, -1567,  4017, -2896,  -799,  3784, -3406,
+   2896, -3406,  1567,   799, -2896,  4017, -3784,  2276,
+   2896, -4017,  3784, -3406,  2896, -2276,  1567,  -799
+};
+
+
+LOCAL(void)
+do_scale(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
+         JDIMENSION x_crop_offset, JDIMENSION y_crop_offset, int scale_denom,
+         jvirt_barray_ptr *src_coef_arrays,
+         jvirt_barray_ptr *dst_coef_arrays)
+/* Downscale, then crop.  This is only used when no rotate/flip is requested
+ * with the scale.
+ */
+{
+  JDIMENSION dst_blk_x, dst_blk_y, src_blk_x, src_blk_y;
+  JDIMENSION x_crop_blocks, y_crop_blocks, max_width_in_blocks = 0;
+  int ci, offset_y, n, shift, p, q, i, k, l, u, v, nonzero;
+  const INT16 *matrix, *mptr;
+  JBLOCKARRAY src_buffer, dst_buffer;
+  JCOEFPTR src_ptr, dst_ptr;
+  JQUANT_TBL *src_qtbl, *dst_qtbl;
+  JLONG coef, sign, m, max_coef, workspace[DCTSIZE2], half_qval[DCTSIZE2];
+  double recip[DCTSIZE2];
+  int *rowbuf, *wsptr;
+  JOCTET *rowmask;
+  jpeg_component_info *compptr, *src_compptr;
+
+  switch (scale_denom) {
+  case 2:  matrix = scale_matrix_2;  shift = 1;  break;
+  case 4:  matrix = scale_matrix_4;  shift = 2;  break;
+  case 8:  matrix = scale_matrix_8;  shift = 3;  break;
+  default:
+    ERREXIT(srcinfo, JERR_NOTIMPL);
+    return;
+  }
+  n = DCTSIZE / scale_denom;
+
+  /* Allocate buffers for the horizontally-processed coefficients of one row
+   * of destination blocks in any component and for masks of their nonzero
+   * rows.
+   */
+  for (ci = 0; ci < dstinfo->num_components; ci++)
+    max_width_in_blocks = MAX(max_width_in_blocks,
+                              dstinfo->comp_info[ci].width_in_blocks);
+  rowbuf = (int *)(*srcinfo->mem->alloc_large)
+    ((j_common_ptr)srcinfo, JPOOL_IMAGE,
+     (size_t)max_width_in_blocks * DCTSIZE2 * sizeof(int));
+  rowmask = (JOCTET *)(*srcinfo->mem->alloc_large)
+    ((j_common_ptr)srcinfo, JPOOL_IMAGE, (size_t)max_width_in_blocks);
+
+  for (ci = 0; ci < dstinfo->num_components; ci++) {
+    compptr = dstinfo->comp_info + ci;
+    src_compptr = srcinfo->comp_info + ci;
+    src_qtbl = src_compptr->quant_table;
+    dst_qtbl = dstinfo->quant_tbl_ptrs[compptr->quant_tbl_no];
+    if (src_qtbl == NULL || dst_qtbl == NULL)
+      ERREXIT1(srcinfo, JERR_NO_QUANT_TABLE, compptr->quant_tbl_no);
+    /* The destination coefficients have 3 fractional bits, so that the
+     * quantizer can round correctly.  Division is slow, so we multiply by
+     * reciprocals instead.  Since the source coefficients are clamped, the
+     * dividends are integers < 2^24, and the divisors are < 2^19, so if we
+     * add 1/2 to each dividend, the rounding error of the product cannot move
+     * it across an integer boundary, and truncating it gives the same result
+     * as integer division.
+     */
+    for (k = 0; k < DCTSIZE2; k++) {
+      JLONG qval = (JLONG)dst_qtbl->quantval[k] << 3;
+
+      half_qval[k] = qval >> 1;
+      recip[k] = 1.0 / (double)qval;
+    }
+    x_crop_blocks = x_crop_offset * compptr->h_samp_factor;
+    y_crop_blocks = y_crop_offset * compptr->v_samp_factor;
+    for (dst_blk_y = 0; dst_blk_y < compptr->height_in_blocks;
+         dst_blk_y += compptr->v_samp_factor) {
+      dst_buffer = (*srcinfo->mem->access_virt_barray)
+        ((j_common_ptr)srcinfo, dst_coef_arrays[ci], dst_blk_y,
+         (JDIMENSION)compptr->v_samp_factor, TRUE);
+      for (offset_y = 0; offset_y < compptr->v_samp_factor; offset_y++) {
+        /* Pass 1: dequantize the low-order coefficients of the source blocks
+         * and process them horizontally.  The virtual array manager only
+         * guarantees that we can access v_samp_factor source block rows at
+         * once, so we do this one source block row at a time, storing the
+         * results in rowbuf.  Source blocks beyond the right and bottom edges
+         * are replaced by the edge blocks.
+         */
+        for (p = 0; p < scale_denom; p++) {
+          src_blk_y = (dst_blk_y + y_crop_blocks + offset_y) * scale_denom + p;
+          if (src_blk_y >= src_compptr->height_in_blocks)
+            src_blk_y = src_compptr->height_in_blocks - 1;
+          src_buffer = (*srcinfo->mem->access_virt_barray)
+            ((j_common_ptr)srcinfo, src_coef_arrays[ci], src_blk_y,
+             (JDIMENSION)1, FALSE);
+          for (dst_blk_x = 0; dst_blk_x < compptr->width_in_blocks;
+               dst_blk_x++) {
+            MEMZERO(workspace, n * DCTSIZE * sizeof(JLONG));
+            nonzero = 0;
+            for (q = 0; q < scale_denom; q++) {
+              src_blk_x = (dst_blk_x + x_crop_blocks) * scale_denom + q;
+              if (src_blk_x >= src_compptr->width_in_blocks)
+                src_blk_x = src_compptr->width_in_blocks - 1;
+              src_ptr = src_buffer[0][src_blk_x];
+              for (k = 0; k < n; k++) {
+                for (l = 0; l < n; l++) {
+                  if (src_ptr[k * DCTSIZE + l] == 0)
+                    continue;
+                  coef = (JLONG)src_ptr[k * DCTSIZE + l] *
+                         src_qtbl->quantval[k * DCTSIZE + l];
+                  max_coef = (k == 0 && l == 0) ? SCALE_MAX_DC : SCALE_MAX_AC;
+                  coef = MAX(MIN(coef, max_coef), -max_coef);
+                  mptr = matrix + (q * n + l) * DCTSIZE;
+                  for (v = 0; v < DCTSIZE; v++)
+                    workspace[k * DCTSIZE + v] += coef * mptr[v];
+                  nonzero |= 1 << k;
+                }
+              }
+            }
+            wsptr = rowbuf + dst_blk_x * DCTSIZE2 + p * n * DCTSIZE;
+            for (i = 0; i < n * DCTSIZE; i++)
+              wsptr[i] = (int)DESCALE(workspace[i], SCALE_CONST_BITS -
+                                                    SCALE_PASS1_BITS + shift);
+            if (p == 0)
+              rowmask[dst_blk_x] = 0;
+            rowmask[dst_blk_x] |= (JOCTET)(nonzero << (p * n));
+          }
+        }
+
+        /* Pass 2: process the destination blocks vertically, skipping rows
+         * that were entirely zero after pass 1, and requantize them.
+         */
+        for (dst_blk_x = 0, wsptr = rowbuf;
+             dst_blk_x < compptr->width_in_blocks;
+             dst_blk_x++, wsptr += DCTSIZE2) {
+          MEMZERO(workspace, DCTSIZE2 * sizeof(JLONG));
+          for (i = 0; i < DCTSIZE; i++) {
+            if (!(rowmask[dst_blk_x] & (1 << i)))
+              continue;
+            for (u = 0; u < DCTSIZE; u++) {
+              m = matrix[i * DCTSIZE + u];
+              if (m == 0)
+                continue;
+              for (v = 0; v < DCTSIZE; v++)
+                workspace[u * DCTSIZE + v] += m * wsptr[i * DCTSIZE + v];
+            }
+          }
+          dst_ptr = dst_buffer[offset_y][dst_blk_x];
+          for (k = 0; k < DCTSIZE2; k++) {
+            coef = DESCALE(workspace[k],
+                           SCALE_CONST_BITS + SCALE_PASS1_BITS - 3);
+            sign = coef < 0 ? -1 : 0;
+            coef = ((coef ^ sign) - sign) + half_qval[k];
+            coef = (JLONG)(((double)coef + 0.5) * recip[k]);
+            coef = (coef ^ sign) - sign;
+            max_coef = (k == 0) ? SCALE_MAX_DC : SCALE_MAX_AC;
+            dst_ptr[k] = (JCOEF)MAX(MIN(coef, max_coef), -max_coef);
+          }
+        }
+      }
+    }
+  }
+}
+
+
 LOCAL(void)
 do_flip_h_no_crop(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
                   JDIMENSION x_crop_offset, jvirt_barray_ptr *src_coef_arrays)
@@ -939,6 +1171,13 @@ jtransform_request_workspace(j_decompress_ptr srcinfo,
     }
   }
 
+  /* DCT-domain scaling can only be combined with cropping */
+  if (info->scale_denom > 1) {
+    if ((info->scale_denom != 2 && info->scale_denom != 4 &&
+         info->scale_denom != 8) || info->transform != JXFORM_NONE)
+      ERREXIT(srcinfo, JERR_NOTIMPL);
+  }
+
   /* If there is only one output component, force the iMCU size to be 1;
    * else use the source iMCU size.  (This allows us to do the right thing
    * when reducing color to grayscale, and also provides a handy way of
@@ -964,6 +1203,12 @@ jtransform_request_workspace(j_decompress_ptr srcinfo,
   default:
     info->output_width = srcinfo->output_width;
     info->output_height = srcinfo->output_height;
+    if (info->scale_denom > 1) {
+      info->output_width = (JDIMENSION)
+        jdiv_round_up((long)info->output_width, (long)info->scale_denom);
+      info->output_height = (JDIMENSION)
+        jdiv_round_up((long)info->output_height, (long)info->scale_denom);
+    }
     if (info->num_components == 1) {
       info->iMCU_sample_width = srcinfo->_min_DCT_h_scaled_size;
       info->iMCU_sample_height = srcinfo->_min_DCT_v_scaled_size;
@@ -1033,9 +1278,10 @@ jtransform_request_workspace(j_decompress_ptr srcinfo,
   transpose_it = FALSE;
   switch (info->transform) {
   case JXFORM_NONE:
-    if (info->x_crop_offset != 0 || info->y_crop_offset != 0)
+    if (info->x_crop_offset != 0 || info->y_crop_offset != 0 ||
+        info->scale_denom > 1)
       need_workspace = TRUE;
-    /* No workspace needed if neither cropping nor transforming */
+    /* No workspace needed if neither cropping nor transforming nor scaling */
     break;
   case JXFORM_FLIP_H:
     if (info->trim)
@@ -1465,7 +1711,10 @@ jtransform_execute_transform(j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
    */
   switch (info->transform) {
   case JXFORM_NONE:
-    if (info->x_crop_offset != 0 || info->y_crop_offset != 0)
+    if (info->scale_denom > 1)
+      do_scale(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
+               info->scale_denom, src_coef_arrays, dst_coef_arrays);
+    else if (info->x_crop_offset != 0 || info->y_crop_offset != 0)
       do_crop(srcinfo, dstinfo, info->x_crop_offset, info->y_crop_offset,
               src_coef_arrays, dst_coef_arrays);
     break;
@@ -67,6 +67,16 @@
  * coefficients and losslessly preserves lower-order coefficients of a
  * sub-block.
  *
+ * libjpeg-turbo does not implement that option, but it does provide a
+ * DCT-domain downscaling option, which reduces the image dimensions by a
+ * factor of 2, 4, or 8 without decompressing it.  Each destination DCT block
+ * is synthesized from the low-order coefficients of the 2x2, 4x4, or 8x8
+ * source DCT blocks that it replaces, and the result is requantized using the
+ * source image's quantization tables.  This is not lossless, but the result
+ * is very close to what a DCT-domain decoder (such as djpeg -scale) would
+ * produce for the reduced image, and it is much faster than decompressing,
+ * resizing, and recompressing the image.
+ *
  * Rotate/flip transform, resize, and crop can be requested together in a
  * single invocation.  The crop is applied last --- that is, the crop region
  * is specified in terms of the destination image after transform/resize.
@@ -128,6 +138,10 @@ typedef struct {
                           coefficients in tact (necessary if other transformed
                           images must be generated from the same set of
                           coefficients. */
+  int scale_denom;     /* If 2, 4, or 8, reduce the image dimensions by this
+                          factor in the DCT domain (see below.)  Only
+                          JXFORM_NONE may be combined with scaling.  0 or 1
+                          disables scaling. */
 
   /* Crop parameters: application need not set these unless crop is TRUE.
    * These can be filled in by jtransform_parse_crop_spec().
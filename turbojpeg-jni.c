@@ -103,6 +103,22 @@
   cArray = NULL; \
 }
 
+/* Direct NIO buffers are accessed in place, so only Java arrays need to be
+   released. */
+#define SAFE_RELEASE_BUF(javaBuf, direct, cBuf) { \
+  if (!(direct)) SAFE_RELEASE(javaBuf, cBuf) \
+  cBuf = NULL; \
+}
+
+/* Return the size (in bytes) of a Java array or direct NIO buffer, or -1 if
+   a buffer that is supposed to be direct is not. */
+static jlong getBufferSize(JNIEnv *env, jobject buf, jboolean direct,
+                           jint elementSize)
+{
+  if (direct) return (*env)->GetDirectBufferCapacity(env, buf);
+  return (jlong)(*env)->GetArrayLength(env, (jarray)buf) * elementSize;
+}
+
 static int ProcessSystemProperties(JNIEnv *env)
 {
   jclass cls;
@@ -215,9 +231,10 @@ bailout:
 }
 
 static jint TJCompressor_compress
-  (JNIEnv *env, jobject obj, jarray src, jint srcElementSize, jint x, jint y,
-   jint width, jint pitch, jint height, jint pf, jbyteArray dst,
-   jint jpegSubsamp, jint jpegQual, jint flags)
+  (JNIEnv *env, jobject obj, jobject src, jboolean srcDirect,
+   jint srcElementSize, jint x, jint y, jint width, jint pitch, jint height,
+   jint pf, jobject dst, jboolean dstDirect, jint jpegSubsamp, jint jpegQual,
+   jint flags)
 {
   tjhandle handle = 0;
   unsigned long jpegSize = 0;
@@ -234,28 +251,34 @@ static jint TJCompressor_compress
 
   actualPitch = (pitch == 0) ? width * tjPixelSize[pf] : pitch;
   arraySize = (y + height - 1) * actualPitch + (x + width) * tjPixelSize[pf];
-  if ((*env)->GetArrayLength(env, src) * srcElementSize < arraySize)
+  if (getBufferSize(env, src, srcDirect, srcElementSize) < arraySize)
     THROW_ARG("Source buffer is not large enough");
   jpegSize = tjBufSize(width, height, jpegSubsamp);
-  if ((*env)->GetArrayLength(env, dst) < (jsize)jpegSize)
+  if (getBufferSize(env, dst, dstDirect, 1) < (jlong)jpegSize)
     THROW_ARG("Destination buffer is not large enough");
 
   if (ProcessSystemProperties(env) < 0) goto bailout;
 
-  BAILIF0(srcBuf = (*env)->GetPrimitiveArrayCritical(env, src, 0));
-  BAILIF0(jpegBuf = (*env)->GetPrimitiveArrayCritical(env, dst, 0));
+  /* No JNI functions may be called within a critical region, so the direct
+     buffers must be resolved first. */
+  if (srcDirect) BAILIF0(srcBuf = (*env)->GetDirectBufferAddress(env, src));
+  if (dstDirect) BAILIF0(jpegBuf = (*env)->GetDirectBufferAddress(env, dst));
+  if (!srcDirect)
+    BAILIF0(srcBuf = (*env)->GetPrimitiveArrayCritical(env, src, 0));
+  if (!dstDirect)
+    BAILIF0(jpegBuf = (*env)->GetPrimitiveArrayCritical(env, dst, 0));
 
   if (tjCompress2(handle, &srcBuf[y * actualPitch + x * tjPixelSize[pf]],
                   width, pitch, height, pf, &jpegBuf, &jpegSize, jpegSubsamp,
                   jpegQual, flags | TJFLAG_NOREALLOC) == -1) {
-    SAFE_RELEASE(dst, jpegBuf);
-    SAFE_RELEASE(src, srcBuf);
+    SAFE_RELEASE_BUF(dst, dstDirect, jpegBuf);
+    SAFE_RELEASE_BUF(src, srcDirect, srcBuf);
     THROW_TJ();
   }
 
 bailout:
-  SAFE_RELEASE(dst, jpegBuf);
-  SAFE_RELEASE(src, srcBuf);
+  SAFE_RELEASE_BUF(dst, dstDirect, jpegBuf);
+  SAFE_RELEASE_BUF(src, srcDirect, srcBuf);
   return (jint)jpegSize;
 }
 
@@ -265,8 +288,9 @@ JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3
    jint pitch, jint height, jint pf, jbyteArray dst, jint jpegSubsamp,
    jint jpegQual, jint flags)
 {
-  return TJCompressor_compress(env, obj, src, 1, x, y, width, pitch, height,
-                               pf, dst, jpegSubsamp, jpegQual, flags);
+  return TJCompressor_compress(env, obj, src, JNI_FALSE, 1, x, y, width,
+                               pitch, height, pf, dst, JNI_FALSE, jpegSubsamp,
+                               jpegQual, flags);
 }
 
 /* TurboJPEG 1.2.x: TJCompressor::compress() byte source */
@@ -275,8 +299,9 @@ JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3
    jint height, jint pf, jbyteArray dst, jint jpegSubsamp, jint jpegQual,
    jint flags)
 {
-  return TJCompressor_compress(env, obj, src, 1, 0, 0, width, pitch, height,
-                               pf, dst, jpegSubsamp, jpegQual, flags);
+  return TJCompressor_compress(env, obj, src, JNI_FALSE, 1, 0, 0, width,
+                               pitch, height, pf, dst, JNI_FALSE, jpegSubsamp,
+                               jpegQual, flags);
 }
 
 /* TurboJPEG 1.3.x: TJCompressor::compress() int source */
@@ -290,9 +315,9 @@ JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3
   if (tjPixelSize[pf] != sizeof(jint))
     THROW_ARG("Pixel format must be 32-bit when compressing from an integer buffer.");
 
-  return TJCompressor_compress(env, obj, src, sizeof(jint), x, y, width,
-                               stride * sizeof(jint), height, pf, dst,
-                               jpegSubsamp, jpegQual, flags);
+  return TJCompressor_compress(env, obj, src, JNI_FALSE, sizeof(jint), x, y,
+                               width, stride * sizeof(jint), height, pf, dst,
+                               JNI_FALSE, jpegSubsamp, jpegQual, flags);
 
 bailout:
   return 0;
@@ -309,14 +334,68 @@ JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3
   if (tjPixelSize[pf] != sizeof(jint))
     THROW_ARG("Pixel format must be 32-bit when compressing from an integer buffer.");
 
-  return TJCompressor_compress(env, obj, src, sizeof(jint), 0, 0, width,
-                               stride * sizeof(jint), height, pf, dst,
-                               jpegSubsamp, jpegQual, flags);
+  return TJCompressor_compress(env, obj, src, JNI_FALSE, sizeof(jint), 0, 0,
+                               width, stride * sizeof(jint), height, pf, dst,
+                               JNI_FALSE, jpegSubsamp, jpegQual, flags);
 
 bailout:
   return 0;
 }
 
+/* TurboJPEG 2.1.x: TJCompressor::compress() direct byte source, byte
+   destination */
+JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress__Ljava_nio_ByteBuffer_2IIIIII_3BIII
+  (JNIEnv *env, jobject obj, jobject src, jint x, jint y, jint width,
+   jint pitch, jint height, jint pf, jbyteArray dst, jint jpegSubsamp,
+   jint jpegQual, jint flags)
+{
+  return TJCompressor_compress(env, obj, src, JNI_TRUE, 1, x, y, width, pitch,
+                               height, pf, dst, JNI_FALSE, jpegSubsamp,
+                               jpegQual, flags);
+}
+
+/* TurboJPEG 2.1.x: TJCompressor::compress() byte source, direct destination */
+JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3BIIIIIILjava_nio_ByteBuffer_2III
+  (JNIEnv *env, jobject obj, jbyteArray src, jint x, jint y, jint width,
+   jint pitch, jint height, jint pf, jobject dst, jint jpegSubsamp,
+   jint jpegQual, jint flags)
+{
+  return TJCompressor_compress(env, obj, src, JNI_FALSE, 1, x, y, width,
+                               pitch, height, pf, dst, JNI_TRUE, jpegSubsamp,
+                               jpegQual, flags);
+}
+
+/* TurboJPEG 2.1.x: TJCompressor::compress() int source, direct destination */
+JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress___3IIIIIIILjava_nio_ByteBuffer_2III
+  (JNIEnv *env, jobject obj, jintArray src, jint x, jint y, jint width,
+   jint stride, jint height, jint pf, jobject dst, jint jpegSubsamp,
+   jint jpegQual, jint flags)
+{
+  if (pf < 0 || pf >= org_libjpegturbo_turbojpeg_TJ_NUMPF)
+    THROW_ARG("Invalid argument in compress()");
+  if (tjPixelSize[pf] != sizeof(jint))
+    THROW_ARG("Pixel format must be 32-bit when compressing from an integer buffer.");
+
+  return TJCompressor_compress(env, obj, src, JNI_FALSE, sizeof(jint), x, y,
+                               width, stride * sizeof(jint), height, pf, dst,
+                               JNI_TRUE, jpegSubsamp, jpegQual, flags);
+
+bailout:
+  return 0;
+}
+
+/* TurboJPEG 2.1.x: TJCompressor::compress() direct byte source, direct
+   destination */
+JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compress__Ljava_nio_ByteBuffer_2IIIIIILjava_nio_ByteBuffer_2III
+  (JNIEnv *env, jobject obj, jobject src, jint x, jint y, jint width,
+   jint pitch, jint height, jint pf, jobject dst, jint jpegSubsamp,
+   jint jpegQual, jint flags)
+{
+  return TJCompressor_compress(env, obj, src, JNI_TRUE, 1, x, y, width, pitch,
+                               height, pf, dst, JNI_TRUE, jpegSubsamp,
+                               jpegQual, flags);
+}
+
 /* TurboJPEG 1.4.x: TJCompressor::compressFromYUV() */
 JNIEXPORT jint JNICALL Java_org_libjpegturbo_turbojpeg_TJCompressor_compressFromYUV___3_3B_3II_3III_3BII
   (JNIEnv *env, jobject obj, jobjectArray srcobjs, jintArray jSrcOffsets,
@@ -649,9 +728,8 @@ bailout:
   return sfjava;
 }
 
-/* TurboJPEG 1.2.x: TJDecompressor::decompressHeader() */
-JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompressHeader
-  (JNIEnv *env, jobject obj, jbyteArray src, jint jpegSize)
+static void TJDecompressor_decompressHeader
+  (JNIEnv *env, jobject obj, jobject src, jboolean srcDirect, jint jpegSize)
 {
   tjhandle handle = 0;
   unsigned char *jpegBuf = NULL;
@@ -659,18 +737,22 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress
 
   GET_HANDLE();
 
-  if ((*env)->GetArrayLength(env, src) < jpegSize)
+  if (getBufferSize(env, src, srcDirect, 1) < jpegSize)
     THROW_ARG("Source buffer is not large enough");
 
-  BAILIF0(jpegBuf = (*env)->GetPrimitiveArrayCritical(env, src, 0));
+  if (srcDirect)
+    jpegBuf = (*env)->GetDirectBufferAddress(env, src);
+  else
+    jpegBuf = (*env)->GetPrimitiveArrayCritical(env, src, 0);
+  BAILIF0(jpegBuf);
 
   if (tjDecompressHeader3(handle, jpegBuf, (unsigned long)jpegSize, &width,
                           &height, &jpegSubsamp, &jpegColorspace) == -1) {
-    SAFE_RELEASE(src, jpegBuf);
+    SAFE_RELEASE_BUF(src, srcDirect, jpegBuf);
     THROW_TJ();
   }
 
-  SAFE_RELEASE(src, jpegBuf);
+  SAFE_RELEASE_BUF(src, srcDirect, jpegBuf);
 
   BAILIF0(_fid = (*env)->GetFieldID(env, _cls, "jpegSubsamp", "I"));
   (*env)->SetIntField(env, obj, _fid, jpegSubsamp);
@@ -684,13 +766,27 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress
   (*env)->SetIntField(env, obj, _fid, height);
 
 bailout:
-  SAFE_RELEASE(src, jpegBuf);
+  SAFE_RELEASE_BUF(src, srcDirect, jpegBuf);
+}
+
+/* TurboJPEG 1.2.x: TJDecompressor::decompressHeader() */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompressHeader
+  (JNIEnv *env, jobject obj, jbyteArray src, jint jpegSize)
+{
+  TJDecompressor_decompressHeader(env, obj, src, JNI_FALSE, jpegSize);
+}
+
+/* TurboJPEG 2.1.x: TJDecompressor::decompressHeaderDirect() */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompressHeaderDirect
+  (JNIEnv *env, jobject obj, jobject src, jint jpegSize)
+{
+  TJDecompressor_decompressHeader(env, obj, src, JNI_TRUE, jpegSize);
 }
 
 static void TJDecompressor_decompress
-  (JNIEnv *env, jobject obj, jbyteArray src, jint jpegSize, jarray dst,
-   jint dstElementSize, jint x, jint y, jint width, jint pitch, jint height,
-   jint pf, jint flags)
+  (JNIEnv *env, jobject obj, jobject src, jboolean srcDirect, jint jpegSize,
+   jobject dst, jboolean dstDirect, jint dstElementSize, jint x, jint y,
+   jint width, jint pitch, jint height, jint pf, jint flags)
 {
   tjhandle handle = 0;
   jsize arraySize = 0, actualPitch;
@@ -703,27 +799,33 @@ static void TJDecompressor_decompress
   if (org_libjpegturbo_turbojpeg_TJ_NUMPF != TJ_NUMPF)
     THROW_ARG("Mismatch between Java and C API");
 
-  if ((*env)->GetArrayLength(env, src) < jpegSize)
+  if (getBufferSize(env, src, srcDirect, 1) < jpegSize)
     THROW_ARG("Source buffer is not large enough");
   actualPitch = (pitch == 0) ? width * tjPixelSize[pf] : pitch;
   arraySize = (y + height - 1) * actualPitch + (x + width) * tjPixelSize[pf];
-  if ((*env)->GetArrayLength(env, dst) * dstElementSize < arraySize)
+  if (getBufferSize(env, dst, dstDirect, dstElementSize) < arraySize)
     THROW_ARG("Destination buffer is not large enough");
 
-  BAILIF0(jpegBuf = (*env)->GetPrimitiveArrayCritical(env, src, 0));
-  BAILIF0(dstBuf = (*env)->GetPrimitiveArrayCritical(env, dst, 0));
+  /* No JNI functions may be called within a critical region, so the direct
+     buffers must be resolved first. */
+  if (srcDirect) BAILIF0(jpegBuf = (*env)->GetDirectBufferAddress(env, src));
+  if (dstDirect) BAILIF0(dstBuf = (*env)->GetDirectBufferAddress(env, dst));
+  if (!srcDirect)
+    BAILIF0(jpegBuf = (*env)->GetPrimitiveArrayCritical(env, src, 0));
+  if (!dstDirect)
+    BAILIF0(dstBuf = (*env)->GetPrimitiveArrayCritical(env, dst, 0));
 
   if (tjDecompress2(handle, jpegBuf, (unsigned long)jpegSize,
                     &dstBuf[y * actualPitch + x * tjPixelSize[pf]], width,
                     pitch, height, pf, flags) == -1) {
-    SAFE_RELEASE(dst, dstBuf);
-    SAFE_RELEASE(src, jpegBuf);
+    SAFE_RELEASE_BUF(dst, dstDirect, dstBuf);
+    SAFE_RELEASE_BUF(src, srcDirect, jpegBuf);
     THROW_TJ();
   }
 
 bailout:
-  SAFE_RELEASE(dst, dstBuf);
-  SAFE_RELEASE(src, jpegBuf);
+  SAFE_RELEASE_BUF(dst, dstDirect, dstBuf);
+  SAFE_RELEASE_BUF(src, srcDirect, jpegBuf);
 }
 
 /* TurboJPEG 1.3.x: TJDecompressor::decompress() byte destination */
@@ -731,8 +833,9 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress
   (JNIEnv *env, jobject obj, jbyteArray src, jint jpegSize, jbyteArray dst,
    jint x, jint y, jint width, jint pitch, jint height, jint pf, jint flags)
 {
-  TJDecompressor_decompress(env, obj, src, jpegSize, dst, 1, x, y, width,
-                            pitch, height, pf, flags);
+  TJDecompressor_decompress(env, obj, src, JNI_FALSE, jpegSize, dst,
+                            JNI_FALSE, 1, x, y, width, pitch, height, pf,
+                            flags);
 }
 
 /* TurboJPEG 1.2.x: TJDecompressor::decompress() byte destination */
@@ -740,8 +843,9 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress
   (JNIEnv *env, jobject obj, jbyteArray src, jint jpegSize, jbyteArray dst,
    jint width, jint pitch, jint height, jint pf, jint flags)
 {
-  TJDecompressor_decompress(env, obj, src, jpegSize, dst, 1, 0, 0, width,
-                            pitch, height, pf, flags);
+  TJDecompressor_decompress(env, obj, src, JNI_FALSE, jpegSize, dst,
+                            JNI_FALSE, 1, 0, 0, width, pitch, height, pf,
+                            flags);
 }
 
 /* TurboJPEG 1.3.x: TJDecompressor::decompress() int destination */
@@ -754,8 +858,9 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress
   if (tjPixelSize[pf] != sizeof(jint))
     THROW_ARG("Pixel format must be 32-bit when decompressing to an integer buffer.");
 
-  TJDecompressor_decompress(env, obj, src, jpegSize, dst, sizeof(jint), x, y,
-                            width, stride * sizeof(jint), height, pf, flags);
+  TJDecompressor_decompress(env, obj, src, JNI_FALSE, jpegSize, dst,
+                            JNI_FALSE, sizeof(jint), x, y, width,
+                            stride * sizeof(jint), height, pf, flags);
 
 bailout:
   return;
@@ -771,13 +876,63 @@ JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress
   if (tjPixelSize[pf] != sizeof(jint))
     THROW_ARG("Pixel format must be 32-bit when decompressing to an integer buffer.");
 
-  TJDecompressor_decompress(env, obj, src, jpegSize, dst, sizeof(jint), 0, 0,
-                            width, stride * sizeof(jint), height, pf, flags);
+  TJDecompressor_decompress(env, obj, src, JNI_FALSE, jpegSize, dst,
+                            JNI_FALSE, sizeof(jint), 0, 0, width,
+                            stride * sizeof(jint), height, pf, flags);
 
 bailout:
   return;
 }
 
+/* TurboJPEG 2.1.x: TJDecompressor::decompress() direct source, byte
+   destination */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress__Ljava_nio_ByteBuffer_2I_3BIIIIIII
+  (JNIEnv *env, jobject obj, jobject src, jint jpegSize, jbyteArray dst,
+   jint x, jint y, jint width, jint pitch, jint height, jint pf, jint flags)
+{
+  TJDecompressor_decompress(env, obj, src, JNI_TRUE, jpegSize, dst, JNI_FALSE,
+                            1, x, y, width, pitch, height, pf, flags);
+}
+
+/* TurboJPEG 2.1.x: TJDecompressor::decompress() direct source, int
+   destination */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress__Ljava_nio_ByteBuffer_2I_3IIIIIIII
+  (JNIEnv *env, jobject obj, jobject src, jint jpegSize, jintArray dst,
+   jint x, jint y, jint width, jint stride, jint height, jint pf, jint flags)
+{
+  if (pf < 0 || pf >= org_libjpegturbo_turbojpeg_TJ_NUMPF)
+    THROW_ARG("Invalid argument in decompress()");
+  if (tjPixelSize[pf] != sizeof(jint))
+    THROW_ARG("Pixel format must be 32-bit when decompressing to an integer buffer.");
+
+  TJDecompressor_decompress(env, obj, src, JNI_TRUE, jpegSize, dst, JNI_FALSE,
+                            sizeof(jint), x, y, width, stride * sizeof(jint),
+                            height, pf, flags);
+
+bailout:
+  return;
+}
+
+/* TurboJPEG 2.1.x: TJDecompressor::decompress() byte source, direct
+   destination */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress___3BILjava_nio_ByteBuffer_2IIIIIII
+  (JNIEnv *env, jobject obj, jbyteArray src, jint jpegSize, jobject dst,
+   jint x, jint y, jint width, jint pitch, jint height, jint pf, jint flags)
+{
+  TJDecompressor_decompress(env, obj, src, JNI_FALSE, jpegSize, dst, JNI_TRUE,
+                            1, x, y, width, pitch, height, pf, flags);
+}
+
+/* TurboJPEG 2.1.x: TJDecompressor::decompress() direct source, direct
+   destination */
+JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompress__Ljava_nio_ByteBuffer_2ILjava_nio_ByteBuffer_2IIIIIII
+  (JNIEnv *env, jobject obj, jobject src, jint jpegSize, jobject dst,
+   jint x, jint y, jint width, jint pitch, jint height, jint pf, jint flags)
+{
+  TJDecompressor_decompress(env, obj, src, JNI_TRUE, jpegSize, dst, JNI_TRUE,
+                            1, x, y, width, pitch, height, pf, flags);
+}
+
 /* TurboJPEG 1.4.x: TJDecompressor::decompressToYUV() */
 JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_decompressToYUV___3BI_3_3B_3II_3III
   (JNIEnv *env, jobject obj, jbyteArray src, jint jpegSize,
@@ -1112,17 +1267,17 @@ bailout:
   return -1;
 }
 
-/* TurboJPEG 1.2.x: TJTransformer::transform() */
-JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transform
-  (JNIEnv *env, jobject obj, jbyteArray jsrcBuf, jint jpegSize,
-   jobjectArray dstobjs, jobjectArray tobjs, jint flags)
+static jintArray TJTransformer_transform
+  (JNIEnv *env, jobject obj, jobject jsrcBuf, jboolean srcDirect,
+   jint jpegSize, jobjectArray dstobjs, jboolean dstDirect, jobjectArray tobjs,
+   jint flags)
 {
   tjhandle handle = 0;
   unsigned char *jpegBuf = NULL, **dstBufs = NULL;
   jsize n = 0;
   unsigned long *dstSizes = NULL;
   tjtransform *t = NULL;
-  jbyteArray *jdstBufs = NULL;
+  jobject *jdstBufs = NULL;
   int i, jpegWidth = 0, jpegHeight = 0, jpegSubsamp;
   jintArray jdstSizes = 0;
   jint *dstSizesi = NULL;
@@ -1130,7 +1285,7 @@ JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transf
 
   GET_HANDLE();
 
-  if ((*env)->GetArrayLength(env, jsrcBuf) < jpegSize)
+  if (getBufferSize(env, jsrcBuf, srcDirect, 1) < jpegSize)
     THROW_ARG("Source buffer is not large enough");
   BAILIF0(_fid = (*env)->GetFieldID(env, _cls, "jpegWidth", "I"));
   jpegWidth = (int)(*env)->GetIntField(env, obj, _fid);
@@ -1146,7 +1301,7 @@ JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transf
   if ((dstBufs =
        (unsigned char **)malloc(sizeof(unsigned char *) * n)) == NULL)
     THROW_MEM();
-  if ((jdstBufs = (jbyteArray *)malloc(sizeof(jbyteArray) * n)) == NULL)
+  if ((jdstBufs = (jobject *)malloc(sizeof(jobject) * n)) == NULL)
     THROW_MEM();
   if ((dstSizes = (unsigned long *)malloc(sizeof(unsigned long) * n)) == NULL)
     THROW_MEM();
@@ -1197,26 +1352,36 @@ JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transf
     if (t[i].r.w != 0) w = t[i].r.w;
     if (t[i].r.h != 0) h = t[i].r.h;
     BAILIF0(jdstBufs[i] = (*env)->GetObjectArrayElement(env, dstobjs, i));
-    if ((unsigned long)(*env)->GetArrayLength(env, jdstBufs[i]) <
-        tjBufSize(w, h, jpegSubsamp))
+    if (getBufferSize(env, jdstBufs[i], dstDirect, 1) <
+        (jlong)tjBufSize(w, h, jpegSubsamp))
       THROW_ARG("Destination buffer is not large enough");
+    /* No JNI functions may be called within a critical region, so the
+       direct buffers must be resolved first. */
+    if (dstDirect)
+      BAILIF0(dstBufs[i] = (*env)->GetDirectBufferAddress(env, jdstBufs[i]));
+  }
+  if (srcDirect)
+    jpegBuf = (*env)->GetDirectBufferAddress(env, jsrcBuf);
+  else
+    jpegBuf = (*env)->GetPrimitiveArrayCritical(env, jsrcBuf, 0);
+  BAILIF0(jpegBuf);
+  if (!dstDirect) {
+    for (i = 0; i < n; i++)
+      BAILIF0(dstBufs[i] =
+              (*env)->GetPrimitiveArrayCritical(env, jdstBufs[i], 0));
   }
-  BAILIF0(jpegBuf = (*env)->GetPrimitiveArrayCritical(env, jsrcBuf, 0));
-  for (i = 0; i < n; i++)
-    BAILIF0(dstBufs[i] =
-            (*env)->GetPrimitiveArrayCritical(env, jdstBufs[i], 0));
 
   if (tjTransform(handle, jpegBuf, jpegSize, n, dstBufs, dstSizes, t,
                   flags | TJFLAG_NOREALLOC) == -1) {
     for (i = 0; i < n; i++)
-      SAFE_RELEASE(jdstBufs[i], dstBufs[i]);
-    SAFE_RELEASE(jsrcBuf, jpegBuf);
+      SAFE_RELEASE_BUF(jdstBufs[i], dstDirect, dstBufs[i]);
+    SAFE_RELEASE_BUF(jsrcBuf, srcDirect, jpegBuf);
     THROW_TJ();
   }
 
   for (i = 0; i < n; i++)
-    SAFE_RELEASE(jdstBufs[i], dstBufs[i]);
-  SAFE_RELEASE(jsrcBuf, jpegBuf);
+    SAFE_RELEASE_BUF(jdstBufs[i], dstDirect, dstBufs[i]);
+  SAFE_RELEASE_BUF(jsrcBuf, srcDirect, jpegBuf);
 
   jdstSizes = (*env)->NewIntArray(env, n);
   BAILIF0(dstSizesi = (*env)->GetIntArrayElements(env, jdstSizes, 0));
@@ -1226,18 +1391,57 @@ bailout:
   if (dstSizesi) (*env)->ReleaseIntArrayElements(env, jdstSizes, dstSizesi, 0);
   if (dstBufs) {
     for (i = 0; i < n; i++) {
-      if (dstBufs[i] && jdstBufs && jdstBufs[i])
+      if (dstBufs[i] && jdstBufs && jdstBufs[i] && !dstDirect)
         (*env)->ReleasePrimitiveArrayCritical(env, jdstBufs[i], dstBufs[i], 0);
     }
     free(dstBufs);
   }
-  SAFE_RELEASE(jsrcBuf, jpegBuf);
+  SAFE_RELEASE_BUF(jsrcBuf, srcDirect, jpegBuf);
   free(jdstBufs);
   free(dstSizes);
   free(t);
   return jdstSizes;
 }
 
+/* TurboJPEG 1.2.x: TJTransformer::transform() */
+JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transform
+  (JNIEnv *env, jobject obj, jbyteArray jsrcBuf, jint jpegSize,
+   jobjectArray dstobjs, jobjectArray tobjs, jint flags)
+{
+  return TJTransformer_transform(env, obj, jsrcBuf, JNI_FALSE, jpegSize,
+                                 dstobjs, JNI_FALSE, tobjs, flags);
+}
+
+/* TurboJPEG 2.1.x: TJTransformer::transformDirect() direct source, byte
+   destinations */
+JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transformDirect__Ljava_nio_ByteBuffer_2I_3_3B_3Lorg_libjpegturbo_turbojpeg_TJTransform_2I
+  (JNIEnv *env, jobject obj, jobject jsrcBuf, jint jpegSize,
+   jobjectArray dstobjs, jobjectArray tobjs, jint flags)
+{
+  return TJTransformer_transform(env, obj, jsrcBuf, JNI_TRUE, jpegSize,
+                                 dstobjs, JNI_FALSE, tobjs, flags);
+}
+
+/* TurboJPEG 2.1.x: TJTransformer::transformDirect() byte source, direct
+   destinations */
+JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transformDirect___3BI_3Ljava_nio_ByteBuffer_2_3Lorg_libjpegturbo_turbojpeg_TJTransform_2I
+  (JNIEnv *env, jobject obj, jbyteArray jsrcBuf, jint jpegSize,
+   jobjectArray dstobjs, jobjectArray tobjs, jint flags)
+{
+  return TJTransformer_transform(env, obj, jsrcBuf, JNI_FALSE, jpegSize,
+                                 dstobjs, JNI_TRUE, tobjs, flags);
+}
+
+/* TurboJPEG 2.1.x: TJTransformer::transformDirect() direct source, direct
+   destinations */
+JNIEXPORT jintArray JNICALL Java_org_libjpegturbo_turbojpeg_TJTransformer_transformDirect__Ljava_nio_ByteBuffer_2I_3Ljava_nio_ByteBuffer_2_3Lorg_libjpegturbo_turbojpeg_TJTransform_2I
+  (JNIEnv *env, jobject obj, jobject jsrcBuf, jint jpegSize,
+   jobjectArray dstobjs, jobjectArray tobjs, jint flags)
+{
+  return TJTransformer_transform(env, obj, jsrcBuf, JNI_TRUE, jpegSize,
+                                 dstobjs, JNI_TRUE, tobjs, flags);
+}
+
 /* TurboJPEG 1.2.x: TJDecompressor::destroy() */
 JNIEXPORT void JNICALL Java_org_libjpegturbo_turbojpeg_TJDecompressor_destroy
   (JNIEnv *env, jobject obj)
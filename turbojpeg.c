@@ -38,6 +38,12 @@
 #include <jerror.h>
 #include <setjmp.h>
 #include <errno.h>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 #include "./turbojpeg.h"
 #include "./tjutil.h"
 #include "transupp.h"
@@ -48,6 +54,10 @@ extern void jpeg_mem_dest_tj(j_compress_ptr, unsigned char **, unsigned long *,
                              boolean);
 extern void jpeg_mem_src_tj(j_decompress_ptr, const unsigned char *,
                             unsigned long);
+extern size_t jpeg_dct_cache_size_tj(j_compress_ptr);
+extern void jpeg_dct_cache_tj(j_compress_ptr, void *, size_t, boolean);
+extern void jpeg_coef_source_tj(j_decompress_ptr, j_decompress_ptr);
+extern const char *jsimd_get_name(void);
 
 #define PAD(v, p)  ((v + (p) - 1) & (~((p) - 1)))
 #define IS_POW2(x)  (((x) & (x - 1)) == 0)
@@ -62,6 +72,8 @@ struct my_error_mgr {
   jmp_buf setjmp_buffer;
   void (*emit_message) (j_common_ptr, int);
   boolean warning, stopOnWarning;
+  char *msgBuf;                 /* if not NULL, receives library messages
+                                   instead of the global error string */
 };
 typedef struct my_error_mgr *my_error_ptr;
 
@@ -83,7 +95,10 @@ static void my_error_exit(j_common_ptr cinfo)
 
 static void my_output_message(j_common_ptr cinfo)
 {
-  (*cinfo->err->format_message) (cinfo, errStr);
+  my_error_ptr myerr = (my_error_ptr)cinfo->err;
+
+  (*cinfo->err->format_message) (cinfo,
+                                 myerr->msgBuf ? myerr->msgBuf : errStr);
 }
 
 static void my_emit_message(j_common_ptr cinfo, int msg_level)
@@ -102,6 +117,38 @@ static void my_emit_message(j_common_ptr cinfo, int msg_level)
 
 enum { COMPRESS = 1, DECOMPRESS = 2 };
 
+/* Kinds of destination manager used by the compressor */
+enum { DEST_MEM = 0, DEST_CHUNK, DEST_CALLBACK, NUMDEST };
+
+/* States of an incremental decompression stream (see
+   tjDecompressStreamHeader()) */
+enum {
+  STREAM_IDLE = 0,              /* no stream in progress */
+  STREAM_HEADER,                /* reading the JPEG header */
+  STREAM_HEADER_DONE,           /* header read, output not yet set up */
+  STREAM_STARTING,              /* in jpeg_start_decompress() */
+  STREAM_SCANLINES              /* in jpeg_read_scanlines() */
+};
+
+typedef struct {
+  struct jpeg_source_mgr pub;   /* public fields (must be first) */
+  unsigned char *buf;           /* data left over from previous calls */
+  size_t bufSize;               /* allocated size of buf */
+  unsigned long skipBytes;      /* bytes to discard from the next data */
+  const JOCTET *data;           /* caller's data that follows buf */
+  size_t dataSize;
+  boolean switched;             /* TRUE = decompressor has moved on to data */
+  const JOCTET *backup;         /* restart point in buf when data was reached */
+  size_t backupSize;
+  boolean eos;                  /* TRUE = no more data is forthcoming */
+  boolean eoiFound;             /* TRUE = EOI marker has been received */
+  size_t scanned;               /* bytes already searched for EOI marker */
+  int state;
+  JSAMPROW *row_pointer;
+  unsigned char *dstBuf;        /* output parameters, as originally passed */
+  int width, pitch, height, pixelFormat, flags;
+} tjstream;
+
 typedef struct _tjinstance {
   struct jpeg_compress_struct cinfo;
   struct jpeg_decompress_struct dinfo;
@@ -109,6 +156,22 @@ typedef struct _tjinstance {
   int init, headerRead;
   char errStr[JMSG_LENGTH_MAX];
   boolean isInstanceError;
+  tjstream stream;
+  /* Unquantized DCT output, indexed by (dct_method == JDCT_ISLOW), saved
+     for the duration of a multi-quality compression (see compressQuality()) */
+  void *dctCache[2];
+  size_t dctCacheSize[2];
+  /* Write function and its argument, for the duration of a call to
+     tjCompressToCallback() */
+  tjwritefunc writeFunc;
+  void *writeData;
+  /* Destination managers that are not currently attached to cinfo */
+  struct jpeg_destination_mgr *dest[NUMDEST];
+  int destType;
+  /* Decompressor instances used by the worker threads of
+     tjDecompressBatch(), kept so that later batches can reuse them */
+  struct _tjinstance **workers;
+  int numWorkers;
 } tjinstance;
 
 static const int pixelsize[TJ_NUMSAMP] = { 3, 3, 3, 1, 3, 3 };
@@ -176,6 +239,12 @@ static int cs2pf[JPEG_NUMCS] = {
   snprintf(this->errStr, JMSG_LENGTH_MAX, "%s", m); \
   this->isInstanceError = TRUE;  THROWG(m) \
 }
+/* Same as THROW(), but leaves the global error string alone (for use in the
+   worker threads of tjDecompressBatch()) */
+#define THROWI(m) { \
+  snprintf(this->errStr, JMSG_LENGTH_MAX, "%s", m); \
+  this->isInstanceError = TRUE;  retval = -1;  goto bailout; \
+}
 
 #define GET_INSTANCE(handle) \
   tjinstance *this = (tjinstance *)handle; \
@@ -214,6 +283,16 @@ static int cs2pf[JPEG_NUMCS] = {
   this->jerr.warning = FALSE; \
   this->isInstanceError = FALSE;
 
+#define GET_TJINSTANCE(handle) \
+  tjinstance *this = (tjinstance *)handle; \
+  \
+  if (!this) { \
+    snprintf(errStr, JMSG_LENGTH_MAX, "Invalid handle"); \
+    return -1; \
+  } \
+  this->jerr.warning = FALSE; \
+  this->isInstanceError = FALSE;
+
 static int getPixelFormat(int pixelSize, int flags)
 {
   if (pixelSize == 1) return TJPF_GRAY;
@@ -304,7 +383,9 @@ static int setCompDefaults(struct jpeg_compress_struct *cinfo, int pixelFormat,
 }
 
 
-static int getSubsamp(j_decompress_ptr dinfo)
+static int getSubsampFromFactors(int num_components,
+                                 J_COLOR_SPACE jpeg_color_space,
+                                 const jpeg_component_info *comp_info)
 {
   int retval = -1, i, k;
 
@@ -312,68 +393,68 @@ static int getSubsamp(j_decompress_ptr dinfo)
      and in fact it's possible to generate grayscale JPEGs with sampling
      factors > 1 (even though those sampling factors are ignored by the
      decompressor.)  Thus, we need to treat grayscale as a special case. */
-  if (dinfo->num_components == 1 && dinfo->jpeg_color_space == JCS_GRAYSCALE)
+  if (num_components == 1 && jpeg_color_space == JCS_GRAYSCALE)
     return TJSAMP_GRAY;
 
   for (i = 0; i < NUMSUBOPT; i++) {
-    if (dinfo->num_components == pixelsize[i] ||
-        ((dinfo->jpeg_color_space == JCS_YCCK ||
-          dinfo->jpeg_color_space == JCS_CMYK) &&
-         pixelsize[i] == 3 && dinfo->num_components == 4)) {
-      if (dinfo->comp_info[0].h_samp_factor == tjMCUWidth[i] / 8 &&
-          dinfo->comp_info[0].v_samp_factor == tjMCUHeight[i] / 8) {
+    if (num_components == pixelsize[i] ||
+        ((jpeg_color_space == JCS_YCCK ||
+          jpeg_color_space == JCS_CMYK) &&
+         pixelsize[i] == 3 && num_components == 4)) {
+      if (comp_info[0].h_samp_factor == tjMCUWidth[i] / 8 &&
+          comp_info[0].v_samp_factor == tjMCUHeight[i] / 8) {
         int match = 0;
 
-        for (k = 1; k < dinfo->num_components; k++) {
+        for (k = 1; k < num_components; k++) {
           int href = 1, vref = 1;
 
-          if ((dinfo->jpeg_color_space == JCS_YCCK ||
-               dinfo->jpeg_color_space == JCS_CMYK) && k == 3) {
+          if ((jpeg_color_space == JCS_YCCK ||
+               jpeg_color_space == JCS_CMYK) && k == 3) {
             href = tjMCUWidth[i] / 8;  vref = tjMCUHeight[i] / 8;
           }
-          if (dinfo->comp_info[k].h_samp_factor == href &&
-              dinfo->comp_info[k].v_samp_factor == vref)
+          if (comp_info[k].h_samp_factor == href &&
+              comp_info[k].v_samp_factor == vref)
             match++;
         }
-        if (match == dinfo->num_components - 1) {
+        if (match == num_components - 1) {
           retval = i;  break;
         }
       }
       /* Handle 4:2:2 and 4:4:0 images whose sampling factors are specified
          in non-standard ways. */
-      if (dinfo->comp_info[0].h_samp_factor == 2 &&
-          dinfo->comp_info[0].v_samp_factor == 2 &&
+      if (comp_info[0].h_samp_factor == 2 &&
+          comp_info[0].v_samp_factor == 2 &&
           (i == TJSAMP_422 || i == TJSAMP_440)) {
         int match = 0;
 
-        for (k = 1; k < dinfo->num_components; k++) {
+        for (k = 1; k < num_components; k++) {
           int href = tjMCUHeight[i] / 8, vref = tjMCUWidth[i] / 8;
 
-          if ((dinfo->jpeg_color_space == JCS_YCCK ||
-               dinfo->jpeg_color_space == JCS_CMYK) && k == 3) {
+          if ((jpeg_color_space == JCS_YCCK ||
+               jpeg_color_space == JCS_CMYK) && k == 3) {
             href = vref = 2;
           }
-          if (dinfo->comp_info[k].h_samp_factor == href &&
-              dinfo->comp_info[k].v_samp_factor == vref)
+          if (comp_info[k].h_samp_factor == href &&
+              comp_info[k].v_samp_factor == vref)
             match++;
         }
-        if (match == dinfo->num_components - 1) {
+        if (match == num_components - 1) {
           retval = i;  break;
         }
       }
       /* Handle 4:4:4 images whose sampling factors are specified in
          non-standard ways. */
-      if (dinfo->comp_info[0].h_samp_factor *
-          dinfo->comp_info[0].v_samp_factor <=
+      if (comp_info[0].h_samp_factor *
+          comp_info[0].v_samp_factor <=
           D_MAX_BLOCKS_IN_MCU / pixelsize[i] && i == TJSAMP_444) {
         int match = 0;
-        for (k = 1; k < dinfo->num_components; k++) {
-          if (dinfo->comp_info[k].h_samp_factor ==
-              dinfo->comp_info[0].h_samp_factor &&
-              dinfo->comp_info[k].v_samp_factor ==
-              dinfo->comp_info[0].v_samp_factor)
+        for (k = 1; k < num_components; k++) {
+          if (comp_info[k].h_samp_factor ==
+              comp_info[0].h_samp_factor &&
+              comp_info[k].v_samp_factor ==
+              comp_info[0].v_samp_factor)
             match++;
-          if (match == dinfo->num_components - 1) {
+          if (match == num_components - 1) {
             retval = i;  break;
           }
         }
@@ -383,6 +464,30 @@ static int getSubsamp(j_decompress_ptr dinfo)
   return retval;
 }
 
+static int getSubsamp(j_decompress_ptr dinfo)
+{
+  return getSubsampFromFactors(dinfo->num_components, dinfo->jpeg_color_space,
+                               dinfo->comp_info);
+}
+
+
+static int getColorspaceFromJCS(J_COLOR_SPACE jpeg_color_space)
+{
+  switch (jpeg_color_space) {
+  case JCS_GRAYSCALE:  return TJCS_GRAY;
+  case JCS_RGB:        return TJCS_RGB;
+  case JCS_YCbCr:      return TJCS_YCbCr;
+  case JCS_CMYK:       return TJCS_CMYK;
+  case JCS_YCCK:       return TJCS_YCCK;
+  default:             return -1;
+  }
+}
+
+static int getColorspace(j_decompress_ptr dinfo)
+{
+  return getColorspaceFromJCS(dinfo->jpeg_color_space);
+}
+
 
 /* General API functions */
 
@@ -413,13 +518,79 @@ DLLEXPORT int tjGetErrorCode(tjhandle handle)
 }
 
 
+DLLEXPORT int tjEnableProfiling(tjhandle handle, int enable)
+{
+  int retval = 0;
+
+  GET_INSTANCE(handle);
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+  if (((this->init & COMPRESS) &&
+       !jpeg_enable_profiling((j_common_ptr)cinfo, (boolean)!!enable)) ||
+      ((this->init & DECOMPRESS) &&
+       !jpeg_enable_profiling((j_common_ptr)dinfo, (boolean)!!enable)))
+    THROW("tjEnableProfiling(): Profiling support was not built in");
+
+bailout:
+  return retval;
+}
+
+
+DLLEXPORT int tjGetProfile(tjhandle handle, tjprofile *profile)
+{
+  jpeg_stage_profile stages[JPROF_NUMSTAGES];
+  int retval = 0, i;
+
+  GET_INSTANCE(handle);
+
+  if (profile == NULL)
+    THROW("tjGetProfile(): Invalid argument");
+
+  memset(profile, 0, sizeof(tjprofile) * TJ_NUMPROF);
+  if (this->init & COMPRESS) {
+    jpeg_get_profile((j_common_ptr)cinfo, stages);
+    for (i = 0; i < TJ_NUMPROF; i++) {
+      profile[i].ticks += stages[i].ticks;
+      profile[i].calls += stages[i].calls;
+    }
+  }
+  if (this->init & DECOMPRESS) {
+    jpeg_get_profile((j_common_ptr)dinfo, stages);
+    for (i = 0; i < TJ_NUMPROF; i++) {
+      profile[i].ticks += stages[i].ticks;
+      profile[i].calls += stages[i].calls;
+    }
+  }
+
+bailout:
+  return retval;
+}
+
+
+DLLEXPORT const char *tjGetSIMDName(void)
+{
+  return jsimd_get_name();
+}
+
+
 DLLEXPORT int tjDestroy(tjhandle handle)
 {
+  int i;
+
   GET_INSTANCE(handle);
 
   if (setjmp(this->jerr.setjmp_buffer)) return -1;
   if (this->init & COMPRESS) jpeg_destroy_compress(cinfo);
   if (this->init & DECOMPRESS) jpeg_destroy_decompress(dinfo);
+  free(this->stream.buf);
+  free(this->stream.row_pointer);
+  for (i = 0; i < this->numWorkers; i++)
+    tjDestroy((tjhandle)this->workers[i]);
+  free(this->workers);
   free(this);
   return 0;
 }
@@ -721,6 +892,399 @@ DLLEXPORT int tjCompress(tjhandle handle, unsigned char *srcBuf, int width,
 }
 
 
+/* Compress the source image at one quality level of a multi-quality
+   compression.  The first time that a particular DCT method is used, the
+   image is compressed from row_pointer[], and the unquantized DCT output is
+   saved.  After that, the saved DCT output is simply requantized, so color
+   conversion, downsampling, and the forward DCT are skipped.  Returns -1 if
+   setCompDefaults() fails.  Other errors, including failure to allocate the
+   DCT output buffer, are signaled through the libjpeg error handler, so the
+   caller must call setjmp() first and must free the DCT output buffers when
+   finished. */
+
+static int compressQuality(tjinstance *this, JSAMPROW *row_pointer,
+                           int width, int height, int pixelFormat,
+                           unsigned char **jpegBuf, unsigned long *jpegSize,
+                           int jpegSubsamp, int jpegQual, int flags)
+{
+  j_compress_ptr cinfo = &this->cinfo;
+  JSAMPARRAY dummyPlanes[MAX_COMPONENTS];
+  int alloc = 1, index;
+
+  cinfo->image_width = width;
+  cinfo->image_height = height;
+
+  if (flags & TJFLAG_NOREALLOC) {
+    alloc = 0;  *jpegSize = tjBufSize(width, height, jpegSubsamp);
+  }
+  jpeg_mem_dest_tj(cinfo, jpegBuf, jpegSize, alloc);
+  if (setCompDefaults(cinfo, pixelFormat, jpegSubsamp, jpegQual, flags) == -1)
+    return -1;
+
+  /* The quality level determines the DCT method, and the DCT output differs
+     between methods. */
+  index = (cinfo->dct_method == JDCT_ISLOW);
+  if (this->dctCache[index] == NULL) {
+    jpeg_start_compress(cinfo, TRUE);
+    this->dctCacheSize[index] = jpeg_dct_cache_size_tj(cinfo);
+    if ((this->dctCache[index] = malloc(this->dctCacheSize[index])) == NULL)
+      ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 0);
+    jpeg_dct_cache_tj(cinfo, this->dctCache[index],
+                      this->dctCacheSize[index], FALSE);
+    while (cinfo->next_scanline < cinfo->image_height)
+      jpeg_write_scanlines(cinfo, &row_pointer[cinfo->next_scanline],
+                           cinfo->image_height - cinfo->next_scanline);
+  } else {
+    /* The sample data are not read when reusing the DCT output, so we can
+       bypass the preprocessing steps by pretending to write raw data. */
+    cinfo->raw_data_in = TRUE;
+    jpeg_start_compress(cinfo, TRUE);
+    jpeg_dct_cache_tj(cinfo, this->dctCache[index], this->dctCacheSize[index],
+                      TRUE);
+    MEMZERO(dummyPlanes, sizeof(dummyPlanes));
+    while (cinfo->next_scanline < cinfo->image_height)
+      jpeg_write_raw_data(cinfo, dummyPlanes,
+                          cinfo->max_v_samp_factor * DCTSIZE);
+  }
+  jpeg_finish_compress(cinfo);
+  return 0;
+}
+
+static void freeDCTCache(tjinstance *this)
+{
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    free(this->dctCache[i]);
+    this->dctCache[i] = NULL;
+    this->dctCacheSize[i] = 0;
+  }
+}
+
+
+DLLEXPORT int tjCompressMulti(tjhandle handle, const unsigned char *srcBuf,
+                              int width, int pitch, int height,
+                              int pixelFormat, unsigned char **jpegBufs,
+                              unsigned long *jpegSizes, int jpegSubsamp,
+                              const int *jpegQuals, int n, int flags)
+{
+  int i, retval = 0;
+  JSAMPROW *row_pointer = NULL;
+
+  GET_CINSTANCE(handle)
+  this->jerr.stopOnWarning = (flags & TJFLAG_STOPONWARNING) ? TRUE : FALSE;
+  if ((this->init & COMPRESS) == 0)
+    THROW("tjCompressMulti(): Instance has not been initialized for compression");
+
+  if (srcBuf == NULL || width <= 0 || pitch < 0 || height <= 0 ||
+      pixelFormat < 0 || pixelFormat >= TJ_NUMPF || jpegBufs == NULL ||
+      jpegSizes == NULL || jpegSubsamp < 0 || jpegSubsamp >= NUMSUBOPT ||
+      jpegQuals == NULL || n < 1)
+    THROW("tjCompressMulti(): Invalid argument");
+  for (i = 0; i < n; i++) {
+    if (jpegQuals[i] < 0 || jpegQuals[i] > 100)
+      THROW("tjCompressMulti(): Invalid argument");
+  }
+
+  if (pitch == 0) pitch = width * tjPixelSize[pixelFormat];
+
+  if ((row_pointer = (JSAMPROW *)malloc(sizeof(JSAMPROW) * height)) == NULL)
+    THROW("tjCompressMulti(): Memory allocation failure");
+  for (i = 0; i < height; i++) {
+    if (flags & TJFLAG_BOTTOMUP)
+      row_pointer[i] = (JSAMPROW)&srcBuf[(height - i - 1) * (size_t)pitch];
+    else
+      row_pointer[i] = (JSAMPROW)&srcBuf[i * (size_t)pitch];
+  }
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+  for (i = 0; i < n; i++) {
+    if ((retval = compressQuality(this, row_pointer, width, height,
+                                  pixelFormat, &jpegBufs[i], &jpegSizes[i],
+                                  jpegSubsamp, jpegQuals[i], flags)) == -1)
+      goto bailout;
+  }
+
+bailout:
+  if (cinfo->global_state > CSTATE_START) jpeg_abort_compress(cinfo);
+  free(row_pointer);
+  freeDCTCache(this);
+  if (this->jerr.warning) retval = -1;
+  this->jerr.stopOnWarning = FALSE;
+  return retval;
+}
+
+
+DLLEXPORT int tjCompressToSize(tjhandle handle, const unsigned char *srcBuf,
+                               int width, int pitch, int height,
+                               int pixelFormat, unsigned char **jpegBuf,
+                               unsigned long *jpegSize, int jpegSubsamp,
+                               int *jpegQual, unsigned long targetSize,
+                               int flags)
+{
+  int i, retval = 0, minQual = 1, maxQual, qual;
+  JSAMPROW *row_pointer = NULL;
+
+  GET_CINSTANCE(handle)
+  this->jerr.stopOnWarning = (flags & TJFLAG_STOPONWARNING) ? TRUE : FALSE;
+  if ((this->init & COMPRESS) == 0)
+    THROW("tjCompressToSize(): Instance has not been initialized for compression");
+
+  if (srcBuf == NULL || width <= 0 || pitch < 0 || height <= 0 ||
+      pixelFormat < 0 || pixelFormat >= TJ_NUMPF || jpegBuf == NULL ||
+      jpegSize == NULL || jpegSubsamp < 0 || jpegSubsamp >= NUMSUBOPT ||
+      jpegQual == NULL || *jpegQual < 1 || *jpegQual > 100)
+    THROW("tjCompressToSize(): Invalid argument");
+  maxQual = *jpegQual;
+
+  if (pitch == 0) pitch = width * tjPixelSize[pixelFormat];
+
+  if ((row_pointer = (JSAMPROW *)malloc(sizeof(JSAMPROW) * height)) == NULL)
+    THROW("tjCompressToSize(): Memory allocation failure");
+  for (i = 0; i < height; i++) {
+    if (flags & TJFLAG_BOTTOMUP)
+      row_pointer[i] = (JSAMPROW)&srcBuf[(height - i - 1) * (size_t)pitch];
+    else
+      row_pointer[i] = (JSAMPROW)&srcBuf[i * (size_t)pitch];
+  }
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+  /* Binary search for the highest quality level whose JPEG image fits.  Each
+     attempt overwrites the destination buffer, so the image from the last
+     attempt is kept if it is the one we want. */
+  qual = 0;
+  while (minQual < maxQual) {
+    qual = (minQual + maxQual + 1) / 2;
+    if ((retval = compressQuality(this, row_pointer, width, height,
+                                  pixelFormat, jpegBuf, jpegSize, jpegSubsamp,
+                                  qual, flags)) == -1)
+      goto bailout;
+    if (*jpegSize <= targetSize)
+      minQual = qual;
+    else
+      maxQual = qual - 1;
+  }
+  if (qual != minQual) {
+    if ((retval = compressQuality(this, row_pointer, width, height,
+                                  pixelFormat, jpegBuf, jpegSize, jpegSubsamp,
+                                  minQual, flags)) == -1)
+      goto bailout;
+  }
+  *jpegQual = minQual;
+
+bailout:
+  if (cinfo->global_state > CSTATE_START) jpeg_abort_compress(cinfo);
+  free(row_pointer);
+  freeDCTCache(this);
+  if (this->jerr.warning) retval = -1;
+  this->jerr.stopOnWarning = FALSE;
+  return retval;
+}
+
+
+/* The libjpeg destination managers refuse to replace a destination manager of
+   a different kind, since they are allocated from the permanent pool and
+   cannot be freed.  Thus, each kind is created once per instance and swapped
+   into cinfo as needed.  The in-memory destination manager is attached
+   whenever a TurboJPEG function is not running. */
+
+static void setDestType(tjinstance *this, int destType)
+{
+  if (destType == this->destType) return;
+  this->dest[this->destType] = this->cinfo.dest;
+  this->cinfo.dest = this->dest[destType];
+  this->destType = destType;
+}
+
+
+/* Compress the rows of a packed-pixel image to whichever destination manager
+   has been attached to this->cinfo.  Errors are signaled through the libjpeg
+   error handler, so the caller must call setjmp() first. */
+
+static int compressRows(tjinstance *this, JSAMPROW *row_pointer, int width,
+                        int height, int pixelFormat, int jpegSubsamp,
+                        int jpegQual, int flags)
+{
+  j_compress_ptr cinfo = &this->cinfo;
+
+  cinfo->image_width = width;
+  cinfo->image_height = height;
+  if (setCompDefaults(cinfo, pixelFormat, jpegSubsamp, jpegQual, flags) == -1)
+    return -1;
+
+  jpeg_start_compress(cinfo, TRUE);
+  while (cinfo->next_scanline < cinfo->image_height)
+    jpeg_write_scanlines(cinfo, &row_pointer[cinfo->next_scanline],
+                         cinfo->image_height - cinfo->next_scanline);
+  jpeg_finish_compress(cinfo);
+  return 0;
+}
+
+
+DLLEXPORT int tjCompressToChunks(tjhandle handle, const unsigned char *srcBuf,
+                                 int width, int pitch, int height,
+                                 int pixelFormat, tjchunk **chunks,
+                                 int *numChunks, int jpegSubsamp,
+                                 int jpegQual, int flags)
+{
+  int i, retval = 0;
+  JSAMPROW *row_pointer = NULL;
+  jpeg_chunk_list list;
+
+  MEMZERO(&list, sizeof(jpeg_chunk_list));
+
+  GET_CINSTANCE(handle)
+  this->jerr.stopOnWarning = (flags & TJFLAG_STOPONWARNING) ? TRUE : FALSE;
+  if ((this->init & COMPRESS) == 0)
+    THROW("tjCompressToChunks(): Instance has not been initialized for compression");
+
+  if (srcBuf == NULL || width <= 0 || pitch < 0 || height <= 0 ||
+      pixelFormat < 0 || pixelFormat >= TJ_NUMPF || chunks == NULL ||
+      numChunks == NULL || jpegSubsamp < 0 || jpegSubsamp >= NUMSUBOPT ||
+      jpegQual < 0 || jpegQual > 100)
+    THROW("tjCompressToChunks(): Invalid argument");
+  *chunks = NULL;
+  *numChunks = 0;
+
+  if (pitch == 0) pitch = width * tjPixelSize[pixelFormat];
+
+  if ((row_pointer = (JSAMPROW *)malloc(sizeof(JSAMPROW) * height)) == NULL)
+    THROW("tjCompressToChunks(): Memory allocation failure");
+  for (i = 0; i < height; i++) {
+    if (flags & TJFLAG_BOTTOMUP)
+      row_pointer[i] = (JSAMPROW)&srcBuf[(height - i - 1) * (size_t)pitch];
+    else
+      row_pointer[i] = (JSAMPROW)&srcBuf[i * (size_t)pitch];
+  }
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+#ifndef NO_PUTENV
+  if (flags & TJFLAG_FORCEMMX) putenv("JSIMD_FORCEMMX=1");
+  else if (flags & TJFLAG_FORCESSE) putenv("JSIMD_FORCESSE=1");
+  else if (flags & TJFLAG_FORCESSE2) putenv("JSIMD_FORCESSE2=1");
+#endif
+
+  setDestType(this, DEST_CHUNK);
+  jpeg_chunk_dest(cinfo, &list);
+  if ((retval = compressRows(this, row_pointer, width, height, pixelFormat,
+                             jpegSubsamp, jpegQual, flags)) == -1)
+    goto bailout;
+
+  /* Hand the chunks over to the caller.  Only the descriptors are copied. */
+  if ((*chunks = (tjchunk *)malloc(sizeof(tjchunk) * list.num_chunks)) ==
+      NULL)
+    THROW("tjCompressToChunks(): Memory allocation failure");
+  for (i = 0; i < (int)list.num_chunks; i++) {
+    (*chunks)[i].data = list.chunks[i].data;
+    (*chunks)[i].size = (unsigned long)list.chunks[i].size;
+  }
+  *numChunks = (int)list.num_chunks;
+  free(list.chunks);
+  MEMZERO(&list, sizeof(jpeg_chunk_list));
+
+bailout:
+  if (cinfo->global_state > CSTATE_START) jpeg_abort_compress(cinfo);
+  setDestType(this, DEST_MEM);
+  jpeg_free_chunks(&list);
+  free(row_pointer);
+  if (this->jerr.warning) retval = -1;
+  this->jerr.stopOnWarning = FALSE;
+  return retval;
+}
+
+
+DLLEXPORT void tjFreeChunks(tjchunk *chunks, int numChunks)
+{
+  int i;
+
+  if (chunks == NULL) return;
+  for (i = 0; i < numChunks; i++)
+    free(chunks[i].data);
+  free(chunks);
+}
+
+
+static boolean write_callback_data(j_compress_ptr cinfo, const JOCTET *data,
+                                   size_t size)
+{
+  tjinstance *this = (tjinstance *)cinfo;
+
+  return (*this->writeFunc) (data, (unsigned long)size, this->writeData) == 0;
+}
+
+DLLEXPORT int tjCompressToCallback(tjhandle handle,
+                                   const unsigned char *srcBuf, int width,
+                                   int pitch, int height, int pixelFormat,
+                                   tjwritefunc writeFunc, void *userData,
+                                   int jpegSubsamp, int jpegQual, int flags)
+{
+  int i, retval = 0;
+  JSAMPROW *row_pointer = NULL;
+
+  GET_CINSTANCE(handle)
+  this->jerr.stopOnWarning = (flags & TJFLAG_STOPONWARNING) ? TRUE : FALSE;
+  if ((this->init & COMPRESS) == 0)
+    THROW("tjCompressToCallback(): Instance has not been initialized for compression");
+
+  if (srcBuf == NULL || width <= 0 || pitch < 0 || height <= 0 ||
+      pixelFormat < 0 || pixelFormat >= TJ_NUMPF || writeFunc == NULL ||
+      jpegSubsamp < 0 || jpegSubsamp >= NUMSUBOPT || jpegQual < 0 ||
+      jpegQual > 100)
+    THROW("tjCompressToCallback(): Invalid argument");
+
+  if (pitch == 0) pitch = width * tjPixelSize[pixelFormat];
+
+  if ((row_pointer = (JSAMPROW *)malloc(sizeof(JSAMPROW) * height)) == NULL)
+    THROW("tjCompressToCallback(): Memory allocation failure");
+  for (i = 0; i < height; i++) {
+    if (flags & TJFLAG_BOTTOMUP)
+      row_pointer[i] = (JSAMPROW)&srcBuf[(height - i - 1) * (size_t)pitch];
+    else
+      row_pointer[i] = (JSAMPROW)&srcBuf[i * (size_t)pitch];
+  }
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+#ifndef NO_PUTENV
+  if (flags & TJFLAG_FORCEMMX) putenv("JSIMD_FORCEMMX=1");
+  else if (flags & TJFLAG_FORCESSE) putenv("JSIMD_FORCESSE=1");
+  else if (flags & TJFLAG_FORCESSE2) putenv("JSIMD_FORCESSE2=1");
+#endif
+
+  this->writeFunc = writeFunc;
+  this->writeData = userData;
+  setDestType(this, DEST_CALLBACK);
+  jpeg_callback_dest(cinfo, write_callback_data);
+  retval = compressRows(this, row_pointer, width, height, pixelFormat,
+                        jpegSubsamp, jpegQual, flags);
+
+bailout:
+  if (cinfo->global_state > CSTATE_START) jpeg_abort_compress(cinfo);
+  setDestType(this, DEST_MEM);
+  free(row_pointer);
+  this->writeFunc = NULL;
+  this->writeData = NULL;
+  if (this->jerr.warning) retval = -1;
+  this->jerr.stopOnWarning = FALSE;
+  return retval;
+}
+
+
 DLLEXPORT int tjEncodeYUVPlanes(tjhandle handle, const unsigned char *srcBuf,
                                 int width, int pitch, int height,
                                 int pixelFormat, unsigned char **dstPlanes,
@@ -1112,7 +1676,297 @@ bailout:
 }
 
 
-/* Decompressor */
+/* Decompressor */
+
+/* Source manager for incremental decompression.  Each call to
+   tjDecompressStreamHeader() or tjDecompressStreamRows() reads directly from
+   the caller's buffer.  If data were left over from the previous call, then
+   the decompressor reads them from stream->buf first and moves on to the
+   caller's buffer when they run out.  Only the data that the decompressor has
+   not consumed when the call returns (because the decompressor suspended in
+   the middle of a marker or an MCU) are copied into stream->buf, so that they
+   can be rescanned when more data arrive. */
+
+static void init_stream_source(j_decompress_ptr dinfo)
+{
+  /* no work necessary here */
+}
+
+/* Discard any data that skip_stream_input_data() could not skip because they
+   follow the leftover data. */
+
+static void streamSkip(tjstream *stream)
+{
+  size_t skip;
+
+  if (stream->switched || stream->skipBytes == 0) return;
+  skip = stream->dataSize < stream->skipBytes ?
+         stream->dataSize : (size_t)stream->skipBytes;
+  stream->data += skip;  stream->dataSize -= skip;
+  stream->skipBytes -= (unsigned long)skip;
+}
+
+static boolean fill_stream_input_buffer(j_decompress_ptr dinfo)
+{
+  static const JOCTET mybuffer[4] = {
+    (JOCTET)0xFF, (JOCTET)JPEG_EOI, 0, 0
+  };
+  tjstream *stream = (tjstream *)dinfo->src;
+
+  streamSkip(stream);
+  if (!stream->switched && stream->dataSize > 0) {
+    /* The leftover data have been used up, so move on to the caller's data.
+       The decompressor has not synchronized its position since it last did
+       so in the leftover data, so it might still back up to that point.
+       Remember where it is, so that streamSave() can preserve the data from
+       there on. */
+    stream->backup = stream->pub.next_input_byte;
+    stream->backupSize = stream->pub.bytes_in_buffer;
+    stream->pub.next_input_byte = stream->data;
+    stream->pub.bytes_in_buffer = stream->dataSize;
+    stream->switched = TRUE;
+    return TRUE;
+  }
+
+  /* Suspend the decompressor until more data is pushed. */
+  if (!stream->eos) return FALSE;
+
+  /* The caller has told us that there is no more data, so insert a fake EOI
+     marker, as the in-memory source manager does. */
+  WARNMS(dinfo, JWRN_JPEG_EOF);
+  stream->pub.next_input_byte = mybuffer;
+  stream->pub.bytes_in_buffer = 2;
+  return TRUE;
+}
+
+static void skip_stream_input_data(j_decompress_ptr dinfo, long num_bytes)
+{
+  tjstream *stream = (tjstream *)dinfo->src;
+
+  if (num_bytes <= 0) return;
+  if ((size_t)num_bytes > stream->pub.bytes_in_buffer) {
+    /* The rest of the skipped data will be discarded as it arrives. */
+    stream->skipBytes += (unsigned long)num_bytes -
+                         (unsigned long)stream->pub.bytes_in_buffer;
+    stream->pub.next_input_byte += stream->pub.bytes_in_buffer;
+    stream->pub.bytes_in_buffer = 0;
+  } else {
+    stream->pub.next_input_byte += (size_t)num_bytes;
+    stream->pub.bytes_in_buffer -= (size_t)num_bytes;
+  }
+}
+
+static void term_stream_source(j_decompress_ptr dinfo)
+{
+  /* no work necessary here */
+}
+
+static void startStream(tjinstance *this)
+{
+  tjstream *stream = &this->stream;
+
+  stream->pub.init_source = init_stream_source;
+  stream->pub.fill_input_buffer = fill_stream_input_buffer;
+  stream->pub.skip_input_data = skip_stream_input_data;
+  stream->pub.resync_to_restart = jpeg_resync_to_restart;
+  stream->pub.term_source = term_stream_source;
+  stream->pub.next_input_byte = NULL;
+  stream->pub.bytes_in_buffer = 0;
+  stream->skipBytes = 0;
+  stream->data = NULL;
+  stream->dataSize = 0;
+  stream->switched = FALSE;
+  stream->eos = stream->eoiFound = FALSE;
+  stream->scanned = 0;
+  stream->state = STREAM_HEADER;
+}
+
+/* Abandon the incremental decompression stream, if any.  This is also called
+   by the other decompression functions, since they reuse the decompressor. */
+
+static void endStream(tjinstance *this)
+{
+  tjstream *stream = &this->stream;
+
+  if (stream->state == STREAM_IDLE) return;
+  if (this->dinfo.global_state > DSTATE_START)
+    jpeg_abort_decompress(&this->dinfo);
+  free(stream->row_pointer);
+  stream->row_pointer = NULL;
+  stream->pub.bytes_in_buffer = 0;
+  stream->data = NULL;
+  stream->dataSize = 0;
+  stream->state = STREAM_IDLE;
+}
+
+/* Make jpegSize bytes of new data available to the stream source manager.
+   The data are not copied, so they are valid only until streamSave() is
+   called. */
+
+static void streamLoad(tjstream *stream, const unsigned char *jpegBuf,
+                       unsigned long jpegSize)
+{
+  stream->data = NULL;
+  stream->dataSize = 0;
+  stream->switched = FALSE;
+
+  if (stream->pub.bytes_in_buffer == 0 && stream->skipBytes > 0) {
+    unsigned long skip =
+      jpegSize < stream->skipBytes ? jpegSize : stream->skipBytes;
+
+    jpegBuf += skip;  jpegSize -= skip;
+    stream->skipBytes -= skip;
+  }
+  if (jpegSize == 0) return;
+
+  if (stream->pub.bytes_in_buffer == 0) {
+    stream->pub.next_input_byte = jpegBuf;
+    stream->pub.bytes_in_buffer = (size_t)jpegSize;
+  } else {
+    /* fill_stream_input_buffer() will move on to the new data once the
+       leftover data have been consumed. */
+    stream->data = jpegBuf;
+    stream->dataSize = (size_t)jpegSize;
+  }
+}
+
+/* Copy the data that the decompressor has not yet consumed into stream->buf,
+   since the caller's buffer need not persist beyond the current call.  The
+   unconsumed data consist of a piece of the leftover data, a piece of the
+   caller's data, or both (if the decompressor is in the middle of a marker or
+   an MCU that straddles the two.) */
+
+static int streamSave(tjstream *stream)
+{
+  const JOCTET *data1 = stream->pub.next_input_byte, *data2 = NULL;
+  size_t size1 = stream->pub.bytes_in_buffer, size2 = 0, needed;
+
+  if (stream->state == STREAM_IDLE) return 0;
+
+  streamSkip(stream);
+  if (!stream->switched) {
+    data2 = stream->data;  size2 = stream->dataSize;
+  } else if (stream->pub.next_input_byte == stream->data &&
+             stream->pub.bytes_in_buffer == stream->dataSize) {
+    /* The decompressor has not synchronized its position since it moved on
+       to the caller's data (it always consumes at least one byte before
+       doing so), so it will resume from its restart point in the leftover
+       data. */
+    data1 = stream->backup;  size1 = stream->backupSize;
+    data2 = stream->data;  size2 = stream->dataSize;
+  }
+  stream->data = NULL;
+  stream->dataSize = 0;
+  stream->switched = FALSE;
+
+  needed = size1 + size2;
+  if (needed < size1) return -1;
+  if (needed > stream->bufSize) {
+    unsigned char *newbuf;
+
+    if (needed < stream->bufSize * 2) needed = stream->bufSize * 2;
+    if ((newbuf = (unsigned char *)malloc(needed)) == NULL)
+      return -1;
+    if (size1 > 0) MEMCOPY(newbuf, data1, size1);
+    free(stream->buf);
+    stream->buf = newbuf;
+    stream->bufSize = needed;
+  } else if (size1 > 0 && data1 != stream->buf)
+    memmove(stream->buf, data1, size1);
+  if (size2 > 0) MEMCOPY(stream->buf + size1, data2, size2);
+
+  stream->pub.next_input_byte = stream->buf;
+  stream->pub.bytes_in_buffer = size1 + size2;
+  return 0;
+}
+
+/* Search the data that have been received but not yet consumed for the EOI
+   marker.  This walks the marker segments by their lengths, since their
+   contents (such as APPn data or Huffman tables) can contain any byte
+   sequence.  Outside of marker segments, 0xFF bytes in entropy-coded data are
+   always followed by 0x00, a fill byte, or an RSTn marker, so this cannot be
+   fooled by the image data.  The search begins just after the SOS marker
+   segment of the first scan, where jpeg_read_header() stops, and
+   stream->scanned may point beyond the available data if a marker segment
+   has not been received in its entirety. */
+
+static boolean streamFindEOI(tjstream *stream)
+{
+  const JOCTET *data = stream->pub.next_input_byte;
+  size_t i = stream->scanned, avail = stream->pub.bytes_in_buffer;
+
+  while (i + 1 < avail) {
+    int c = data[i + 1];
+
+    if (data[i] != 0xFF || c == 0 || c == 0xFF || c == 0x01 /* TEM */ ||
+        (c & 0xF8) == JPEG_RST0) {
+      i++;
+      continue;
+    }
+    if (c == JPEG_EOI) {
+      stream->eoiFound = TRUE;
+      break;
+    }
+    /* All other markers are followed by a 2-byte length, which includes
+       itself. */
+    if (i + 3 >= avail) break;
+    i += 2 + (((size_t)data[i + 2] << 8) | data[i + 3]);
+  }
+  stream->scanned = i;
+  return stream->eoiFound;
+}
+
+/* Decompress as many scanlines as the available data allows.  Returns the
+   number of scanlines decompressed so far, or -1 if memory could not be
+   allocated. */
+
+static int streamDecode(tjinstance *this)
+{
+  j_decompress_ptr dinfo = &this->dinfo;
+  tjstream *stream = &this->stream;
+  JDIMENSION i;
+
+  /* The arithmetic entropy decoder does not support suspension, so an
+     arithmetic-coded image is not decompressed until all of its data has been
+     received.  Until then, nothing is consumed, so stream->scanned remains
+     valid.  The data have to be retained anyway, so gather them into
+     stream->buf in order to search them. */
+  if (dinfo->arith_code && !stream->eos && !stream->eoiFound) {
+    if (streamSave(stream) == -1) return -1;
+    if (!streamFindEOI(stream)) return 0;
+  }
+
+  if (stream->state == STREAM_STARTING) {
+    size_t pitch = stream->pitch;
+
+    /* This suspends until the whole image has been read, if the image has
+       multiple scans. */
+    if (!jpeg_start_decompress(dinfo)) return 0;
+
+    if (pitch == 0)
+      pitch = dinfo->output_width * tjPixelSize[stream->pixelFormat];
+    if ((stream->row_pointer =
+         (JSAMPROW *)malloc(sizeof(JSAMPROW) * dinfo->output_height)) == NULL)
+      return -1;
+    for (i = 0; i < dinfo->output_height; i++) {
+      if (stream->flags & TJFLAG_BOTTOMUP)
+        stream->row_pointer[i] =
+          &stream->dstBuf[(dinfo->output_height - i - 1) * pitch];
+      else
+        stream->row_pointer[i] = &stream->dstBuf[i * pitch];
+    }
+    stream->state = STREAM_SCANLINES;
+  }
+
+  while (dinfo->output_scanline < dinfo->output_height) {
+    if (jpeg_read_scanlines(dinfo,
+                            &stream->row_pointer[dinfo->output_scanline],
+                            dinfo->output_height -
+                            dinfo->output_scanline) == 0)
+      break;
+  }
+  return (int)dinfo->output_scanline;
+}
 
 static tjhandle _tjInitDecompress(tjinstance *this)
 {
@@ -1174,24 +2028,21 @@ DLLEXPORT int tjDecompressHeader3(tjhandle handle,
     THROW("tjDecompressHeader3(): Invalid argument");
 
   if (setjmp(this->jerr.setjmp_buffer)) {
-    /* If we get here, the JPEG code has signaled an error. */
+    /* If we get here, the JPEG code has signaled an error.  Abort the
+       decompressor so that the next call does not resume in the middle of
+       this header. */
+    if (dinfo->global_state > DSTATE_START) jpeg_abort_decompress(dinfo);
     return -1;
   }
 
+  endStream(this);
   jpeg_mem_src_tj(dinfo, jpegBuf, jpegSize);
   jpeg_read_header(dinfo, TRUE);
 
   *width = dinfo->image_width;
   *height = dinfo->image_height;
   *jpegSubsamp = getSubsamp(dinfo);
-  switch (dinfo->jpeg_color_space) {
-  case JCS_GRAYSCALE:  *jpegColorspace = TJCS_GRAY;  break;
-  case JCS_RGB:        *jpegColorspace = TJCS_RGB;  break;
-  case JCS_YCbCr:      *jpegColorspace = TJCS_YCbCr;  break;
-  case JCS_CMYK:       *jpegColorspace = TJCS_CMYK;  break;
-  case JCS_YCCK:       *jpegColorspace = TJCS_YCCK;  break;
-  default:             *jpegColorspace = -1;  break;
-  }
+  *jpegColorspace = getColorspace(dinfo);
 
   jpeg_abort_decompress(dinfo);
 
@@ -1228,6 +2079,240 @@ DLLEXPORT int tjDecompressHeader(tjhandle handle, unsigned char *jpegBuf,
 }
 
 
+/* Lightweight header scanner.  This walks the marker segments in the same way
+   as read_markers() in jdmarker.c and applies the same checks as get_sof(),
+   initial_setup() in jdinput.c, and default_decompress_parms() in jdapimin.c,
+   but it never touches the heap, and it does not validate the contents of the
+   table segments (DQT, DHT, etc.)  Every read is bounds-checked, so a
+   truncated header is reported as an error rather than overrunning jpegBuf. */
+
+#define GET_2BYTES(ptr)  (((unsigned int)(ptr)[0] << 8) | (ptr)[1])
+
+DLLEXPORT int tjScanHeader(const unsigned char *jpegBuf,
+                           unsigned long jpegSize, int *width, int *height,
+                           int *jpegSubsamp, int *jpegColorspace)
+{
+  jpeg_component_info comp_info[MAX_COMPONENTS];
+  const unsigned char *ptr, *end;
+  unsigned int length, imageWidth = 0, imageHeight = 0;
+  int retval = 0, marker, precision = 0, numComponents = 0, scanComponents;
+  int usedComponents, i;
+  boolean sawSOF = FALSE, sawJFIF = FALSE, sawAdobe = FALSE, extraneous;
+  int adobeTransform = 0;
+  J_COLOR_SPACE jpegColorSpace;
+
+  if (jpegBuf == NULL || jpegSize <= 0 || width == NULL || height == NULL ||
+      jpegSubsamp == NULL || jpegColorspace == NULL)
+    THROWG("tjScanHeader(): Invalid argument");
+
+  ptr = jpegBuf;  end = jpegBuf + jpegSize;
+  if (jpegSize < 2 || ptr[0] != 0xFF || ptr[1] != 0xD8)
+    THROWG("tjScanHeader(): Not a JPEG file");
+  ptr += 2;
+
+  for (;;) {
+    /* Find the next marker, skipping any fill bytes (see next_marker() in
+       jdmarker.c.) */
+    extraneous = FALSE;
+    for (;;) {
+      while (ptr < end && *ptr != 0xFF) {
+        ptr++;  extraneous = TRUE;
+      }
+      while (ptr < end && *ptr == 0xFF) ptr++;
+      if (ptr >= end)
+        THROWG("tjScanHeader(): Premature end of JPEG file");
+      if (*ptr != 0) break;
+      ptr++;  extraneous = TRUE;
+    }
+    marker = *ptr++;
+    if (extraneous)
+      THROWG("tjScanHeader(): Corrupt JPEG data: extraneous bytes before marker");
+
+    switch (marker) {
+    case 0xC0:                  /* SOF0 (baseline) */
+    case 0xC1:                  /* SOF1 (extended sequential, Huffman) */
+    case 0xC2:                  /* SOF2 (progressive, Huffman) */
+    case 0xC9:                  /* SOF9 (extended sequential, arithmetic) */
+    case 0xCA:                  /* SOF10 (progressive, arithmetic) */
+      if (sawSOF)
+        THROWG("tjScanHeader(): Invalid JPEG file structure: two SOF markers");
+      if (end - ptr < 8)
+        THROWG("tjScanHeader(): Premature end of JPEG file");
+      length = GET_2BYTES(ptr);
+      precision = ptr[2];
+      imageHeight = GET_2BYTES(&ptr[3]);
+      imageWidth = GET_2BYTES(&ptr[5]);
+      numComponents = ptr[7];
+      if (imageWidth == 0 || imageHeight == 0 || numComponents == 0)
+        THROWG("tjScanHeader(): Empty JPEG image (DNL not supported)");
+      if (length != 8 + (unsigned int)numComponents * 3)
+        THROWG("tjScanHeader(): Bogus marker length");
+      if ((unsigned long)(end - ptr) < length)
+        THROWG("tjScanHeader(): Premature end of JPEG file");
+      if (numComponents > MAX_COMPONENTS)
+        THROWG("tjScanHeader(): Too many color components");
+      for (i = 0; i < numComponents; i++) {
+        comp_info[i].component_id = ptr[8 + i * 3];
+        comp_info[i].h_samp_factor = (ptr[9 + i * 3] >> 4) & 15;
+        comp_info[i].v_samp_factor = ptr[9 + i * 3] & 15;
+      }
+      sawSOF = TRUE;
+      ptr += length;
+      break;
+
+    case 0xC3:                  /* SOF3 (lossless, Huffman) */
+    case 0xC5:                  /* SOF5 (differential sequential, Huffman) */
+    case 0xC6:                  /* SOF6 (differential progressive, Huffman) */
+    case 0xC7:                  /* SOF7 (differential lossless, Huffman) */
+    case 0xC8:                  /* JPG (reserved for JPEG extensions) */
+    case 0xCB:                  /* SOF11 (lossless, arithmetic) */
+    case 0xCD:                  /* SOF13 (differential sequential, arith.) */
+    case 0xCE:                  /* SOF14 (differential progressive, arith.) */
+    case 0xCF:                  /* SOF15 (differential lossless, arith.) */
+      THROWG("tjScanHeader(): Unsupported JPEG process");
+
+    case 0xDA:                  /* SOS */
+      if (!sawSOF)
+        THROWG("tjScanHeader(): Invalid JPEG file structure: SOS before SOF");
+      if (end - ptr < 3)
+        THROWG("tjScanHeader(): Premature end of JPEG file");
+      /* See get_sos() in jdmarker.c */
+      length = GET_2BYTES(ptr);
+      scanComponents = ptr[2];
+      if (length != (unsigned int)scanComponents * 2 + 6 ||
+          scanComponents < 1 || scanComponents > MAX_COMPS_IN_SCAN)
+        THROWG("tjScanHeader(): Bogus marker length");
+      if ((unsigned long)(end - ptr) < length)
+        THROWG("tjScanHeader(): Premature end of JPEG file");
+      for (i = 0, usedComponents = 0; i < scanComponents; i++) {
+        int ci;
+
+        for (ci = 0; ci < numComponents && ci < MAX_COMPS_IN_SCAN; ci++) {
+          if (ptr[3 + i * 2] == comp_info[ci].component_id &&
+              !(usedComponents & (1 << ci)))
+            break;
+        }
+        if (ci >= numComponents || ci >= MAX_COMPS_IN_SCAN)
+          THROWG("tjScanHeader(): Invalid component ID in SOS");
+        usedComponents |= 1 << ci;
+      }
+      goto done;
+
+    case 0xD9:                  /* EOI */
+      THROWG("tjScanHeader(): JPEG datastream contains no image");
+
+    case 0xD8:                  /* SOI */
+      THROWG("tjScanHeader(): Invalid JPEG file structure: two SOI markers");
+
+    case 0xD0:  case 0xD1:  case 0xD2:  case 0xD3:  /* RST0-RST7 */
+    case 0xD4:  case 0xD5:  case 0xD6:  case 0xD7:
+    case 0x01:                  /* TEM */
+      break;                    /* parameterless */
+
+    case 0xC4:                  /* DHT */
+    case 0xCC:                  /* DAC */
+    case 0xDB:                  /* DQT */
+    case 0xDC:                  /* DNL */
+    case 0xDD:                  /* DRI */
+    case 0xE0:  case 0xE1:  case 0xE2:  case 0xE3:  /* APP0-APP15 */
+    case 0xE4:  case 0xE5:  case 0xE6:  case 0xE7:
+    case 0xE8:  case 0xE9:  case 0xEA:  case 0xEB:
+    case 0xEC:  case 0xED:  case 0xEE:  case 0xEF:
+    case 0xFE:                  /* COM */
+      if (end - ptr < 2)
+        THROWG("tjScanHeader(): Premature end of JPEG file");
+      length = GET_2BYTES(ptr);
+      if (length < 2 || (marker == 0xDD && length != 4))
+        THROWG("tjScanHeader(): Bogus marker length");
+      if ((unsigned long)(end - ptr) < length)
+        THROWG("tjScanHeader(): Premature end of JPEG file");
+      /* See examine_app0() and examine_app14() in jdmarker.c */
+      if (marker == 0xE0 && length - 2 >= 14 && !memcmp(&ptr[2], "JFIF", 5)) {
+        sawJFIF = TRUE;
+        if (ptr[7] != 1)
+          THROWG("tjScanHeader(): Unsupported JFIF major version");
+      }
+      if (marker == 0xEE && length - 2 >= 12 &&
+          !memcmp(&ptr[2], "Adobe", 5)) {
+        sawAdobe = TRUE;
+        adobeTransform = ptr[13];
+      }
+      ptr += length;
+      break;
+
+    default:
+      THROWG("tjScanHeader(): Unsupported marker type");
+    }
+  }
+
+done:
+  if (imageWidth > JPEG_MAX_DIMENSION || imageHeight > JPEG_MAX_DIMENSION)
+    THROWG("tjScanHeader(): Maximum supported image dimension exceeded");
+  if (precision != BITS_IN_JSAMPLE)
+    THROWG("tjScanHeader(): Unsupported JPEG data precision");
+  for (i = 0; i < numComponents; i++) {
+    if (comp_info[i].h_samp_factor < 1 ||
+        comp_info[i].h_samp_factor > MAX_SAMP_FACTOR ||
+        comp_info[i].v_samp_factor < 1 ||
+        comp_info[i].v_samp_factor > MAX_SAMP_FACTOR)
+      THROWG("tjScanHeader(): Bogus sampling factors");
+  }
+
+  /* Guess the JPEG colorspace (see default_decompress_parms() in
+     jdapimin.c.)  Unknown Adobe transform codes generate a warning in
+     libjpeg, so they are treated as errors here, just as
+     tjDecompressHeader3() returns -1 for them. */
+  switch (numComponents) {
+  case 1:
+    jpegColorSpace = JCS_GRAYSCALE;
+    break;
+  case 3:
+    if (sawJFIF)
+      jpegColorSpace = JCS_YCbCr;
+    else if (sawAdobe) {
+      if (adobeTransform == 0)
+        jpegColorSpace = JCS_RGB;
+      else if (adobeTransform == 1)
+        jpegColorSpace = JCS_YCbCr;
+      else
+        THROWG("tjScanHeader(): Unknown Adobe color transform code");
+    } else if (comp_info[0].component_id == 82 &&
+               comp_info[1].component_id == 71 &&
+               comp_info[2].component_id == 66)
+      jpegColorSpace = JCS_RGB; /* ASCII 'R', 'G', 'B' */
+    else
+      jpegColorSpace = JCS_YCbCr;
+    break;
+  case 4:
+    if (sawAdobe) {
+      if (adobeTransform == 0)
+        jpegColorSpace = JCS_CMYK;
+      else if (adobeTransform == 2)
+        jpegColorSpace = JCS_YCCK;
+      else
+        THROWG("tjScanHeader(): Unknown Adobe color transform code");
+    } else
+      jpegColorSpace = JCS_CMYK;
+    break;
+  default:
+    jpegColorSpace = JCS_UNKNOWN;
+  }
+
+  *width = imageWidth;
+  *height = imageHeight;
+  *jpegSubsamp = getSubsampFromFactors(numComponents, jpegColorSpace,
+                                       comp_info);
+  *jpegColorspace = getColorspaceFromJCS(jpegColorSpace);
+
+  if (*jpegSubsamp < 0)
+    THROWG("tjScanHeader(): Could not determine subsampling type for JPEG image");
+  if (*jpegColorspace < 0)
+    THROWG("tjScanHeader(): Could not determine colorspace of JPEG image");
+
+bailout:
+  return retval;
+}
+
 DLLEXPORT tjscalingfactor *tjGetScalingFactors(int *numscalingfactors)
 {
   if (numscalingfactors == NULL) {
@@ -1269,6 +2354,7 @@ DLLEXPORT int tjDecompress2(tjhandle handle, const unsigned char *jpegBuf,
     retval = -1;  goto bailout;
   }
 
+  endStream(this);
   jpeg_mem_src_tj(dinfo, jpegBuf, jpegSize);
   jpeg_read_header(dinfo, TRUE);
   this->dinfo.out_color_space = pf2cs[pixelFormat];
@@ -1332,6 +2418,577 @@ DLLEXPORT int tjDecompress(tjhandle handle, unsigned char *jpegBuf,
 }
 
 
+/* Decompress one image of a batch using the given instance.  The row pointer
+   array is reused for all images that fit in it. */
+static int decompressBatchImage(tjinstance *this, tjbatchimage *image,
+                                int pixelFormat, int flags,
+                                JSAMPROW **row_pointer, JDIMENSION *maxRows)
+{
+  j_decompress_ptr dinfo = &this->dinfo;
+  JDIMENSION row;
+  int retval = 0, width, height, pitch, jpegwidth, jpegheight, scaledw,
+    scaledh, k;
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+  jpeg_mem_src_tj(dinfo, image->jpegBuf, image->jpegSize);
+  jpeg_read_header(dinfo, TRUE);
+  dinfo->out_color_space = pf2cs[pixelFormat];
+  if (flags & TJFLAG_FASTDCT) dinfo->dct_method = JDCT_FASTEST;
+  if (flags & TJFLAG_FASTUPSAMPLE) dinfo->do_fancy_upsampling = FALSE;
+
+  jpegwidth = dinfo->image_width;  jpegheight = dinfo->image_height;
+  width = image->width ? image->width : jpegwidth;
+  height = image->height ? image->height : jpegheight;
+  for (k = 0; k < NUMSF; k++) {
+    scaledw = TJSCALED(jpegwidth, sf[k]);
+    scaledh = TJSCALED(jpegheight, sf[k]);
+    if (scaledw <= width && scaledh <= height)
+      break;
+  }
+  if (k >= NUMSF)
+    THROWI("tjDecompressBatch(): Could not scale down to desired image dimensions");
+  dinfo->scale_num = sf[k].num;
+  dinfo->scale_denom = sf[k].denom;
+
+  jpeg_start_decompress(dinfo);
+  pitch = image->pitch;
+  if (pitch == 0) pitch = dinfo->output_width * tjPixelSize[pixelFormat];
+
+  if (dinfo->output_height > *maxRows) {
+    free(*row_pointer);
+    *maxRows = dinfo->output_height;
+    if ((*row_pointer = (JSAMPROW *)malloc(sizeof(JSAMPROW) * *maxRows)) ==
+        NULL) {
+      *maxRows = 0;
+      THROWI("tjDecompressBatch(): Memory allocation failure");
+    }
+  }
+  for (row = 0; row < dinfo->output_height; row++) {
+    if (flags & TJFLAG_BOTTOMUP)
+      (*row_pointer)[row] = &image->dstBuf[(dinfo->output_height - row - 1) *
+                                           (size_t)pitch];
+    else
+      (*row_pointer)[row] = &image->dstBuf[row * (size_t)pitch];
+  }
+  while (dinfo->output_scanline < dinfo->output_height)
+    jpeg_read_scanlines(dinfo, &(*row_pointer)[dinfo->output_scanline],
+                        dinfo->output_height - dinfo->output_scanline);
+  jpeg_finish_decompress(dinfo);
+
+  image->scaledWidth = dinfo->output_width;
+  image->scaledHeight = dinfo->output_height;
+
+bailout:
+  if (dinfo->global_state > DSTATE_START) jpeg_abort_decompress(dinfo);
+  return retval;
+}
+
+
+/* Multi-threaded batch decompression.  The images are handed out one at a
+   time to the calling thread and the worker threads, each of which uses its
+   own decompressor instance, so the order in which they complete is
+   unspecified. */
+
+#ifdef _WIN32
+typedef HANDLE THREAD_T;
+typedef CRITICAL_SECTION MUTEX_T;
+#define THREAD_FUNC  DWORD WINAPI
+#define THREAD_RETURN  return 0
+#define MUTEX_INIT(m)  InitializeCriticalSection(m)
+#define MUTEX_DESTROY(m)  DeleteCriticalSection(m)
+#define MUTEX_LOCK(m)  EnterCriticalSection(m)
+#define MUTEX_UNLOCK(m)  LeaveCriticalSection(m)
+#else
+typedef pthread_t THREAD_T;
+typedef pthread_mutex_t MUTEX_T;
+#define THREAD_FUNC  void *
+#define THREAD_RETURN  return NULL
+#define MUTEX_INIT(m)  pthread_mutex_init(m, NULL)
+#define MUTEX_DESTROY(m)  pthread_mutex_destroy(m)
+#define MUTEX_LOCK(m)  pthread_mutex_lock(m)
+#define MUTEX_UNLOCK(m)  pthread_mutex_unlock(m)
+#endif
+
+typedef struct {
+  tjbatchimage *images;
+  int n, pixelFormat, flags;
+  int next;                     /* index of the next image to decompress */
+  boolean failed;               /* TRUE = stop handing out images */
+  /* The error or warning to report (an error takes precedence over a
+     warning, and an earlier image takes precedence over a later one) */
+  int errorIndex;               /* -1 = none */
+  boolean warning;
+  char errStr[JMSG_LENGTH_MAX];
+  MUTEX_T mutex;
+} tjbatch;
+
+typedef struct {
+  tjbatch *batch;
+  tjinstance *instance;
+} tjbatchworker;
+
+static THREAD_FUNC batchWorker(void *arg)
+{
+  tjbatchworker *worker = (tjbatchworker *)arg;
+  tjbatch *batch = worker->batch;
+  tjinstance *this = worker->instance;
+  JSAMPROW *row_pointer = NULL;
+  JDIMENSION maxRows = 0;
+  boolean failed;
+  int i;
+
+  /* The threads run concurrently, so each one reports errors through its own
+     instance's error string rather than through the global one. */
+  this->jerr.msgBuf = this->errStr;
+  this->jerr.stopOnWarning =
+    (batch->flags & TJFLAG_STOPONWARNING) ? TRUE : FALSE;
+  for (;;) {
+    MUTEX_LOCK(&batch->mutex);
+    i = batch->failed ? batch->n : batch->next++;
+    MUTEX_UNLOCK(&batch->mutex);
+    if (i >= batch->n) break;
+
+    this->jerr.warning = FALSE;
+    this->isInstanceError = FALSE;
+    failed = decompressBatchImage(this, &batch->images[i], batch->pixelFormat,
+                                  batch->flags, &row_pointer, &maxRows) == -1;
+    if (!failed && !this->jerr.warning) continue;
+
+    /* The library outputs only the first warning for each instance (see
+       emit_message() in jerror.c), so regenerate the message from this
+       instance's error manager. */
+    if (!this->isInstanceError)
+      (*this->dinfo.err->format_message) ((j_common_ptr)&this->dinfo,
+                                          this->errStr);
+    MUTEX_LOCK(&batch->mutex);
+    if (batch->errorIndex < 0 || (failed && !batch->failed) ||
+        (failed == batch->failed && i < batch->errorIndex)) {
+      batch->errorIndex = i;
+      batch->warning = this->jerr.warning;
+      snprintf(batch->errStr, JMSG_LENGTH_MAX, "%s", this->errStr);
+    }
+    if (failed) batch->failed = TRUE;
+    MUTEX_UNLOCK(&batch->mutex);
+  }
+  free(row_pointer);
+  this->jerr.stopOnWarning = FALSE;
+  this->jerr.msgBuf = NULL;
+  THREAD_RETURN;
+}
+
+DLLEXPORT int tjDecompressBatch(tjhandle handle, tjbatchimage *images, int n,
+                                int pixelFormat, int flags, int numThreads)
+{
+  tjbatch batch;
+  tjbatchworker *workers = NULL;
+  THREAD_T *threads = NULL;
+  int i, retval = 0, numStarted = 0, mutexInit = 0;
+
+  GET_TJINSTANCE(handle);
+  if ((this->init & DECOMPRESS) == 0)
+    THROW("tjDecompressBatch(): Instance has not been initialized for decompression");
+
+  if (images == NULL || n < 1 || pixelFormat < 0 ||
+      pixelFormat >= TJ_NUMPF || numThreads < 0)
+    THROW("tjDecompressBatch(): Invalid argument");
+  for (i = 0; i < n; i++) {
+    if (images[i].jpegBuf == NULL || images[i].jpegSize <= 0 ||
+        images[i].dstBuf == NULL || images[i].width < 0 ||
+        images[i].pitch < 0 || images[i].height < 0)
+      THROW("tjDecompressBatch(): Invalid argument");
+    images[i].scaledWidth = images[i].scaledHeight = 0;
+  }
+  if (numThreads < 1) numThreads = 1;
+  if (numThreads > n) numThreads = n;
+
+#ifndef NO_PUTENV
+  if (flags & TJFLAG_FORCEMMX) putenv("JSIMD_FORCEMMX=1");
+  else if (flags & TJFLAG_FORCESSE) putenv("JSIMD_FORCESSE=1");
+  else if (flags & TJFLAG_FORCESSE2) putenv("JSIMD_FORCESSE2=1");
+#endif
+
+  endStream(this);
+
+  /* The calling thread uses this instance, and each additional thread uses a
+     worker instance that is created on first use and reused by later
+     batches. */
+  if (numThreads - 1 > this->numWorkers) {
+    tjinstance **newWorkers = (tjinstance **)
+      realloc(this->workers, sizeof(tjinstance *) * (numThreads - 1));
+
+    if (newWorkers == NULL)
+      THROW("tjDecompressBatch(): Memory allocation failure");
+    this->workers = newWorkers;
+    while (this->numWorkers < numThreads - 1) {
+      if ((this->workers[this->numWorkers] =
+           (tjinstance *)tjInitDecompress()) == NULL)
+        THROW("tjDecompressBatch(): Could not create worker instance");
+      this->numWorkers++;
+    }
+  }
+
+  MEMZERO(&batch, sizeof(tjbatch));
+  batch.images = images;  batch.n = n;
+  batch.pixelFormat = pixelFormat;  batch.flags = flags;
+  batch.errorIndex = -1;
+  if ((workers = (tjbatchworker *)malloc(sizeof(tjbatchworker) *
+                                         numThreads)) == NULL ||
+      (threads = (THREAD_T *)malloc(sizeof(THREAD_T) * numThreads)) == NULL)
+    THROW("tjDecompressBatch(): Memory allocation failure");
+  MUTEX_INIT(&batch.mutex);
+  mutexInit = 1;
+  for (i = 0; i < numThreads; i++) {
+    workers[i].batch = &batch;
+    workers[i].instance = i == 0 ? this : this->workers[i - 1];
+  }
+
+  for (i = 1; i < numThreads; i++) {
+#ifdef _WIN32
+    if ((threads[i] = CreateThread(NULL, 0, batchWorker, &workers[i], 0,
+                                   NULL)) == NULL)
+      break;
+#else
+    if (pthread_create(&threads[i], NULL, batchWorker, &workers[i]))
+      break;
+#endif
+    numStarted++;
+  }
+  /* If a thread could not be created, then the remaining threads (at least
+     the calling thread) decompress its share of the images. */
+  batchWorker(&workers[0]);
+  for (i = 1; i <= numStarted; i++) {
+#ifdef _WIN32
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+#else
+    pthread_join(threads[i], NULL);
+#endif
+  }
+
+  /* All of the threads have finished, so the error can now be copied to the
+     global error string as well. */
+  if (batch.errorIndex >= 0) {
+    snprintf(errStr, JMSG_LENGTH_MAX, "%s", batch.errStr);
+    snprintf(this->errStr, JMSG_LENGTH_MAX, "%s", batch.errStr);
+    this->isInstanceError = TRUE;
+    this->jerr.warning = batch.warning;
+    retval = -1;
+  }
+
+bailout:
+  if (mutexInit) MUTEX_DESTROY(&batch.mutex);
+  free(workers);
+  free(threads);
+  if (this->jerr.warning) retval = -1;
+  return retval;
+}
+
+
+DLLEXPORT int tjDecompressMulti(tjhandle handle, const unsigned char *jpegBuf,
+                                unsigned long jpegSize, tjscaledimage *images,
+                                int n, int pixelFormat, int flags)
+{
+  j_decompress_ptr outinfo = NULL;
+  JSAMPROW *row_pointer = NULL;
+  JDIMENSION maxRows = 0, row;
+  int i, retval = 0, width, height, pitch, jpegwidth, jpegheight, scaledw,
+    scaledh, k;
+
+  GET_DINSTANCE(handle);
+  this->jerr.stopOnWarning = (flags & TJFLAG_STOPONWARNING) ? TRUE : FALSE;
+  if ((this->init & DECOMPRESS) == 0)
+    THROW("tjDecompressMulti(): Instance has not been initialized for decompression");
+
+  if (jpegBuf == NULL || jpegSize <= 0 || images == NULL || n < 1 ||
+      pixelFormat < 0 || pixelFormat >= TJ_NUMPF)
+    THROW("tjDecompressMulti(): Invalid argument");
+  for (i = 0; i < n; i++) {
+    if (images[i].dstBuf == NULL || images[i].width < 0 ||
+        images[i].pitch < 0 || images[i].height < 0)
+      THROW("tjDecompressMulti(): Invalid argument");
+    images[i].scaledWidth = images[i].scaledHeight = 0;
+  }
+
+#ifndef NO_PUTENV
+  if (flags & TJFLAG_FORCEMMX) putenv("JSIMD_FORCEMMX=1");
+  else if (flags & TJFLAG_FORCESSE) putenv("JSIMD_FORCESSE=1");
+  else if (flags & TJFLAG_FORCESSE2) putenv("JSIMD_FORCESSE2=1");
+#endif
+
+  /* Each destination image is decompressed by a separate decompressor, which
+     reads the coefficients that our decompressor has entropy-decoded. */
+  if ((outinfo = (j_decompress_ptr)
+                 malloc(sizeof(struct jpeg_decompress_struct))) == NULL)
+    THROW("tjDecompressMulti(): Memory allocation failure");
+  MEMZERO(outinfo, sizeof(struct jpeg_decompress_struct));
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+  endStream(this);
+  jpeg_mem_src_tj(dinfo, jpegBuf, jpegSize);
+  jpeg_read_header(dinfo, TRUE);
+  jpeg_read_coefficients(dinfo);
+
+  outinfo->err = &this->jerr.pub;
+  jpeg_create_decompress(outinfo);
+
+  for (i = 0; i < n; i++) {
+    jpeg_mem_src_tj(outinfo, jpegBuf, jpegSize);
+    jpeg_read_header(outinfo, TRUE);
+    outinfo->out_color_space = pf2cs[pixelFormat];
+    if (flags & TJFLAG_FASTDCT) outinfo->dct_method = JDCT_FASTEST;
+    if (flags & TJFLAG_FASTUPSAMPLE) outinfo->do_fancy_upsampling = FALSE;
+
+    jpegwidth = outinfo->image_width;  jpegheight = outinfo->image_height;
+    width = images[i].width ? images[i].width : jpegwidth;
+    height = images[i].height ? images[i].height : jpegheight;
+    for (k = 0; k < NUMSF; k++) {
+      scaledw = TJSCALED(jpegwidth, sf[k]);
+      scaledh = TJSCALED(jpegheight, sf[k]);
+      if (scaledw <= width && scaledh <= height)
+        break;
+    }
+    if (k >= NUMSF)
+      THROW("tjDecompressMulti(): Could not scale down to desired image dimensions");
+    outinfo->scale_num = sf[k].num;
+    outinfo->scale_denom = sf[k].denom;
+
+    jpeg_coef_source_tj(outinfo, dinfo);
+    jpeg_start_decompress(outinfo);
+    pitch = images[i].pitch;
+    if (pitch == 0) pitch = outinfo->output_width * tjPixelSize[pixelFormat];
+
+    /* The row pointer array is reused for all images that fit in it. */
+    if (outinfo->output_height > maxRows) {
+      free(row_pointer);
+      maxRows = outinfo->output_height;
+      if ((row_pointer = (JSAMPROW *)malloc(sizeof(JSAMPROW) * maxRows)) ==
+          NULL)
+        THROW("tjDecompressMulti(): Memory allocation failure");
+    }
+    if (setjmp(this->jerr.setjmp_buffer)) {
+      /* If we get here, the JPEG code has signaled an error. */
+      retval = -1;  goto bailout;
+    }
+    for (row = 0; row < outinfo->output_height; row++) {
+      if (flags & TJFLAG_BOTTOMUP)
+        row_pointer[row] =
+          &images[i].dstBuf[(outinfo->output_height - row - 1) *
+                            (size_t)pitch];
+      else
+        row_pointer[row] = &images[i].dstBuf[row * (size_t)pitch];
+    }
+    while (outinfo->output_scanline < outinfo->output_height)
+      jpeg_read_scanlines(outinfo, &row_pointer[outinfo->output_scanline],
+                          outinfo->output_height - outinfo->output_scanline);
+    jpeg_finish_decompress(outinfo);
+
+    images[i].scaledWidth = outinfo->output_width;
+    images[i].scaledHeight = outinfo->output_height;
+  }
+  jpeg_finish_decompress(dinfo);
+
+bailout:
+  if (outinfo) {
+    if (outinfo->mem) jpeg_destroy_decompress(outinfo);
+    free(outinfo);
+  }
+  if (dinfo->global_state > DSTATE_START) jpeg_abort_decompress(dinfo);
+  free(row_pointer);
+  if (this->jerr.warning) retval = -1;
+  this->jerr.stopOnWarning = FALSE;
+  return retval;
+}
+
+
+DLLEXPORT int tjDecompressStreamHeader(tjhandle handle,
+                                       const unsigned char *jpegBuf,
+                                       unsigned long jpegSize, int *width,
+                                       int *height, int *jpegSubsamp,
+                                       int *jpegColorspace)
+{
+  struct jpeg_source_mgr *src = NULL;
+  int retval = 0;
+
+  GET_DINSTANCE(handle);
+  if ((this->init & DECOMPRESS) == 0)
+    THROW("tjDecompressStreamHeader(): Instance has not been initialized for decompression");
+
+  if ((jpegBuf == NULL && jpegSize > 0) || width == NULL || height == NULL ||
+      jpegSubsamp == NULL || jpegColorspace == NULL)
+    THROW("tjDecompressStreamHeader(): Invalid argument");
+
+  if (this->stream.state == STREAM_IDLE) startStream(this);
+  streamLoad(&this->stream, jpegBuf, jpegSize);
+  src = dinfo->src;
+  dinfo->src = &this->stream.pub;
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+  if (this->stream.state == STREAM_HEADER) {
+    if (jpeg_read_header(dinfo, TRUE) == JPEG_SUSPENDED)
+      retval = 1;
+    else
+      this->stream.state = STREAM_HEADER_DONE;
+  }
+
+  if (retval == 0) {
+    *width = dinfo->image_width;
+    *height = dinfo->image_height;
+    *jpegSubsamp = getSubsamp(dinfo);
+    *jpegColorspace = getColorspace(dinfo);
+
+    if (*jpegSubsamp < 0)
+      THROW("tjDecompressStreamHeader(): Could not determine subsampling type for JPEG image");
+    if (*jpegColorspace < 0)
+      THROW("tjDecompressStreamHeader(): Could not determine colorspace of JPEG image");
+    if (*width < 1 || *height < 1)
+      THROW("tjDecompressStreamHeader(): Invalid data returned in header");
+  }
+
+  if (streamSave(&this->stream) == -1)
+    THROW("tjDecompressStreamHeader(): Memory allocation failure");
+
+bailout:
+  if (src) dinfo->src = src;
+  if (retval == -1) endStream(this);
+  return retval;
+}
+
+
+DLLEXPORT int tjDecompressStreamRows(tjhandle handle,
+                                     const unsigned char *jpegBuf,
+                                     unsigned long jpegSize,
+                                     unsigned char *dstBuf, int width,
+                                     int pitch, int height, int pixelFormat,
+                                     int flags)
+{
+  struct jpeg_source_mgr *src = NULL;
+  tjstream *stream;
+  int i, retval = 0, jpegwidth, jpegheight, maxw, maxh, scaledw, scaledh;
+
+  GET_DINSTANCE(handle);
+  stream = &this->stream;
+  this->jerr.stopOnWarning = (flags & TJFLAG_STOPONWARNING) ? TRUE : FALSE;
+  if ((this->init & DECOMPRESS) == 0)
+    THROW("tjDecompressStreamRows(): Instance has not been initialized for decompression");
+
+  if ((jpegBuf == NULL && jpegSize > 0) || dstBuf == NULL || width < 0 ||
+      pitch < 0 || height < 0 || pixelFormat < 0 || pixelFormat >= TJ_NUMPF)
+    THROW("tjDecompressStreamRows(): Invalid argument");
+
+  if (stream->state < STREAM_HEADER_DONE)
+    THROW("tjDecompressStreamRows(): JPEG header has not been read");
+  if (stream->state > STREAM_HEADER_DONE &&
+      (dstBuf != stream->dstBuf || width != stream->width ||
+       pitch != stream->pitch || height != stream->height ||
+       pixelFormat != stream->pixelFormat || flags != stream->flags))
+    THROW("tjDecompressStreamRows(): Destination image parameters cannot be changed during decompression");
+
+  streamLoad(stream, jpegBuf, jpegSize);
+  src = dinfo->src;
+  dinfo->src = &stream->pub;
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+  if (stream->state == STREAM_HEADER_DONE) {
+    dinfo->out_color_space = pf2cs[pixelFormat];
+    if (flags & TJFLAG_FASTDCT) dinfo->dct_method = JDCT_FASTEST;
+    if (flags & TJFLAG_FASTUPSAMPLE) dinfo->do_fancy_upsampling = FALSE;
+
+    jpegwidth = dinfo->image_width;  jpegheight = dinfo->image_height;
+    maxw = width ? width : jpegwidth;
+    maxh = height ? height : jpegheight;
+    for (i = 0; i < NUMSF; i++) {
+      scaledw = TJSCALED(jpegwidth, sf[i]);
+      scaledh = TJSCALED(jpegheight, sf[i]);
+      if (scaledw <= maxw && scaledh <= maxh)
+        break;
+    }
+    if (i >= NUMSF)
+      THROW("tjDecompressStreamRows(): Could not scale down to desired image dimensions");
+    dinfo->scale_num = sf[i].num;
+    dinfo->scale_denom = sf[i].denom;
+
+    stream->dstBuf = dstBuf;
+    stream->width = width;  stream->pitch = pitch;  stream->height = height;
+    stream->pixelFormat = pixelFormat;
+    stream->flags = flags;
+    stream->state = STREAM_STARTING;
+  }
+
+  if ((retval = streamDecode(this)) == -1)
+    THROW("tjDecompressStreamRows(): Memory allocation failure");
+  /* Once the last scanline has been decompressed, there is no need to wait
+     for the EOI marker.  If a warning occurred, then the stream is kept, so
+     that the next call can return the number of rows. */
+  if (stream->state == STREAM_SCANLINES &&
+      dinfo->output_scanline >= dinfo->output_height && !this->jerr.warning)
+    endStream(this);
+
+  if (streamSave(stream) == -1)
+    THROW("tjDecompressStreamRows(): Memory allocation failure");
+
+bailout:
+  if (src) dinfo->src = src;
+  /* Only fatal errors (including warnings with TJFLAG_STOPONWARNING) abandon
+     the stream. */
+  if (retval == -1) endStream(this);
+  if (this->jerr.warning) retval = -1;
+  this->jerr.stopOnWarning = FALSE;
+  return retval;
+}
+
+
+DLLEXPORT int tjDecompressStreamFinish(tjhandle handle)
+{
+  struct jpeg_source_mgr *src = NULL;
+  int retval = 0;
+
+  GET_DINSTANCE(handle);
+  this->jerr.stopOnWarning =
+    (this->stream.flags & TJFLAG_STOPONWARNING) ? TRUE : FALSE;
+  if ((this->init & DECOMPRESS) == 0)
+    THROW("tjDecompressStreamFinish(): Instance has not been initialized for decompression");
+
+  if (this->stream.state < STREAM_STARTING) goto bailout;
+
+  src = dinfo->src;
+  dinfo->src = &this->stream.pub;
+
+  if (setjmp(this->jerr.setjmp_buffer)) {
+    /* If we get here, the JPEG code has signaled an error. */
+    retval = -1;  goto bailout;
+  }
+
+  /* Decompress the rest of the image, treating it as truncated if the
+     available data runs out. */
+  this->stream.eos = TRUE;
+  if (streamDecode(this) == -1)
+    THROW("tjDecompressStreamFinish(): Memory allocation failure");
+
+bailout:
+  if (src) dinfo->src = src;
+  endStream(this);
+  if (this->jerr.warning) retval = -1;
+  this->jerr.stopOnWarning = FALSE;
+  return retval;
+}
+
+
 static int setDecodeDefaults(struct jpeg_decompress_struct *dinfo,
                              int pixelFormat, int subsamp, int flags)
 {
@@ -1432,6 +3089,7 @@ DLLEXPORT int tjDecodeYUVPlanes(tjhandle handle,
   else if (flags & TJFLAG_FORCESSE2) putenv("JSIMD_FORCESSE2=1");
 #endif
 
+  endStream(this);
   dinfo->progressive_mode = dinfo->inputctl->has_multiple_scans = FALSE;
   dinfo->Ss = dinfo->Ah = dinfo->Al = 0;
   dinfo->Se = DCTSIZE2 - 1;
@@ -1608,6 +3266,7 @@ DLLEXPORT int tjDecompressToYUVPlanes(tjhandle handle,
     retval = -1;  goto bailout;
   }
 
+  endStream(this);
   if (!this->headerRead) {
     jpeg_mem_src_tj(dinfo, jpegBuf, jpegSize);
     jpeg_read_header(dinfo, TRUE);
@@ -1760,6 +3419,7 @@ DLLEXPORT int tjDecompressToYUV2(tjhandle handle, const unsigned char *jpegBuf,
     return -1;
   }
 
+  endStream(this);
   jpeg_mem_src_tj(dinfo, jpegBuf, jpegSize);
   jpeg_read_header(dinfo, TRUE);
   jpegSubsamp = getSubsamp(dinfo);
@@ -1867,6 +3527,7 @@ DLLEXPORT int tjTransform(tjhandle handle, const unsigned char *jpegBuf,
     retval = -1;  goto bailout;
   }
 
+  endStream(this);
   jpeg_mem_src_tj(dinfo, jpegBuf, jpegSize);
 
   for (i = 0; i < n; i++) {
@@ -1877,6 +3538,16 @@ DLLEXPORT int tjTransform(tjhandle handle, const unsigned char *jpegBuf,
     xinfo[i].crop = (t[i].options & TJXOPT_CROP) ? 1 : 0;
     if (n != 1 && t[i].op == TJXOP_HFLIP) xinfo[i].slow_hflip = 1;
     else xinfo[i].slow_hflip = 0;
+    switch (t[i].options & (TJXOPT_SCALE2 | TJXOPT_SCALE4 | TJXOPT_SCALE8)) {
+    case 0:  xinfo[i].scale_denom = 1;  break;
+    case TJXOPT_SCALE2:  xinfo[i].scale_denom = 2;  break;
+    case TJXOPT_SCALE4:  xinfo[i].scale_denom = 4;  break;
+    case TJXOPT_SCALE8:  xinfo[i].scale_denom = 8;  break;
+    default:
+      THROW("tjTransform(): Only one scaling option may be specified");
+    }
+    if (xinfo[i].scale_denom > 1 && t[i].op != TJXOP_NONE)
+      THROW("tjTransform(): Scaling cannot be combined with a transform operation");
 
     if (xinfo[i].crop) {
       xinfo[i].crop_xoffset = t[i].r.x;  xinfo[i].crop_xoffset_set = JCROP_POS;
@@ -1921,10 +3592,12 @@ DLLEXPORT int tjTransform(tjhandle handle, const unsigned char *jpegBuf,
   for (i = 0; i < n; i++) {
     int w, h, alloc = 1;
 
-    if (!xinfo[i].crop) {
-      w = dinfo->image_width;  h = dinfo->image_height;
-    } else {
+    if (xinfo[i].crop) {
       w = xinfo[i].crop_width;  h = xinfo[i].crop_height;
+    } else if (xinfo[i].scale_denom > 1) {
+      w = xinfo[i].output_width;  h = xinfo[i].output_height;
+    } else {
+      w = dinfo->image_width;  h = dinfo->image_height;
     }
     if (flags & TJFLAG_NOREALLOC) {
       alloc = 0;  dstSizes[i] = tjBufSize(w, h, jpegSubsamp);
@@ -2054,19 +3727,18 @@ DLLEXPORT unsigned char *tjLoadImage(const char *filename, int *width,
     retval = -1;  goto bailout;
   }
 
+  /* The PPM and BMP readers deliver one row at a time into whatever row
+     src->buffer designates, so point it at the destination row and let the
+     reader convert (or, if no conversion is needed, read) straight into the
+     caller's buffer. */
   while (cinfo->next_scanline < cinfo->image_height) {
-    int i, nlines = (*src->get_pixel_rows) (cinfo, src);
+    JSAMPROW dstptr;
+    int row = cinfo->next_scanline;
 
-    for (i = 0; i < nlines; i++) {
-      unsigned char *dstptr;
-      int row;
-
-      row = cinfo->next_scanline + i;
-      if (invert) dstptr = &dstBuf[((*height) - row - 1) * pitch];
-      else dstptr = &dstBuf[row * pitch];
-      memcpy(dstptr, src->buffer[i], (*width) * tjPixelSize[*pixelFormat]);
-    }
-    cinfo->next_scanline += nlines;
+    if (invert) dstptr = &dstBuf[((*height) - row - 1) * pitch];
+    else dstptr = &dstBuf[row * pitch];
+    src->buffer = &dstptr;
+    cinfo->next_scanline += (*src->get_pixel_rows) (cinfo, src);
   }
 
   (*src->finish_input) (cinfo, src);
@@ -2131,14 +3803,16 @@ DLLEXPORT int tjSaveImage(const char *filename, unsigned char *buffer,
 
   if (pitch == 0) pitch = width * tjPixelSize[pixelFormat];
 
+  /* The PPM and BMP writers read from whatever row dst->buffer designates, so
+     point it at the source row rather than copying the row. */
   while (dinfo->output_scanline < dinfo->output_height) {
-    unsigned char *rowptr;
+    JSAMPROW rowptr;
 
     if (invert)
       rowptr = &buffer[(height - dinfo->output_scanline - 1) * pitch];
     else
       rowptr = &buffer[dinfo->output_scanline * pitch];
-    memcpy(dst->buffer[0], rowptr, width * tjPixelSize[pixelFormat]);
+    dst->buffer = &rowptr;
     (*dst->put_pixel_rows) (dinfo, dst, 1);
     dinfo->output_scanline++;
   }
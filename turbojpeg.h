@@ -441,6 +441,46 @@ enum TJERR {
 };
 
 
+/**
+ * The number of profiling stages
+ */
+#define TJ_NUMPROF  6
+
+/**
+ * Profiling stages for #tjGetProfile()
+ *
+ * Each stage accumulates the time spent in the corresponding part of the
+ * underlying codec.  Time spent outside of these stages (buffer management,
+ * memory allocation, etc.) is not counted.
+ */
+enum TJPROF {
+  /**
+   * Reading or writing JPEG markers (headers, tables, and restart markers)
+   */
+  TJPROF_MARKERS = 0,
+  /**
+   * Huffman or arithmetic decoding or encoding
+   */
+  TJPROF_ENTROPY,
+  /**
+   * Inverse DCT, or forward DCT and quantization
+   */
+  TJPROF_DCT,
+  /**
+   * Chrominance upsampling or downsampling
+   */
+  TJPROF_SAMPLING,
+  /**
+   * Color conversion (including merged upsampling and color conversion)
+   */
+  TJPROF_COLOR,
+  /**
+   * Color quantization (never used by the TurboJPEG API functions)
+   */
+  TJPROF_QUANTIZE
+};
+
+
 /**
  * The number of transform operations
  */
@@ -544,6 +584,28 @@ enum TJXOP {
  * image.
  */
 #define TJXOPT_COPYNONE  64
+/**
+ * This option will cause #tjTransform() to reduce the width and height of
+ * the output image by a factor of 2.  The DCT coefficients of the reduced
+ * image are derived from the low-order DCT coefficients of the source image
+ * and requantized using the source image's quantization tables, so this is
+ * not lossless, but it is much faster than decompressing, resizing, and
+ * recompressing the image.  This option can be combined with #TJXOPT_CROP
+ * (the cropping region is specified in terms of the reduced image) and
+ * #TJXOPT_GRAY, but the transform operation must be #TJXOP_NONE.  Only one of
+ * #TJXOPT_SCALE2, #TJXOPT_SCALE4, and #TJXOPT_SCALE8 may be specified.
+ */
+#define TJXOPT_SCALE2  128
+/**
+ * This option will cause #tjTransform() to reduce the width and height of
+ * the output image by a factor of 4.  See #TJXOPT_SCALE2.
+ */
+#define TJXOPT_SCALE4  256
+/**
+ * This option will cause #tjTransform() to reduce the width and height of
+ * the output image by a factor of 8.  See #TJXOPT_SCALE2.
+ */
+#define TJXOPT_SCALE8  512
 
 
 /**
@@ -645,6 +707,134 @@ typedef struct tjtransform {
                        int transformIndex, struct tjtransform *transform);
 } tjtransform;
 
+/**
+ * JPEG image to be decompressed by #tjDecompressBatch()
+ */
+typedef struct {
+  /**
+   * Pointer to a buffer containing the JPEG image to decompress
+   */
+  const unsigned char *jpegBuf;
+  /**
+   * Size of the JPEG image (in bytes)
+   */
+  unsigned long jpegSize;
+  /**
+   * Pointer to an image buffer that will receive the decompressed image (see
+   * the description of the <tt>dstBuf</tt> parameter of #tjDecompress2().)
+   */
+  unsigned char *dstBuf;
+  /**
+   * Desired width (in pixels) of the destination image (see the description
+   * of the <tt>width</tt> parameter of #tjDecompress2().)
+   */
+  int width;
+  /**
+   * Bytes per line in the destination image (see the description of the
+   * <tt>pitch</tt> parameter of #tjDecompress2().)
+   */
+  int pitch;
+  /**
+   * Desired height (in pixels) of the destination image (see the description
+   * of the <tt>height</tt> parameter of #tjDecompress2().)
+   */
+  int height;
+  /**
+   * Receives the width (in pixels) of the decompressed image, or 0 if the
+   * image was not decompressed
+   */
+  int scaledWidth;
+  /**
+   * Receives the height (in pixels) of the decompressed image, or 0 if the
+   * image was not decompressed
+   */
+  int scaledHeight;
+} tjbatchimage;
+
+/**
+ * Destination image for #tjDecompressMulti()
+ */
+typedef struct {
+  /**
+   * Pointer to an image buffer that will receive the decompressed image (see
+   * the description of the <tt>dstBuf</tt> parameter of #tjDecompress2().)
+   */
+  unsigned char *dstBuf;
+  /**
+   * Desired width (in pixels) of the destination image (see the description
+   * of the <tt>width</tt> parameter of #tjDecompress2().)
+   */
+  int width;
+  /**
+   * Bytes per line in the destination image (see the description of the
+   * <tt>pitch</tt> parameter of #tjDecompress2().)
+   */
+  int pitch;
+  /**
+   * Desired height (in pixels) of the destination image (see the description
+   * of the <tt>height</tt> parameter of #tjDecompress2().)
+   */
+  int height;
+  /**
+   * Receives the width (in pixels) of the decompressed image, or 0 if the
+   * image was not decompressed
+   */
+  int scaledWidth;
+  /**
+   * Receives the height (in pixels) of the decompressed image, or 0 if the
+   * image was not decompressed
+   */
+  int scaledHeight;
+} tjscaledimage;
+
+/**
+ * Counters for one profiling stage (see #tjGetProfile())
+ */
+typedef struct {
+  /**
+   * Time spent in the stage.  This is measured in CPU time-stamp counter
+   * cycles on x86 platforms and in nanoseconds (or, on Windows, performance
+   * counter ticks) on other platforms.
+   */
+  unsigned long long ticks;
+  /**
+   * Number of times the stage was entered.  Most stages are entered once per
+   * MCU or once per row group.
+   */
+  unsigned long calls;
+} tjprofile;
+
+/**
+ * Chunk of a JPEG image generated by #tjCompressToChunks()
+ */
+typedef struct {
+  /**
+   * Pointer to the JPEG data in this chunk
+   */
+  unsigned char *data;
+  /**
+   * Number of bytes of JPEG data in this chunk
+   */
+  unsigned long size;
+} tjchunk;
+
+/**
+ * Function that receives the JPEG data generated by #tjCompressToCallback()
+ *
+ * @param data pointer to the next piece of the JPEG image.  This is valid
+ * only until the function returns.
+ *
+ * @param size size of the piece (in bytes)
+ *
+ * @param userData the <tt>userData</tt> pointer that was passed to
+ * #tjCompressToCallback()
+ *
+ * @return 0 if the data were written successfully, or -1 if an error
+ * occurred (which causes the compression to fail.)
+ */
+typedef int (*tjwritefunc) (const unsigned char *data, unsigned long size,
+                            void *userData);
+
 /**
  * TurboJPEG instance handle
  */
@@ -746,6 +936,239 @@ DLLEXPORT int tjCompress2(tjhandle handle, const unsigned char *srcBuf,
                           int jpegSubsamp, int jpegQual, int flags);
 
 
+/**
+ * Compress an RGB, grayscale, or CMYK image into several JPEG images, each
+ * with a different quality level.
+ *
+ * This produces the same JPEG images as calling #tjCompress2() once for each
+ * quality level, but the color conversion, chrominance subsampling, and
+ * forward DCT are performed only once (or twice, if some of the quality
+ * levels are 96 or higher and others are not, unless #TJFLAG_ACCURATEDCT is
+ * specified.)  The unquantized DCT coefficients are retained in memory
+ * (using 256 bytes per 8x8 block) until the function returns, and they are
+ * requantized and entropy-coded for each quality level.
+ *
+ * @param handle a handle to a TurboJPEG compressor or transformer instance
+ *
+ * @param srcBuf pointer to an image buffer containing RGB, grayscale, or
+ * CMYK pixels to be compressed (see the description of the <tt>srcBuf</tt>
+ * parameter of #tjCompress2().)
+ *
+ * @param width width (in pixels) of the source image
+ *
+ * @param pitch bytes per line in the source image (see the description of
+ * the <tt>pitch</tt> parameter of #tjCompress2().)
+ *
+ * @param height height (in pixels) of the source image
+ *
+ * @param pixelFormat pixel format of the source image (see @ref TJPF
+ * "Pixel formats".)
+ *
+ * @param jpegBufs an array of <tt>n</tt> pointers to image buffers, each of
+ * which will receive one of the JPEG images.  Each buffer is handled in the
+ * same way as the <tt>jpegBuf</tt> parameter of #tjCompress2().
+ *
+ * @param jpegSizes an array of <tt>n</tt> unsigned long variables, each of
+ * which is handled in the same way as the <tt>jpegSize</tt> parameter of
+ * #tjCompress2().  Upon return, <tt>jpegSizes[i]</tt> will contain the size
+ * of the JPEG image with quality <tt>jpegQuals[i]</tt> (in bytes.)
+ *
+ * @param jpegSubsamp the level of chrominance subsampling to be used when
+ * generating the JPEG images (see @ref TJSAMP
+ * "Chrominance subsampling options".)
+ *
+ * @param jpegQuals an array of <tt>n</tt> image quality levels (1 = worst,
+ * 100 = best)
+ *
+ * @param n the number of JPEG images to generate
+ *
+ * @param flags the bitwise OR of one or more of the @ref TJFLAG_ACCURATEDCT
+ * "flags"
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2()
+ * and #tjGetErrorCode().)
+ */
+DLLEXPORT int tjCompressMulti(tjhandle handle, const unsigned char *srcBuf,
+                              int width, int pitch, int height,
+                              int pixelFormat, unsigned char **jpegBufs,
+                              unsigned long *jpegSizes, int jpegSubsamp,
+                              const int *jpegQuals, int n, int flags);
+
+
+/**
+ * Compress an RGB, grayscale, or CMYK image into a JPEG image with the
+ * highest quality level that does not exceed a target size.
+ *
+ * The quality level is found using a binary search, in which each attempt
+ * reuses the unquantized DCT coefficients from the first attempt (see
+ * #tjCompressMulti().)  This is considerably faster than searching with
+ * #tjCompress2().  The search assumes that the size of the JPEG image
+ * increases with the quality level, which is almost always the case.
+ *
+ * @param handle a handle to a TurboJPEG compressor or transformer instance
+ *
+ * @param srcBuf pointer to an image buffer containing RGB, grayscale, or
+ * CMYK pixels to be compressed (see the description of the <tt>srcBuf</tt>
+ * parameter of #tjCompress2().)
+ *
+ * @param width width (in pixels) of the source image
+ *
+ * @param pitch bytes per line in the source image (see the description of
+ * the <tt>pitch</tt> parameter of #tjCompress2().)
+ *
+ * @param height height (in pixels) of the source image
+ *
+ * @param pixelFormat pixel format of the source image (see @ref TJPF
+ * "Pixel formats".)
+ *
+ * @param jpegBuf address of a pointer to an image buffer that will receive the
+ * JPEG image (see the description of the <tt>jpegBuf</tt> parameter of
+ * #tjCompress2().)
+ *
+ * @param jpegSize pointer to an unsigned long variable that holds the size of
+ * the JPEG image buffer (see the description of the <tt>jpegSize</tt>
+ * parameter of #tjCompress2().)
+ *
+ * @param jpegSubsamp the level of chrominance subsampling to be used when
+ * generating the JPEG image (see @ref TJSAMP
+ * "Chrominance subsampling options".)
+ *
+ * @param jpegQual pointer to an int variable that specifies the highest
+ * image quality level to consider (1 = worst, 100 = best.)  Upon return,
+ * <tt>*jpegQual</tt> will contain the quality level of the JPEG image.
+ *
+ * @param targetSize the maximum size of the JPEG image (in bytes.)  If the
+ * JPEG image with quality level 1 is larger than this, then that image is
+ * returned anyway, so the caller should check <tt>*jpegSize</tt>.
+ *
+ * @param flags the bitwise OR of one or more of the @ref TJFLAG_ACCURATEDCT
+ * "flags"
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2()
+ * and #tjGetErrorCode().)
+ */
+DLLEXPORT int tjCompressToSize(tjhandle handle, const unsigned char *srcBuf,
+                               int width, int pitch, int height,
+                               int pixelFormat, unsigned char **jpegBuf,
+                               unsigned long *jpegSize, int jpegSubsamp,
+                               int *jpegQual, unsigned long targetSize,
+                               int flags);
+
+
+/**
+ * Compress an RGB, grayscale, or CMYK image into a list of JPEG chunks.
+ *
+ * This generates the same JPEG image as #tjCompress2(), but the image is
+ * written into a list of fixed-size chunks rather than into one contiguous
+ * buffer.  Thus, the JPEG data are never copied into a larger buffer as the
+ * image grows, and the peak memory usage is only the size of the JPEG image
+ * (rounded up to the chunk size.)  This is most useful for large progressive
+ * or optimized JPEG images, whose size is difficult to estimate.  The chunks
+ * can be passed to a vectored write function such as <tt>writev()</tt>.
+ *
+ * @param handle a handle to a TurboJPEG compressor or transformer instance
+ *
+ * @param srcBuf pointer to an image buffer containing RGB, grayscale, or
+ * CMYK pixels to be compressed (see the description of the <tt>srcBuf</tt>
+ * parameter of #tjCompress2().)
+ *
+ * @param width width (in pixels) of the source image
+ *
+ * @param pitch bytes per line in the source image (see the description of
+ * the <tt>pitch</tt> parameter of #tjCompress2().)
+ *
+ * @param height height (in pixels) of the source image
+ *
+ * @param pixelFormat pixel format of the source image (see @ref TJPF
+ * "Pixel formats".)
+ *
+ * @param chunks address of a pointer that will receive an array of
+ * #tjchunk structures describing the JPEG image, in order.  The array and
+ * the chunks should be freed with #tjFreeChunks() when they are no longer
+ * needed.  If the function fails, then <tt>*chunks</tt> is set to NULL.
+ *
+ * @param numChunks pointer to an int variable that will receive the number of
+ * chunks in the array
+ *
+ * @param jpegSubsamp the level of chrominance subsampling to be used when
+ * generating the JPEG image (see @ref TJSAMP
+ * "Chrominance subsampling options".)
+ *
+ * @param jpegQual the image quality of the generated JPEG image (1 = worst,
+ * 100 = best)
+ *
+ * @param flags the bitwise OR of one or more of the @ref TJFLAG_ACCURATEDCT
+ * "flags".  #TJFLAG_NOREALLOC is ignored.
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2()
+ * and #tjGetErrorCode().)
+ */
+DLLEXPORT int tjCompressToChunks(tjhandle handle, const unsigned char *srcBuf,
+                                 int width, int pitch, int height,
+                                 int pixelFormat, tjchunk **chunks,
+                                 int *numChunks, int jpegSubsamp,
+                                 int jpegQual, int flags);
+
+
+/**
+ * Free a list of JPEG chunks that was generated by #tjCompressToChunks().
+ *
+ * @param chunks pointer to the array of chunks to free
+ *
+ * @param numChunks the number of chunks in the array
+ */
+DLLEXPORT void tjFreeChunks(tjchunk *chunks, int numChunks);
+
+
+/**
+ * Compress an RGB, grayscale, or CMYK image into a JPEG image and pass the
+ * JPEG data to a callback function as they are generated.
+ *
+ * This generates the same JPEG image as #tjCompress2(), but the JPEG image is
+ * never held in memory in its entirety.  The callback receives the image in
+ * order, in pieces of 4096 bytes or less.
+ *
+ * @param handle a handle to a TurboJPEG compressor or transformer instance
+ *
+ * @param srcBuf pointer to an image buffer containing RGB, grayscale, or
+ * CMYK pixels to be compressed (see the description of the <tt>srcBuf</tt>
+ * parameter of #tjCompress2().)
+ *
+ * @param width width (in pixels) of the source image
+ *
+ * @param pitch bytes per line in the source image (see the description of
+ * the <tt>pitch</tt> parameter of #tjCompress2().)
+ *
+ * @param height height (in pixels) of the source image
+ *
+ * @param pixelFormat pixel format of the source image (see @ref TJPF
+ * "Pixel formats".)
+ *
+ * @param writeFunc function that will receive the JPEG data (see
+ * #tjwritefunc.)  If it returns -1, then the compression fails.
+ *
+ * @param userData pointer that will be passed to <tt>writeFunc</tt>
+ *
+ * @param jpegSubsamp the level of chrominance subsampling to be used when
+ * generating the JPEG image (see @ref TJSAMP
+ * "Chrominance subsampling options".)
+ *
+ * @param jpegQual the image quality of the generated JPEG image (1 = worst,
+ * 100 = best)
+ *
+ * @param flags the bitwise OR of one or more of the @ref TJFLAG_ACCURATEDCT
+ * "flags".  #TJFLAG_NOREALLOC is ignored.
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2()
+ * and #tjGetErrorCode().)
+ */
+DLLEXPORT int tjCompressToCallback(tjhandle handle,
+                                   const unsigned char *srcBuf, int width,
+                                   int pitch, int height, int pixelFormat,
+                                   tjwritefunc writeFunc, void *userData,
+                                   int jpegSubsamp, int jpegQual, int flags);
+
+
 /**
  * Compress a YUV planar image into a JPEG image.
  *
@@ -1150,6 +1573,46 @@ DLLEXPORT int tjDecompressHeader3(tjhandle handle,
                                   int *jpegColorspace);
 
 
+/**
+ * Retrieve information about a JPEG image without creating a decompressor
+ * instance.  This function parses the JPEG markers directly, up to and
+ * including the first SOS marker, and it returns the same information as
+ * #tjDecompressHeader3() without allocating any memory.  It is thus suitable
+ * for quickly classifying large numbers of JPEG images.  The contents of the
+ * quantization and Huffman tables are not validated, so an image that passes
+ * this function may still be rejected by #tjDecompressHeader3() or
+ * #tjDecompress2().  Truncated or otherwise malformed headers are never read
+ * beyond <tt>jpegSize</tt> bytes and cause this function to fail.
+ *
+ * @param jpegBuf pointer to a buffer containing a JPEG image or the beginning
+ * of one
+ *
+ * @param jpegSize size of the JPEG image (in bytes)
+ *
+ * @param width pointer to an integer variable that will receive the width (in
+ * pixels) of the JPEG image
+ *
+ * @param height pointer to an integer variable that will receive the height
+ * (in pixels) of the JPEG image
+ *
+ * @param jpegSubsamp pointer to an integer variable that will receive the
+ * level of chrominance subsampling used when the JPEG image was compressed
+ * (see @ref TJSAMP "Chrominance subsampling options".)
+ *
+ * @param jpegColorspace pointer to an integer variable that will receive one
+ * of the JPEG colorspace constants, indicating the colorspace of the JPEG
+ * image (see @ref TJCS "JPEG colorspaces".)
+ *
+ * @return 0 if successful, or -1 if an error occurred (see
+ * #tjGetErrorStr2().)  Conditions that would cause #tjDecompressHeader3() to
+ * generate a warning, such as extraneous bytes before a marker, are treated
+ * as errors.
+*/
+DLLEXPORT int tjScanHeader(const unsigned char *jpegBuf,
+                           unsigned long jpegSize, int *width, int *height,
+                           int *jpegSubsamp, int *jpegColorspace);
+
+
 /**
  * Returns a list of fractional scaling factors that the JPEG decompressor in
  * this implementation of TurboJPEG supports.
@@ -1219,6 +1682,217 @@ DLLEXPORT int tjDecompress2(tjhandle handle, const unsigned char *jpegBuf,
                             int flags);
 
 
+/**
+ * Decompress a series of JPEG images to RGB, grayscale, or CMYK images,
+ * optionally using multiple threads.
+ *
+ * This is equivalent to calling #tjDecompress2() for each image, but the JPEG
+ * header of each image is read only once, and the per-call overhead is
+ * incurred only once for the whole series.  This is beneficial when
+ * decompressing many small images, such as thumbnails or sprites.  If
+ * <tt>numThreads</tt> is greater than 1, then the images are distributed
+ * among the calling thread and <tt>numThreads - 1</tt> additional threads,
+ * each of which uses its own decompressor instance.  These instances are
+ * created the first time they are needed and are reused by subsequent calls
+ * to this function with the same TurboJPEG instance.
+ *
+ * @param handle a handle to a TurboJPEG decompressor or transformer instance
+ *
+ * @param images an array of <tt>n</tt> #tjbatchimage structures, each of
+ * which specifies a JPEG image and the destination image into which it should
+ * be decompressed.  No two destination images may overlap.
+ *
+ * @param n the number of images to decompress
+ *
+ * @param pixelFormat pixel format of the destination images (see @ref
+ * TJPF "Pixel formats".)
+ *
+ * @param flags the bitwise OR of one or more of the @ref TJFLAG_ACCURATEDCT
+ * "flags"
+ *
+ * @param numThreads the number of threads to use (including the calling
+ * thread.)  0 or 1 decompresses all of the images in the calling thread.
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2()
+ * and #tjGetErrorCode().)  If more than one image generated an error or a
+ * warning, then the error for the first such image is reported, and errors
+ * take precedence over warnings.  As with #tjDecompress2(), a warning does
+ * not prevent the image or the remaining images from being decompressed
+ * (unless #TJFLAG_STOPONWARNING is specified.)  If a fatal error occurs, then
+ * no further images are started, and the <tt>scaledWidth</tt> and
+ * <tt>scaledHeight</tt> fields of the image that caused the error and of any
+ * image that was not decompressed are set to 0.  When using multiple threads,
+ * images following the image that caused the error may already have been
+ * decompressed.
+ */
+DLLEXPORT int tjDecompressBatch(tjhandle handle, tjbatchimage *images, int n,
+                                int pixelFormat, int flags, int numThreads);
+
+
+/**
+ * Decompress a JPEG image to several RGB, grayscale, or CMYK images of
+ * different sizes.
+ *
+ * This is equivalent to calling #tjDecompress2() once for each destination
+ * image, but the JPEG image is entropy-decoded (which is usually the most
+ * expensive step of decompression) only once.  The DCT coefficients of the
+ * whole image are held in memory, and each destination image is produced from
+ * them using its own scaling factor.  This is beneficial when generating
+ * several renditions of the same image, such as for responsive web pages.
+ *
+ * @param handle a handle to a TurboJPEG decompressor or transformer instance
+ *
+ * @param jpegBuf pointer to a buffer containing the JPEG image to decompress
+ *
+ * @param jpegSize size of the JPEG image (in bytes)
+ *
+ * @param images an array of <tt>n</tt> #tjscaledimage structures, each of
+ * which specifies a destination image and the desired dimensions of that
+ * image
+ *
+ * @param n the number of destination images
+ *
+ * @param pixelFormat pixel format of the destination images (see @ref
+ * TJPF "Pixel formats".)
+ *
+ * @param flags the bitwise OR of one or more of the @ref TJFLAG_ACCURATEDCT
+ * "flags"
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2()
+ * and #tjGetErrorCode().)  If a fatal error occurs, then the
+ * <tt>scaledWidth</tt> and <tt>scaledHeight</tt> fields of the destination
+ * images that were not decompressed are set to 0.
+ */
+DLLEXPORT int tjDecompressMulti(tjhandle handle, const unsigned char *jpegBuf,
+                                unsigned long jpegSize, tjscaledimage *images,
+                                int n, int pixelFormat, int flags);
+
+
+/**
+ * Begin or continue incremental decompression of a JPEG image, and retrieve
+ * information about the image once enough of it has been received.
+ *
+ * The incremental decompression functions allow a JPEG image to be
+ * decompressed as its data arrives (for instance, from a non-blocking network
+ * socket), without first accumulating the whole image in memory.  The data
+ * is pushed to the decompressor in chunks of any size, using this function
+ * until the header has been read and #tjDecompressStreamRows() thereafter.
+ * Only the data that the decompressor has not yet been able to consume is
+ * retained between calls, so the buffers passed to these functions need not
+ * persist after the functions return.  Calling any other decompression
+ * function with the same instance abandons the stream.
+ *
+ * @param handle a handle to a TurboJPEG decompressor or transformer instance
+ *
+ * @param jpegBuf pointer to a buffer containing the next chunk of the JPEG
+ * image (may be NULL if <tt>jpegSize</tt> is 0)
+ *
+ * @param jpegSize size of the chunk (in bytes)
+ *
+ * @param width pointer to an integer variable that will receive the width (in
+ * pixels) of the JPEG image
+ *
+ * @param height pointer to an integer variable that will receive the height
+ * (in pixels) of the JPEG image
+ *
+ * @param jpegSubsamp pointer to an integer variable that will receive the
+ * level of chrominance subsampling used when the JPEG image was compressed
+ * (see @ref TJSAMP "Chrominance subsampling options".)
+ *
+ * @param jpegColorspace pointer to an integer variable that will receive one
+ * of the JPEG colorspace constants, indicating the colorspace of the JPEG
+ * image (see @ref TJCS "JPEG colorspaces".)
+ *
+ * @return 0 if the JPEG header has been read (in which case the image
+ * information has been stored in the variables described above), 1 if more
+ * data is needed in order to read the header, or -1 if an error occurred (see
+ * #tjGetErrorStr2().)  If an error occurs, then the stream is abandoned.
+ */
+DLLEXPORT int tjDecompressStreamHeader(tjhandle handle,
+                                       const unsigned char *jpegBuf,
+                                       unsigned long jpegSize, int *width,
+                                       int *height, int *jpegSubsamp,
+                                       int *jpegColorspace);
+
+
+/**
+ * Continue incremental decompression of a JPEG image, decompressing as many
+ * rows as the data received so far allows into an RGB, grayscale, or CMYK
+ * image.  #tjDecompressStreamHeader() must have successfully read the JPEG
+ * header before this function is called.
+ *
+ * The destination image parameters are set by the first call to this
+ * function for a given image, and the same values must be passed to all
+ * subsequent calls for that image.  Images with multiple scans (such as
+ * progressive JPEG images) are buffered internally, and no rows are
+ * available until the last scan has been received.  Arithmetic-coded images
+ * are not decompressed until the whole image has been received, since the
+ * arithmetic entropy decoder cannot suspend.  Once all rows have been
+ * decompressed, the stream ends, and the next call to
+ * #tjDecompressStreamHeader() begins a new image.
+ *
+ * @param handle a handle to a TurboJPEG decompressor or transformer instance
+ *
+ * @param jpegBuf pointer to a buffer containing the next chunk of the JPEG
+ * image (may be NULL if <tt>jpegSize</tt> is 0)
+ *
+ * @param jpegSize size of the chunk (in bytes)
+ *
+ * @param dstBuf pointer to an image buffer that will receive the decompressed
+ * image (see #tjDecompress2() for a description of this parameter and the
+ * next four parameters)
+ *
+ * @param width desired width (in pixels) of the destination image
+ *
+ * @param pitch bytes per line in the destination image
+ *
+ * @param height desired height (in pixels) of the destination image
+ *
+ * @param pixelFormat pixel format of the destination image (see @ref
+ * TJPF "Pixel formats".)
+ *
+ * @param flags the bitwise OR of one or more of the @ref TJFLAG_ACCURATEDCT
+ * "flags"
+ *
+ * @return the number of rows of the destination image that have been
+ * decompressed so far (the stream has ended if this is equal to the scaled
+ * image height), or -1 if an error occurred (see #tjGetErrorStr2() and
+ * #tjGetErrorCode().)  As with #tjDecompress2(), a warning (such as one
+ * caused by corrupt data) also causes this function to return -1, and
+ * #tjGetErrorCode() then returns #TJERR_WARNING.  In that case, the stream is
+ * not abandoned unless #TJFLAG_STOPONWARNING is specified, and the rows
+ * decompressed so far remain valid.  Calling this function again (with
+ * <tt>jpegSize</tt> set to 0, if there is no more data) continues the stream
+ * and returns the number of rows.  Any other error abandons the stream.
+ */
+DLLEXPORT int tjDecompressStreamRows(tjhandle handle,
+                                     const unsigned char *jpegBuf,
+                                     unsigned long jpegSize,
+                                     unsigned char *dstBuf, int width,
+                                     int pitch, int height, int pixelFormat,
+                                     int flags);
+
+
+/**
+ * End incremental decompression of a JPEG image.  If the destination image
+ * has been set up by #tjDecompressStreamRows(), then the remaining rows are
+ * decompressed as if the JPEG image were truncated at the end of the data
+ * received so far, which generates a warning.  Otherwise, the stream is
+ * simply abandoned.
+ *
+ * @param handle a handle to a TurboJPEG decompressor or transformer instance
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2()
+ * and #tjGetErrorCode().)  As with #tjDecompress2(), a warning also causes
+ * this function to return -1, and #tjGetErrorCode() then returns
+ * #TJERR_WARNING.  Thus, this function returns -1 if the JPEG image was
+ * truncated, but the remaining rows of the destination image are still
+ * filled in unless #TJFLAG_STOPONWARNING was passed to
+ * #tjDecompressStreamRows().
+ */
+DLLEXPORT int tjDecompressStreamFinish(tjhandle handle);
+
+
 /**
  * Decompress a JPEG image to a YUV planar image.  This function performs JPEG
  * decompression but leaves out the color conversion step, so a planar YUV
@@ -1533,7 +2207,12 @@ DLLEXPORT int tjDestroy(tjhandle handle);
  * Allocate an image buffer for use with TurboJPEG.  You should always use
  * this function to allocate the JPEG destination buffer(s) for the compression
  * and transform functions unless you are disabling automatic buffer
- * (re)allocation (by setting #TJFLAG_NOREALLOC.)
+ * (re)allocation (by setting #TJFLAG_NOREALLOC.)  Unless #TJFLAG_NOREALLOC is
+ * set, a compression or transform function that needs to enlarge a buffer
+ * allocated with this function passes it to <tt>realloc()</tt>, so the
+ * original pointer may no longer be valid when the function returns.  Always
+ * use the updated pointer that the function stores in <tt>*jpegBuf</tt> (or
+ * <tt>dstBufs[i]</tt>), even if the function fails.
  *
  * @param bytes the number of bytes to allocate
  *
@@ -1670,6 +2349,57 @@ DLLEXPORT char *tjGetErrorStr2(tjhandle handle);
 DLLEXPORT int tjGetErrorCode(tjhandle handle);
 
 
+/**
+ * Enable or disable per-stage timing for the given TurboJPEG instance.
+ * Enabling profiling clears the counters.  While profiling is enabled, the
+ * time spent in each stage of subsequent compression, decompression, and
+ * transform operations is accumulated in the counters, which can be retrieved
+ * by calling #tjGetProfile().
+ *
+ * @param handle a handle to a TurboJPEG compressor, decompressor, or
+ * transformer instance
+ *
+ * @param enable 1 to enable profiling and clear the counters, or 0 to disable
+ * profiling and leave the counters intact
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2().)
+ * An error is returned if the underlying codec was built without profiling
+ * support (the <tt>WITH_PROFILE</tt> CMake variable.)
+ */
+DLLEXPORT int tjEnableProfiling(tjhandle handle, int enable);
+
+
+/**
+ * Retrieve the per-stage timing counters for the given TurboJPEG instance.
+ * For a transformer instance, the counters for the decompressor and the
+ * compressor are summed.
+ *
+ * @param handle a handle to a TurboJPEG compressor, decompressor, or
+ * transformer instance
+ *
+ * @param profile pointer to an array of #TJ_NUMPROF #tjprofile structures,
+ * indexed by @ref TJPROF "profiling stage", that will receive the counters.
+ * The counters are all zero if profiling has never been enabled for the
+ * instance.
+ *
+ * @return 0 if successful, or -1 if an error occurred (see #tjGetErrorStr2().)
+ */
+DLLEXPORT int tjGetProfile(tjhandle handle, tjprofile *profile);
+
+
+/**
+ * Returns the name of the SIMD instruction set extension that the underlying
+ * codec uses on this CPU (for instance, "AVX2", "SSE2", or "NEON"), or "none"
+ * if the codec was built without SIMD extensions or if they are unavailable
+ * or disabled.  The result takes into account the <tt>JSIMD_FORCE*</tt>
+ * environment variables, and it is intended to be recorded along with
+ * benchmark results.
+ *
+ * @return the name of the SIMD instruction set extension in use
+ */
+DLLEXPORT const char *tjGetSIMDName(void);
+
+
 /* Deprecated functions and macros */
 #define TJFLAG_FORCEMMX  8
 #define TJFLAG_FORCESSE  16
@@ -104,6 +104,16 @@ put_pixel_rows(j_decompress_ptr cinfo, djpeg_dest_ptr dinfo,
   register JDIMENSION col;
   int pad;
 
+  if (!dest->use_inversion_array && cinfo->out_color_space == JCS_EXT_BGR &&
+      dest->pad_bytes == 0) {
+    /* The pixels are already in BMP order, and no padding is needed, so we
+     * can write them straight from the decompressor output buffer.
+     */
+    (void)JFWRITE(dest->pub.output_file, dest->pub.buffer[0],
+                  dest->row_width);
+    return;
+  }
+
   if (dest->use_inversion_array) {
     /* Access next row in virtual array */
     image_ptr = (*cinfo->mem->access_virt_sarray)
@@ -121,7 +131,7 @@ put_pixel_rows(j_decompress_ptr cinfo, djpeg_dest_ptr dinfo,
   inptr = dest->pub.buffer[0];
 
   if (cinfo->out_color_space == JCS_EXT_BGR) {
-    MEMCOPY(outptr, inptr, dest->row_width);
+    MEMCOPY(outptr, inptr, dest->data_width);
     outptr += cinfo->output_width * 3;
   } else if (cinfo->out_color_space == JCS_RGB565) {
     boolean big_endian = is_big_endian();
@@ -83,7 +83,9 @@ typedef ppm_dest_struct *ppm_dest_ptr;
  * In this module rows_supplied will always be 1.
  *
  * put_pixel_rows handles the "normal" 8-bit case where the decompressor
- * output buffer is physically the same as the fwrite buffer.
+ * output buffer is physically the same as the fwrite buffer.  We write from
+ * whatever row the buffer pointer currently designates, so the caller may
+ * also substitute its own row.
  */
 
 METHODDEF(void)
@@ -92,7 +94,8 @@ put_pixel_rows(j_decompress_ptr cinfo, djpeg_dest_ptr dinfo,
 {
   ppm_dest_ptr dest = (ppm_dest_ptr)dinfo;
 
-  (void)JFWRITE(dest->pub.output_file, dest->iobuffer, dest->buffer_width);
+  (void)JFWRITE(dest->pub.output_file, dest->pub.buffer[0],
+                dest->buffer_width);
 }
 
 